@@ -50,6 +50,7 @@
 #include "voxblox/integrator/integrator_utils.h"
 #include "voxblox/interpolator/interpolator.h"
 #include "voxblox/utils/approx_hash_array.h"
+#include "voxblox/utils/thread_pool.h"
 
 namespace voxblox {
 
@@ -124,6 +125,15 @@ class ICP {
 
   bool refiningRollPitch() { return config_.refine_roll_pitch; }
 
+  /**
+   * Matches the mini batches on the workers of thread_pool, which may be
+   * shared with the integrators, instead of a pool of num_threads - 1 workers
+   * that is created on first use.
+   */
+  void setThreadPool(const ThreadPool::Ptr& thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+
  private:
   typedef Transformation::Vector6 Vector6;
 
@@ -226,6 +236,8 @@ class ICP {
   FloatingPoint voxel_size_;
   FloatingPoint voxel_size_inv_;
   std::shared_ptr<Interpolator<TsdfVoxel>> interpolator_;
+
+  ThreadPool::Ptr thread_pool_;
 };
 
 }  // namespace voxblox
@@ -9,6 +9,7 @@
 
 #include "voxblox/Block.pb.h"
 #include "voxblox/core/common.h"
+#include "voxblox/core/voxel_storage.h"
 
 namespace voxblox {
 
@@ -17,27 +18,43 @@ namespace Update {
 enum Status { kMap, kMesh, kEsdf, kCount };
 }  // namespace Update
 
-/** An n x n x n container holding VoxelType. It is aware of its 3D position and
- * contains functions for accessing voxels by position and index */
-template <typename VoxelType>
+/**
+ * An n x n x n container holding VoxelType. It is aware of its 3D position and
+ * contains functions for accessing voxels by position and index. The memory
+ * layout of the voxels is selected through VoxelStorageType, see
+ * voxel_storage.h. The functions returning raw voxel pointers are only
+ * available with the default AosVoxelStorage.
+ */
+template <typename VoxelType,
+          template <typename> class VoxelStorageType = AosVoxelStorage>
 class Block {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-  typedef std::shared_ptr<Block<VoxelType> > Ptr;
-  typedef std::shared_ptr<const Block<VoxelType> > ConstPtr;
+  typedef std::shared_ptr<Block> Ptr;
+  typedef std::shared_ptr<const Block> ConstPtr;
+  typedef VoxelStorageType<VoxelType> VoxelStorage;
+  typedef typename VoxelStorage::VoxelRef VoxelRef;
+  typedef typename VoxelStorage::ConstVoxelRef ConstVoxelRef;
 
   Block(size_t voxels_per_side, FloatingPoint voxel_size, const Point& origin)
       : has_data_(false),
         voxels_per_side_(voxels_per_side),
         voxel_size_(voxel_size),
         origin_(origin),
-        updated_(false) {
+        updated_(false),
+        num_observed_voxels_(0u) {
     num_voxels_ = voxels_per_side_ * voxels_per_side_ * voxels_per_side_;
     voxel_size_inv_ = 1.0 / voxel_size_;
     block_size_ = voxels_per_side_ * voxel_size_;
     block_size_inv_ = 1.0 / block_size_;
-    voxels_.reset(new VoxelType[num_voxels_]);
+    voxels_.allocate(num_voxels_);
+    num_mask_words_ = (num_voxels_ + kBitsPerMaskWord - 1u) / kBitsPerMaskWord;
+    observed_mask_.reset(new std::atomic<uint64_t>[num_mask_words_]);
+    clearObservedMask();
+    dirty_masks_.reset(
+        new std::atomic<uint64_t>[Update::kCount * num_mask_words_]);
+    markAllVoxelsDirty();
   }
 
   explicit Block(const BlockProto& proto);
@@ -94,11 +111,11 @@ class Block {
   VoxelIndex computeVoxelIndexFromLinearIndex(size_t linear_index) const;
 
   /// Accessors to actual blocks.
-  inline const VoxelType& getVoxelByLinearIndex(size_t index) const {
+  inline ConstVoxelRef getVoxelByLinearIndex(size_t index) const {
     return voxels_[index];
   }
 
-  inline const VoxelType& getVoxelByVoxelIndex(const VoxelIndex& index) const {
+  inline ConstVoxelRef getVoxelByVoxelIndex(const VoxelIndex& index) const {
     return voxels_[computeLinearIndexFromVoxelIndex(index)];
   }
 
@@ -108,7 +125,7 @@ class Block {
    *of this block. Try not to use this function if there is an alternative to
    * directly address the voxels via precise integer indexing math.
    */
-  inline const VoxelType& getVoxelByCoordinates(const Point& coords) const {
+  inline ConstVoxelRef getVoxelByCoordinates(const Point& coords) const {
     return voxels_[computeLinearIndexFromCoordinates(coords)];
   }
 
@@ -118,8 +135,10 @@ class Block {
    *of this block. Try not to use this function if there is an alternative to
    * directly address the voxels via precise integer indexing math.
    */
-  inline VoxelType& getVoxelByCoordinates(const Point& coords) {
-    return voxels_[computeLinearIndexFromCoordinates(coords)];
+  inline VoxelRef getVoxelByCoordinates(const Point& coords) {
+    const size_t linear_index = computeLinearIndexFromCoordinates(coords);
+    markVoxelObserved(linear_index);
+    return voxels_[linear_index];
   }
 
   /**
@@ -129,20 +148,25 @@ class Block {
    * directly address the voxels via precise integer indexing math.
    */
   inline VoxelType* getVoxelPtrByCoordinates(const Point& coords) {
-    return &voxels_[computeLinearIndexFromCoordinates(coords)];
+    const size_t linear_index = computeLinearIndexFromCoordinates(coords);
+    markVoxelObserved(linear_index);
+    return &voxels_[linear_index];
   }
 
   inline const VoxelType* getVoxelPtrByCoordinates(const Point& coords) const {
     return &voxels_[computeLinearIndexFromCoordinates(coords)];
   }
 
-  inline VoxelType& getVoxelByLinearIndex(size_t index) {
+  inline VoxelRef getVoxelByLinearIndex(size_t index) {
     DCHECK_LT(index, num_voxels_);
+    markVoxelObserved(index);
     return voxels_[index];
   }
 
-  inline VoxelType& getVoxelByVoxelIndex(const VoxelIndex& index) {
-    return voxels_[computeLinearIndexFromVoxelIndex(index)];
+  inline VoxelRef getVoxelByVoxelIndex(const VoxelIndex& index) {
+    const size_t linear_index = computeLinearIndexFromVoxelIndex(index);
+    markVoxelObserved(linear_index);
+    return voxels_[linear_index];
   }
 
   inline bool isValidVoxelIndex(const VoxelIndex& index) const;
@@ -178,17 +202,140 @@ class Block {
   }
   void set_has_data(bool has_data) { has_data_ = has_data; }
 
+  /**
+   * Gives direct access to the storage, e.g. to the planes of a SoA layout.
+   * Writing through it bypasses the observed mask, use markVoxelObserved or
+   * recomputeObservedMask afterwards.
+   */
+  const VoxelStorage& voxels() const { return voxels_; }
+  VoxelStorage& voxels() { return voxels_; }
+
+  /**
+   * The observed mask is a conservative record of the voxels that hold data.
+   * The bit of a voxel is set whenever the voxel is accessed through one of
+   * the non-const accessors, so a cleared bit guarantees that the voxel is
+   * still default constructed. Passes that ignore default voxels can then skip
+   * straight to the set bits with forEachObservedVoxel. Thread safe.
+   */
+  inline void markVoxelObserved(size_t linear_index) {
+    DCHECK_LT(linear_index, num_voxels_);
+    const uint64_t bit = uint64_t{1u} << (linear_index % kBitsPerMaskWord);
+    std::atomic<uint64_t>& word =
+        observed_mask_[linear_index / kBitsPerMaskWord];
+    // Most writes hit voxels that are already marked, so avoid the atomic
+    // read-modify-write in that case.
+    if ((word.load(std::memory_order_relaxed) & bit) == 0u &&
+        (word.fetch_or(bit, std::memory_order_relaxed) & bit) == 0u) {
+      num_observed_voxels_.fetch_add(1u, std::memory_order_relaxed);
+    }
+  }
+
+  inline bool isVoxelObserved(size_t linear_index) const {
+    DCHECK_LT(linear_index, num_voxels_);
+    const uint64_t bit = uint64_t{1u} << (linear_index % kBitsPerMaskWord);
+    return (observed_mask_[linear_index / kBitsPerMaskWord].load(
+                std::memory_order_relaxed) &
+            bit) != 0u;
+  }
+
+  /// Number of set bits in the observed mask.
+  size_t num_observed_voxels() const {
+    return num_observed_voxels_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Calls function(linear_index) for every voxel in the observed mask, in
+   * increasing order of the linear index. NOT thread safe against concurrent
+   * writes to the block.
+   */
+  template <typename Function>
+  void forEachObservedVoxel(Function&& function) const;
+
+  /// Rebuilds the observed mask from the voxel data, see hasVoxelData().
+  void recomputeObservedMask();
+
+  /**
+   * The dirty masks record which voxels changed since the derived thing of
+   * each Update::Status was last updated from the block, so that it can be
+   * updated for these voxels only, unlike updated() which only flags the
+   * block as a whole. A new block starts with all voxels dirty. Recording
+   * them is up to the producer, see
+   * TsdfIntegratorBase::Config::track_dirty_voxels. Marks the voxel for all
+   * statuses. Thread safe.
+   */
+  inline void markVoxelDirty(size_t linear_index) {
+    DCHECK_LT(linear_index, num_voxels_);
+    const uint64_t bit = uint64_t{1u} << (linear_index % kBitsPerMaskWord);
+    const size_t word_idx = linear_index / kBitsPerMaskWord;
+    for (int status = 0; status < Update::kCount; ++status) {
+      std::atomic<uint64_t>& word =
+          dirty_masks_[status * num_mask_words_ + word_idx];
+      if ((word.load(std::memory_order_relaxed) & bit) == 0u) {
+        word.fetch_or(bit, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// Marks all voxels, for changes to the whole block. NOT thread safe.
+  void markAllVoxelsDirty();
+  void markAllVoxelsDirty(Update::Status status);
+
+  inline bool isVoxelDirty(Update::Status status, size_t linear_index) const {
+    DCHECK_LT(linear_index, num_voxels_);
+    const uint64_t bit = uint64_t{1u} << (linear_index % kBitsPerMaskWord);
+    return (dirty_masks_[status * num_mask_words_ +
+                         linear_index / kBitsPerMaskWord]
+                .load(std::memory_order_relaxed) &
+            bit) != 0u;
+  }
+
+  bool hasDirtyVoxels(Update::Status status) const;
+
+  /// True if one of the voxels in [begin, end) is marked.
+  bool hasDirtyVoxelsInRange(Update::Status status, size_t begin,
+                             size_t end) const;
+
+  /**
+   * Calls function(linear_index) for every voxel in the dirty mask of status,
+   * in increasing order of the linear index. If no voxel is marked, e.g.
+   * because the producer does not record dirty voxels, all voxels are
+   * visited. NOT thread safe against concurrent writes to the block.
+   */
+  template <typename Function>
+  void forEachDirtyVoxel(Update::Status status, Function&& function) const;
+
+  /// NOT thread safe against concurrent writes to the block.
+  void clearDirtyVoxels(Update::Status status) {
+    std::atomic<uint64_t>* mask = &dirty_masks_[status * num_mask_words_];
+    for (size_t i = 0u; i < num_mask_words_; ++i) {
+      mask[i].store(0u, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Brings the block back into its freshly constructed state at a new origin
+   * without reallocating the voxels, used to recycle blocks from a BlockPool.
+   */
+  void reinitialize(const Point& origin) {
+    voxels_.fill(VoxelType());
+    clearObservedMask();
+    markAllVoxelsDirty();
+    origin_ = origin;
+    has_data_ = false;
+    updated_.reset();
+  }
+
   // Serialization.
   void getProto(BlockProto* proto) const;
   void serializeToIntegers(std::vector<uint32_t>* data) const;
   void deserializeFromIntegers(const std::vector<uint32_t>& data);
 
-  void mergeBlock(const Block<VoxelType>& other_block);
+  void mergeBlock(const Block& other_block);
 
   size_t getMemorySize() const;
 
  protected:
-  std::unique_ptr<VoxelType[]> voxels_;
+  VoxelStorage voxels_;
 
   // Derived, cached parameters.
   size_t num_voxels_;
@@ -197,6 +344,15 @@ class Block {
   bool has_data_;
 
  private:
+  static constexpr size_t kBitsPerMaskWord = 64u;
+
+  void clearObservedMask() {
+    for (size_t i = 0u; i < num_mask_words_; ++i) {
+      observed_mask_[i].store(0u, std::memory_order_relaxed);
+    }
+    num_observed_voxels_.store(0u, std::memory_order_relaxed);
+  }
+
   void deserializeProto(const BlockProto& proto);
   void serializeProto(BlockProto* proto) const;
 
@@ -212,6 +368,14 @@ class Block {
 
   /// Is set to true when data is updated.
   std::bitset<Update::kCount> updated_;
+
+  /// One bit per voxel, see markVoxelObserved.
+  size_t num_mask_words_;
+  std::unique_ptr<std::atomic<uint64_t>[]> observed_mask_;
+  std::atomic<size_t> num_observed_voxels_;
+
+  /// Update::kCount masks of num_mask_words_ words, see markVoxelDirty.
+  std::unique_ptr<std::atomic<uint64_t>[]> dirty_masks_;
 };
 
 }  // namespace voxblox
@@ -9,6 +9,7 @@
 #include <Eigen/Core>
 
 #include "voxblox/core/common.h"
+#include "voxblox/utils/flat_hash_map.h"
 
 namespace voxblox {
 
@@ -44,6 +45,45 @@ typedef std::unordered_set<AnyIndex, AnyIndexHash, std::equal_to<AnyIndex>,
                            Eigen::aligned_allocator<AnyIndex> >
     IndexSet;
 
+/**
+ * Hash for block indexes that avalanches all input bits into the low bits of
+ * the output, which is what open-addressing maps use to pick a slot. The
+ * linear combination in AnyIndexHash maps neighboring blocks to neighboring
+ * hashes, leading to long probe sequences in such maps. The coordinates are
+ * combined and then mixed with the 64 bit finalizer of MurmurHash3.
+ */
+struct AnyIndexMixingHash {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  std::size_t operator()(const AnyIndex& index) const {
+    constexpr uint64_t kPrime = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = static_cast<uint32_t>(index.x());
+    hash = hash * kPrime + static_cast<uint32_t>(index.y());
+    hash = hash * kPrime + static_cast<uint32_t>(index.z());
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return static_cast<std::size_t>(hash);
+  }
+};
+
+/**
+ * Flat, open-addressing alternative to AnyIndexHashMapType. Faster lookups and
+ * iteration, but insertions and erasures invalidate all iterators and
+ * references into the map, see FlatHashMap.
+ */
+template <typename ValueType>
+struct FlatAnyIndexHashMapType {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef FlatHashMap<AnyIndex, ValueType, AnyIndexMixingHash,
+                      std::equal_to<AnyIndex> >
+      type;
+};
+
 typedef typename AnyIndexHashMapType<IndexVector>::type HierarchicalIndexMap;
 
 typedef typename AnyIndexHashMapType<IndexSet>::type HierarchicalIndexSet;
@@ -77,6 +117,35 @@ typedef std::unordered_set<LongIndex, LongIndexHash, std::equal_to<LongIndex>,
                            Eigen::aligned_allocator<LongIndex> >
     LongIndexSet;
 
+/// Mixing hash for large index values, see AnyIndexMixingHash.
+struct LongIndexMixingHash {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  std::size_t operator()(const LongIndex& index) const {
+    constexpr uint64_t kPrime = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = static_cast<uint64_t>(index.x());
+    hash = hash * kPrime + static_cast<uint64_t>(index.y());
+    hash = hash * kPrime + static_cast<uint64_t>(index.z());
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return static_cast<std::size_t>(hash);
+  }
+};
+
+/// Flat alternative to LongIndexHashMapType, see FlatAnyIndexHashMapType.
+template <typename ValueType>
+struct FlatLongIndexHashMapType {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef FlatHashMap<LongIndex, ValueType, LongIndexMixingHash,
+                      std::equal_to<LongIndex> >
+      type;
+};
+
 }  // namespace voxblox
 
 #endif  // VOXBLOX_CORE_BLOCK_HASH_H_
@@ -9,8 +9,8 @@
 
 namespace voxblox {
 
-template <typename VoxelType>
-size_t Block<VoxelType>::computeLinearIndexFromVoxelIndex(
+template <typename VoxelType, template <typename> class VoxelStorageType>
+size_t Block<VoxelType, VoxelStorageType>::computeLinearIndexFromVoxelIndex(
     const VoxelIndex& index) const {
   size_t linear_index = static_cast<size_t>(
       index.x() +
@@ -26,8 +26,9 @@ size_t Block<VoxelType>::computeLinearIndexFromVoxelIndex(
   return linear_index;
 }
 
-template <typename VoxelType>
-VoxelIndex Block<VoxelType>::computeTruncatedVoxelIndexFromCoordinates(
+template <typename VoxelType, template <typename> class VoxelStorageType>
+VoxelIndex
+Block<VoxelType, VoxelStorageType>::computeTruncatedVoxelIndexFromCoordinates(
     const Point& coords) const {
   const IndexElement max_value = voxels_per_side_ - 1;
   VoxelIndex voxel_index =
@@ -39,8 +40,8 @@ VoxelIndex Block<VoxelType>::computeTruncatedVoxelIndexFromCoordinates(
                     std::max(std::min(voxel_index.z(), max_value), 0));
 }
 
-template <typename VoxelType>
-VoxelIndex Block<VoxelType>::computeVoxelIndexFromLinearIndex(
+template <typename VoxelType, template <typename> class VoxelStorageType>
+VoxelIndex Block<VoxelType, VoxelStorageType>::computeVoxelIndexFromLinearIndex(
     size_t linear_index) const {
   int rem = linear_index;
   VoxelIndex result;
@@ -53,8 +54,9 @@ VoxelIndex Block<VoxelType>::computeVoxelIndexFromLinearIndex(
   return result;
 }
 
-template <typename VoxelType>
-bool Block<VoxelType>::isValidVoxelIndex(const VoxelIndex& index) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Block<VoxelType, VoxelStorageType>::isValidVoxelIndex(
+    const VoxelIndex& index) const {
   if (index.x() < 0 ||
       index.x() >= static_cast<IndexElement>(voxels_per_side_)) {
     return false;
@@ -70,8 +72,8 @@ bool Block<VoxelType>::isValidVoxelIndex(const VoxelIndex& index) const {
   return true;
 }
 
-template <typename VoxelType>
-Block<VoxelType>::Block(const BlockProto& proto)
+template <typename VoxelType, template <typename> class VoxelStorageType>
+Block<VoxelType, VoxelStorageType>::Block(const BlockProto& proto)
     : Block(proto.voxels_per_side(), proto.voxel_size(),
             Point(proto.origin_x(), proto.origin_y(), proto.origin_z())) {
   has_data_ = proto.has_data();
@@ -87,8 +89,8 @@ Block<VoxelType>::Block(const BlockProto& proto)
   deserializeFromIntegers(data);
 }
 
-template <typename VoxelType>
-void Block<VoxelType>::getProto(BlockProto* proto) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+void Block<VoxelType, VoxelStorageType>::getProto(BlockProto* proto) const {
   CHECK_NOTNULL(proto);
 
   proto->set_voxels_per_side(voxels_per_side_);
@@ -108,8 +110,8 @@ void Block<VoxelType>::getProto(BlockProto* proto) const {
   }
 }
 
-template <typename VoxelType>
-void Block<VoxelType>::mergeBlock(const Block<VoxelType>& other_block) {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+void Block<VoxelType, VoxelStorageType>::mergeBlock(const Block& other_block) {
   CHECK_EQ(other_block.voxel_size(), voxel_size());
   CHECK_EQ(other_block.voxels_per_side(), voxels_per_side());
 
@@ -119,17 +121,125 @@ void Block<VoxelType>::mergeBlock(const Block<VoxelType>& other_block) {
     has_data() = true;
     updated().set();
 
-    for (IndexElement voxel_idx = 0;
-         voxel_idx < static_cast<IndexElement>(num_voxels()); ++voxel_idx) {
+    // Merging a default constructed voxel does not change the other voxel, so
+    // only the observed voxels of the other block need to be merged.
+    other_block.forEachObservedVoxel([this, &other_block](size_t voxel_idx) {
+      VoxelType voxel = getVoxelByLinearIndex(voxel_idx);
       mergeVoxelAIntoVoxelB<VoxelType>(
-          other_block.getVoxelByLinearIndex(voxel_idx),
-          &(getVoxelByLinearIndex(voxel_idx)));
+          other_block.getVoxelByLinearIndex(voxel_idx), &voxel);
+      getVoxelByLinearIndex(voxel_idx) = voxel;
+      markVoxelDirty(voxel_idx);
+    });
+  }
+}
+
+template <typename VoxelType, template <typename> class VoxelStorageType>
+template <typename Function>
+void Block<VoxelType, VoxelStorageType>::forEachObservedVoxel(
+    Function&& function) const {
+  for (size_t word_idx = 0u; word_idx < num_mask_words_; ++word_idx) {
+    uint64_t word = observed_mask_[word_idx].load(std::memory_order_relaxed);
+    while (word != 0u) {
+      const size_t bit_idx = static_cast<size_t>(__builtin_ctzll(word));
+      function(word_idx * kBitsPerMaskWord + bit_idx);
+      // Clear the lowest set bit.
+      word &= word - 1u;
+    }
+  }
+}
+
+template <typename VoxelType, template <typename> class VoxelStorageType>
+void Block<VoxelType, VoxelStorageType>::recomputeObservedMask() {
+  clearObservedMask();
+  for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
+    if (hasVoxelData<VoxelType>(voxels_[voxel_idx])) {
+      markVoxelObserved(voxel_idx);
+    }
+  }
+}
+
+template <typename VoxelType, template <typename> class VoxelStorageType>
+void Block<VoxelType, VoxelStorageType>::markAllVoxelsDirty() {
+  for (int status = 0; status < Update::kCount; ++status) {
+    markAllVoxelsDirty(static_cast<Update::Status>(status));
+  }
+}
+
+template <typename VoxelType, template <typename> class VoxelStorageType>
+void Block<VoxelType, VoxelStorageType>::markAllVoxelsDirty(
+    Update::Status status) {
+  std::atomic<uint64_t>* mask = &dirty_masks_[status * num_mask_words_];
+  for (size_t i = 0u; i < num_mask_words_; ++i) {
+    // The last word may be partially used.
+    const size_t num_bits = num_voxels_ - i * kBitsPerMaskWord;
+    mask[i].store((num_bits >= kBitsPerMaskWord)
+                      ? ~uint64_t{0u}
+                      : ((uint64_t{1u} << num_bits) - 1u),
+                  std::memory_order_relaxed);
+  }
+}
+
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Block<VoxelType, VoxelStorageType>::hasDirtyVoxels(
+    Update::Status status) const {
+  const std::atomic<uint64_t>* mask = &dirty_masks_[status * num_mask_words_];
+  for (size_t i = 0u; i < num_mask_words_; ++i) {
+    if (mask[i].load(std::memory_order_relaxed) != 0u) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Block<VoxelType, VoxelStorageType>::hasDirtyVoxelsInRange(
+    Update::Status status, size_t begin, size_t end) const {
+  DCHECK_LE(end, num_voxels_);
+  if (begin >= end) {
+    return false;
+  }
+  const std::atomic<uint64_t>* mask = &dirty_masks_[status * num_mask_words_];
+  const size_t first_word = begin / kBitsPerMaskWord;
+  const size_t last_word = (end - 1u) / kBitsPerMaskWord;
+  for (size_t word_idx = first_word; word_idx <= last_word; ++word_idx) {
+    uint64_t word = mask[word_idx].load(std::memory_order_relaxed);
+    if (word_idx == first_word) {
+      word &= ~uint64_t{0u} << (begin % kBitsPerMaskWord);
+    }
+    if (word_idx == last_word) {
+      word &= ~uint64_t{0u} >> (kBitsPerMaskWord - 1u - (end - 1u) %
+                                                     kBitsPerMaskWord);
+    }
+    if (word != 0u) {
+      return true;
     }
   }
+  return false;
 }
 
-template <typename VoxelType>
-size_t Block<VoxelType>::getMemorySize() const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+template <typename Function>
+void Block<VoxelType, VoxelStorageType>::forEachDirtyVoxel(
+    Update::Status status, Function&& function) const {
+  if (!hasDirtyVoxels(status)) {
+    for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
+      function(voxel_idx);
+    }
+    return;
+  }
+  const std::atomic<uint64_t>* mask = &dirty_masks_[status * num_mask_words_];
+  for (size_t word_idx = 0u; word_idx < num_mask_words_; ++word_idx) {
+    uint64_t word = mask[word_idx].load(std::memory_order_relaxed);
+    while (word != 0u) {
+      const size_t bit_idx = static_cast<size_t>(__builtin_ctzll(word));
+      function(word_idx * kBitsPerMaskWord + bit_idx);
+      word &= word - 1u;
+    }
+  }
+}
+
+template <typename VoxelType, template <typename> class VoxelStorageType>
+size_t Block<VoxelType, VoxelStorageType>::getMemorySize() const {
   size_t size = 0u;
 
   // Calculate size of members
@@ -142,10 +252,12 @@ size_t Block<VoxelType>::getMemorySize() const {
 
   size += sizeof(has_data_);
   size += sizeof(updated_);
+  size += sizeof(num_mask_words_);
+  size += sizeof(num_observed_voxels_);
+  size += num_mask_words_ * sizeof(uint64_t);
+  size += Update::kCount * num_mask_words_ * sizeof(uint64_t);
 
-  if (num_voxels_ > 0u) {
-    size += (num_voxels_ * sizeof(voxels_[0]));
-  }
+  size += voxels_.getMemorySize();
   return size;
 }
 
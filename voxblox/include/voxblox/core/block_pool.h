@@ -0,0 +1,160 @@
+#ifndef VOXBLOX_CORE_BLOCK_POOL_H_
+#define VOXBLOX_CORE_BLOCK_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/block.h"
+#include "voxblox/core/common.h"
+#include "voxblox/utils/timing.h"
+
+namespace voxblox {
+
+/**
+ * Free list of blocks that were removed from a layer. Recycling a pooled block
+ * reuses both its voxel array and the control block of its shared pointer, so
+ * allocating a block while a robot moves through the world does not touch the
+ * heap. Only blocks that are no longer referenced anywhere else are pooled and
+ * at most max_num_pooled_blocks of them are kept, setting it to 0 disables the
+ * pool. All blocks of a pool must share the same voxel size and voxels per
+ * side, which is why every layer owns its own pool.
+ *
+ * Every allocation is timed by the "block_pool/hit" or "block_pool/miss"
+ * timer, so their numbers of samples give the hit rate of all pools.
+ *
+ * All functions are thread safe. A mutex guards the free list and the
+ * counters only, blocks are constructed and freed outside of it.
+ */
+template <typename VoxelType,
+          template <typename> class VoxelStorageType = AosVoxelStorage>
+class BlockPool {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Block<VoxelType, VoxelStorageType> BlockType;
+
+  static constexpr size_t kDefaultMaxNumPooledBlocks = 256u;
+
+  explicit BlockPool(
+      size_t max_num_pooled_blocks = kDefaultMaxNumPooledBlocks)
+      : max_num_pooled_blocks_(max_num_pooled_blocks),
+        num_hits_(0u),
+        num_misses_(0u) {}
+
+  /// Pooled blocks are owned exclusively, sharing them would hand them out
+  /// twice.
+  BlockPool(const BlockPool&) = delete;
+  BlockPool& operator=(const BlockPool&) = delete;
+
+  /// Pops a block from the free list or allocates a new one if it is empty.
+  typename BlockType::Ptr allocateBlock(size_t voxels_per_side,
+                                        FloatingPoint voxel_size,
+                                        const Point& origin) {
+    // Looking up the handles once avoids constructing the tags every block.
+    static const size_t kHitTimer = timing::Timing::GetHandle("block_pool/hit");
+    static const size_t kMissTimer =
+        timing::Timing::GetHandle("block_pool/miss");
+
+    typename BlockType::Ptr block;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!free_blocks_.empty()) {
+        block = std::move(free_blocks_.back());
+        free_blocks_.pop_back();
+        ++num_hits_;
+      } else {
+        ++num_misses_;
+      }
+    }
+    if (block) {
+      timing::Timer hit_timer(kHitTimer);
+      DCHECK_EQ(block->voxels_per_side(), voxels_per_side);
+      DCHECK_EQ(block->voxel_size(), voxel_size);
+      block->reinitialize(origin);
+      return block;
+    }
+    timing::Timer miss_timer(kMissTimer);
+    return std::make_shared<BlockType>(voxels_per_side, voxel_size, origin);
+  }
+
+  /**
+   * Takes the block out of *block and keeps it for reuse if nobody else holds
+   * a reference to it and the pool is not full yet.
+   */
+  void releaseBlock(typename BlockType::Ptr* block) {
+    DCHECK(block != nullptr);
+    if (*block && block->use_count() == 1) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (free_blocks_.size() < max_num_pooled_blocks_) {
+        free_blocks_.emplace_back(std::move(*block));
+      }
+    }
+    block->reset();
+  }
+
+  /// Frees all pooled blocks.
+  void clear() {
+    std::vector<typename BlockType::Ptr> free_blocks;
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_blocks.swap(free_blocks_);
+  }
+
+  size_t getNumPooledBlocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_blocks_.size();
+  }
+  size_t getMaxNumPooledBlocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_num_pooled_blocks_;
+  }
+
+  /// Sets the high-water mark, excess pooled blocks are freed right away.
+  void setMaxNumPooledBlocks(size_t max_num_pooled_blocks) {
+    std::vector<typename BlockType::Ptr> excess_blocks;
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_num_pooled_blocks_ = max_num_pooled_blocks;
+    while (free_blocks_.size() > max_num_pooled_blocks_) {
+      excess_blocks.emplace_back(std::move(free_blocks_.back()));
+      free_blocks_.pop_back();
+    }
+  }
+
+  size_t getNumHits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_hits_;
+  }
+  size_t getNumMisses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_misses_;
+  }
+
+  /// Fraction of allocations served from the pool.
+  double getHitRate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t num_allocations = num_hits_ + num_misses_;
+    if (num_allocations == 0u) {
+      return 0.0;
+    }
+    return static_cast<double>(num_hits_) / num_allocations;
+  }
+
+ private:
+  size_t max_num_pooled_blocks_;
+  size_t num_hits_;
+  size_t num_misses_;
+
+  mutable std::mutex mutex_;
+  std::vector<typename BlockType::Ptr> free_blocks_;
+};
+
+template <typename VoxelType, template <typename> class VoxelStorageType>
+constexpr size_t
+    BlockPool<VoxelType, VoxelStorageType>::kDefaultMaxNumPooledBlocks;
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_CORE_BLOCK_POOL_H_
@@ -0,0 +1,140 @@
+#ifndef VOXBLOX_CORE_CONCURRENT_BLOCK_MAP_H_
+#define VOXBLOX_CORE_CONCURRENT_BLOCK_MAP_H_
+
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/block_hash.h"
+#include "voxblox/core/common.h"
+
+namespace voxblox {
+
+/**
+ * Block map that many threads can look up and allocate blocks in at the same
+ * time. The blocks are split over num_shards independent flat hash maps, each
+ * guarded by its own mutex, and the shard of a block is picked from the high
+ * bits of its mixed hash. Two threads therefore only contend if they touch
+ * blocks of the same shard at the same time, which with the default of 64
+ * shards is rare even for 16+ threads allocating on fresh terrain. With a
+ * single shard the map behaves like a map behind one global mutex.
+ *
+ * Only find and findOrAllocate are thread safe, all other functions require
+ * that no other thread accesses the map.
+ */
+template <typename BlockType>
+class ConcurrentBlockMap {
+ public:
+  typedef typename BlockType::Ptr BlockPtr;
+  typedef typename FlatAnyIndexHashMapType<BlockPtr>::type ShardMap;
+
+  static constexpr size_t kDefaultNumShards = 64u;
+
+  /// num_shards has to be a power of two.
+  explicit ConcurrentBlockMap(size_t num_shards = kDefaultNumShards)
+      : num_shards_(num_shards), shards_(new Shard[num_shards]) {
+    CHECK_GT(num_shards_, 0u);
+    CHECK_EQ(num_shards_ & (num_shards_ - 1u), 0u)
+        << "The number of shards has to be a power of two.";
+  }
+
+  ConcurrentBlockMap(const ConcurrentBlockMap&) = delete;
+  ConcurrentBlockMap& operator=(const ConcurrentBlockMap&) = delete;
+
+  /// Returns the block or a nullptr if it is not in the map. Thread safe.
+  BlockPtr find(const BlockIndex& index) const {
+    const Shard& shard = getShard(index);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    typename ShardMap::const_iterator it = shard.map.find(index);
+    if (it == shard.map.end()) {
+      return BlockPtr();
+    }
+    return it->second;
+  }
+
+  /**
+   * Returns the block at index, if it does not exist yet it is created by
+   * calling allocate_block(index). Every block is allocated exactly once, no
+   * matter how many threads request it simultaneously. Thread safe as long as
+   * allocate_block is.
+   */
+  template <typename BlockAllocator>
+  BlockPtr findOrAllocate(const BlockIndex& index,
+                          BlockAllocator&& allocate_block) {
+    Shard& shard = getShard(index);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    typename ShardMap::iterator it = shard.map.find(index);
+    if (it != shard.map.end()) {
+      return it->second;
+    }
+    BlockPtr block = allocate_block(index);
+    DCHECK(block);
+    shard.map.emplace(index, block);
+    return block;
+  }
+
+  /// Calls function(index, block) for every block. NOT thread safe.
+  template <typename Function>
+  void forEachBlock(Function&& function) const {
+    for (size_t shard_idx = 0u; shard_idx < num_shards_; ++shard_idx) {
+      for (const typename ShardMap::value_type& kv : shards_[shard_idx].map) {
+        function(kv.first, kv.second);
+      }
+    }
+  }
+
+  /// NOT thread safe.
+  size_t size() const {
+    size_t num_blocks = 0u;
+    for (size_t shard_idx = 0u; shard_idx < num_shards_; ++shard_idx) {
+      num_blocks += shards_[shard_idx].map.size();
+    }
+    return num_blocks;
+  }
+
+  bool empty() const { return size() == 0u; }
+
+  /// Drops all blocks but keeps the memory of the shards. NOT thread safe.
+  void clear() {
+    for (size_t shard_idx = 0u; shard_idx < num_shards_; ++shard_idx) {
+      shards_[shard_idx].map.clear();
+    }
+  }
+
+  size_t num_shards() const { return num_shards_; }
+
+ private:
+  struct Shard {
+    mutable std::mutex mutex;
+    ShardMap map;
+  };
+
+  /**
+   * The shard maps pick their slots from the low bits of the same hash, using
+   * the high bits here keeps the blocks of a shard spread over its slots.
+   */
+  size_t getShardIndex(const BlockIndex& index) const {
+    return static_cast<size_t>(static_cast<uint64_t>(hasher_(index)) >> 40) &
+           (num_shards_ - 1u);
+  }
+
+  Shard& getShard(const BlockIndex& index) {
+    return shards_[getShardIndex(index)];
+  }
+  const Shard& getShard(const BlockIndex& index) const {
+    return shards_[getShardIndex(index)];
+  }
+
+  const size_t num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+  AnyIndexMixingHash hasher_;
+};
+
+template <typename BlockType>
+constexpr size_t ConcurrentBlockMap<BlockType>::kDefaultNumShards;
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_CORE_CONCURRENT_BLOCK_MAP_H_
@@ -14,52 +14,89 @@
 #include "voxblox/io/layer_io.h"
 
 namespace voxblox {
+
+/// Configuration of the ESDF maps of all ESDF voxel layouts.
+struct EsdfMapConfig {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  FloatingPoint esdf_voxel_size = 0.2;
+  size_t esdf_voxels_per_side = 16u;
+  /**
+   * Range of the coarse level of the map, which holds one distance per block
+   * for queries beyond the maximum distance of the ESDF, 0 disables it. See
+   * EsdfMapBase::updateCoarseLevel.
+   */
+  FloatingPoint coarse_max_distance_m = 0.0;
+};
+
 /**
  * Map holding a Euclidean Signed Distance Field Layer. Contains functions for
  * interacting with the layer and getting gradient and distance information.
+ * Holds ESDF voxels of either layout, see the EsdfMap and CompactEsdfMap
+ * typedefs below.
  */
-class EsdfMap {
+template <typename EsdfVoxelType>
+class EsdfMapBase {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-  typedef std::shared_ptr<EsdfMap> Ptr;
-
-  struct Config {
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-
-    FloatingPoint esdf_voxel_size = 0.2;
-    size_t esdf_voxels_per_side = 16u;
-  };
+  typedef std::shared_ptr<EsdfMapBase> Ptr;
+  typedef EsdfMapConfig Config;
+  typedef Layer<EsdfVoxelType> EsdfLayer;
 
-  explicit EsdfMap(const Config& config)
-      : esdf_layer_(new Layer<EsdfVoxel>(config.esdf_voxel_size,
-                                         config.esdf_voxels_per_side)),
-        interpolator_(esdf_layer_.get()) {
+  explicit EsdfMapBase(const Config& config)
+      : esdf_layer_(new EsdfLayer(config.esdf_voxel_size,
+                                  config.esdf_voxels_per_side)),
+        interpolator_(esdf_layer_.get()),
+        coarse_max_distance_m_(config.coarse_max_distance_m),
+        fine_max_distance_m_(0.0) {
     block_size_ = config.esdf_voxel_size * config.esdf_voxels_per_side;
   }
 
   /// Creates a new EsdfMap based on a COPY of this layer.
-  explicit EsdfMap(const Layer<EsdfVoxel>& layer)
-      : EsdfMap(aligned_shared<Layer<EsdfVoxel>>(layer)) {}
+  explicit EsdfMapBase(const EsdfLayer& layer)
+      : EsdfMapBase(aligned_shared<EsdfLayer>(layer)) {}
 
   /// Creates a new EsdfMap that contains this layer.
-  explicit EsdfMap(Layer<EsdfVoxel>::Ptr layer)
-      : esdf_layer_(layer), interpolator_(CHECK_NOTNULL(esdf_layer_.get())) {
+  explicit EsdfMapBase(typename EsdfLayer::Ptr layer)
+      : esdf_layer_(layer),
+        interpolator_(CHECK_NOTNULL(esdf_layer_.get())),
+        coarse_max_distance_m_(0.0),
+        fine_max_distance_m_(0.0) {
     block_size_ = layer->block_size();
   }
 
-  virtual ~EsdfMap() {}
+  virtual ~EsdfMapBase() {}
 
-  Layer<EsdfVoxel>* getEsdfLayerPtr() { return esdf_layer_.get(); }
-  const Layer<EsdfVoxel>* getEsdfLayerConstPtr() const {
-    return esdf_layer_.get();
-  }
+  EsdfLayer* getEsdfLayerPtr() { return esdf_layer_.get(); }
+  const EsdfLayer* getEsdfLayerConstPtr() const { return esdf_layer_.get(); }
 
-  const Layer<EsdfVoxel>& getEsdfLayer() const { return *esdf_layer_; }
+  const EsdfLayer& getEsdfLayer() const { return *esdf_layer_; }
 
   FloatingPoint block_size() const { return block_size_; }
   FloatingPoint voxel_size() const { return esdf_layer_->voxel_size(); }
 
+  FloatingPoint getCoarseMaxDistance() const { return coarse_max_distance_m_; }
+  void setCoarseMaxDistance(FloatingPoint coarse_max_distance_m) {
+    coarse_max_distance_m_ = coarse_max_distance_m;
+  }
+  bool usesCoarseLevel() const { return coarse_max_distance_m_ > 0.0; }
+
+  /**
+   * Rebuilds the coarse level from the ESDF layer, whose distances saturate
+   * at fine_max_distance_m. The coarse level holds one voxel per block of the
+   * ESDF layer, with the exact distance from its center to the center of the
+   * closest block containing an occupied voxel, up to coarse_max_distance_m.
+   * Getting the distance of a position where the ESDF is saturated then falls
+   * back to a lower bound of the distance derived from it, so the ESDF only
+   * has to be updated up to a short maximum distance while long range
+   * queries still see the space growing.
+   */
+  void updateCoarseLevel(FloatingPoint fine_max_distance_m);
+  const Layer<EsdfVoxel>* getCoarseLayerPtr() const {
+    return coarse_layer_.get();
+  }
+
   /**
    * Specific accessor functions for esdf maps.
    * Returns true if the point exists in the map AND is observed.
@@ -81,6 +118,13 @@ class EsdfMap {
 
   bool isObserved(const Eigen::Vector3d& position) const;
 
+  /**
+   * Lower bound of the distance at the position from the coarse level, false
+   * if there is no coarse level or the block of the position is not observed.
+   */
+  bool getCoarseDistanceAtPosition(const Eigen::Vector3d& position,
+                                   double* distance) const;
+
   // NOTE(mereweth@jpl.nasa.gov)
   // EigenDRef is fully dynamic stride type alias for Numpy array slices
   // Use column-major matrices; column-by-column traversal is faster
@@ -123,12 +167,27 @@ class EsdfMap {
   FloatingPoint block_size_;
 
   // The layers.
-  Layer<EsdfVoxel>::Ptr esdf_layer_;
+  typename EsdfLayer::Ptr esdf_layer_;
 
   // Interpolator for the layer.
-  Interpolator<EsdfVoxel> interpolator_;
+  Interpolator<EsdfVoxelType> interpolator_;
+
+  /// Extends distances reaching fine_max_distance_m_, see updateCoarseLevel.
+  void applyCoarseLevel(const Eigen::Vector3d& position,
+                        double* distance) const;
+
+  FloatingPoint coarse_max_distance_m_;
+  FloatingPoint fine_max_distance_m_;
+  Layer<EsdfVoxel>::Ptr coarse_layer_;
 };
 
+typedef EsdfMapBase<EsdfVoxel> EsdfMap;
+typedef EsdfMapBase<CompactEsdfVoxel> CompactEsdfMap;
+
+// Both are instantiated in esdf_map.cc.
+extern template class EsdfMapBase<EsdfVoxel>;
+extern template class EsdfMapBase<CompactEsdfVoxel>;
+
 }  // namespace voxblox
 
 #endif  // VOXBLOX_CORE_ESDF_MAP_H_
@@ -11,6 +11,7 @@
 #include "voxblox/Layer.pb.h"
 #include "voxblox/core/block.h"
 #include "voxblox/core/block_hash.h"
+#include "voxblox/core/block_pool.h"
 #include "voxblox/core/common.h"
 #include "voxblox/core/voxel.h"
 
@@ -19,16 +20,22 @@ namespace voxblox {
 /**
  * A 3D information layer, containing data of type VoxelType stored in blocks.
  * This class contains functions for manipulating and accessing these blocks.
+ * The container mapping block indices to blocks is selected through
+ * IndexHashMapType. It defaults to the flat open-addressing map, pass
+ * AnyIndexHashMapType to use the node based std::unordered_map instead.
+ * VoxelStorageType selects the memory layout of the voxels inside the blocks,
+ * see voxel_storage.h.
  */
-template <typename VoxelType>
+template <typename VoxelType,
+          template <typename> class IndexHashMapType = FlatAnyIndexHashMapType,
+          template <typename> class VoxelStorageType = AosVoxelStorage>
 class Layer {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
   typedef std::shared_ptr<Layer> Ptr;
-  typedef Block<VoxelType> BlockType;
-  typedef
-      typename AnyIndexHashMapType<typename BlockType::Ptr>::type BlockHashMap;
+  typedef Block<VoxelType, VoxelStorageType> BlockType;
+  typedef typename IndexHashMapType<typename BlockType::Ptr>::type BlockHashMap;
   typedef typename std::pair<BlockIndex, typename BlockType::Ptr> BlockMapPair;
 
   explicit Layer(FloatingPoint voxel_size, size_t voxels_per_side)
@@ -131,10 +138,8 @@ class Layer {
   }
 
   typename BlockType::Ptr allocateNewBlock(const BlockIndex& index) {
-    auto insert_status = block_map_.emplace(
-        index, std::make_shared<BlockType>(
-                   voxels_per_side_, voxel_size_,
-                   getOriginPointFromGridIndex(index, block_size_)));
+    auto insert_status =
+        block_map_.emplace(index, allocateDetachedBlock(index));
 
     DCHECK(insert_status.second)
         << "Block already exists when allocating at " << index.transpose();
@@ -144,13 +149,24 @@ class Layer {
     return insert_status.first->second;
   }
 
+  /**
+   * Allocates a block for the given index, recycling one from the block pool
+   * if possible, without adding it to the layer. Use insertBlock to add it
+   * later on.
+   */
+  typename BlockType::Ptr allocateDetachedBlock(const BlockIndex& index) {
+    return block_pool_.allocateBlock(
+        voxels_per_side_, voxel_size_,
+        getOriginPointFromGridIndex(index, block_size_));
+  }
+
   inline typename BlockType::Ptr allocateNewBlockByCoordinates(
       const Point& coords) {
     return allocateNewBlock(computeBlockIndexFromCoordinates(coords));
   }
 
   inline void insertBlock(
-      const std::pair<const BlockIndex, typename Block<VoxelType>::Ptr>&
+      const std::pair<const BlockIndex, typename BlockType::Ptr>&
           block_pair) {
     auto insert_status = block_map_.insert(block_pair);
 
@@ -160,11 +176,24 @@ class Layer {
     DCHECK(insert_status.first->second);
   }
 
-  void removeBlock(const BlockIndex& index) { block_map_.erase(index); }
-  void removeAllBlocks() { block_map_.clear(); }
+  /// Removed blocks are handed to the block pool for reuse.
+  void removeBlock(const BlockIndex& index) {
+    typename BlockHashMap::iterator it = block_map_.find(index);
+    if (it != block_map_.end()) {
+      block_pool_.releaseBlock(&it->second);
+      block_map_.erase(index);
+    }
+  }
+
+  void removeAllBlocks() {
+    for (typename BlockHashMap::value_type& kv : block_map_) {
+      block_pool_.releaseBlock(&kv.second);
+    }
+    block_map_.clear();
+  }
 
   void removeBlockByCoordinates(const Point& coords) {
-    block_map_.erase(computeBlockIndexFromCoordinates(coords));
+    removeBlock(computeBlockIndexFromCoordinates(coords));
   }
 
   void removeDistantBlocks(const Point& center, const double max_distance) {
@@ -177,7 +206,7 @@ class Layer {
       }
     }
     for (const BlockIndex& index : needs_erasing) {
-      block_map_.erase(index);
+      removeBlock(index);
     }
   }
 
@@ -204,6 +233,18 @@ class Layer {
 
   size_t getNumberOfAllocatedBlocks() const { return block_map_.size(); }
 
+  const BlockPool<VoxelType, VoxelStorageType>& getBlockPool() const {
+    return block_pool_;
+  }
+
+  /**
+   * Sets how many removed blocks are kept around for reuse, 0 disables
+   * recycling.
+   */
+  void setMaxNumPooledBlocks(size_t max_num_pooled_blocks) {
+    block_pool_.setMaxNumPooledBlocks(max_num_pooled_blocks);
+  }
+
   bool hasBlock(const BlockIndex& block_index) const {
     return block_map_.count(block_index) > 0;
   }
@@ -221,7 +262,7 @@ class Layer {
     }
     const VoxelIndex local_voxel_index =
         getLocalFromGlobalVoxelIndex(global_voxel_index, voxels_per_side_);
-    const Block<VoxelType>& block = getBlockByIndex(block_index);
+    const BlockType& block = getBlockByIndex(block_index);
     return &block.getVoxelByVoxelIndex(local_voxel_index);
   }
 
@@ -234,12 +275,12 @@ class Layer {
     }
     const VoxelIndex local_voxel_index =
         getLocalFromGlobalVoxelIndex(global_voxel_index, voxels_per_side_);
-    Block<VoxelType>& block = getBlockByIndex(block_index);
+    BlockType& block = getBlockByIndex(block_index);
     return &block.getVoxelByVoxelIndex(local_voxel_index);
   }
 
   inline const VoxelType* getVoxelPtrByCoordinates(const Point& coords) const {
-    typename Block<VoxelType>::ConstPtr block_ptr =
+    typename BlockType::ConstPtr block_ptr =
         getBlockPtrByIndex(computeBlockIndexFromCoordinates(coords));
     if (!block_ptr) {
       return nullptr;
@@ -248,7 +289,7 @@ class Layer {
   }
 
   inline VoxelType* getVoxelPtrByCoordinates(const Point& coords) {
-    typename Block<VoxelType>::Ptr block_ptr =
+    typename BlockType::Ptr block_ptr =
         getBlockPtrByIndex(computeBlockIndexFromCoordinates(coords));
     if (!block_ptr) {
       return nullptr;
@@ -293,6 +334,8 @@ class Layer {
   std::string getType() const;
 
   BlockHashMap block_map_;
+
+  BlockPool<VoxelType, VoxelStorageType> block_pool_;
 };
 
 }  // namespace voxblox
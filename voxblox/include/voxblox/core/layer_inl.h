@@ -21,8 +21,10 @@
 
 namespace voxblox {
 
-template <typename VoxelType>
-Layer<VoxelType>::Layer(const LayerProto& proto)
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+Layer<VoxelType, IndexHashMapType, VoxelStorageType>::Layer(
+    const LayerProto& proto)
     : voxel_size_(proto.voxel_size()),
       voxels_per_side_(proto.voxels_per_side()) {
   CHECK_EQ(getType().compare(proto.type()), 0)
@@ -39,8 +41,10 @@ Layer<VoxelType>::Layer(const LayerProto& proto)
   voxels_per_side_inv_ = 1.0f / static_cast<FloatingPoint>(voxels_per_side_);
 }
 
-template <typename VoxelType>
-void Layer<VoxelType>::getProto(LayerProto* proto) const {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+void Layer<VoxelType, IndexHashMapType, VoxelStorageType>::getProto(
+    LayerProto* proto) const {
   CHECK_NOTNULL(proto);
 
   CHECK_NE(getType().compare(voxel_types::kNotSerializable), 0)
@@ -51,14 +55,18 @@ void Layer<VoxelType>::getProto(LayerProto* proto) const {
   proto->set_type(getType());
 }
 
-template <typename VoxelType>
-Layer<VoxelType>::Layer(const Layer& other) {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+Layer<VoxelType, IndexHashMapType, VoxelStorageType>::Layer(
+    const Layer& other) {
   voxel_size_ = other.voxel_size_;
   voxel_size_inv_ = other.voxel_size_inv_;
   voxels_per_side_ = other.voxels_per_side_;
   voxels_per_side_inv_ = other.voxels_per_side_inv_;
   block_size_ = other.block_size_;
   block_size_inv_ = other.block_size_inv_;
+  block_pool_.setMaxNumPooledBlocks(
+      other.block_pool_.getMaxNumPooledBlocks());
 
   for (const typename BlockHashMap::value_type& key_value_pair :
        other.block_map_) {
@@ -69,28 +77,29 @@ Layer<VoxelType>::Layer(const Layer& other) {
     typename BlockType::Ptr new_block = allocateBlockPtrByIndex(block_idx);
     CHECK(new_block);
 
-    for (size_t linear_idx = 0u; linear_idx < block_ptr->num_voxels();
-         ++linear_idx) {
-      const VoxelType& voxel = block_ptr->getVoxelByLinearIndex(linear_idx);
-      VoxelType& new_voxel = new_block->getVoxelByLinearIndex(linear_idx);
-      new_voxel = voxel;
-    }
+    // Voxels outside the observed mask are still default constructed.
+    const BlockType& block = *block_ptr;
+    block.forEachObservedVoxel([&new_block, &block](size_t linear_idx) {
+      new_block->getVoxelByLinearIndex(linear_idx) =
+          block.getVoxelByLinearIndex(linear_idx);
+    });
   }
 }
 
-template <typename VoxelType>
-bool Layer<VoxelType>::saveToFile(const std::string& file_path,
-                                  bool clear_file) const {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+bool Layer<VoxelType, IndexHashMapType, VoxelStorageType>::saveToFile(
+    const std::string& file_path, bool clear_file) const {
   constexpr bool kIncludeAllBlocks = true;
   return saveSubsetToFile(file_path, BlockIndexList(), kIncludeAllBlocks,
                           clear_file);
 }
 
-template <typename VoxelType>
-bool Layer<VoxelType>::saveSubsetToFile(const std::string& file_path,
-                                        BlockIndexList blocks_to_include,
-                                        bool include_all_blocks,
-                                        bool clear_file) const {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+bool Layer<VoxelType, IndexHashMapType, VoxelStorageType>::saveSubsetToFile(
+    const std::string& file_path, BlockIndexList blocks_to_include,
+    bool include_all_blocks, bool clear_file) const {
   CHECK_NE(getType().compare(voxel_types::kNotSerializable), 0)
       << "The voxel type of this layer is not serializable!";
 
@@ -161,10 +170,11 @@ bool Layer<VoxelType>::saveSubsetToFile(const std::string& file_path,
   return true;
 }
 
-template <typename VoxelType>
-bool Layer<VoxelType>::saveBlocksToStream(bool include_all_blocks,
-                                          BlockIndexList blocks_to_include,
-                                          std::fstream* outfile_ptr) const {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+bool Layer<VoxelType, IndexHashMapType, VoxelStorageType>::saveBlocksToStream(
+    bool include_all_blocks, BlockIndexList blocks_to_include,
+    std::fstream* outfile_ptr) const {
   CHECK_NOTNULL(outfile_ptr);
   for (const BlockMapPair& pair : block_map_) {
     bool write_block_to_file = include_all_blocks;
@@ -188,9 +198,10 @@ bool Layer<VoxelType>::saveBlocksToStream(bool include_all_blocks,
   return true;
 }
 
-template <typename VoxelType>
-bool Layer<VoxelType>::addBlockFromProto(const BlockProto& block_proto,
-                                         BlockMergingStrategy strategy) {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+bool Layer<VoxelType, IndexHashMapType, VoxelStorageType>::addBlockFromProto(
+    const BlockProto& block_proto, BlockMergingStrategy strategy) {
   CHECK_NE(getType().compare(voxel_types::kNotSerializable), 0)
       << "The voxel type of this layer is not serializable!";
 
@@ -233,8 +244,10 @@ bool Layer<VoxelType>::addBlockFromProto(const BlockProto& block_proto,
   return true;
 }
 
-template <typename VoxelType>
-bool Layer<VoxelType>::isCompatible(const LayerProto& layer_proto) const {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+bool Layer<VoxelType, IndexHashMapType, VoxelStorageType>::isCompatible(
+    const LayerProto& layer_proto) const {
   bool compatible = true;
   compatible &= (std::fabs(layer_proto.voxel_size() - voxel_size_) <
                  std::numeric_limits<FloatingPoint>::epsilon());
@@ -259,8 +272,10 @@ bool Layer<VoxelType>::isCompatible(const LayerProto& layer_proto) const {
   return compatible;
 }
 
-template <typename VoxelType>
-bool Layer<VoxelType>::isCompatible(const BlockProto& block_proto) const {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+bool Layer<VoxelType, IndexHashMapType, VoxelStorageType>::isCompatible(
+    const BlockProto& block_proto) const {
   bool compatible = true;
   compatible &= (std::fabs(block_proto.voxel_size() - voxel_size_) <
                  std::numeric_limits<FloatingPoint>::epsilon());
@@ -269,8 +284,10 @@ bool Layer<VoxelType>::isCompatible(const BlockProto& block_proto) const {
   return compatible;
 }
 
-template <typename VoxelType>
-size_t Layer<VoxelType>::getMemorySize() const {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+size_t
+Layer<VoxelType, IndexHashMapType, VoxelStorageType>::getMemorySize() const {
   size_t size = 0u;
 
   // Calculate size of members
@@ -282,14 +299,16 @@ size_t Layer<VoxelType>::getMemorySize() const {
   // Calculate size of blocks
   size_t num_blocks = getNumberOfAllocatedBlocks();
   if (num_blocks > 0u) {
-    typename Block<VoxelType>::Ptr block = block_map_.begin()->second;
+    typename BlockType::Ptr block = block_map_.begin()->second;
     size += num_blocks * block->getMemorySize();
   }
   return size;
 }
 
-template <typename VoxelType>
-std::string Layer<VoxelType>::getType() const {
+template <typename VoxelType, template <typename> class IndexHashMapType,
+          template <typename> class VoxelStorageType>
+std::string
+Layer<VoxelType, IndexHashMapType, VoxelStorageType>::getType() const {
   return getVoxelType<VoxelType>();
 }
 
@@ -15,6 +15,22 @@ struct TsdfVoxel {
   Color color;
 };
 
+/**
+ * Quantized TsdfVoxel, 8 instead of 12 bytes. The distance is stored as fixed
+ * point normalized to the truncation distance, i.e. kMaxDistance corresponds to
+ * the truncation distance, and the weight as an IEEE 754 half precision float.
+ * The truncation distance is not stored anywhere in the voxel or the layer, so
+ * whoever reads or writes the distance has to know it. Use the accessors in
+ * voxel_utils.h instead of touching the raw members.
+ */
+struct CompactTsdfVoxel {
+  static constexpr int16_t kMaxDistance = INT16_MAX;
+
+  int16_t distance = 0;
+  uint16_t weight = 0u;
+  Color color;
+};
+
 struct EsdfVoxel {
   float distance = 0.0f;
 
@@ -36,6 +52,32 @@ struct EsdfVoxel {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
+/**
+ * Packed EsdfVoxel, 8 instead of 20 bytes and without alignment requirements.
+ * The parent is stored as three 8 bit offsets and the flags as a bitfield, the
+ * same layout EsdfVoxel is serialized with. Offsets beyond +-kMaxParentOffset,
+ * which only full euclidean parents of distances of more than
+ * kMaxParentOffset voxels reach, are clamped, see setEsdfParent in
+ * voxel_utils.h.
+ */
+struct CompactEsdfVoxel {
+  static constexpr int kMaxParentOffset = INT8_MAX;
+  typedef Eigen::Matrix<int8_t, 3, 1> ParentType;
+
+  CompactEsdfVoxel()
+      : observed(false), hallucinated(false), in_queue(false), fixed(false) {}
+
+  float distance = 0.0f;
+  /// See EsdfVoxel::parent.
+  ParentType parent = ParentType::Zero();
+
+  /// See EsdfVoxel, hallucinated is not serialized either.
+  bool observed : 1;
+  bool hallucinated : 1;
+  bool in_queue : 1;
+  bool fixed : 1;
+};
+
 struct OccupancyVoxel {
   float probability_log = 0.0f;
   bool observed = false;
@@ -46,10 +88,52 @@ struct IntensityVoxel {
   float weight = 0.0f;
 };
 
+/**
+ * Whether a voxel differs from a default constructed one in a way that
+ * matters, used to rebuild the observed masks of blocks. Conservative for
+ * voxel types without a specialization.
+ */
+template <typename VoxelType>
+inline bool hasVoxelData(const VoxelType& /*voxel*/) {
+  return true;
+}
+
+template <>
+inline bool hasVoxelData(const TsdfVoxel& voxel) {
+  return voxel.weight != 0.0f;
+}
+
+template <>
+inline bool hasVoxelData(const CompactTsdfVoxel& voxel) {
+  // Negative zero is the only other zero of the half precision weight.
+  return (voxel.weight & 0x7FFFu) != 0u;
+}
+
+template <>
+inline bool hasVoxelData(const EsdfVoxel& voxel) {
+  return voxel.observed;
+}
+
+template <>
+inline bool hasVoxelData(const CompactEsdfVoxel& voxel) {
+  return voxel.observed;
+}
+
+template <>
+inline bool hasVoxelData(const OccupancyVoxel& voxel) {
+  return voxel.observed;
+}
+
+template <>
+inline bool hasVoxelData(const IntensityVoxel& voxel) {
+  return voxel.weight != 0.0f;
+}
+
 /// Used for serialization only.
 namespace voxel_types {
 const std::string kNotSerializable = "not_serializable";
 const std::string kTsdf = "tsdf";
+const std::string kCompactTsdf = "compact_tsdf";
 const std::string kEsdf = "esdf";
 const std::string kOccupancy = "occupancy";
 const std::string kIntensity = "intensity";
@@ -65,11 +149,22 @@ inline std::string getVoxelType<TsdfVoxel>() {
   return voxel_types::kTsdf;
 }
 
+template <>
+inline std::string getVoxelType<CompactTsdfVoxel>() {
+  return voxel_types::kCompactTsdf;
+}
+
 template <>
 inline std::string getVoxelType<EsdfVoxel>() {
   return voxel_types::kEsdf;
 }
 
+/// Serialized like EsdfVoxel, so either can load the layers of the other.
+template <>
+inline std::string getVoxelType<CompactEsdfVoxel>() {
+  return voxel_types::kEsdf;
+}
+
 template <>
 inline std::string getVoxelType<OccupancyVoxel>() {
   return voxel_types::kOccupancy;
@@ -0,0 +1,154 @@
+#ifndef VOXBLOX_CORE_VOXEL_STORAGE_H_
+#define VOXBLOX_CORE_VOXEL_STORAGE_H_
+
+#include <algorithm>
+#include <memory>
+
+#include "voxblox/core/color.h"
+#include "voxblox/core/common.h"
+#include "voxblox/core/voxel.h"
+
+namespace voxblox {
+
+/**
+ * Storage policies decide how a Block lays out its voxels in memory. Every
+ * policy exposes the same interface: VoxelRef and ConstVoxelRef are the types
+ * returned when accessing a voxel, allocate() creates the voxels, fill()
+ * overwrites all of them and getMemorySize() reports the size of the voxel
+ * data in bytes.
+ */
+
+/// Array of structs, the default. Voxels are accessed by plain reference.
+template <typename VoxelType>
+class AosVoxelStorage {
+ public:
+  typedef VoxelType& VoxelRef;
+  typedef const VoxelType& ConstVoxelRef;
+
+  AosVoxelStorage() : num_voxels_(0u) {}
+
+  void allocate(size_t num_voxels) {
+    num_voxels_ = num_voxels;
+    voxels_.reset(new VoxelType[num_voxels_]);
+  }
+
+  inline VoxelRef operator[](size_t index) { return voxels_[index]; }
+  inline ConstVoxelRef operator[](size_t index) const {
+    return voxels_[index];
+  }
+
+  void fill(const VoxelType& voxel) {
+    std::fill(voxels_.get(), voxels_.get() + num_voxels_, voxel);
+  }
+
+  size_t getMemorySize() const { return num_voxels_ * sizeof(VoxelType); }
+
+ private:
+  size_t num_voxels_;
+  std::unique_ptr<VoxelType[]> voxels_;
+};
+
+/**
+ * Structure of arrays, every member of the voxel lives in its own contiguous
+ * plane. Passes that only touch some of the members, e.g. marching cubes or
+ * the ESDF seeding that only read distance and weight, then do not pull the
+ * remaining members through the cache, and the planes can be processed with
+ * vectorized loops. Only specialized for the voxel types that support it.
+ */
+template <typename VoxelType>
+class SoaVoxelStorage;
+
+/// Proxy to a TsdfVoxel in a SoaVoxelStorage, the members refer to the planes.
+struct ConstTsdfVoxelRef {
+  const float& distance;
+  const float& weight;
+  const Color& color;
+
+  operator TsdfVoxel() const {
+    TsdfVoxel voxel;
+    voxel.distance = distance;
+    voxel.weight = weight;
+    voxel.color = color;
+    return voxel;
+  }
+};
+
+/// Mutable proxy, assigning a TsdfVoxel to it writes through to the planes.
+struct TsdfVoxelRef {
+  float& distance;
+  float& weight;
+  Color& color;
+
+  operator ConstTsdfVoxelRef() const {
+    return ConstTsdfVoxelRef{distance, weight, color};
+  }
+
+  operator TsdfVoxel() const {
+    return static_cast<ConstTsdfVoxelRef>(*this);
+  }
+
+  const TsdfVoxelRef& operator=(const TsdfVoxel& voxel) const {
+    distance = voxel.distance;
+    weight = voxel.weight;
+    color = voxel.color;
+    return *this;
+  }
+
+  const TsdfVoxelRef& operator=(const TsdfVoxelRef& other) const {
+    return *this = static_cast<TsdfVoxel>(other);
+  }
+};
+
+template <>
+class SoaVoxelStorage<TsdfVoxel> {
+ public:
+  typedef TsdfVoxelRef VoxelRef;
+  typedef ConstTsdfVoxelRef ConstVoxelRef;
+
+  SoaVoxelStorage() : num_voxels_(0u) {}
+
+  void allocate(size_t num_voxels) {
+    num_voxels_ = num_voxels;
+    distances_.reset(new float[num_voxels_]);
+    weights_.reset(new float[num_voxels_]);
+    colors_.reset(new Color[num_voxels_]);
+    fill(TsdfVoxel());
+  }
+
+  inline VoxelRef operator[](size_t index) {
+    return TsdfVoxelRef{distances_[index], weights_[index], colors_[index]};
+  }
+  inline ConstVoxelRef operator[](size_t index) const {
+    return ConstTsdfVoxelRef{distances_[index], weights_[index],
+                             colors_[index]};
+  }
+
+  void fill(const TsdfVoxel& voxel) {
+    std::fill(distances_.get(), distances_.get() + num_voxels_,
+              voxel.distance);
+    std::fill(weights_.get(), weights_.get() + num_voxels_, voxel.weight);
+    std::fill(colors_.get(), colors_.get() + num_voxels_, voxel.color);
+  }
+
+  /// Direct access to the planes, each holds num_voxels contiguous values.
+  const float* distances() const { return distances_.get(); }
+  float* distances() { return distances_.get(); }
+  const float* weights() const { return weights_.get(); }
+  float* weights() { return weights_.get(); }
+  const Color* colors() const { return colors_.get(); }
+  Color* colors() { return colors_.get(); }
+
+  size_t getMemorySize() const {
+    return num_voxels_ * (2u * sizeof(float) + sizeof(Color));
+  }
+
+ private:
+  size_t num_voxels_;
+  std::unique_ptr<float[]> distances_;
+  std::unique_ptr<float[]> weights_;
+  std::unique_ptr<Color[]> colors_;
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_CORE_VOXEL_STORAGE_H_
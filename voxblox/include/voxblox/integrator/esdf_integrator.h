@@ -2,6 +2,10 @@
 #define VOXBLOX_INTEGRATOR_ESDF_INTEGRATOR_H_
 
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <queue>
 #include <utility>
 #include <vector>
@@ -13,72 +17,131 @@
 #include "voxblox/core/voxel.h"
 #include "voxblox/integrator/integrator_utils.h"
 #include "voxblox/utils/bucket_queue.h"
+#include "voxblox/utils/distance_transform.h"
 #include "voxblox/utils/neighbor_tools.h"
+#include "voxblox/utils/thread_pool.h"
 #include "voxblox/utils/timing.h"
 
 namespace voxblox {
 
+/// Configuration of the ESDF integrators of all ESDF voxel layouts.
+struct EsdfIntegratorConfig {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /**
+   * Whether to use full euclidean distance (true) or quasi-euclidean (false).
+   * Full euclidean is slightly more accurate (up to 8% in the worst case) but
+   * slower.
+   */
+  bool full_euclidean_distance = false;
+  /**
+   * Maximum distance to calculate the actual distance to.
+   * Any values above this will be set to default_distance_m.
+   */
+  FloatingPoint max_distance_m = 2.0;
+  /**
+   * Should mirror (or be smaller than) truncation distance in tsdf
+   * integrator.
+   */
+  FloatingPoint min_distance_m = 0.2;
+  /// Default distance set for unknown values and values > max_distance_m.
+  FloatingPoint default_distance_m = 2.0;
+  /**
+   * For cheaper but less accurate map updates: the minimum difference in
+   * a voxel distance, before the change is propagated.
+   */
+  FloatingPoint min_diff_m = 0.001;
+  /// Minimum weight to consider a TSDF value seen at.
+  float min_weight = 1e-6;
+  /// Number of buckets for the bucketed priority queue.
+  int num_buckets = 20;
+  /**
+   * Whether to push stuff to the open queue multiple times, with updated
+   * distances.
+   */
+  bool multi_queue = false;
+  /**
+   * Whether the open queue is a RingBucketQueue that moves queued voxels
+   * forward when their distance decreases, instead of a BucketQueue. Voxels
+   * are then queued at most once, multi_queue has no effect.
+   */
+  bool decrease_key_queue = false;
+  /**
+   * Number of threads propagating the raise and open sets. With more than
+   * one, the blocks are split between the threads, every thread propagates
+   * the wavefront through its own blocks and hands the voxels it reaches in
+   * the blocks of other threads over to them after every round. As with a
+   * different num_buckets, the changed order of the updates changes the
+   * distances of a few voxels by up to a voxel, or more with
+   * full_euclidean_distance.
+   */
+  size_t propagation_threads = 1u;
+  /**
+   * Whether batch updates, i.e. the ones that are not incremental, compute
+   * exact euclidean distances to the closest fixed voxel with a separable
+   * distance transform, see BlockDistanceTransform, instead of propagating
+   * the distances from voxel to voxel. The distances then also reach through
+   * unobserved space. Uses propagation_threads threads.
+   */
+  bool exact_batch_distance = false;
+  /**
+   * Edge length in blocks of the cube around the robot the ESDF is limited
+   * to, or 0 for an ESDF of the whole TSDF layer. The window follows the
+   * robot through setRollingWindowCenter, which drops the ESDF blocks that
+   * leave it and streams in the TSDF blocks that enter it with the next
+   * update. The memory and the cost of the updates then stay bounded on long
+   * missions.
+   */
+  int rolling_window_blocks = 0;
+  /**
+   * Time budget of updateFromTsdfLayer. If set, the updated blocks are
+   * propagated in rings around the priority center, see
+   * setUpdatePriorityCenter, until the time is spent. The blocks and the
+   * queued voxels that are left are carried over to the next call, see
+   * getUpdateBacklog. With multiple propagation_threads the raise and open
+   * sets are only interrupted between rings.
+   */
+  float max_update_time_s = std::numeric_limits<float>::max();
+  /**
+   * Whether to add an outside layer of occupied voxels. Basically just sets
+   * all unknown voxels in the allocated blocks to occupied.
+   * Try to only use this for batch processing, otherwise look into
+   * addNewRobotPosition below, which uses clear spheres.
+   */
+  bool add_occupied_crust = false;
+
+  /**
+   * For marking unknown space around a robot as free or occupied, these are
+   * the radiuses used around each robot position.
+   */
+  FloatingPoint clear_sphere_radius = 1.5;
+  FloatingPoint occupied_sphere_radius = 5.0;
+};
+
 /**
  * Builds an ESDF layer out of a given TSDF layer. For a description of this
  * algorithm, please see: https://arxiv.org/abs/1611.03631
+ *
+ * Works on the ESDF voxels of either layout, see the EsdfIntegrator and
+ * CompactEsdfIntegrator typedefs below.
  */
-class EsdfIntegrator {
+template <typename EsdfVoxelType>
+class EsdfIntegratorBase {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-  struct Config {
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-
-    /**
-     * Whether to use full euclidean distance (true) or quasi-euclidean (false).
-     * Full euclidean is slightly more accurate (up to 8% in the worst case) but
-     * slower.
-     */
-    bool full_euclidean_distance = false;
-    /**
-     * Maximum distance to calculate the actual distance to.
-     * Any values above this will be set to default_distance_m.
-     */
-    FloatingPoint max_distance_m = 2.0;
-    /**
-     * Should mirror (or be smaller than) truncation distance in tsdf
-     * integrator.
-     */
-    FloatingPoint min_distance_m = 0.2;
-    /// Default distance set for unknown values and values > max_distance_m.
-    FloatingPoint default_distance_m = 2.0;
-    /**
-     * For cheaper but less accurate map updates: the minimum difference in
-     * a voxel distance, before the change is propagated.
-     */
-    FloatingPoint min_diff_m = 0.001;
-    /// Minimum weight to consider a TSDF value seen at.
-    float min_weight = 1e-6;
-    /// Number of buckets for the bucketed priority queue.
-    int num_buckets = 20;
-    /**
-     * Whether to push stuff to the open queue multiple times, with updated
-     * distances.
-     */
-    bool multi_queue = false;
-    /**
-     * Whether to add an outside layer of occupied voxels. Basically just sets
-     * all unknown voxels in the allocated blocks to occupied.
-     * Try to only use this for batch processing, otherwise look into
-     * addNewRobotPosition below, which uses clear spheres.
-     */
-    bool add_occupied_crust = false;
-
-    /**
-     * For marking unknown space around a robot as free or occupied, these are
-     * the radiuses used around each robot position.
-     */
-    FloatingPoint clear_sphere_radius = 1.5;
-    FloatingPoint occupied_sphere_radius = 5.0;
-  };
+  typedef EsdfIntegratorConfig Config;
+  typedef Layer<EsdfVoxelType> EsdfLayer;
 
-  EsdfIntegrator(const Config& config, Layer<TsdfVoxel>* tsdf_layer,
-                 Layer<EsdfVoxel>* esdf_layer);
+  EsdfIntegratorBase(const Config& config, Layer<TsdfVoxel>* tsdf_layer,
+                     EsdfLayer* esdf_layer);
+
+  /**
+   * Integrator without a TSDF layer of its own, it can only be updated through
+   * the updateFromTsdfBlocks overload that takes the TSDF layer, e.g. for TSDF
+   * layers with a different voxel storage.
+   */
+  EsdfIntegratorBase(const Config& config, EsdfLayer* esdf_layer);
 
   /**
    *Used for planning - allocates sphere around as observed but occupied,
@@ -88,6 +151,22 @@ class EsdfIntegrator {
    */
   void addNewRobotPosition(const Point& position);
 
+  /**
+   * Centers the rolling window on the block of position, see
+   * Config::rolling_window_blocks. Only the blocks of the old and the new
+   * window are visited, except for the first call, which drops all ESDF
+   * blocks outside of the window.
+   */
+  void setRollingWindowCenter(const Point& position);
+
+  bool hasRollingWindow() const { return config_.rolling_window_blocks > 0; }
+
+  /// True if there is no rolling window yet or the block is in it.
+  inline bool isInRollingWindow(const BlockIndex& block_index) const {
+    return !rolling_window_set_ ||
+           isInWindow(rolling_window_min_, block_index);
+  }
+
   /**
    *Update from a TSDF layer in batch, clearing the current ESDF layer in the
    * process.
@@ -95,10 +174,33 @@ class EsdfIntegrator {
   void updateFromTsdfLayerBatch();
   /**
    * Incrementally update from the TSDF layer, optionally clearing the updated
-   * flag of all changed TSDF voxels.
+   * flag of all changed TSDF voxels. If the TSDF blocks record their dirty
+   * voxels, see Block::markVoxelDirty, only these are propagated.
    */
   void updateFromTsdfLayer(bool clear_updated_flag);
 
+  /**
+   * Makes the updates with a max_update_time_s propagate the blocks closest to
+   * position first, e.g. the ones around the robot that the planner needs.
+   */
+  void setUpdatePriorityCenter(const Point& position) {
+    update_priority_center_ = position;
+  }
+
+  /// Work the last updateFromTsdfLayer left over for the next one.
+  struct UpdateBacklog {
+    /// Updated blocks that were not propagated yet.
+    size_t num_blocks = 0u;
+    /// Voxels left in the raise and open sets.
+    size_t num_queued_voxels = 0u;
+  };
+  UpdateBacklog getUpdateBacklog() const {
+    UpdateBacklog backlog;
+    backlog.num_blocks = num_backlog_blocks_;
+    backlog.num_queued_voxels = raise_.size() + open_.size();
+    return backlog;
+  }
+
   /**
    * Short-cut for pushing neighbors (i.e., incremental update) by default.
    * Not necessary in batch.
@@ -106,6 +208,25 @@ class EsdfIntegrator {
   void updateFromTsdfBlocks(const BlockIndexList& tsdf_blocks,
                             bool incremental = false);
 
+  /**
+   * Same as above but reads from the given TSDF layer, which may use any voxel
+   * storage. Only the distances and weights of the TSDF voxels are read.
+   */
+  template <template <typename> class VoxelStorageType>
+  void updateFromTsdfBlocks(
+      const Layer<TsdfVoxel, FlatAnyIndexHashMapType, VoxelStorageType>&
+          tsdf_layer,
+      const BlockIndexList& tsdf_blocks, bool incremental = false);
+
+  /**
+   * Same as above for a compact TSDF layer, its distances are normalized to
+   * the given truncation distance.
+   */
+  void updateFromTsdfBlocks(const Layer<CompactTsdfVoxel>& tsdf_layer,
+                            FloatingPoint truncation_distance,
+                            const BlockIndexList& tsdf_blocks,
+                            bool incremental = false);
+
   /**
    * For incremental updates, the raise set contains all fixed voxels whose
    * distances have INCREASED since last iteration. This means that all voxels
@@ -139,6 +260,7 @@ class EsdfIntegrator {
     updated_blocks_.clear();
     open_.clear();
     raise_ = AlignedQueue<GlobalIndex>();
+    num_backlog_blocks_ = 0u;
   }
   /// Update some specific settings.
   float getEsdfMaxDistance() const { return config_.max_distance_m; }
@@ -153,17 +275,178 @@ class EsdfIntegrator {
     config_.full_euclidean_distance = full_euclidean;
   }
 
+  /**
+   * Propagates on the workers of thread_pool, which may be shared with the
+   * other integrators, instead of a pool of propagation_threads - 1 workers
+   * that is created on first use.
+   */
+  void setThreadPool(const ThreadPool::Ptr& thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+
  protected:
+  /**
+   * Seeds the ESDF from the given blocks of any kind of TSDF layer and
+   * propagates it. get_distance_and_weight(voxel, &distance, &weight) returns
+   * the metric distance and the weight of a TSDF voxel.
+   */
+  template <typename TsdfLayerType, typename DistanceAndWeightGetter>
+  void updateFromTsdfBlocksImpl(
+      const TsdfLayerType& tsdf_layer, const BlockIndexList& tsdf_blocks,
+      bool incremental, const DistanceAndWeightGetter& get_distance_and_weight);
+
+  /**
+   * Returns the updated TSDF blocks and the blocks whose ESDF changed without
+   * their TSDF, marking all voxels of the latter dirty.
+   */
+  void getUpdatedBlocks(BlockIndexList* tsdf_blocks);
+  void clearUpdatedFlags(const BlockIndexList& tsdf_blocks);
+
+  /// updateFromTsdfLayer within max_update_time_s.
+  void updateFromTsdfLayerTimeLimited(bool clear_updated_flag);
+
+  bool isUpdateTimeLimited() const {
+    return config_.max_update_time_s < std::numeric_limits<float>::max();
+  }
+
+  /// Voxels the raise and open sets process between reading the clock.
+  static constexpr size_t kUpdateTimeCheckInterval = 256u;
+
+  /// Always true outside of updateFromTsdfLayerTimeLimited.
+  inline bool isUpdateTimeLeft() const {
+    return !limit_update_time_ ||
+           std::chrono::duration<float>(std::chrono::steady_clock::now() -
+                                        update_start_time_)
+                   .count() < config_.max_update_time_s;
+  }
+
+  /// What seeding a single ESDF voxel from its TSDF voxel did.
+  enum class TsdfPropagation { kNone, kNew, kLower, kRaise };
+
+  /**
+   * Seeds the ESDF voxel at lin_index of esdf_block from the distance and
+   * weight of the corresponding TSDF voxel and queues it for propagation.
+   */
+  TsdfPropagation propagateTsdfVoxel(const BlockIndex& block_index,
+                                     size_t lin_index, float tsdf_distance,
+                                     float tsdf_weight, bool incremental,
+                                     Block<EsdfVoxelType>* esdf_block);
+
+  /**
+   * Pushes the observed voxels of other blocks that border the given new
+   * blocks to the open set, so the distances of the existing ESDF flow into
+   * the new blocks.
+   */
+  void openVoxelsAroundBlocks(const BlockIndexList& new_blocks);
+
+  /// Counts the voxel updates of the open set.
+  struct OpenSetStats {
+    size_t num_updates = 0u;
+    size_t num_inside = 0u;
+    size_t num_outside = 0u;
+    size_t num_flipped = 0u;
+  };
+
+  /**
+   * Updates the neighbor in direction neighbor_idx of the neighborhood lookup
+   * tables of a voxel with the given distance and parent. Returns true if the
+   * neighbor changed and has to be pushed to the open set.
+   */
+  bool updateNeighbor(FloatingPoint distance, const SignedIndex& parent,
+                      unsigned int neighbor_idx, EsdfVoxelType* neighbor_voxel,
+                      OpenSetStats* stats) const;
+
+  /// What raising a voxel requires of its neighbor.
+  enum class RaiseAction { kNone, kRaise, kOpen };
+
+  /**
+   * Invalidates the neighbor in the given direction of a raised voxel if the
+   * raised voxel is its parent, or else marks it as queued to update the
+   * raised voxel back.
+   */
+  RaiseAction raiseNeighbor(const SignedIndex& direction,
+                            EsdfVoxelType* neighbor_voxel) const;
+
+  /// A voxel a propagation thread reached in a block of another thread.
+  struct PropagationMessage {
+    GlobalIndex neighbor_index;
+    /// Parent and distance of the voxel that reached it.
+    SignedIndex parent;
+    FloatingPoint distance;
+    /// Direction from that voxel in the neighborhood lookup tables.
+    unsigned int neighbor_idx;
+  };
+  typedef AlignedVector<PropagationMessage> PropagationMessages;
+
+  typedef SelectableBucketQueue<GlobalIndex, LongIndexMixingHash> OpenQueue;
+
+  /// Queues of a propagation thread, kept to reuse their memory.
+  struct PropagationThread {
+    OpenQueue open;
+    AlignedQueue<GlobalIndex> raise;
+    /// Voxels the raise set pushes to the open set.
+    GlobalIndexVector opened;
+    OpenSetStats stats;
+  };
+
+  /// The thread that propagates the voxels of the block of global_index.
+  inline size_t getPropagationThread(const GlobalIndex& global_index) const {
+    return AnyIndexHash()(getBlockIndexFromGlobalVoxelIndex(
+               global_index, voxels_per_side_inv_)) %
+           config_.propagation_threads;
+  }
+
+  /// True if the block is in the rolling window with the given lowest block.
+  inline bool isInWindow(const BlockIndex& window_min,
+                         const BlockIndex& block_index) const {
+    const BlockIndex offset = block_index - window_min;
+    return (offset.array() >= 0).all() &&
+           (offset.array() < config_.rolling_window_blocks).all();
+  }
+
+  /// True if all neighbors of the voxel are in its own block.
+  inline bool hasNeighborsInOwnBlock(const GlobalIndex& global_index) const {
+    const BlockIndex block_index =
+        getBlockIndexFromGlobalVoxelIndex(global_index, voxels_per_side_inv_);
+    const GlobalIndex voxel_index =
+        global_index -
+        block_index.cast<LongIndexElement>() * voxels_per_side_;
+    return (voxel_index.array() > 0).all() &&
+           (voxel_index.array() + 1 <
+            static_cast<LongIndexElement>(voxels_per_side_))
+               .all();
+  }
+
+  /**
+   * Runs the propagation threads in rounds until they stop handing over
+   * voxels. In every round, every thread first calls receive for the messages
+   * the other threads sent it in the last round and then propagate, which
+   * sends messages to thread j by adding them to outbox[j].
+   */
+  void runPropagationRounds(
+      const std::function<void(size_t, const PropagationMessage&)>& receive,
+      const std::function<void(size_t, PropagationMessages*)>& propagate);
+
+  void processRaiseSetParallel();
+  void processOpenSetParallel();
+
+  /**
+   * Sets the distances of all observed voxels of the ESDF layer that are not
+   * fixed to the exact distance to the closest fixed voxel, instead of
+   * processing the raise and open sets, see Config::exact_batch_distance.
+   */
+  void computeExactDistances();
+
   Config config_;
 
   Layer<TsdfVoxel>* tsdf_layer_;
-  Layer<EsdfVoxel>* esdf_layer_;
+  EsdfLayer* esdf_layer_;
 
   /**
    * Open Queue for incremental updates. Contains global voxel indices
    * for the ESDF layer.
    */
-  BucketQueue<GlobalIndex> open_;
+  OpenQueue open_;
 
   /**
    * Raise set for updates; these are values that used to be in the fixed
@@ -173,11 +456,41 @@ class EsdfIntegrator {
   AlignedQueue<GlobalIndex> raise_;
 
   size_t voxels_per_side_;
+  FloatingPoint voxels_per_side_inv_;
   FloatingPoint voxel_size_;
 
   IndexSet updated_blocks_;
+
+  Point update_priority_center_ = Point::Zero();
+  bool limit_update_time_ = false;
+  std::chrono::steady_clock::time_point update_start_time_;
+  size_t num_backlog_blocks_ = 0u;
+
+  /// Lowest block of the rolling window, once it is set.
+  bool rolling_window_set_ = false;
+  BlockIndex rolling_window_min_;
+
+  ThreadPool::Ptr thread_pool_;
+  std::vector<PropagationThread> propagation_threads_;
+  /**
+   * Messages sent by propagation thread i to thread j at index
+   * i * propagation_threads + j, of the previous and of the current round.
+   */
+  std::vector<PropagationMessages> messages_[2];
+
+  /// Kept to reuse its memory between batch updates.
+  BlockDistanceTransform distance_transform_;
 };
 
+typedef EsdfIntegratorBase<EsdfVoxel> EsdfIntegrator;
+typedef EsdfIntegratorBase<CompactEsdfVoxel> CompactEsdfIntegrator;
+
+// Both are instantiated in esdf_integrator.cc.
+extern template class EsdfIntegratorBase<EsdfVoxel>;
+extern template class EsdfIntegratorBase<CompactEsdfVoxel>;
+
 }  // namespace voxblox
 
+#include "voxblox/integrator/esdf_integrator_inl.h"
+
 #endif  // VOXBLOX_INTEGRATOR_ESDF_INTEGRATOR_H_
@@ -0,0 +1,132 @@
+#ifndef VOXBLOX_INTEGRATOR_ESDF_INTEGRATOR_INL_H_
+#define VOXBLOX_INTEGRATOR_ESDF_INTEGRATOR_INL_H_
+
+namespace voxblox {
+
+template <typename EsdfVoxelType>
+template <template <typename> class VoxelStorageType>
+void EsdfIntegratorBase<EsdfVoxelType>::updateFromTsdfBlocks(
+    const Layer<TsdfVoxel, FlatAnyIndexHashMapType, VoxelStorageType>&
+        tsdf_layer,
+    const BlockIndexList& tsdf_blocks, bool incremental) {
+  typedef typename Block<TsdfVoxel, VoxelStorageType>::ConstVoxelRef
+      ConstVoxelRef;
+  updateFromTsdfBlocksImpl(
+      tsdf_layer, tsdf_blocks, incremental,
+      [](ConstVoxelRef voxel, float* distance, float* weight) {
+        *distance = voxel.distance;
+        *weight = voxel.weight;
+      });
+}
+
+template <typename EsdfVoxelType>
+template <typename TsdfLayerType, typename DistanceAndWeightGetter>
+void EsdfIntegratorBase<EsdfVoxelType>::updateFromTsdfBlocksImpl(
+    const TsdfLayerType& tsdf_layer, const BlockIndexList& tsdf_blocks,
+    bool incremental, const DistanceAndWeightGetter& get_distance_and_weight) {
+  typedef typename TsdfLayerType::BlockType TsdfBlock;
+
+  CHECK_EQ(tsdf_layer.voxels_per_side(), esdf_layer_->voxels_per_side());
+  timing::Timer esdf_timer("esdf");
+
+  // Go through all blocks in TSDF and copy their values for relevant voxels.
+  size_t num_lower = 0u;
+  size_t num_raise = 0u;
+  size_t num_new = 0u;
+  BlockIndexList new_esdf_blocks;
+  timing::Timer propagate_timer("esdf/propagate_tsdf");
+  VLOG(3) << "[ESDF update]: Propagating " << tsdf_blocks.size()
+          << " updated blocks from the TSDF.";
+  for (const BlockIndex& block_index : tsdf_blocks) {
+    typename TsdfBlock::ConstPtr tsdf_block =
+        tsdf_layer.getBlockPtrByIndex(block_index);
+    if (!tsdf_block || !isInRollingWindow(block_index)) {
+      continue;
+    }
+
+    // Allocate the same block in the ESDF layer.
+    // Block indices are the same across all layers.
+    const bool new_esdf_block = !esdf_layer_->hasBlock(block_index);
+    typename Block<EsdfVoxelType>::Ptr esdf_block =
+        esdf_layer_->allocateBlockPtrByIndex(block_index);
+    esdf_block->set_updated(true);
+    if (new_esdf_block) {
+      new_esdf_blocks.push_back(block_index);
+    }
+
+    auto propagate_voxel = [&](size_t lin_index) {
+      // Only distance and weight are read, so with a structure of arrays
+      // storage the colors never enter the cache.
+      float tsdf_distance;
+      float tsdf_weight;
+      get_distance_and_weight(tsdf_block->getVoxelByLinearIndex(lin_index),
+                              &tsdf_distance, &tsdf_weight);
+      switch (propagateTsdfVoxel(block_index, lin_index, tsdf_distance,
+                                 tsdf_weight, incremental, esdf_block.get())) {
+        case TsdfPropagation::kNew:
+          num_new++;
+          break;
+        case TsdfPropagation::kLower:
+          num_lower++;
+          break;
+        case TsdfPropagation::kRaise:
+          num_raise++;
+          break;
+        case TsdfPropagation::kNone:
+          break;
+      }
+    };
+
+    // Voxels outside the observed mask have zero weight and are skipped,
+    // unless they have to be turned into the occupied crust.
+    const bool visit_unobserved_voxels =
+        (!incremental && config_.add_occupied_crust) ||
+        config_.min_weight <= 0.0f;
+    if (visit_unobserved_voxels) {
+      const size_t num_voxels_per_block = tsdf_block->num_voxels();
+      for (size_t lin_index = 0u; lin_index < num_voxels_per_block;
+           ++lin_index) {
+        propagate_voxel(lin_index);
+      }
+    } else if (incremental && !new_esdf_block &&
+               tsdf_block->hasDirtyVoxels(Update::kEsdf)) {
+      // The other voxels were propagated before and did not change since, so
+      // propagating them again would not change the ESDF.
+      tsdf_block->forEachDirtyVoxel(Update::kEsdf, [&](size_t lin_index) {
+        if (tsdf_block->isVoxelObserved(lin_index)) {
+          propagate_voxel(lin_index);
+        }
+      });
+    } else {
+      tsdf_block->forEachObservedVoxel(propagate_voxel);
+    }
+  }
+
+  if (incremental) {
+    openVoxelsAroundBlocks(new_esdf_blocks);
+  }
+
+  propagate_timer.Stop();
+  VLOG(3) << "[ESDF update]: Lower: " << num_lower << " Raise: " << num_raise
+          << " New: " << num_new;
+
+  if (!incremental && config_.exact_batch_distance) {
+    timing::Timer exact_timer("esdf/exact_distance");
+    computeExactDistances();
+    exact_timer.Stop();
+  } else {
+    timing::Timer raise_timer("esdf/raise_esdf");
+    processRaiseSet();
+    raise_timer.Stop();
+
+    timing::Timer update_timer("esdf/update_esdf");
+    processOpenSet();
+    update_timer.Stop();
+  }
+
+  esdf_timer.Stop();
+}
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_INTEGRATOR_ESDF_INTEGRATOR_INL_H_
@@ -43,10 +43,28 @@ class EsdfOccIntegrator {
 
   /**
    * Fixed is overloaded as occupied in this case.
-   * Only batch operations are currently supported for the occupancy map.
+   * Update from an occupancy layer in batch, clearing the current ESDF layer
+   * in the process.
    */
   void updateFromOccLayerBatch();
-  void updateFromOccBlocks(const BlockIndexList& occ_blocks);
+  /**
+   * Incrementally update from the occupancy blocks flagged for the ESDF,
+   * optionally clearing their flags and dirty voxels. Only the dirty voxels
+   * of the blocks are visited, see Block::markVoxelDirty, which the
+   * OccupancyIntegrator records for the voxels whose occupancy changed.
+   */
+  void updateFromOccLayer(bool clear_updated_flag);
+  void updateFromOccBlocks(const BlockIndexList& occ_blocks,
+                           bool incremental = false);
+
+  /**
+   * For incremental updates, the raise set contains all voxels that are no
+   * longer occupied. All voxels that have these voxels as parents are
+   * invalidated, and their other neighbors are pushed to the open set to
+   * assign them new values.
+   * The raise set is always empty in batch operations.
+   */
+  void processRaiseSet();
 
   void processOpenSet();
 
@@ -66,6 +84,26 @@ class EsdfOccIntegrator {
                    VoxelIndex* neighbor_voxel_index) const;
 
  protected:
+  /// What seeding a single ESDF voxel from its occupancy voxel did.
+  enum class OccPropagation { kNone, kNew, kLower, kRaise };
+
+  /**
+   * Seeds the ESDF voxel at lin_index of esdf_block from the corresponding
+   * occupancy voxel and queues it for propagation.
+   */
+  OccPropagation propagateOccVoxel(const BlockIndex& block_index,
+                                   size_t lin_index,
+                                   const OccupancyVoxel& occ_voxel,
+                                   bool incremental,
+                                   Block<EsdfVoxel>* esdf_block);
+
+  /**
+   * Sets a new free voxel to the smallest distance its observed neighbors
+   * lead to, returns true if there is one within max_distance_m.
+   */
+  bool updateVoxelFromNeighbors(const VoxelKey& voxel_key,
+                                EsdfVoxel* esdf_voxel) const;
+
   Config config_;
 
   Layer<OccupancyVoxel>* occ_layer_;
@@ -4,6 +4,8 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <cstdint>
+#include <thread>
 #include <vector>
 
 #include <glog/logging.h>
@@ -33,6 +35,9 @@ class ThreadSafeIndex {
   /// returns true if index is valid, false otherwise
   bool getNextIndex(size_t* idx);
 
+  /// Number of valid indices that were handed out since the last reset.
+  size_t getNumReadIndices() const;
+
   void reset();
 
  protected:
@@ -44,6 +49,45 @@ class ThreadSafeIndex {
   const size_t number_of_points_;
 };
 
+/**
+ * Lock of a single byte that spins, yielding, until it is free. Far smaller
+ * and cheaper to take than a std::mutex, but only suited for critical sections
+ * of a few instructions.
+ */
+class SpinLock {
+ public:
+  void lock() {
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+      // Wait with plain reads, they do not take the cache line away from the
+      // thread holding the lock.
+      while (locked_.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  void unlock() { locked_.store(false, std::memory_order_release); }
+
+ private:
+  std::atomic<bool> locked_{false};
+};
+
+/// Size of a cache line on all common x86 and ARM CPUs.
+static constexpr size_t kCacheLineSize = 64u;
+
+/**
+ * SpinLock padded to a cache line. In an array of these, two threads taking
+ * different locks never write to the same cache line. The padding alone is
+ * enough, each lock starts kCacheLineSize bytes after the previous one, so no
+ * over-aligned allocation is needed.
+ */
+class PaddedSpinLock : public SpinLock {
+ private:
+  char padding_[kCacheLineSize - sizeof(SpinLock)];
+};
+static_assert(sizeof(PaddedSpinLock) == kCacheLineSize,
+              "A padded spin lock has to fill exactly one cache line.");
+
 /*
  * The class attempts to ensure that the points are read in an order that gives
  * good coverage over the pointcloud very quickly. This is so that the
@@ -77,6 +121,8 @@ class MixedThreadSafeIndex : public ThreadSafeIndex {
 class SortedThreadSafeIndex : public ThreadSafeIndex {
  public:
   explicit SortedThreadSafeIndex(const Pointcloud& points_C);
+  /// Sorts by the given distances of the points instead.
+  explicit SortedThreadSafeIndex(const std::vector<FloatingPoint>& ranges);
 
  protected:
   virtual size_t getNextIndexImpl(size_t sequential_idx);
@@ -89,6 +135,9 @@ class ThreadSafeIndexFactory {
  public:
   static ThreadSafeIndex* get(const std::string& mode,
                               const Pointcloud& points_C);
+  /// Same as above for points at the given distances from the sensor.
+  static ThreadSafeIndex* get(const std::string& mode,
+                              const std::vector<FloatingPoint>& ranges);
 };
 
 /**
@@ -114,6 +163,8 @@ class RayCaster {
   bool nextRayIndex(GlobalIndex* ray_index);
 
  private:
+  friend class BatchRayCaster;
+
   void setupRayCaster(const Point& start_scaled, const Point& end_scaled);
 
   Ray t_to_next_boundary_;
@@ -125,6 +176,68 @@ class RayCaster {
   uint current_step_;
 };
 
+/**
+ * Traverses a batch of up to kMaxNumRays rays at once, with AVX2 (see
+ * VOXBLOX_USE_AVX2) eight rays in lockstep. The rays are set up by RayCaster
+ * and visit the same voxels in the same order. The indices of all rays are
+ * written to buffers that are reused for the next batch, so an instance kept
+ * per thread casts without allocating once its buffers fit the longest ray.
+ */
+class BatchRayCaster {
+ public:
+  static constexpr size_t kMaxNumRays = 8u;
+
+  BatchRayCaster();
+
+  /// Removes all rays, the buffers are kept.
+  void clear() { num_rays_ = 0u; }
+
+  size_t num_rays() const { return num_rays_; }
+  bool full() const { return num_rays_ == kMaxNumRays; }
+
+  /// Adds the remaining part of the ray of ray_caster and returns its index.
+  size_t addRay(const RayCaster& ray_caster);
+
+  /// Fills the index buffers of all rays of the batch.
+  void castRays();
+
+  size_t getNumIndices(size_t ray_idx) const {
+    DCHECK_LT(ray_idx, num_rays_);
+    return num_indices_[ray_idx];
+  }
+
+  /// Index of the voxel the ray visits in step step_idx, requires castRays.
+  GlobalIndex getIndex(size_t ray_idx, size_t step_idx) const {
+    DCHECK_LT(ray_idx, num_rays_);
+    DCHECK_LT(step_idx, num_indices_[ray_idx]);
+    const size_t buffer_idx = step_idx * kMaxNumRays + ray_idx;
+    return start_indices_[ray_idx] +
+           GlobalIndex(offsets_[0][buffer_idx], offsets_[1][buffer_idx],
+                       offsets_[2][buffer_idx]);
+  }
+
+ private:
+  void castRaysScalar();
+#ifdef __AVX2__
+  void castRaysAvx2(size_t max_num_indices);
+#endif
+
+  size_t num_rays_;
+
+  /// Traversal state of every ray, structure of arrays with a lane per ray.
+  std::array<std::array<float, kMaxNumRays>, 3> t_to_next_boundary_;
+  std::array<std::array<float, kMaxNumRays>, 3> t_step_size_;
+  std::array<std::array<int32_t, kMaxNumRays>, 3> ray_step_signs_;
+  std::array<GlobalIndex, kMaxNumRays> start_indices_;
+  std::array<size_t, kMaxNumRays> num_indices_;
+
+  /**
+   * Per axis, the offsets of the visited voxels from the first voxel of their
+   * ray. Step i of ray j is at i * kMaxNumRays + j.
+   */
+  std::array<std::vector<int32_t>, 3> offsets_;
+};
+
 /**
  * This function assumes PRE-SCALED coordinates, where one unit = one voxel
  * size. The indices are also returned in this scales coordinate system, which
@@ -143,52 +256,83 @@ inline void castRay(const Point& start_scaled, const Point& end_scaled,
 }
 
 /**
- * Takes start and end in WORLD COORDINATES, does all pre-scaling and
- * sorting into hierarhical index.
+ * Voxel indices grouped by their block, like a HierarchicalIndexMap. Clearing
+ * keeps all memory, so a buffer that is reused for all rays stops allocating
+ * once it held the longest of them.
  */
-inline void getHierarchicalIndexAlongRay(
-    const Point& start, const Point& end, size_t voxels_per_side,
-    FloatingPoint voxel_size, FloatingPoint truncation_distance,
-    bool voxel_carving_enabled, HierarchicalIndexMap* hierarchical_idx_map) {
-  hierarchical_idx_map->clear();
+class HierarchicalIndexBuffer {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-  FloatingPoint voxels_per_side_inv = 1.0 / voxels_per_side;
-  FloatingPoint voxel_size_inv = 1.0 / voxel_size;
+  HierarchicalIndexBuffer() : num_blocks_(0u), last_block_slot_(0u) {}
 
-  const Ray unit_ray = (end - start).normalized();
+  /// Removes all indices, the memory is kept.
+  void clear() {
+    num_blocks_ = 0u;
+    block_slots_.clear();
+  }
 
-  const Point ray_end = end + unit_ray * truncation_distance;
-  const Point ray_start =
-      voxel_carving_enabled ? start : (end - unit_ray * truncation_distance);
+  /// Number of blocks with at least one voxel, in order of their first voxel.
+  size_t num_blocks() const { return num_blocks_; }
 
-  const Point start_scaled = ray_start * voxel_size_inv;
-  const Point end_scaled = ray_end * voxel_size_inv;
+  const BlockIndex& getBlockIndex(size_t block_slot) const {
+    DCHECK_LT(block_slot, num_blocks_);
+    return blocks_[block_slot].block_index;
+  }
 
-  AlignedVector<GlobalIndex> global_voxel_index;
-  timing::Timer cast_ray_timer("integrate/cast_ray");
-  castRay(start_scaled, end_scaled, &global_voxel_index);
-  cast_ray_timer.Stop();
+  /// The voxels of a block, in the order they were added.
+  const VoxelIndexList& getVoxelIndices(size_t block_slot) const {
+    DCHECK_LT(block_slot, num_blocks_);
+    return blocks_[block_slot].voxel_indices;
+  }
 
-  timing::Timer create_index_timer("integrate/create_hi_index");
-  for (const GlobalIndex& global_voxel_idx : global_voxel_index) {
-    BlockIndex block_idx = getBlockIndexFromGlobalVoxelIndex(
-        global_voxel_idx, voxels_per_side_inv);
-    VoxelIndex local_voxel_idx =
-        getLocalFromGlobalVoxelIndex(global_voxel_idx, voxels_per_side);
+  void addVoxel(const BlockIndex& block_idx, const VoxelIndex& voxel_idx);
 
-    if (local_voxel_idx.x() < 0) {
-      local_voxel_idx.x() += voxels_per_side;
-    }
-    if (local_voxel_idx.y() < 0) {
-      local_voxel_idx.y() += voxels_per_side;
-    }
-    if (local_voxel_idx.z() < 0) {
-      local_voxel_idx.z() += voxels_per_side;
-    }
+ private:
+  struct BlockVoxels {
+    BlockIndex block_index;
+    VoxelIndexList voxel_indices;
+  };
+
+  /// Only the first num_blocks_ entries are in use, the rest keeps its memory.
+  std::vector<BlockVoxels> blocks_;
+  size_t num_blocks_;
+  FlatAnyIndexHashMapType<size_t>::type block_slots_;
+  /// Consecutive voxels of a ray mostly share their block.
+  size_t last_block_slot_;
+};
+
+/**
+ * Takes start and end in WORLD COORDINATES, does all pre-scaling and
+ * sorting into hierarhical index. Reusing the buffer for all rays avoids any
+ * allocations.
+ */
+void getHierarchicalIndexAlongRay(const Point& start, const Point& end,
+                                  size_t voxels_per_side,
+                                  FloatingPoint voxel_size,
+                                  FloatingPoint truncation_distance,
+                                  bool voxel_carving_enabled,
+                                  HierarchicalIndexBuffer* hierarchical_idx);
+
+/**
+ * Takes start and end in WORLD COORDINATES, does all pre-scaling and
+ * sorting into hierarhical index.
+ */
+inline void getHierarchicalIndexAlongRay(
+    const Point& start, const Point& end, size_t voxels_per_side,
+    FloatingPoint voxel_size, FloatingPoint truncation_distance,
+    bool voxel_carving_enabled, HierarchicalIndexMap* hierarchical_idx_map) {
+  CHECK_NOTNULL(hierarchical_idx_map);
+  hierarchical_idx_map->clear();
 
-    (*hierarchical_idx_map)[block_idx].push_back(local_voxel_idx);
+  HierarchicalIndexBuffer hierarchical_idx;
+  getHierarchicalIndexAlongRay(start, end, voxels_per_side, voxel_size,
+                               truncation_distance, voxel_carving_enabled,
+                               &hierarchical_idx);
+  for (size_t i = 0u; i < hierarchical_idx.num_blocks(); ++i) {
+    (*hierarchical_idx_map)[hierarchical_idx.getBlockIndex(i)] =
+        hierarchical_idx.getVoxelIndices(i);
   }
-  create_index_timer.Stop();
 }
 
 }  // namespace voxblox
@@ -2,6 +2,9 @@
 #define VOXBLOX_INTEGRATOR_OCCUPANCY_INTEGRATOR_H_
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
@@ -75,71 +78,73 @@ class OccupancyIntegrator {
         clamp_max_log_);
   }
 
+  /**
+   * Steady state integration does not allocate, the rays and the touched cells
+   * are kept in buffers that are reused for every scan.
+   */
   void integratePointCloud(const Transformation& T_G_C,
                            const Pointcloud& points_C) {
-    timing::Timer integrate_timer("integrate_occ");
+    // Looking up the handles once avoids constructing the tags every scan.
+    static const size_t kIntegrateTimer =
+        timing::Timing::GetHandle("integrate_occ");
+    static const size_t kCastRayTimer =
+        timing::Timing::GetHandle("integrate_occ/cast_ray");
+    static const size_t kUpdateVoxelsTimer =
+        timing::Timing::GetHandle("integrate_occ/update_occupancy");
+    timing::Timer integrate_timer(kIntegrateTimer);
 
     const Point& origin = T_G_C.getPosition();
 
-    LongIndexSet free_cells;
-    LongIndexSet occupied_cells;
+    ray_cells_.clear();
 
     const Point start_scaled = origin * voxel_size_inv_;
     Point end_scaled = Point::Zero();
 
+    timing::Timer cast_ray_timer(kCastRayTimer);
+    ray_caster_.clear();
     for (size_t pt_idx = 0; pt_idx < points_C.size(); ++pt_idx) {
       const Point& point_C = points_C[pt_idx];
       const Point point_G = T_G_C * point_C;
       const Ray unit_ray = (point_G - origin).normalized();
 
-      timing::Timer cast_ray_timer("integrate_occ/cast_ray");
-
-      AlignedVector<GlobalIndex> global_voxel_indices;
       FloatingPoint ray_distance = (point_G - origin).norm();
+      bool is_clearing = false;
       if (ray_distance < config_.min_ray_length_m) {
         continue;
       } else if (ray_distance > config_.max_ray_length_m) {
         // Simply clear up until the max ray distance in this case.
         end_scaled =
             (origin + config_.max_ray_length_m * unit_ray) * voxel_size_inv_;
-
-        if (free_cells.find(getGridIndexFromPoint<GlobalIndex>(end_scaled)) ==
-            free_cells.end()) {
-          castRay(start_scaled, end_scaled, &global_voxel_indices);
-          free_cells.insert(global_voxel_indices.begin(),
-                            global_voxel_indices.end());
-        }
+        is_clearing = true;
       } else {
         end_scaled = point_G * voxel_size_inv_;
-        if (occupied_cells.find(getGridIndexFromPoint<GlobalIndex>(
-                end_scaled)) == occupied_cells.end()) {
-          castRay(start_scaled, end_scaled, &global_voxel_indices);
-
-          if (global_voxel_indices.size() > 2) {
-            free_cells.insert(global_voxel_indices.begin(),
-                              global_voxel_indices.end() - 1);
-            occupied_cells.insert(global_voxel_indices.back());
-          }
-        }
       }
-      cast_ray_timer.Stop();
-    }
 
-    timing::Timer update_voxels_timer("integrate_occ/update_occupancy");
+      const GlobalIndex end_index =
+          getGridIndexFromPoint<GlobalIndex>(end_scaled);
+      if (hasCellFlag(end_index, is_clearing ? kFreeCell : kOccupiedCell)) {
+        continue;
+      }
 
-    // Clean up the lists: remove any occupied cells from free cells.
-    for (const GlobalIndex& global_index : occupied_cells) {
-      LongIndexSet::iterator cell_it = free_cells.find(global_index);
-      if (cell_it != free_cells.end()) {
-        free_cells.erase(cell_it);
+      const size_t ray_idx =
+          ray_caster_.addRay(RayCaster(start_scaled, end_scaled));
+      ray_is_clearing_[ray_idx] = is_clearing;
+      ray_end_indices_[ray_idx] = end_index;
+      if (ray_caster_.full()) {
+        insertCastRays();
+        ray_caster_.clear();
       }
     }
-    // Then actually update the occupancy voxels.
+    insertCastRays();
+    cast_ray_timer.Stop();
+
+    timing::Timer update_voxels_timer(kUpdateVoxelsTimer);
+
+    // Cells that are both free and occupied count as occupied.
     BlockIndex last_block_idx = BlockIndex::Zero();
     Block<OccupancyVoxel>::Ptr block;
-
-    bool occupied = false;
-    for (const GlobalIndex& global_voxel_idx : free_cells) {
+    for (const std::pair<const GlobalIndex, uint8_t>& cell : ray_cells_) {
+      const GlobalIndex& global_voxel_idx = cell.first;
       BlockIndex block_idx = getBlockIndexFromGlobalVoxelIndex(
           global_voxel_idx, voxels_per_side_inv_);
       VoxelIndex local_voxel_idx =
@@ -152,25 +157,16 @@ class OccupancyIntegrator {
       }
 
       OccupancyVoxel& occ_voxel = block->getVoxelByVoxelIndex(local_voxel_idx);
+      const bool occupied = (cell.second & kOccupiedCell) != 0u;
+      const bool was_observed = occ_voxel.observed;
+      const bool was_occupied = occ_voxel.probability_log > 0.0f;
       updateOccupancyVoxel(occupied, &occ_voxel);
-    }
-    block.reset();
-
-    occupied = true;
-    for (const GlobalIndex& global_voxel_idx : occupied_cells) {
-      BlockIndex block_idx = getBlockIndexFromGlobalVoxelIndex(
-          global_voxel_idx, voxels_per_side_inv_);
-      VoxelIndex local_voxel_idx =
-          getLocalFromGlobalVoxelIndex(global_voxel_idx, voxels_per_side_);
-
-      if (!block || block_idx != last_block_idx) {
-        block = layer_->allocateBlockPtrByIndex(block_idx);
-        block->updated().set();
-        last_block_idx = block_idx;
+      // Only voxels that are new or flipped their occupancy change the ESDF,
+      // see EsdfOccIntegrator::updateFromOccLayer.
+      if (!was_observed || was_occupied != (occ_voxel.probability_log > 0.0f)) {
+        block->markVoxelDirty(
+            block->computeLinearIndexFromVoxelIndex(local_voxel_idx));
       }
-
-      OccupancyVoxel& occ_voxel = block->getVoxelByVoxelIndex(local_voxel_idx);
-      updateOccupancyVoxel(occupied, &occ_voxel);
     }
 
     update_voxels_timer.Stop();
@@ -178,6 +174,48 @@ class OccupancyIntegrator {
   }
 
  protected:
+  /// Flags of the cells in ray_cells_.
+  enum CellFlag : uint8_t { kFreeCell = 1u, kOccupiedCell = 2u };
+
+  bool hasCellFlag(const GlobalIndex& global_voxel_idx, CellFlag flag) const {
+    const FlatLongIndexHashMapType<uint8_t>::type::const_iterator cell_it =
+        ray_cells_.find(global_voxel_idx);
+    return cell_it != ray_cells_.end() && (cell_it->second & flag) != 0u;
+  }
+
+  /**
+   * Casts the rays of ray_caster_ and marks the voxels they pass through as
+   * free and the voxels they end in as occupied.
+   */
+  void insertCastRays() {
+    ray_caster_.castRays();
+    for (size_t ray_idx = 0u; ray_idx < ray_caster_.num_rays(); ++ray_idx) {
+      // Rays of the batch are only skipped before casting if an earlier batch
+      // already marked their end voxel, check the earlier rays of this batch
+      // as well to get the same result as casting the rays one by one.
+      const size_t num_indices = ray_caster_.getNumIndices(ray_idx);
+      if (ray_is_clearing_[ray_idx]) {
+        if (hasCellFlag(ray_end_indices_[ray_idx], kFreeCell)) {
+          continue;
+        }
+        for (size_t i = 0u; i < num_indices; ++i) {
+          ray_cells_[ray_caster_.getIndex(ray_idx, i)] |= kFreeCell;
+        }
+      } else {
+        if (hasCellFlag(ray_end_indices_[ray_idx], kOccupiedCell)) {
+          continue;
+        }
+        if (num_indices > 2) {
+          for (size_t i = 0u; i + 1u < num_indices; ++i) {
+            ray_cells_[ray_caster_.getIndex(ray_idx, i)] |= kFreeCell;
+          }
+          ray_cells_[ray_caster_.getIndex(ray_idx, num_indices - 1u)] |=
+              kOccupiedCell;
+        }
+      }
+    }
+  }
+
   Config config_;
 
   Layer<OccupancyVoxel>* layer_;
@@ -197,6 +235,13 @@ class OccupancyIntegrator {
   FloatingPoint voxel_size_inv_;
   FloatingPoint voxels_per_side_inv_;
   FloatingPoint block_size_inv_;
+
+  /// Rays of the current batch, reused between scans.
+  BatchRayCaster ray_caster_;
+  /// Free and occupied cells of the current scan, reused between scans.
+  FlatLongIndexHashMapType<uint8_t>::type ray_cells_;
+  std::array<bool, BatchRayCaster::kMaxNumRays> ray_is_clearing_;
+  std::array<GlobalIndex, BatchRayCaster::kMaxNumRays> ray_end_indices_;
 };
 
 }  // namespace voxblox
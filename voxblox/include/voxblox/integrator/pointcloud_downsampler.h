@@ -0,0 +1,99 @@
+#ifndef VOXBLOX_INTEGRATOR_POINTCLOUD_DOWNSAMPLER_H_
+#define VOXBLOX_INTEGRATOR_POINTCLOUD_DOWNSAMPLER_H_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/utils/thread_pool.h"
+
+namespace voxblox {
+
+/**
+ * Reduces a pointcloud to a single point per cell of a voxel grid, ahead of
+ * any of the TSDF integrators. The points of a cell are replaced by their
+ * mean, carrying their averaged color and their number as weight, see
+ * TsdfIntegratorBase::integrateWeightedPointCloud.
+ *
+ * Instead of hashing every point, the points are radix sorted by the Morton
+ * code of their cell, after which the points of a cell are neighbors. Both the
+ * sort and the averaging are split over the threads, and the reduced cloud
+ * comes out in Morton order, so points that are close in space stay close in
+ * memory. All buffers are kept between calls, once they fit the clouds no
+ * memory is allocated.
+ */
+class PointcloudDownsampler {
+ public:
+  struct Config {
+    /// Edge length of the cells the points are merged in.
+    FloatingPoint voxel_size = 0.05;
+    size_t num_threads = std::thread::hardware_concurrency();
+  };
+
+  explicit PointcloudDownsampler(const Config& config);
+
+  const Config& getConfig() const { return config_; }
+
+  /**
+   * Runs on the workers of thread_pool, which may be shared with the
+   * integrators, instead of a pool of num_threads - 1 workers that is created
+   * on first use.
+   */
+  void setThreadPool(const ThreadPool::Ptr& thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+
+  /**
+   * Merges the points of every cell, dropping points that are not finite.
+   * Points further than 2^21 cells from the lowest point along an axis are
+   * dropped as well. The outputs only allocate if their capacity does not
+   * suffice. NOT thread safe.
+   */
+  void downsample(const Pointcloud& points, const Colors& colors,
+                  Pointcloud* downsampled_points, Colors* downsampled_colors,
+                  std::vector<float>* weights);
+
+ private:
+  /// Bits of each coordinate in the Morton code.
+  static constexpr int kBitsPerAxis = 21;
+  static constexpr int kRadixBits = 8;
+  static constexpr size_t kRadixSize = 1u << kRadixBits;
+  /// Fewer points are not worth another task.
+  static constexpr size_t kMinPointsPerTask = 4096u;
+
+  typedef std::array<size_t, kRadixSize> Histogram;
+
+  /// Runs task(0) to task(num_tasks - 1), with the calling thread taking part.
+  void runTasks(size_t num_tasks, const std::function<void(size_t)>& task);
+
+  /// Sorts sorted_keys_ and sorted_point_indices_ by the lowest num_bits bits.
+  void sortByKey(size_t num_points, int num_bits, size_t num_tasks);
+
+  /// Beginning of the points of task task_idx, moved to the start of a cell.
+  size_t getCellAlignedBegin(size_t task_idx, size_t num_tasks,
+                             size_t num_points) const;
+
+  Config config_;
+  FloatingPoint voxel_size_inv_;
+
+  ThreadPool::Ptr thread_pool_;
+
+  // Reused buffers.
+  std::vector<uint64_t> sorted_keys_;
+  std::vector<uint64_t> key_buffer_;
+  std::vector<uint32_t> sorted_point_indices_;
+  std::vector<uint32_t> point_index_buffer_;
+  AlignedVector<GlobalIndex> task_min_cells_;
+  AlignedVector<GlobalIndex> task_max_cells_;
+  std::vector<Histogram> task_histograms_;
+  std::vector<size_t> task_num_cells_;
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_INTEGRATOR_POINTCLOUD_DOWNSAMPLER_H_
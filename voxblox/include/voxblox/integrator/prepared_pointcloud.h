@@ -0,0 +1,116 @@
+#ifndef VOXBLOX_INTEGRATOR_PREPARED_POINTCLOUD_H_
+#define VOXBLOX_INTEGRATOR_PREPARED_POINTCLOUD_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+
+#include "voxblox/core/common.h"
+
+namespace voxblox {
+
+/**
+ * A pointcloud that passed the ray length checks of the integrators, together
+ * with its points in the global frame, ready to be cast. The points are stored
+ * as a structure of arrays, so the ranges, the checks and the transform are
+ * computed with Eigen's packet math over whole columns instead of point by
+ * point inside every integration thread. Points below the minimum ray length
+ * or that are not finite are dropped, the order of the remaining points is
+ * kept. All buffers are kept between calls, once they fit the clouds no
+ * memory is allocated.
+ *
+ * A cloud is prepared once and can then be integrated by any TSDF integrator,
+ * see TsdfIntegratorBase::integratePreparedPointCloud. If the pose of the
+ * sensor changes, e.g. after it was refined by ICP, only the transform has to
+ * be redone, see setTransform.
+ */
+class PreparedPointcloud {
+ public:
+  struct Config {
+    FloatingPoint min_ray_length_m = 0.1;
+    FloatingPoint max_ray_length_m = 5.0;
+    /// If false points beyond max_ray_length_m are dropped instead of being
+    /// used to clear, unless the cloud consists of freespace points.
+    bool allow_clear = true;
+  };
+
+  PreparedPointcloud() : num_input_points_(0u), freespace_points_(false) {}
+
+  /**
+   * Filters points_C by the ray length checks and transforms the remaining
+   * points with T_G_C. If freespace_points is true all points only clear, see
+   * TsdfIntegratorBase::integratePointCloud. NOT thread safe.
+   */
+  void prepare(const Config& config, const Transformation& T_G_C,
+               const Pointcloud& points_C, bool freespace_points);
+
+  /// Transforms the points with T_G_C instead. NOT thread safe.
+  void setTransform(const Transformation& T_G_C);
+
+  const Transformation& getTransform() const { return T_G_C_; }
+  const Point& getOrigin() const { return T_G_C_.getPosition(); }
+
+  /// Number of points that passed the checks.
+  size_t size() const { return point_indices_.size(); }
+  bool empty() const { return point_indices_.empty(); }
+
+  /// Number of points of the cloud given to prepare.
+  size_t getNumInputPoints() const { return num_input_points_; }
+  bool areFreespacePoints() const { return freespace_points_; }
+
+  /// Point i in the sensor frame.
+  inline Point getPointC(const size_t i) const {
+    DCHECK_LT(i, size());
+    return Point(x_C_[i], y_C_[i], z_C_[i]);
+  }
+
+  /// Point i in the global frame.
+  inline Point getPointG(const size_t i) const {
+    DCHECK_LT(i, size());
+    return Point(x_G_[i], y_G_[i], z_G_[i]);
+  }
+
+  /// Distance of point i to the sensor.
+  inline FloatingPoint getRange(const size_t i) const {
+    DCHECK_LT(i, size());
+    return ranges_[i];
+  }
+
+  /// Index of point i in the cloud given to prepare, e.g. to get its color.
+  inline size_t getPointIndex(const size_t i) const {
+    DCHECK_LT(i, size());
+    return point_indices_[i];
+  }
+
+  /// True if point i only clears the space up to it.
+  inline bool isClearing(const size_t i) const {
+    DCHECK_LT(i, size());
+    return is_clearing_[i] != 0u;
+  }
+
+  const std::vector<FloatingPoint>& getRanges() const { return ranges_; }
+
+ private:
+  /// Number of points whose ranges are computed at once.
+  static constexpr int kChunkSize = 256;
+
+  Transformation T_G_C_;
+  size_t num_input_points_;
+  bool freespace_points_;
+
+  std::vector<FloatingPoint> x_C_;
+  std::vector<FloatingPoint> y_C_;
+  std::vector<FloatingPoint> z_C_;
+  std::vector<FloatingPoint> x_G_;
+  std::vector<FloatingPoint> y_G_;
+  std::vector<FloatingPoint> z_G_;
+  std::vector<FloatingPoint> ranges_;
+  std::vector<uint32_t> point_indices_;
+  std::vector<uint8_t> is_clearing_;
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_INTEGRATOR_PREPARED_POINTCLOUD_H_
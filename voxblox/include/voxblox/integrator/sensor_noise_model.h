@@ -0,0 +1,109 @@
+#ifndef VOXBLOX_INTEGRATOR_SENSOR_NOISE_MODEL_H_
+#define VOXBLOX_INTEGRATOR_SENSOR_NOISE_MODEL_H_
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/common.h"
+
+namespace voxblox {
+
+/**
+ * Weights of the measurements of a sensor, derived from its depth noise. A
+ * measurement with standard deviation sigma gets the weight 1 / sigma^2,
+ * normalized to the weight of a measurement at 1 m. The weights are tabulated
+ * over the range once, looking one up costs two loads and a multiply-add
+ * instead of evaluating the model.
+ */
+class SensorNoiseModel {
+ public:
+  enum class Type : int {
+    /// sigma proportional to the depth, the weighting voxblox always used.
+    kInverseSquareDepth = 1,
+    /// sigma = lidar_noise_m + lidar_noise_per_m * range.
+    kLidar = 2,
+    /// sigma = rgbd_noise_m + rgbd_noise_quadratic * (depth - offset)^2.
+    kRgbd = 3,
+  };
+
+  struct Config {
+    Type type = Type::kInverseSquareDepth;
+    /// Range covered by the table, the weights of further measurements are
+    /// computed from the model.
+    FloatingPoint max_range_m = 5.0;
+
+    float lidar_noise_m = 0.02f;
+    float lidar_noise_per_m = 0.001f;
+
+    /// Defaults of a Kinect, see Nguyen et al., "Modeling Kinect Sensor Noise
+    /// for Improved 3D Reconstruction and Tracking", 3DIMPVT 2012.
+    float rgbd_noise_m = 0.0012f;
+    float rgbd_noise_quadratic = 0.0019f;
+    float rgbd_noise_offset_m = 0.4f;
+  };
+
+  /// Type of the name, one of "inverse_square_depth", "lidar", "rgbd".
+  static Type getTypeFromName(const std::string& type_name);
+
+  explicit SensorNoiseModel(const Config& config);
+
+  const Config& getConfig() const { return config_; }
+
+  /**
+   * Weight of a measurement at point_C in the sensor frame, based on the
+   * range for LiDARs and on the depth otherwise. Thread safe.
+   */
+  inline float getWeight(const Point& point_C) const {
+    return getWeightAtRange((config_.type == Type::kLidar)
+                                ? point_C.norm()
+                                : std::abs(point_C.z()));
+  }
+
+  /**
+   * Weight of a measurement at range, which is the depth for depth based
+   * sensors. Ranges below kEpsilon get no weight, as voxblox always gave
+   * points at zero depth. The other ranges below the first entry of the table
+   * get its weight, which keeps the inverse square weights finite, ranges
+   * beyond it are computed from the model and NaNs get the weight at
+   * max_range_m. Thread safe.
+   */
+  inline float getWeightAtRange(const FloatingPoint range) const {
+    if (range < kEpsilon) {
+      return 0.0f;
+    }
+    const FloatingPoint scaled_range =
+        std::max(range * bin_size_inv_, static_cast<FloatingPoint>(1.0));
+    if (!(scaled_range < max_scaled_range_)) {
+      if (std::isnan(scaled_range)) {
+        return weights_.back();
+      }
+      return computeWeightAtRange(range);
+    }
+    const size_t bin = static_cast<size_t>(scaled_range);
+    const float fraction = scaled_range - static_cast<FloatingPoint>(bin);
+    return weights_[bin] + fraction * (weights_[bin + 1u] - weights_[bin]);
+  }
+
+  /// Evaluates the model without the table. Thread safe.
+  float computeWeightAtRange(FloatingPoint range) const;
+
+ private:
+  static constexpr size_t kNumBins = 4096u;
+
+  /// Standard deviation of a measurement at range.
+  float computeNoise(FloatingPoint range) const;
+
+  Config config_;
+  FloatingPoint bin_size_inv_;
+  FloatingPoint max_scaled_range_;
+  /// Weights at the ranges i / bin_size_inv_, for i = 0 to kNumBins.
+  std::vector<float> weights_;
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_INTEGRATOR_SENSOR_NOISE_MODEL_H_
@@ -2,9 +2,12 @@
 #define VOXBLOX_INTEGRATOR_TSDF_INTEGRATOR_H_
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cmath>
 #include <deque>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <mutex>
@@ -19,10 +22,15 @@
 
 #include "voxblox/core/block_hash.h"
 #include "voxblox/core/common.h"
+#include "voxblox/core/concurrent_block_map.h"
 #include "voxblox/core/layer.h"
 #include "voxblox/core/voxel.h"
 #include "voxblox/integrator/integrator_utils.h"
+#include "voxblox/integrator/prepared_pointcloud.h"
+#include "voxblox/integrator/sensor_noise_model.h"
 #include "voxblox/utils/approx_hash_array.h"
+#include "voxblox/utils/camera_model.h"
+#include "voxblox/utils/thread_pool.h"
 #include "voxblox/utils/timing.h"
 
 namespace voxblox {
@@ -31,14 +39,18 @@ enum class TsdfIntegratorType : int {
   kSimple = 1,
   kMerged = 2,
   kFast = 3,
+  kPartitioned = 4,
+  kProjective = 5,
 };
 
-static constexpr size_t kNumTsdfIntegratorTypes = 3u;
+static constexpr size_t kNumTsdfIntegratorTypes = 5u;
 
 const std::array<std::string, kNumTsdfIntegratorTypes>
     kTsdfIntegratorTypeNames = {{/*kSimple*/ "simple",
                                  /*kMerged*/ "merged",
-                                 /*kFast*/ "fast"}};
+                                 /*kFast*/ "fast",
+                                 /*kPartitioned*/ "partitioned",
+                                 /*kProjective*/ "projective"}};
 
 /**
  * Base class to the simple, merged and fast TSDF integrators. The integrator
@@ -62,16 +74,39 @@ class TsdfIntegratorBase {
     FloatingPoint min_ray_length_m = 0.1;
     FloatingPoint max_ray_length_m = 5.0;
     bool use_const_weight = false;
+    /// Noise model the weights of the measurements are derived from, see
+    /// SensorNoiseModel. Options: "inverse_square_depth", "lidar", "rgbd"
+    std::string sensor_noise_model = "inverse_square_depth";
     bool allow_clear = true;
     bool use_weight_dropoff = true;
     bool use_sparsity_compensation_factor = false;
     float sparsity_compensation_factor = 1.0f;
 
     size_t integrator_threads = std::thread::hardware_concurrency();
+    /// Number of independently locked shards of the map holding the blocks
+    /// allocated during integration, has to be a power of two.
+    size_t num_block_map_shards =
+        ConcurrentBlockMap<Block<TsdfVoxel>>::kDefaultNumShards;
+    /// If true the voxels are guarded by the striped spin locks of
+    /// voxel_locks_ instead of the striped mutexes.
+    bool use_voxel_spin_locks = false;
 
     /// Mode of the ThreadSafeIndex, determines the integration order of the
     /// rays. Options: "mixed", "sorted"
     std::string integration_order_mode = "mixed";
+    /**
+     * Time budget of a single call to integratePointCloud. Once it is used up
+     * the remaining points are dropped, as they are read in the order of
+     * integration_order_mode these are the least informative ones. Ignored by
+     * the projective integrator, whose cost does not depend on the points.
+     */
+    float max_integration_time_s = std::numeric_limits<float>::max();
+    /**
+     * If true the updated voxels are recorded in the dirty masks of their
+     * blocks, see Block::markVoxelDirty, so the mesh and the ESDF are only
+     * updated around them instead of over the whole updated blocks.
+     */
+    bool track_dirty_voxels = false;
 
     /// merge integrator specific
     bool enable_anti_grazing = false;
@@ -82,16 +117,34 @@ class TsdfIntegratorBase {
     int max_consecutive_ray_collisions = 2;
     /// fast integrator specific
     int clear_checks_every_n_frames = 1;
-    /// fast integrator specific
-    float max_integration_time_s = std::numeric_limits<float>::max();
+
+    /// projective integrator specific, the depth image the points are
+    /// rendered into.
+    CameraIntrinsics projective_camera_intrinsics;
 
     std::string print() const;
   };
 
+  /// Outcome of the last call to integratePointCloud.
+  struct IntegrationStats {
+    /// Points that were integrated or rejected by the range checks.
+    size_t num_integrated_points = 0u;
+    /// Points that were dropped as max_integration_time_s ran out.
+    size_t num_dropped_points = 0u;
+  };
+
   TsdfIntegratorBase(const Config& config, Layer<TsdfVoxel>* layer);
 
   /**
-   * Integrates the given point infomation into the TSDF.
+   * Integrates into a layer of compact voxels, whose distances are quantized
+   * relative to config.default_truncation_distance. Only supported by the
+   * simple integrator.
+   */
+  TsdfIntegratorBase(const Config& config, Layer<CompactTsdfVoxel>* layer);
+
+  /**
+   * Integrates the given point infomation into the TSDF. Prepares the points,
+   * see preparePointcloud, and integrates them.
    * NOT thread safe.
    * @param freespace_points if true points will only be integrated up to the
    * truncation distance. Used when we are given a minimum distance to a point,
@@ -100,71 +153,193 @@ class TsdfIntegratorBase {
   virtual void integratePointCloud(const Transformation& T_G_C,
                                    const Pointcloud& points_C,
                                    const Colors& colors,
-                                   const bool freespace_points = false) = 0;
+                                   const bool freespace_points = false);
+
+  /**
+   * Applies the ray length checks of the config to points_C and transforms
+   * the remaining points into the global frame. The result can be integrated
+   * by any integrator sharing these checks. Thread safe.
+   */
+  void preparePointcloud(const Transformation& T_G_C,
+                         const Pointcloud& points_C,
+                         const bool freespace_points,
+                         PreparedPointcloud* prepared_points) const;
+
+  /**
+   * Integrates a prepared cloud, colors holds the colors of the cloud given to
+   * preparePointcloud. NOT thread safe.
+   */
+  virtual void integratePreparedPointCloud(
+      const PreparedPointcloud& prepared_points, const Colors& colors) = 0;
+
+  /**
+   * Same as integratePointCloud, with the weight of every point multiplied by
+   * its entry in point_weights. These are the number of points merged into
+   * each point by the PointcloudDownsampler. The projective integrator keeps
+   * the closest point per pixel and ignores the weights. NOT thread safe.
+   */
+  void integrateWeightedPointCloud(const Transformation& T_G_C,
+                                   const Pointcloud& points_C,
+                                   const Colors& colors,
+                                   const std::vector<float>& point_weights,
+                                   const bool freespace_points = false);
 
   /// Returns a CONST ref of the config.
   const Config& getConfig() const { return config_; }
 
+  const IntegrationStats& getLastIntegrationStats() const {
+    return last_integration_stats_;
+  }
+
   void setLayer(Layer<TsdfVoxel>* layer);
+  void setLayer(Layer<CompactTsdfVoxel>* layer);
+
+  /// Replaces the sensor noise model of the config, NOT thread safe.
+  void setSensorNoiseModel(const SensorNoiseModel::Config& config) {
+    sensor_noise_model_ = SensorNoiseModel(config);
+  }
+  const SensorNoiseModel& getSensorNoiseModel() const {
+    return sensor_noise_model_;
+  }
+
+  /**
+   * Runs the integration on the workers of thread_pool, which may be shared
+   * with other integrators, instead of a pool of integrator_threads - 1
+   * workers that is created on first use. The integration is still split into
+   * integrator_threads tasks.
+   */
+  void setThreadPool(const ThreadPool::Ptr& thread_pool) {
+    thread_pool_ = thread_pool;
+  }
 
  protected:
+  /**
+   * Runs task(0) to task(integrator_threads - 1) on the thread pool, with the
+   * calling thread taking part, and returns once all are done. Task i may use
+   * thread_ray_casters_[i].
+   */
+  void runIntegrationTasks(const std::function<void(size_t)>& task);
+
+  /// Starts the max_integration_time_s budget of an integratePointCloud call.
+  void startIntegrationTimer() {
+    integration_start_time_ = std::chrono::steady_clock::now();
+  }
+
   /// Thread safe.
-  inline bool isPointValid(const Point& point_C, const bool freespace_point,
-                           bool* is_clearing) const {
-    DCHECK(is_clearing != nullptr);
-    const FloatingPoint ray_distance = point_C.norm();
-    if (ray_distance < config_.min_ray_length_m) {
-      return false;
-    } else if (ray_distance > config_.max_ray_length_m) {
-      if (config_.allow_clear || freespace_point) {
-        *is_clearing = true;
-        return true;
-      } else {
-        return false;
-      }
-    } else {
-      *is_clearing = freespace_point;
-      return true;
-    }
+  inline bool isIntegrationTimeLeft() const {
+    return std::chrono::duration<float>(std::chrono::steady_clock::now() -
+                                        integration_start_time_)
+               .count() < config_.max_integration_time_s;
+  }
+
+  /// Stores the statistics of an integratePointCloud call.
+  void setIntegrationStats(size_t num_points, size_t num_dropped_points) {
+    DCHECK_LE(num_dropped_points, num_points);
+    last_integration_stats_.num_integrated_points =
+        num_points - num_dropped_points;
+    last_integration_stats_.num_dropped_points = num_dropped_points;
   }
 
   /**
    * Will return a pointer to a voxel located at global_voxel_idx in the tsdf
    * layer. Thread safe.
    * Takes in the last_block_idx and last_block to prevent unneeded map lookups.
-   * If this voxel belongs to a block that has not been allocated, a block in
-   * temp_block_map_ is created/accessed and a voxel from this map is returned
-   * instead. Unlike the layer, accessing temp_block_map_ is controlled via a
-   * mutex allowing it to grow during integration.
-   * These temporary blocks can be merged into the layer later by calling
-   * updateLayerWithStoredBlocks
+   * If this voxel belongs to a block that has not been allocated, the block is
+   * allocated in new_blocks_, which all threads can grow concurrently. The
+   * layer's own map cannot grow while other threads probe it, so these blocks
+   * are handed over to the layer by calling updateLayerWithStoredBlocks.
    */
-  TsdfVoxel* allocateStorageAndGetVoxelPtr(const GlobalIndex& global_voxel_idx,
-                                           Block<TsdfVoxel>::Ptr* last_block,
-                                           BlockIndex* last_block_idx);
+  template <typename VoxelType>
+  VoxelType* allocateStorageAndGetVoxelPtr(
+      const GlobalIndex& global_voxel_idx,
+      std::shared_ptr<Block<VoxelType>>* last_block,
+      BlockIndex* last_block_idx);
 
   /**
-   * Merges temporarily stored blocks into the main layer. NOT thread safe, see
+   * Inserts the blocks allocated during integration into the main layer. Only
+   * moves the block pointers. NOT thread safe, see
    * allocateStorageAndGetVoxelPtr for more details.
    */
   void updateLayerWithStoredBlocks();
 
   /// Updates tsdf_voxel, Thread safe.
+  template <typename VoxelType>
   void updateTsdfVoxel(const Point& origin, const Point& point_G,
                        const GlobalIndex& global_voxel_index,
                        const Color& color, const float weight,
-                       TsdfVoxel* tsdf_voxel);
+                       VoxelType* tsdf_voxel);
+
+  /**
+   * Computes the distance of the voxel to the surface along the ray and the
+   * weight of this measurement. Thread safe.
+   */
+  void computeTsdfMeasurement(const Point& origin, const Point& point_G,
+                              const GlobalIndex& global_voxel_index,
+                              const float weight, float* sdf,
+                              float* updated_weight) const;
+
+  /**
+   * Applies the weight dropoff behind the surface and the sparsity
+   * compensation to the weight of a measurement with distance sdf.
+   */
+  float computeUpdatedWeight(const float sdf, const float weight) const;
+
+  /**
+   * Fuses a measurement into tsdf_voxel. NOT thread safe, the caller has to
+   * hold the mutex of the voxel.
+   */
+  void fuseTsdfMeasurement(const float sdf, const float weight,
+                           const Color& color, TsdfVoxel* tsdf_voxel) const;
+
+  /**
+   * Same as above for a compact voxel, the measurement is fused in full
+   * precision and only the result is quantized. NOT thread safe.
+   */
+  void fuseTsdfMeasurement(const float sdf, const float weight,
+                           const Color& color,
+                           CompactTsdfVoxel* tsdf_voxel) const;
+
+  /// The layer of the voxel type, nullptr if the integrator writes the other.
+  template <typename VoxelType>
+  Layer<VoxelType>* getLayer();
+
+  /// The blocks of the voxel type allocated during integration.
+  template <typename VoxelType>
+  ConcurrentBlockMap<Block<VoxelType>>* getNewBlocks();
 
   /// Calculates TSDF distance, Thread safe.
   float computeDistance(const Point& origin, const Point& point_G,
                         const Point& voxel_center) const;
 
-  /// Thread safe.
-  float getVoxelWeight(const Point& point_C) const;
+  /// Weight of a measurement at point_C. Thread safe.
+  inline float getVoxelWeight(const Point& point_C) const {
+    if (config_.use_const_weight) {
+      return 1.0f;
+    }
+    return sensor_noise_model_.getWeight(point_C);
+  }
+
+  /**
+   * Weight of point point_idx, scaled by the weights given to
+   * integrateWeightedPointCloud. Thread safe.
+   */
+  inline float getPointWeight(const Point& point_C, size_t point_idx) const {
+    const float weight = getVoxelWeight(point_C);
+    if (point_weights_ == nullptr) {
+      return weight;
+    }
+    DCHECK_LT(point_idx, point_weights_->size());
+    return weight * (*point_weights_)[point_idx];
+  }
 
   Config config_;
 
+  /// Weights of the points of the current integrateWeightedPointCloud call.
+  const std::vector<float>* point_weights_;
+
+  /// Exactly one of the layers is set, see setLayer.
   Layer<TsdfVoxel>* layer_;
+  Layer<CompactTsdfVoxel>* compact_layer_;
 
   // Cached map config.
   FloatingPoint voxel_size_;
@@ -175,13 +350,21 @@ class TsdfIntegratorBase {
   FloatingPoint voxel_size_inv_;
   FloatingPoint voxels_per_side_inv_;
   FloatingPoint block_size_inv_;
+  /// Slope of the weight dropoff behind the surface.
+  float dropoff_slope_;
+
+  /// Tabulated weights of the measurements.
+  SensorNoiseModel sensor_noise_model_;
+
+  /// Points of the current integratePointCloud call, reused between calls.
+  PreparedPointcloud prepared_points_;
 
-  std::mutex temp_block_mutex_;
   /**
-   * Temporary block storage, used to hold blocks that need to be created while
-   * integrating a new pointcloud
+   * Blocks that are created while integrating a new pointcloud. Sharded so
+   * that threads allocating different blocks do not wait on each other.
    */
-  Layer<TsdfVoxel>::BlockHashMap temp_block_map_;
+  ConcurrentBlockMap<Block<TsdfVoxel>> new_blocks_;
+  ConcurrentBlockMap<Block<CompactTsdfVoxel>> new_compact_blocks_;
 
   /**
    * We need to prevent simultaneous access to the voxels in the map. We could
@@ -195,6 +378,30 @@ class TsdfIntegratorBase {
    * (num_threads / (2^n)). For 8 threads and 12 bits this gives 0.2%.
    */
   ApproxHashArray<12, std::mutex, GlobalIndex, LongIndexHash> mutexes_;
+  /**
+   * Locks of use_voxel_spin_locks, as many as there are mutexes. The hash puts
+   * neighbouring voxels on neighbouring locks, so the locks are padded to
+   * keep threads updating nearby voxels off each other's cache lines.
+   */
+  ApproxHashArray<12, PaddedSpinLock, GlobalIndex, LongIndexHash>
+      voxel_locks_;
+
+  ThreadPool::Ptr thread_pool_;
+
+  /// Ray casters of the integration tasks, reused to avoid allocations.
+  std::vector<BatchRayCaster> thread_ray_casters_;
+
+  /// Used in terminating the integration early if it exceeds a time limit.
+  std::chrono::time_point<std::chrono::steady_clock> integration_start_time_;
+
+  IntegrationStats last_integration_stats_;
+
+ private:
+  /// Sets up everything but the layer.
+  explicit TsdfIntegratorBase(const Config& config);
+
+  /// Caches the sizes of the layer and the values derived from them.
+  void cacheLayerSizes(FloatingPoint voxel_size, size_t voxels_per_side);
 };
 
 /// Creates a TSDF integrator of the desired type.
@@ -210,7 +417,8 @@ class TsdfIntegratorFactory {
 
 /**
  * Basic TSDF integrator. Every point is raycast through all the voxels, which
- * are updated individually. An exact but very slow approach.
+ * are updated individually. An exact but very slow approach, unless it is cut
+ * short by max_integration_time_s.
  */
 class SimpleTsdfIntegrator : public TsdfIntegratorBase {
  public:
@@ -219,20 +427,25 @@ class SimpleTsdfIntegrator : public TsdfIntegratorBase {
   SimpleTsdfIntegrator(const Config& config, Layer<TsdfVoxel>* layer)
       : TsdfIntegratorBase(config, layer) {}
 
-  void integratePointCloud(const Transformation& T_G_C,
-                           const Pointcloud& points_C, const Colors& colors,
-                           const bool freespace_points = false);
+  SimpleTsdfIntegrator(const Config& config, Layer<CompactTsdfVoxel>* layer)
+      : TsdfIntegratorBase(config, layer) {}
 
-  void integrateFunction(const Transformation& T_G_C,
-                         const Pointcloud& points_C, const Colors& colors,
-                         const bool freespace_points,
-                         ThreadSafeIndex* index_getter);
+  void integratePreparedPointCloud(const PreparedPointcloud& prepared_points,
+                                   const Colors& colors);
+
+  /// Casts the rays in batches of ray_caster.
+  template <typename VoxelType>
+  void integrateFunction(const PreparedPointcloud& prepared_points,
+                         const Colors& colors, ThreadSafeIndex* index_getter,
+                         BatchRayCaster* ray_caster);
 };
 
 /**
  * Uses ray bundling to improve integration speed, points which lie in the same
  * voxel are "merged" into a single point. Raycasting and updating then proceeds
- * as normal. Fast for large voxels, with minimal loss of information.
+ * as normal. Fast for large voxels, with minimal loss of information. The
+ * merged rays are cast in the order their first point is read in, so a time
+ * limit drops the least informative voxels.
  */
 class MergedTsdfIntegrator : public TsdfIntegratorBase {
  public:
@@ -241,34 +454,60 @@ class MergedTsdfIntegrator : public TsdfIntegratorBase {
   MergedTsdfIntegrator(const Config& config, Layer<TsdfVoxel>* layer)
       : TsdfIntegratorBase(config, layer) {}
 
-  void integratePointCloud(const Transformation& T_G_C,
-                           const Pointcloud& points_C, const Colors& colors,
-                           const bool freespace_points = false);
+  void integratePreparedPointCloud(const PreparedPointcloud& prepared_points,
+                                   const Colors& colors);
 
  protected:
-  void bundleRays(const Transformation& T_G_C, const Pointcloud& points_C,
-                  const bool freespace_points, ThreadSafeIndex* index_getter,
-                  LongIndexHashMapType<AlignedVector<size_t>>::type* voxel_map,
-                  LongIndexHashMapType<AlignedVector<size_t>>::type* clear_map);
-
-  void integrateVoxel(
-      const Transformation& T_G_C, const Pointcloud& points_C,
-      const Colors& colors, bool enable_anti_grazing, bool clearing_ray,
-      const std::pair<GlobalIndex, AlignedVector<size_t>>& kv,
-      const LongIndexHashMapType<AlignedVector<size_t>>::type& voxel_map);
-
-  void integrateVoxels(
-      const Transformation& T_G_C, const Pointcloud& points_C,
-      const Colors& colors, bool enable_anti_grazing, bool clearing_ray,
-      const LongIndexHashMapType<AlignedVector<size_t>>::type& voxel_map,
-      const LongIndexHashMapType<AlignedVector<size_t>>::type& clear_map,
-      size_t thread_idx);
-
-  void integrateRays(
-      const Transformation& T_G_C, const Pointcloud& points_C,
-      const Colors& colors, bool enable_anti_grazing, bool clearing_ray,
-      const LongIndexHashMapType<AlignedVector<size_t>>::type& voxel_map,
-      const LongIndexHashMapType<AlignedVector<size_t>>::type& clear_map);
+  /// Points of the cloud, by the voxel they fall into.
+  typedef LongIndexHashMapType<AlignedVector<size_t>>::type VoxelPointMap;
+  /// Entries of a VoxelPointMap, in the order they were first hit by a point.
+  typedef std::vector<const VoxelPointMap::value_type*> VoxelPointList;
+
+  /**
+   * Bundles the points until the time limit, returns the number of points
+   * that were dropped.
+   */
+  size_t bundleRays(const PreparedPointcloud& prepared_points,
+                    ThreadSafeIndex* index_getter, VoxelPointMap* voxel_map,
+                    VoxelPointList* voxel_list, VoxelPointMap* clear_map,
+                    VoxelPointList* clear_list);
+
+  /// The points of one voxel of the map, merged into a single ray.
+  struct MergedRay {
+    const GlobalIndex* voxel_idx;
+    Point point_G;
+    Color color;
+    FloatingPoint weight;
+  };
+
+  /// Merges the points of kv, returns false if there are none.
+  bool mergePoints(const PreparedPointcloud& prepared_points,
+                   const Colors& colors, bool clearing_ray,
+                   const VoxelPointMap::value_type& kv,
+                   MergedRay* merged_ray) const;
+
+  /// Updates the voxels of ray_caster, which cast merged_rays.
+  void integrateMergedRays(const Point& origin, bool enable_anti_grazing,
+                           bool clearing_ray,
+                           const MergedRay* merged_rays,
+                           const BatchRayCaster& ray_caster,
+                           const VoxelPointMap& voxel_map);
+
+  /**
+   * Integrates every integrator_threads-th entry of voxel_list until the time
+   * limit, returns the number of points that were dropped.
+   */
+  size_t integrateVoxels(const PreparedPointcloud& prepared_points,
+                         const Colors& colors, bool enable_anti_grazing,
+                         bool clearing_ray,
+                         const VoxelPointMap& voxel_map,
+                         const VoxelPointList& voxel_list, size_t thread_idx);
+
+  /// Returns the number of points that were dropped.
+  size_t integrateRays(const PreparedPointcloud& prepared_points,
+                       const Colors& colors, bool enable_anti_grazing,
+                       bool clearing_ray, const VoxelPointMap& voxel_map,
+                       const VoxelPointList& voxel_list);
 };
 
 /**
@@ -290,14 +529,15 @@ class FastTsdfIntegrator : public TsdfIntegratorBase {
   FastTsdfIntegrator(const Config& config, Layer<TsdfVoxel>* layer)
       : TsdfIntegratorBase(config, layer) {}
 
-  void integrateFunction(const Transformation& T_G_C,
-                         const Pointcloud& points_C, const Colors& colors,
-                         const bool freespace_points,
-                         ThreadSafeIndex* index_getter);
+  /**
+   * Casts each ray lazily with a RayCaster, so that the rays cut off by
+   * max_consecutive_ray_collisions are not traversed to their end.
+   */
+  void integrateFunction(const PreparedPointcloud& prepared_points,
+                         const Colors& colors, ThreadSafeIndex* index_getter);
 
-  void integratePointCloud(const Transformation& T_G_C,
-                           const Pointcloud& points_C, const Colors& colors,
-                           const bool freespace_points = false);
+  void integratePreparedPointCloud(const PreparedPointcloud& prepared_points,
+                                   const Colors& colors);
 
  private:
   /**
@@ -336,10 +576,191 @@ class FastTsdfIntegrator : public TsdfIntegratorBase {
   ApproxHashSet<masked_bits_, full_reset_threshold_, GlobalIndex, LongIndexHash>
       voxel_observed_approx_set_;
 
-  /// Used in terminating the integration early if it exceeds a time limit.
-  std::chrono::time_point<std::chrono::steady_clock> integration_start_time_;
+};
+
+/**
+ * Owner-computes variant of the simple integrator, every point is raycast
+ * through all the voxels just the same. The work is split in two passes:
+ * first the threads cast the rays and bin the ray segments by the block they
+ * pass through, then whole blocks are handed out to the threads. Each voxel is
+ * thus written by exactly one thread and is updated without any locking. The
+ * segments of a block are fused in the order of their points, so the result
+ * does not depend on the number of threads.
+ */
+class PartitionedTsdfIntegrator : public TsdfIntegratorBase {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  PartitionedTsdfIntegrator(const Config& config, Layer<TsdfVoxel>* layer)
+      : TsdfIntegratorBase(config, layer) {}
+
+  void integratePreparedPointCloud(const PreparedPointcloud& prepared_points,
+                                   const Colors& colors);
+
+ protected:
+  /// Part of the ray of a point that lies inside a single block.
+  struct RaySegment {
+    /// Index of the point in the prepared cloud.
+    size_t point_idx;
+    /// Thread that cast the ray, the voxels are stored in its buffer.
+    size_t thread_idx;
+    /// Range of the linear voxel indices in the buffer of the thread.
+    size_t begin;
+    size_t end;
+
+    bool operator<(const RaySegment& other) const {
+      return point_idx < other.point_idx;
+    }
+  };
+
+  typedef AnyIndexHashMapType<std::vector<RaySegment>>::type BlockSegmentMap;
+
+  /// All ray segments that fall into one block.
+  struct BlockWork {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    BlockIndex block_idx;
+    Block<TsdfVoxel>::Ptr block;
+    std::vector<RaySegment> segments;
+  };
+
+  /**
+   * Casts rays and bins their segments by block until the time limit. The
+   * blocks of all binned segments are updated in full. Thread safe.
+   */
+  void binRays(const PreparedPointcloud& prepared_points, size_t thread_idx,
+               ThreadSafeIndex* index_getter);
+
+  /**
+   * Integrates whole blocks until none are left. Thread safe as every block is
+   * only taken by a single thread.
+   */
+  void integrateBlocks(const PreparedPointcloud& prepared_points,
+                       const Colors& colors, std::atomic<size_t>* next_block);
+
+  void integrateBlock(const PreparedPointcloud& prepared_points,
+                      const Colors& colors, BlockWork* block_work);
+
+  /**
+   * Per thread buffers, kept between calls to avoid reallocating them for
+   * every scan.
+   */
+  std::vector<std::vector<uint32_t>> thread_voxel_indices_;
+  std::vector<BlockSegmentMap> thread_block_segments_;
+  AlignedVector<BlockWork> blocks_to_integrate_;
+};
+
+/**
+ * Integrates organized depth images by projecting the voxels into the image
+ * instead of casting rays. All blocks overlapping the view frustum are visited,
+ * every voxel is projected into the image and updated with the distance to the
+ * measured depth along its viewing ray, and blocks that receive no update are
+ * not allocated. Blocks are handed out to the threads as a whole, so no voxel
+ * locking is needed. The per-voxel projection and update is branch free and,
+ * if compiled with AVX2 (VOXBLOX_USE_AVX2), processes eight voxels of a block
+ * row at a time.
+ *
+ * The camera poses are those of optical frames: z forward, x right, y down.
+ */
+class ProjectiveTsdfIntegrator : public TsdfIntegratorBase {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  ProjectiveTsdfIntegrator(const Config& config, Layer<TsdfVoxel>* layer);
+
+  void setCameraIntrinsics(const CameraIntrinsics& intrinsics);
+  const CameraIntrinsics& getCameraIntrinsics() const { return intrinsics_; }
+
+  /**
+   * Integrates a depth image matching the camera intrinsics. colors holds one
+   * color per pixel in row major order or is empty. NOT thread safe.
+   */
+  void integrateDepthImage(const Transformation& T_G_C,
+                           const DepthImage& depth_image, const Colors& colors);
+
+  /**
+   * Renders the points of an organized sensor into a depth image, keeping the
+   * closest point per pixel, and integrates it. Freespace points are not
+   * supported and are ignored. NOT thread safe.
+   */
+  void integratePointCloud(const Transformation& T_G_C,
+                           const Pointcloud& points_C, const Colors& colors,
+                           const bool freespace_points = false);
+
+  /**
+   * Same as above for a prepared cloud, whose points below the minimum ray
+   * length are not rendered. NOT thread safe.
+   */
+  void integratePreparedPointCloud(const PreparedPointcloud& prepared_points,
+                                   const Colors& colors);
+
+ protected:
+  /// Renders point_C into the depth image if it is the closest of its pixel.
+  void renderPoint(const Point& point_C, const Color& color);
+
+  /// Blocks that overlap the view frustum of the camera.
+  void getBlocksInView(const Transformation& T_G_C, BlockIndexList* blocks);
+
+  /// Integrates blocks until none are left. Thread safe.
+  void integrateBlocks(const Transformation& T_C_G,
+                       const DepthImage& depth_image, const Colors& colors,
+                       size_t thread_idx, std::atomic<size_t>* next_block);
+
+  /**
+   * Updates all voxels of the block that project into the image, returns the
+   * number of updated voxels. Thread safe for different blocks.
+   */
+  size_t integrateBlock(const Transformation& T_C_G,
+                        const DepthImage& depth_image, const Colors& colors,
+                        Block<TsdfVoxel>* block) const;
+
+  /**
+   * Updates voxels x_begin to x_end - 1 of a row of voxels whose first voxel
+   * center is at first_voxel_C in the camera frame and that are step_C apart.
+   */
+  size_t updateVoxelRow(const Point& first_voxel_C, const Point& step_C,
+                        size_t x_begin, size_t x_end,
+                        const DepthImage& depth_image, const Colors& colors,
+                        size_t first_linear_idx, Block<TsdfVoxel>* block) const;
+
+#ifdef __AVX2__
+  /// Same as above for eight voxels at a time.
+  size_t updateVoxelRowAvx2(const Point& first_voxel_C, const Point& step_C,
+                            size_t x_begin, size_t x_end,
+                            const DepthImage& depth_image,
+                            const Colors& colors, size_t first_linear_idx,
+                            Block<TsdfVoxel>* block) const;
+#endif
+
+  /**
+   * Fuses the distance to the depth measured at pixel_idx into the voxel,
+   * shared by all kernels.
+   */
+  void updateVoxel(float sdf, float depth, size_t pixel_idx,
+                   const Colors& colors, size_t linear_idx,
+                   Block<TsdfVoxel>* block) const;
+
+  CameraIntrinsics intrinsics_;
+  /// Frustum of the camera, in the x forward frame of the CameraModel.
+  CameraModel camera_model_;
+  /// Rotates the x forward CameraModel frame into the optical frame.
+  Transformation T_C_M_;
+
+  DepthImage rendered_depth_image_;
+  Colors rendered_colors_;
+  BlockIndexList blocks_in_view_;
+  /// Blocks allocated by each thread, inserted after integration.
+  std::vector<std::vector<std::pair<BlockIndex, Block<TsdfVoxel>::Ptr>>>
+      thread_new_blocks_;
+  /**
+   * Per thread block that missing blocks are integrated into, it only enters
+   * the layer if it received an update and is recycled otherwise.
+   */
+  std::vector<Block<TsdfVoxel>::Ptr> thread_scratch_blocks_;
 };
 
 }  // namespace voxblox
 
+#include "voxblox/integrator/tsdf_integrator_inl.h"
+
 #endif  // VOXBLOX_INTEGRATOR_TSDF_INTEGRATOR_H_
@@ -0,0 +1,108 @@
+#ifndef VOXBLOX_INTEGRATOR_TSDF_INTEGRATOR_INL_H_
+#define VOXBLOX_INTEGRATOR_TSDF_INTEGRATOR_INL_H_
+
+#include <memory>
+#include <mutex>
+
+namespace voxblox {
+
+template <>
+inline Layer<TsdfVoxel>* TsdfIntegratorBase::getLayer<TsdfVoxel>() {
+  return layer_;
+}
+
+template <>
+inline Layer<CompactTsdfVoxel>*
+TsdfIntegratorBase::getLayer<CompactTsdfVoxel>() {
+  return compact_layer_;
+}
+
+template <>
+inline ConcurrentBlockMap<Block<TsdfVoxel>>*
+TsdfIntegratorBase::getNewBlocks<TsdfVoxel>() {
+  return &new_blocks_;
+}
+
+template <>
+inline ConcurrentBlockMap<Block<CompactTsdfVoxel>>*
+TsdfIntegratorBase::getNewBlocks<CompactTsdfVoxel>() {
+  return &new_compact_blocks_;
+}
+
+// Will return a pointer to a voxel located at global_voxel_idx in the tsdf
+// layer. Thread safe.
+// Takes in the last_block_idx and last_block to prevent unneeded map lookups.
+// If the block this voxel would be in has not been allocated, it is allocated
+// in new_blocks_, which is sharded so that all threads can grow it at once.
+// These blocks are inserted into the layer later by calling
+// updateLayerWithStoredBlocks()
+template <typename VoxelType>
+VoxelType* TsdfIntegratorBase::allocateStorageAndGetVoxelPtr(
+    const GlobalIndex& global_voxel_idx,
+    std::shared_ptr<Block<VoxelType>>* last_block,
+    BlockIndex* last_block_idx) {
+  DCHECK(last_block != nullptr);
+  DCHECK(last_block_idx != nullptr);
+
+  Layer<VoxelType>* layer = getLayer<VoxelType>();
+  DCHECK(layer != nullptr);
+
+  const BlockIndex block_idx =
+      getBlockIndexFromGlobalVoxelIndex(global_voxel_idx, voxels_per_side_inv_);
+
+  if ((block_idx != *last_block_idx) || (*last_block == nullptr)) {
+    *last_block = layer->getBlockPtrByIndex(block_idx);
+    *last_block_idx = block_idx;
+  }
+
+  // If no block at this location currently exists, we allocate a new block
+  // that will be inserted into the layer later. Only the shard of the block is
+  // locked, and drawing blocks from the pool of the layer is thread safe.
+  if (*last_block == nullptr) {
+    *last_block = getNewBlocks<VoxelType>()->findOrAllocate(
+        block_idx, [layer](const BlockIndex& index) {
+          return layer->allocateDetachedBlock(index);
+        });
+  }
+
+  (*last_block)->updated().set();
+
+  const VoxelIndex local_voxel_idx =
+      getLocalFromGlobalVoxelIndex(global_voxel_idx, voxels_per_side_);
+  if (config_.track_dirty_voxels) {
+    (*last_block)->markVoxelDirty(
+        (*last_block)->computeLinearIndexFromVoxelIndex(local_voxel_idx));
+  }
+
+  return &((*last_block)->getVoxelByVoxelIndex(local_voxel_idx));
+}
+
+// Updates tsdf_voxel. Thread safe.
+template <typename VoxelType>
+void TsdfIntegratorBase::updateTsdfVoxel(const Point& origin,
+                                         const Point& point_G,
+                                         const GlobalIndex& global_voxel_idx,
+                                         const Color& color, const float weight,
+                                         VoxelType* tsdf_voxel) {
+  DCHECK(tsdf_voxel != nullptr);
+
+  float sdf;
+  float updated_weight;
+  computeTsdfMeasurement(origin, point_G, global_voxel_idx, weight, &sdf,
+                         &updated_weight);
+
+  if (config_.use_voxel_spin_locks) {
+    std::lock_guard<PaddedSpinLock> lock(voxel_locks_.get(global_voxel_idx));
+    fuseTsdfMeasurement(sdf, updated_weight, color, tsdf_voxel);
+    return;
+  }
+
+  // Lookup the mutex that is responsible for this voxel and lock it
+  std::lock_guard<std::mutex> lock(mutexes_.get(global_voxel_idx));
+
+  fuseTsdfMeasurement(sdf, updated_weight, color, tsdf_voxel);
+}
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_INTEGRATOR_TSDF_INTEGRATOR_INL_H_
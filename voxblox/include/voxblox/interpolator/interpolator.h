@@ -10,16 +10,74 @@
 namespace voxblox {
 
 /**
- * Interpolates voxels to give distances and gradients
+ * Per voxel type accessors for the members that can be interpolated. Kept
+ * separate from the Interpolator so they are shared by all voxel storage
+ * layouts.
  */
 template <typename VoxelType>
+struct InterpolatorVoxelTraits {
+  static float getVoxelSdf(const VoxelType& voxel);
+  static float getVoxelWeight(const VoxelType& voxel);
+
+  static uint8_t getRed(const VoxelType& voxel);
+  static uint8_t getBlue(const VoxelType& voxel);
+  static uint8_t getGreen(const VoxelType& voxel);
+  static uint8_t getAlpha(const VoxelType& voxel);
+
+  /// The neighbors are either pointers to the voxels or copies of them.
+  static const VoxelType& getVoxel(const VoxelType* voxel) { return *voxel; }
+  static const VoxelType& getVoxel(const VoxelType& voxel) { return voxel; }
+
+  template <typename TGetter, typename NeighborType>
+  static FloatingPoint interpMember(const InterpVector& q_vector,
+                                    const NeighborType* voxels,
+                                    TGetter (*getter)(const VoxelType&));
+
+  template <typename NeighborType>
+  static VoxelType interpVoxel(const InterpVector& q_vector,
+                               const NeighborType* voxels);
+};
+
+/**
+ * How the Interpolator holds the 8 neighbors of a point. The voxels of an
+ * array of structs layout are referenced by pointer, the others are copied as
+ * their accessors return proxies.
+ */
+template <typename VoxelType, template <typename> class VoxelStorageType>
+struct InterpolatorNeighborTraits {
+  typedef VoxelType NeighborType;
+
+  template <typename ConstVoxelRef>
+  static NeighborType getNeighbor(const ConstVoxelRef& voxel) {
+    return voxel;
+  }
+};
+
+template <typename VoxelType>
+struct InterpolatorNeighborTraits<VoxelType, AosVoxelStorage> {
+  typedef const VoxelType* NeighborType;
+
+  static NeighborType getNeighbor(const VoxelType& voxel) { return &voxel; }
+};
+
+/**
+ * Interpolates voxels to give distances and gradients. Works with any voxel
+ * storage layout of the layer.
+ */
+template <typename VoxelType,
+          template <typename> class VoxelStorageType = AosVoxelStorage>
 class Interpolator {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
   typedef std::shared_ptr<Interpolator> Ptr;
+  typedef Layer<VoxelType, FlatAnyIndexHashMapType, VoxelStorageType>
+      LayerType;
+  typedef InterpolatorNeighborTraits<VoxelType, VoxelStorageType>
+      NeighborTraits;
+  typedef typename NeighborTraits::NeighborType NeighborType;
 
-  explicit Interpolator(const Layer<VoxelType>* layer);
+  explicit Interpolator(const LayerType* layer);
 
   bool getGradient(const Point& pos, Point* grad,
                    const bool interpolate = false) const;
@@ -49,7 +107,8 @@ class Interpolator {
   bool setIndexes(const Point& pos, BlockIndex* block_index,
                   InterpIndexes* voxel_indexes) const;
 
-  bool getVoxelsAndQVector(const Point& pos, const VoxelType** voxels,
+  /// Gathers the 8 voxels surrounding pos, see InterpolatorNeighborTraits.
+  bool getVoxelsAndQVector(const Point& pos, NeighborType* voxels,
                            InterpVector* q_vector) const;
 
  private:
@@ -64,7 +123,7 @@ class Interpolator {
 
   bool getVoxelsAndQVector(const BlockIndex& block_index,
                            const InterpIndexes& voxel_indexes, const Point& pos,
-                           const VoxelType** voxels,
+                           NeighborType* voxels,
                            InterpVector* q_vector) const;
 
   bool getInterpDistance(const Point& pos, FloatingPoint* distance) const;
@@ -79,23 +138,9 @@ class Interpolator {
 
   bool getNearestVoxel(const Point& pos, VoxelType* voxel) const;
 
-  static float getVoxelSdf(const VoxelType& voxel);
-  static float getVoxelWeight(const VoxelType& voxel);
-
-  static uint8_t getRed(const VoxelType& voxel);
-  static uint8_t getBlue(const VoxelType& voxel);
-  static uint8_t getGreen(const VoxelType& voxel);
-  static uint8_t getAlpha(const VoxelType& voxel);
-
-  template <typename TGetter>
-  static FloatingPoint interpMember(const InterpVector& q_vector,
-                                    const VoxelType** voxels,
-                                    TGetter (*getter)(const VoxelType&));
-
-  static VoxelType interpVoxel(const InterpVector& q_vector,
-                               const VoxelType** voxels);
+  typedef InterpolatorVoxelTraits<VoxelType> VoxelTraits;
 
-  const Layer<VoxelType>* layer_;
+  const LayerType* layer_;
 };
 
 }  // namespace voxblox
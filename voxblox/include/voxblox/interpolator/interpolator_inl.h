@@ -7,14 +7,13 @@
 
 namespace voxblox {
 
-template <typename VoxelType>
-Interpolator<VoxelType>::Interpolator(const Layer<VoxelType>* layer)
+template <typename VoxelType, template <typename> class VoxelStorageType>
+Interpolator<VoxelType, VoxelStorageType>::Interpolator(const LayerType* layer)
     : layer_(layer) {}
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getDistance(const Point& pos,
-                                          FloatingPoint* distance,
-                                          bool interpolate) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getDistance(
+    const Point& pos, FloatingPoint* distance, bool interpolate) const {
   if (interpolate) {
     return getInterpDistance(pos, distance);
   } else {
@@ -22,9 +21,9 @@ bool Interpolator<VoxelType>::getDistance(const Point& pos,
   }
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getWeight(const Point& pos, FloatingPoint* weight,
-                                        bool interpolate) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getWeight(
+    const Point& pos, FloatingPoint* weight, bool interpolate) const {
   CHECK_NOTNULL(weight);
   if (interpolate) {
     return getInterpWeight(pos, weight);
@@ -33,9 +32,9 @@ bool Interpolator<VoxelType>::getWeight(const Point& pos, FloatingPoint* weight,
   }
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getVoxel(const Point& pos, VoxelType* voxel,
-                                       bool interpolate) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getVoxel(
+    const Point& pos, VoxelType* voxel, bool interpolate) const {
   if (interpolate) {
     return getInterpVoxel(pos, voxel);
   } else {
@@ -43,12 +42,12 @@ bool Interpolator<VoxelType>::getVoxel(const Point& pos, VoxelType* voxel,
   }
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getGradient(const Point& pos, Point* grad,
-                                          const bool interpolate) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getGradient(
+    const Point& pos, Point* grad, const bool interpolate) const {
   CHECK_NOTNULL(grad);
 
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
+  typename LayerType::BlockType::ConstPtr block_ptr =
       layer_->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
@@ -74,8 +73,8 @@ bool Interpolator<VoxelType>::getGradient(const Point& pos, Point* grad,
   return true;
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getAdaptiveDistanceAndGradient(
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getAdaptiveDistanceAndGradient(
     const Point& pos, FloatingPoint* distance, Point* grad) const {
   // TODO(helenol): try to see how to minimize number of lookups for the
   // gradient and interpolation calculations...
@@ -96,7 +95,7 @@ bool Interpolator<VoxelType>::getAdaptiveDistanceAndGradient(
   // Now try to estimate the gradient. Same general procedure as getGradient()
   // above, but also allow finite difference methods other than central
   // difference (left difference, right difference).
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
+  typename LayerType::BlockType::ConstPtr block_ptr =
       layer_->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
@@ -153,13 +152,13 @@ bool Interpolator<VoxelType>::getAdaptiveDistanceAndGradient(
   return true;
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::setIndexes(const Point& pos,
-                                         BlockIndex* block_index,
-                                         InterpIndexes* voxel_indexes) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::setIndexes(
+    const Point& pos, BlockIndex* block_index,
+    InterpIndexes* voxel_indexes) const {
   // get voxel index
   *block_index = layer_->computeBlockIndexFromCoordinates(pos);
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
+  typename LayerType::BlockType::ConstPtr block_ptr =
       layer_->getBlockPtrByIndex(*block_index);
   if (block_ptr == nullptr) {
     return false;
@@ -197,11 +196,10 @@ bool Interpolator<VoxelType>::setIndexes(const Point& pos,
   return true;
 }
 
-template <typename VoxelType>
-void Interpolator<VoxelType>::getQVector(const Point& voxel_pos,
-                                         const Point& pos,
-                                         const FloatingPoint voxel_size_inv,
-                                         InterpVector* q_vector) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+void Interpolator<VoxelType, VoxelStorageType>::getQVector(
+    const Point& voxel_pos, const Point& pos,
+    const FloatingPoint voxel_size_inv, InterpVector* q_vector) const {
   CHECK_NOTNULL(q_vector);
 
   const Point voxel_offset = (pos - voxel_pos) * voxel_size_inv;
@@ -222,15 +220,15 @@ void Interpolator<VoxelType>::getQVector(const Point& voxel_pos,
   // clang-format on
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getVoxelsAndQVector(
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getVoxelsAndQVector(
     const BlockIndex& block_index, const InterpIndexes& voxel_indexes,
-    const Point& pos, const VoxelType** voxels, InterpVector* q_vector) const {
+    const Point& pos, NeighborType* voxels, InterpVector* q_vector) const {
   CHECK_NOTNULL(q_vector);
 
   // for each voxel index
   for (size_t i = 0; i < static_cast<size_t>(voxel_indexes.cols()); ++i) {
-    typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
+    typename LayerType::BlockType::ConstPtr block_ptr =
         layer_->getBlockPtrByIndex(block_index);
     if (block_ptr == nullptr) {
       return false;
@@ -258,19 +256,18 @@ bool Interpolator<VoxelType>::getVoxelsAndQVector(
                  block_ptr->voxel_size_inv(), q_vector);
     }
 
-    const VoxelType& voxel = block_ptr->getVoxelByVoxelIndex(voxel_index);
-
-    voxels[i] = &voxel;
-    if (!utils::isObservedVoxel(voxel)) {
+    voxels[i] = NeighborTraits::getNeighbor(
+        block_ptr->getVoxelByVoxelIndex(voxel_index));
+    if (!utils::isObservedVoxel(VoxelTraits::getVoxel(voxels[i]))) {
       return false;
     }
   }
   return true;
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getVoxelsAndQVector(
-    const Point& pos, const VoxelType** voxels, InterpVector* q_vector) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getVoxelsAndQVector(
+    const Point& pos, NeighborType* voxels, InterpVector* q_vector) const {
   // get block and voxels indexes (some voxels may have negative indexes)
   BlockIndex block_index;
   InterpIndexes voxel_indexes;
@@ -282,96 +279,100 @@ bool Interpolator<VoxelType>::getVoxelsAndQVector(
   return getVoxelsAndQVector(block_index, voxel_indexes, pos, voxels, q_vector);
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getInterpDistance(const Point& pos,
-                                                FloatingPoint* distance) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getInterpDistance(
+    const Point& pos, FloatingPoint* distance) const {
   CHECK_NOTNULL(distance);
 
   // get distances of 8 surrounding voxels and weights vector
-  const VoxelType* voxels[8];
+  NeighborType voxels[8];
   InterpVector q_vector;
   if (!getVoxelsAndQVector(pos, voxels, &q_vector)) {
     return false;
   } else {
-    *distance = interpMember(q_vector, voxels, &getVoxelSdf);
+    *distance = VoxelTraits::interpMember(q_vector, voxels,
+                                          &VoxelTraits::getVoxelSdf);
     return true;
   }
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getNearestDistance(
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getNearestDistance(
     const Point& pos, FloatingPoint* distance) const {
   CHECK_NOTNULL(distance);
 
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
+  typename LayerType::BlockType::ConstPtr block_ptr =
       layer_->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
   }
 
-  const VoxelType& voxel = block_ptr->getVoxelByCoordinates(pos);
+  typename LayerType::BlockType::ConstVoxelRef voxel =
+      block_ptr->getVoxelByCoordinates(pos);
 
-  *distance = getVoxelSdf(voxel);
+  *distance = VoxelTraits::getVoxelSdf(voxel);
 
-  return utils::isObservedVoxel(voxel);
+  return utils::isObservedVoxel<VoxelType>(voxel);
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getInterpWeight(const Point& pos,
-                                              FloatingPoint* weight) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getInterpWeight(
+    const Point& pos, FloatingPoint* weight) const {
   CHECK_NOTNULL(weight);
 
   // get distances of 8 surrounding voxels and weights vector
-  const VoxelType* voxels[8];
+  NeighborType voxels[8];
   InterpVector q_vector;
   if (!getVoxelsAndQVector(pos, voxels, &q_vector)) {
     return false;
   } else {
-    *weight = interpMember(q_vector, voxels, &getVoxelWeight);
+    *weight = VoxelTraits::interpMember(q_vector, voxels,
+                                         &VoxelTraits::getVoxelWeight);
     return true;
   }
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getNearestWeight(const Point& pos,
-                                               FloatingPoint* weight) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getNearestWeight(
+    const Point& pos, FloatingPoint* weight) const {
   CHECK_NOTNULL(weight);
 
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
+  typename LayerType::BlockType::ConstPtr block_ptr =
       layer_->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
   }
 
-  const VoxelType& voxel = block_ptr->getVoxelByCoordinates(pos);
+  typename LayerType::BlockType::ConstVoxelRef voxel =
+      block_ptr->getVoxelByCoordinates(pos);
 
-  *weight = getVoxelWeight(voxel);
+  *weight = VoxelTraits::getVoxelWeight(voxel);
 
-  return utils::isObservedVoxel(voxel);
+  return utils::isObservedVoxel<VoxelType>(voxel);
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getInterpVoxel(const Point& pos,
-                                             VoxelType* voxel) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getInterpVoxel(
+    const Point& pos, VoxelType* voxel) const {
   CHECK_NOTNULL(voxel);
 
   // get voxels of 8 surrounding voxels and weights vector
-  const VoxelType* voxels[8];
+  NeighborType voxels[8];
   InterpVector q_vector;
   if (!getVoxelsAndQVector(pos, voxels, &q_vector)) {
     return false;
   } else {
-    *voxel = interpVoxel(q_vector, voxels);
+    *voxel = VoxelTraits::interpVoxel(q_vector, voxels);
     return true;
   }
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getNearestVoxel(const Point& pos,
-                                              VoxelType* voxel) const {
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getNearestVoxel(
+    const Point& pos, VoxelType* voxel) const {
   CHECK_NOTNULL(voxel);
 
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
+  typename LayerType::BlockType::ConstPtr block_ptr =
       layer_->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
@@ -382,77 +383,98 @@ bool Interpolator<VoxelType>::getNearestVoxel(const Point& pos,
   return utils::isObservedVoxel(*voxel);
 }
 
-template <typename VoxelType>
-bool Interpolator<VoxelType>::getNearestDistanceAndWeight(
+template <typename VoxelType, template <typename> class VoxelStorageType>
+bool Interpolator<VoxelType, VoxelStorageType>::getNearestDistanceAndWeight(
     const Point& pos, FloatingPoint* distance, float* weight) const {
   CHECK_NOTNULL(distance);
   CHECK_NOTNULL(weight);
 
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
+  typename LayerType::BlockType::ConstPtr block_ptr =
       layer_->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
   }
-  const VoxelType& voxel = block_ptr->getVoxelByCoordinates(pos);
-  *distance = getVoxelSdf(voxel);
-  *weight = getVoxelWeight(voxel);
+  typename LayerType::BlockType::ConstVoxelRef voxel =
+      block_ptr->getVoxelByCoordinates(pos);
+  *distance = VoxelTraits::getVoxelSdf(voxel);
+  *weight = VoxelTraits::getVoxelWeight(voxel);
   return true;
 }
 
 template <>
-inline float Interpolator<TsdfVoxel>::getVoxelSdf(const TsdfVoxel& voxel) {
+inline float InterpolatorVoxelTraits<TsdfVoxel>::getVoxelSdf(
+    const TsdfVoxel& voxel) {
   return voxel.distance;
 }
 
 template <>
-inline float Interpolator<EsdfVoxel>::getVoxelSdf(const EsdfVoxel& voxel) {
+inline float InterpolatorVoxelTraits<EsdfVoxel>::getVoxelSdf(
+    const EsdfVoxel& voxel) {
+  return voxel.distance;
+}
+
+template <>
+inline float InterpolatorVoxelTraits<CompactEsdfVoxel>::getVoxelSdf(
+    const CompactEsdfVoxel& voxel) {
   return voxel.distance;
 }
 
 template <typename VoxelType>
-inline float Interpolator<VoxelType>::getVoxelWeight(
+inline float InterpolatorVoxelTraits<VoxelType>::getVoxelWeight(
     const VoxelType& /*voxel*/) {
   return 0.0;
 }
 
 template <>
-inline float Interpolator<TsdfVoxel>::getVoxelWeight(const TsdfVoxel& voxel) {
+inline float InterpolatorVoxelTraits<TsdfVoxel>::getVoxelWeight(
+    const TsdfVoxel& voxel) {
   return voxel.weight;
 }
 
 template <>
-inline float Interpolator<EsdfVoxel>::getVoxelWeight(const EsdfVoxel& voxel) {
+inline float InterpolatorVoxelTraits<EsdfVoxel>::getVoxelWeight(
+    const EsdfVoxel& voxel) {
+  return voxel.observed ? 1.0f : 0.0f;
+}
+
+template <>
+inline float InterpolatorVoxelTraits<CompactEsdfVoxel>::getVoxelWeight(
+    const CompactEsdfVoxel& voxel) {
   return voxel.observed ? 1.0f : 0.0f;
 }
 
 template <>
-inline uint8_t Interpolator<TsdfVoxel>::getRed(const TsdfVoxel& voxel) {
+inline uint8_t InterpolatorVoxelTraits<TsdfVoxel>::getRed(
+    const TsdfVoxel& voxel) {
   return voxel.color.r;
 }
 
 template <>
-inline uint8_t Interpolator<TsdfVoxel>::getGreen(const TsdfVoxel& voxel) {
+inline uint8_t InterpolatorVoxelTraits<TsdfVoxel>::getGreen(
+    const TsdfVoxel& voxel) {
   return voxel.color.g;
 }
 
 template <>
-inline uint8_t Interpolator<TsdfVoxel>::getBlue(const TsdfVoxel& voxel) {
+inline uint8_t InterpolatorVoxelTraits<TsdfVoxel>::getBlue(
+    const TsdfVoxel& voxel) {
   return voxel.color.b;
 }
 
 template <>
-inline uint8_t Interpolator<TsdfVoxel>::getAlpha(const TsdfVoxel& voxel) {
+inline uint8_t InterpolatorVoxelTraits<TsdfVoxel>::getAlpha(
+    const TsdfVoxel& voxel) {
   return voxel.color.a;
 }
 
 template <typename VoxelType>
-template <typename TGetter>
-inline FloatingPoint Interpolator<VoxelType>::interpMember(
-    const InterpVector& q_vector, const VoxelType** voxels,
+template <typename TGetter, typename NeighborType>
+inline FloatingPoint InterpolatorVoxelTraits<VoxelType>::interpMember(
+    const InterpVector& q_vector, const NeighborType* voxels,
     TGetter (*getter)(const VoxelType&)) {
   InterpVector data;
   for (int i = 0; i < data.size(); ++i) {
-    data[i] = static_cast<FloatingPoint>((*getter)(*voxels[i]));
+    data[i] = static_cast<FloatingPoint>((*getter)(getVoxel(voxels[i])));
   }
 
   // FROM PAPER (http://spie.org/samples/PM159.pdf)
@@ -474,8 +496,9 @@ inline FloatingPoint Interpolator<VoxelType>::interpMember(
 }
 
 template <>
-inline TsdfVoxel Interpolator<TsdfVoxel>::interpVoxel(
-    const InterpVector& q_vector, const TsdfVoxel** voxels) {
+template <typename NeighborType>
+inline TsdfVoxel InterpolatorVoxelTraits<TsdfVoxel>::interpVoxel(
+    const InterpVector& q_vector, const NeighborType* voxels) {
   TsdfVoxel voxel;
   voxel.distance = interpMember(q_vector, voxels, &getVoxelSdf);
   voxel.weight = interpMember(q_vector, voxels, &getVoxelWeight);
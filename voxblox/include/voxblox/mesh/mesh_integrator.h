@@ -24,7 +24,6 @@
 #define VOXBLOX_MESH_MESH_INTEGRATOR_H_
 
 #include <algorithm>
-#include <list>
 #include <memory>
 #include <string>
 #include <thread>
@@ -40,6 +39,7 @@
 #include "voxblox/mesh/marching_cubes.h"
 #include "voxblox/mesh/mesh_layer.h"
 #include "voxblox/utils/meshing_utils.h"
+#include "voxblox/utils/thread_pool.h"
 #include "voxblox/utils/timing.h"
 
 namespace voxblox {
@@ -67,14 +67,19 @@ struct MeshIntegratorConfig {
 
 /**
  * Integrates a TSDF layer to incrementally update a mesh layer using marching
- * cubes.
+ * cubes. Works with any voxel storage layout of the sdf layer.
  */
-template <typename VoxelType>
+template <typename VoxelType,
+          template <typename> class VoxelStorageType = AosVoxelStorage>
 class MeshIntegrator {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-  void initFromSdfLayer(const Layer<VoxelType>& sdf_layer) {
+  typedef Layer<VoxelType, FlatAnyIndexHashMapType, VoxelStorageType>
+      LayerType;
+  typedef typename LayerType::BlockType BlockType;
+
+  void initFromSdfLayer(const LayerType& sdf_layer) {
     voxel_size_ = sdf_layer.voxel_size();
     block_size_ = sdf_layer.block_size();
     voxels_per_side_ = sdf_layer.voxels_per_side();
@@ -82,6 +87,14 @@ class MeshIntegrator {
     voxel_size_inv_ = 1.0 / voxel_size_;
     block_size_inv_ = 1.0 / block_size_;
     voxels_per_side_inv_ = 1.0 / voxels_per_side_;
+
+    subblock_voxels_per_side_ = std::min(
+        voxels_per_side_, static_cast<size_t>(kMaxSubblockVoxelsPerSide));
+    subblocks_per_side_ =
+        (voxels_per_side_ + subblock_voxels_per_side_ - 1u) /
+        subblock_voxels_per_side_;
+    num_subblocks_ =
+        subblocks_per_side_ * subblocks_per_side_ * subblocks_per_side_;
   }
 
   /**
@@ -89,7 +102,7 @@ class MeshIntegrator {
    * extraction, i.e. modify the updated flag.
    */
   MeshIntegrator(const MeshIntegratorConfig& config,
-                 Layer<VoxelType>* sdf_layer, MeshLayer* mesh_layer)
+                 LayerType* sdf_layer, MeshLayer* mesh_layer)
       : config_(config),
         sdf_layer_mutable_(CHECK_NOTNULL(sdf_layer)),
         sdf_layer_const_(CHECK_NOTNULL(sdf_layer)),
@@ -110,7 +123,7 @@ class MeshIntegrator {
    * updated flag.
    */
   MeshIntegrator(const MeshIntegratorConfig& config,
-                 const Layer<VoxelType>& sdf_layer, MeshLayer* mesh_layer)
+                 const LayerType& sdf_layer, MeshLayer* mesh_layer)
       : config_(config),
         sdf_layer_mutable_(nullptr),
         sdf_layer_const_(&sdf_layer),
@@ -129,7 +142,22 @@ class MeshIntegrator {
     }
   }
 
-  /// Generates mesh from the tsdf layer.
+  /**
+   * Meshes on the workers of thread_pool, which may be shared with the
+   * integrators, instead of a pool of integrator_threads - 1 workers that is
+   * created on first use.
+   */
+  void setThreadPool(const ThreadPool::Ptr& thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+
+  /**
+   * Generates mesh from the tsdf layer. The mesh of a block is kept in the
+   * order of its subblocks of at most 8^3 voxels. If the block records the
+   * voxels that changed since it was last meshed, see Block::markVoxelDirty,
+   * only the subblocks around these voxels are extracted again and the others
+   * are copied from the previous mesh.
+   */
   void generateMesh(bool only_mesh_updated_blocks, bool clear_updated_flag) {
     CHECK(!clear_updated_flag || (sdf_layer_mutable_ != nullptr))
         << "If you would like to modify the updated flag in the blocks, please "
@@ -142,125 +170,195 @@ class MeshIntegrator {
       sdf_layer_const_->getAllAllocatedBlocks(&all_tsdf_blocks);
     }
 
-    // Allocate all the mesh memory
+    // Allocate all the mesh memory, and the subblock offsets so that the
+    // threads only look them up.
     for (const BlockIndex& block_index : all_tsdf_blocks) {
       mesh_layer_->allocateMeshPtrByIndex(block_index);
+      subblock_offsets_[block_index];
+    }
+
+    // The meshes of the lower neighbors also reach into the meshed blocks, but
+    // are only updated with their own blocks. The lower neighbors that are not
+    // meshed now are fully meshed the next time.
+    IndexSet meshed_blocks(all_tsdf_blocks.begin(), all_tsdf_blocks.end());
+    for (const BlockIndex& block_index : all_tsdf_blocks) {
+      for (unsigned int i = 1u; i < 8u; ++i) {
+        const BlockIndex neighbor_index =
+            block_index - cube_index_offsets_.col(i);
+        if (meshed_blocks.count(neighbor_index) == 0u) {
+          subblock_offsets_.erase(neighbor_index);
+        }
+      }
     }
 
     std::unique_ptr<ThreadSafeIndex> index_getter(
         new MixedThreadSafeIndex(all_tsdf_blocks.size()));
 
-    std::list<std::thread> integration_threads;
-    for (size_t i = 0; i < config_.integrator_threads; ++i) {
-      integration_threads.emplace_back(
-          &MeshIntegrator::generateMeshBlocksFunction, this, all_tsdf_blocks,
-          clear_updated_flag, index_getter.get());
+    auto mesh_blocks = [&](size_t /*task_idx*/) {
+      generateMeshBlocksFunction(all_tsdf_blocks, index_getter.get());
+    };
+    if (config_.integrator_threads == 1u) {
+      mesh_blocks(0u);
+    } else {
+      if (!thread_pool_) {
+        thread_pool_ =
+            std::make_shared<ThreadPool>(config_.integrator_threads - 1u);
+      }
+      thread_pool_->runTasks(config_.integrator_threads, mesh_blocks);
     }
 
-    for (std::thread& thread : integration_threads) {
-      thread.join();
+    // Only cleared once all blocks are meshed, as the meshing of a block reads
+    // the dirty voxels of its neighbors.
+    if (clear_updated_flag) {
+      for (const BlockIndex& block_index : all_tsdf_blocks) {
+        typename BlockType::Ptr block =
+            sdf_layer_mutable_->getBlockPtrByIndex(block_index);
+        block->updated().reset(Update::kMesh);
+        block->clearDirtyVoxels(Update::kMesh);
+      }
     }
   }
 
   void generateMeshBlocksFunction(const BlockIndexList& all_tsdf_blocks,
-                                  bool clear_updated_flag,
                                   ThreadSafeIndex* index_getter) {
     DCHECK(index_getter != nullptr);
-    CHECK(!clear_updated_flag || (sdf_layer_mutable_ != nullptr))
-        << "If you would like to modify the updated flag in the blocks, please "
-        << "use the constructor that provides a non-const link to the sdf "
-        << "layer!";
 
     size_t list_idx;
     while (index_getter->getNextIndex(&list_idx)) {
-      const BlockIndex& block_idx = all_tsdf_blocks[list_idx];
-      updateMeshForBlock(block_idx);
-      if (clear_updated_flag) {
-        typename Block<VoxelType>::Ptr block =
-            sdf_layer_mutable_->getBlockPtrByIndex(block_idx);
-        block->updated().reset(Update::kMesh);
-      }
+      updateMeshForBlock(all_tsdf_blocks[list_idx]);
     }
   }
 
-  void extractBlockMesh(typename Block<VoxelType>::ConstPtr block,
-                        Mesh::Ptr mesh) {
+  /**
+   * Extracts the whole mesh of the block, subblock by subblock. If
+   * subblock_vertex_offsets is given it receives the first vertex of each
+   * subblock followed by the number of vertices.
+   */
+  void extractBlockMesh(
+      typename BlockType::ConstPtr block, Mesh::Ptr mesh,
+      std::vector<size_t>* subblock_vertex_offsets = nullptr) {
     DCHECK(block != nullptr);
     DCHECK(mesh != nullptr);
 
-    IndexElement vps = block->voxels_per_side();
     VertexIndex next_mesh_index = 0;
-
-    VoxelIndex voxel_index;
-    for (voxel_index.x() = 0; voxel_index.x() < vps - 1; ++voxel_index.x()) {
-      for (voxel_index.y() = 0; voxel_index.y() < vps - 1; ++voxel_index.y()) {
-        for (voxel_index.z() = 0; voxel_index.z() < vps - 1;
-             ++voxel_index.z()) {
-          Point coords = block->computeCoordinatesFromVoxelIndex(voxel_index);
-          extractMeshInsideBlock(*block, voxel_index, coords, &next_mesh_index,
-                                 mesh.get());
-        }
-      }
+    if (subblock_vertex_offsets != nullptr) {
+      subblock_vertex_offsets->resize(num_subblocks_ + 1u);
     }
-
-    // Max X plane
-    // takes care of edge (x_max, y_max, z),
-    // takes care of edge (x_max, y, z_max).
-    voxel_index.x() = vps - 1;
-    for (voxel_index.z() = 0; voxel_index.z() < vps; voxel_index.z()++) {
-      for (voxel_index.y() = 0; voxel_index.y() < vps; voxel_index.y()++) {
-        Point coords = block->computeCoordinatesFromVoxelIndex(voxel_index);
-        extractMeshOnBorder(*block, voxel_index, coords, &next_mesh_index,
-                            mesh.get());
+    const bool mesh_inside_block = utils::mayContainSurface(
+        block->voxels(), block->num_voxels(), config_.min_weight);
+    for (size_t subblock_idx = 0u; subblock_idx < num_subblocks_;
+         ++subblock_idx) {
+      if (subblock_vertex_offsets != nullptr) {
+        (*subblock_vertex_offsets)[subblock_idx] = mesh->vertices.size();
       }
+      extractSubblockMesh(*block, subblock_idx, mesh_inside_block,
+                          &next_mesh_index, mesh.get());
     }
-
-    // Max Y plane.
-    // takes care of edge (x, y_max, z_max),
-    // without corner (x_max, y_max, z_max).
-    voxel_index.y() = vps - 1;
-    for (voxel_index.z() = 0; voxel_index.z() < vps; voxel_index.z()++) {
-      for (voxel_index.x() = 0; voxel_index.x() < vps - 1; voxel_index.x()++) {
-        Point coords = block->computeCoordinatesFromVoxelIndex(voxel_index);
-        extractMeshOnBorder(*block, voxel_index, coords, &next_mesh_index,
-                            mesh.get());
-      }
+    if (subblock_vertex_offsets != nullptr) {
+      subblock_vertex_offsets->back() = mesh->vertices.size();
     }
+  }
 
-    // Max Z plane.
-    voxel_index.z() = vps - 1;
-    for (voxel_index.y() = 0; voxel_index.y() < vps - 1; voxel_index.y()++) {
-      for (voxel_index.x() = 0; voxel_index.x() < vps - 1; voxel_index.x()++) {
-        Point coords = block->computeCoordinatesFromVoxelIndex(voxel_index);
-        extractMeshOnBorder(*block, voxel_index, coords, &next_mesh_index,
-                            mesh.get());
+  /**
+   * Extracts the cubes whose first corner lies in the subblock. If
+   * mesh_inside_block is false, only the cubes that reach into the neighboring
+   * blocks are extracted.
+   */
+  void extractSubblockMesh(const BlockType& block, size_t subblock_idx,
+                           bool mesh_inside_block,
+                           VertexIndex* next_mesh_index, Mesh* mesh) {
+    DCHECK(next_mesh_index != nullptr);
+    DCHECK(mesh != nullptr);
+    DCHECK_LT(subblock_idx, num_subblocks_);
+
+    const IndexElement vps = voxels_per_side_;
+    const IndexElement size = subblock_voxels_per_side_;
+    const IndexElement per_side = subblocks_per_side_;
+    const VoxelIndex begin =
+        size * VoxelIndex(subblock_idx % per_side,
+                          (subblock_idx / per_side) % per_side,
+                          subblock_idx / (per_side * per_side));
+    const VoxelIndex end = (begin + VoxelIndex::Constant(size))
+                               .cwiseMin(VoxelIndex::Constant(vps));
+
+    // A cube is only meshed if all its corners are observed, so only cubes
+    // whose first corner is in the observed mask of the block can produce
+    // triangles. Cubes in the max x, y or z plane reach into the neighboring
+    // blocks.
+    VoxelIndex voxel_index;
+    for (voxel_index.z() = begin.z(); voxel_index.z() < end.z();
+         ++voxel_index.z()) {
+      for (voxel_index.y() = begin.y(); voxel_index.y() < end.y();
+           ++voxel_index.y()) {
+        for (voxel_index.x() = begin.x(); voxel_index.x() < end.x();
+             ++voxel_index.x()) {
+          const bool inside_block = voxel_index.x() < vps - 1 &&
+                                    voxel_index.y() < vps - 1 &&
+                                    voxel_index.z() < vps - 1;
+          if ((inside_block && !mesh_inside_block) ||
+              !block.isVoxelObserved(
+                  block.computeLinearIndexFromVoxelIndex(voxel_index))) {
+            continue;
+          }
+          const Point coords =
+              block.computeCoordinatesFromVoxelIndex(voxel_index);
+          if (inside_block) {
+            extractMeshInsideBlock(block, voxel_index, coords, next_mesh_index,
+                                   mesh);
+          } else {
+            extractMeshOnBorder(block, voxel_index, coords, next_mesh_index,
+                                mesh);
+          }
+        }
       }
     }
   }
 
   virtual void updateMeshForBlock(const BlockIndex& block_index) {
     Mesh::Ptr mesh = mesh_layer_->getMeshPtrByIndex(block_index);
-    mesh->clear();
     // This block should already exist, otherwise it makes no sense to update
     // the mesh for it. ;)
-    typename Block<VoxelType>::ConstPtr block =
+    typename BlockType::ConstPtr block =
         sdf_layer_const_->getBlockPtrByIndex(block_index);
 
     if (!block) {
+      mesh->clear();
       LOG(ERROR) << "Trying to mesh a non-existent block at index: "
                  << block_index.transpose();
       return;
     }
-    extractBlockMesh(block, mesh);
-    // Update colors if needed.
-    if (config_.use_color) {
-      updateMeshColor(*block, mesh.get());
+
+    // Only present for the blocks of generateMesh.
+    typename SubblockOffsetsMap::iterator offsets_it =
+        subblock_offsets_.find(block_index);
+    SubblockOffsets* offsets = (offsets_it == subblock_offsets_.end())
+                                   ? nullptr
+                                   : &offsets_it->second;
+    std::vector<bool> dirty_subblocks;
+    if (offsets != nullptr &&
+        getDirtySubblocks(*block, *offsets, mesh->vertices.size(),
+                          &dirty_subblocks)) {
+      updateDirtySubblockMeshes(*block, dirty_subblocks,
+                                &offsets->vertex_offsets, mesh.get());
+    } else {
+      mesh->clear();
+      extractBlockMesh(block, mesh,
+                       (offsets != nullptr) ? &offsets->vertex_offsets
+                                            : nullptr);
+      // Update colors if needed.
+      if (config_.use_color) {
+        updateMeshColor(*block, mesh.get());
+      }
+      if (offsets != nullptr) {
+        offsets->neighbor_mask = getNeighborMask(block_index);
+        offsets->valid = true;
+      }
     }
 
     mesh->updated = true;
   }
 
-  void extractMeshInsideBlock(const Block<VoxelType>& block,
+  void extractMeshInsideBlock(const BlockType& block,
                               const VoxelIndex& index, const Point& coords,
                               VertexIndex* next_mesh_index, Mesh* mesh) {
     DCHECK(next_mesh_index != nullptr);
@@ -274,7 +372,8 @@ class MeshIntegrator {
 
     for (unsigned int i = 0; i < 8; ++i) {
       VoxelIndex corner_index = index + cube_index_offsets_.col(i);
-      const VoxelType& voxel = block.getVoxelByVoxelIndex(corner_index);
+      typename BlockType::ConstVoxelRef voxel =
+          block.getVoxelByVoxelIndex(corner_index);
 
       if (!utils::getSdfIfValid(voxel, config_.min_weight, &(corner_sdf(i)))) {
         all_neighbors_observed = false;
@@ -289,7 +388,7 @@ class MeshIntegrator {
     }
   }
 
-  void extractMeshOnBorder(const Block<VoxelType>& block,
+  void extractMeshOnBorder(const BlockType& block,
                            const VoxelIndex& index, const Point& coords,
                            VertexIndex* next_mesh_index, Mesh* mesh) {
     DCHECK(mesh != nullptr);
@@ -306,7 +405,8 @@ class MeshIntegrator {
       VoxelIndex corner_index = index + cube_index_offsets_.col(i);
 
       if (block.isValidVoxelIndex(corner_index)) {
-        const VoxelType& voxel = block.getVoxelByVoxelIndex(corner_index);
+        typename BlockType::ConstVoxelRef voxel =
+            block.getVoxelByVoxelIndex(corner_index);
 
         if (!utils::getSdfIfValid(voxel, config_.min_weight,
                                   &(corner_sdf(i)))) {
@@ -333,11 +433,11 @@ class MeshIntegrator {
         BlockIndex neighbor_index = block.block_index() + block_offset;
 
         if (sdf_layer_const_->hasBlock(neighbor_index)) {
-          const Block<VoxelType>& neighbor_block =
+          const BlockType& neighbor_block =
               sdf_layer_const_->getBlockByIndex(neighbor_index);
 
           CHECK(neighbor_block.isValidVoxelIndex(corner_index));
-          const VoxelType& voxel =
+          typename BlockType::ConstVoxelRef voxel =
               neighbor_block.getVoxelByVoxelIndex(corner_index);
 
           if (!utils::getSdfIfValid(voxel, config_.min_weight,
@@ -359,29 +459,209 @@ class MeshIntegrator {
     }
   }
 
-  void updateMeshColor(const Block<VoxelType>& block, Mesh* mesh) {
+  void updateMeshColor(const BlockType& block, Mesh* mesh) {
     DCHECK(mesh != nullptr);
 
     mesh->colors.clear();
     mesh->colors.resize(mesh->indices.size());
+    colorVertices(block, 0u, mesh);
+  }
+
+ protected:
+  /// Vertex ranges of the subblocks of the mesh of a block.
+  struct SubblockOffsets {
+    /// First vertex of each subblock, followed by the number of vertices.
+    std::vector<size_t> vertex_offsets;
+    /// Which upper neighbors existed when the block was meshed, see
+    /// getNeighborMask.
+    uint8_t neighbor_mask = 0u;
+    bool valid = false;
+  };
+  typedef typename AnyIndexHashMapType<SubblockOffsets>::type
+      SubblockOffsetsMap;
+
+  static constexpr size_t kMaxSubblockVoxelsPerSide = 8u;
+
+  /// Bit i - 1 is set if the block at cube_index_offsets_.col(i) exists.
+  uint8_t getNeighborMask(const BlockIndex& block_index) const {
+    uint8_t neighbor_mask = 0u;
+    for (unsigned int i = 1u; i < 8u; ++i) {
+      if (sdf_layer_const_->hasBlock(block_index +
+                                     cube_index_offsets_.col(i))) {
+        neighbor_mask |= static_cast<uint8_t>(1u << (i - 1u));
+      }
+    }
+    return neighbor_mask;
+  }
+
+  /**
+   * Finds the subblocks whose cubes have a dirty corner, in the block or in
+   * its upper neighbors. Returns false if the block has to be fully meshed, as
+   * its mesh is not the one of the offsets, the changes are unknown or all
+   * subblocks are dirty.
+   */
+  bool getDirtySubblocks(const BlockType& block, const SubblockOffsets& offsets,
+                         size_t num_vertices,
+                         std::vector<bool>* dirty_subblocks) const {
+    DCHECK(dirty_subblocks != nullptr);
+    if (!offsets.valid || offsets.vertex_offsets.back() != num_vertices ||
+        !block.hasDirtyVoxels(Update::kMesh)) {
+      return false;
+    }
+    const BlockIndex& block_index = block.block_index();
+    const uint8_t neighbor_mask = getNeighborMask(block_index);
+    if (neighbor_mask != offsets.neighbor_mask) {
+      return false;
+    }
+
+    // The upper neighbors, indexed like cube_index_offsets_. Neighbors that
+    // did not change since they were meshed are left out.
+    const BlockType* blocks[8] = {&block};
+    for (unsigned int i = 1u; i < 8u; ++i) {
+      blocks[i] = nullptr;
+      if ((neighbor_mask & (1u << (i - 1u))) == 0u) {
+        continue;
+      }
+      const BlockType& neighbor_block = sdf_layer_const_->getBlockByIndex(
+          block_index + cube_index_offsets_.col(i));
+      if (!neighbor_block.updated().test(Update::kMesh)) {
+        continue;
+      }
+      if (!neighbor_block.hasDirtyVoxels(Update::kMesh)) {
+        return false;
+      }
+      blocks[i] = &neighbor_block;
+    }
+
+    // The corners of the cubes of a subblock are its voxels and the next
+    // voxel in each direction, which may lie in an upper neighbor. They are
+    // tested row by row along x.
+    const size_t vps = voxels_per_side_;
+    const size_t size = subblock_voxels_per_side_;
+    const size_t per_side = subblocks_per_side_;
+    // Index of the block one step along x, of the blocks at x = 0.
+    static const int kNextXIndices[8] = {1, -1, -1, 2, 5, -1, -1, 6};
+    size_t num_dirty_subblocks = 0u;
+    dirty_subblocks->assign(num_subblocks_, false);
+    for (size_t subblock_idx = 0u; subblock_idx < num_subblocks_;
+         ++subblock_idx) {
+      const size_t begin_x = size * (subblock_idx % per_side);
+      const size_t begin_y = size * ((subblock_idx / per_side) % per_side);
+      const size_t begin_z = size * (subblock_idx / (per_side * per_side));
+      const size_t end_x = std::min(begin_x + size, vps);
+      const size_t end_y = std::min(begin_y + size, vps);
+      const size_t end_z = std::min(begin_z + size, vps);
+      bool is_dirty = false;
+      for (size_t z = begin_z; z <= end_z && !is_dirty; ++z) {
+        for (size_t y = begin_y; y <= end_y && !is_dirty; ++y) {
+          // Index of the block of the row in cube_index_offsets_.
+          const int row_block_idx = (y < vps) ? ((z < vps) ? 0 : 4)
+                                              : ((z < vps) ? 3 : 7);
+          const BlockType* row_block = blocks[row_block_idx];
+          const size_t row_begin =
+              vps * ((y < vps ? y : 0u) + vps * (z < vps ? z : 0u));
+          if (row_block != nullptr) {
+            is_dirty = row_block->hasDirtyVoxelsInRange(
+                Update::kMesh, row_begin + begin_x,
+                row_begin + std::min(end_x + 1u, vps));
+          }
+          if (!is_dirty && end_x == vps) {
+            // The row continues with the first voxel of the next block.
+            const BlockType* next_row_block =
+                blocks[kNextXIndices[row_block_idx]];
+            is_dirty = next_row_block != nullptr &&
+                       next_row_block->isVoxelDirty(Update::kMesh, row_begin);
+          }
+        }
+      }
+      (*dirty_subblocks)[subblock_idx] = is_dirty;
+      num_dirty_subblocks += is_dirty ? 1u : 0u;
+    }
+    return num_dirty_subblocks < num_subblocks_;
+  }
+
+  /**
+   * Extracts the dirty subblocks again and copies the others from the current
+   * mesh, which has to match vertex_offsets. Updates vertex_offsets.
+   */
+  void updateDirtySubblockMeshes(const BlockType& block,
+                                 const std::vector<bool>& dirty_subblocks,
+                                 std::vector<size_t>* vertex_offsets,
+                                 Mesh* mesh) {
+    DCHECK(vertex_offsets != nullptr);
+    DCHECK(mesh != nullptr);
+    DCHECK_EQ(vertex_offsets->size(), num_subblocks_ + 1u);
+
+    Pointcloud old_vertices, old_normals;
+    Colors old_colors;
+    old_vertices.swap(mesh->vertices);
+    old_normals.swap(mesh->normals);
+    old_colors.swap(mesh->colors);
+    mesh->indices.clear();
+    mesh->vertices.reserve(old_vertices.size());
+    mesh->normals.reserve(old_normals.size());
+    mesh->colors.reserve(old_colors.size());
+    const bool copy_colors = old_colors.size() == old_vertices.size();
+
+    VertexIndex next_mesh_index = 0;
+    const bool mesh_inside_block = utils::mayContainSurface(
+        block.voxels(), block.num_voxels(), config_.min_weight);
+    for (size_t subblock_idx = 0u; subblock_idx < num_subblocks_;
+         ++subblock_idx) {
+      const size_t old_begin = (*vertex_offsets)[subblock_idx];
+      const size_t old_end = (*vertex_offsets)[subblock_idx + 1u];
+      const size_t begin = mesh->vertices.size();
+      (*vertex_offsets)[subblock_idx] = begin;
+
+      if (dirty_subblocks[subblock_idx]) {
+        extractSubblockMesh(block, subblock_idx, mesh_inside_block,
+                            &next_mesh_index, mesh);
+        if (config_.use_color) {
+          mesh->colors.resize(mesh->vertices.size());
+          colorVertices(block, begin, mesh);
+        }
+        continue;
+      }
+
+      mesh->vertices.insert(mesh->vertices.end(),
+                            old_vertices.begin() + old_begin,
+                            old_vertices.begin() + old_end);
+      mesh->normals.insert(mesh->normals.end(), old_normals.begin() + old_begin,
+                           old_normals.begin() + old_end);
+      if (copy_colors) {
+        mesh->colors.insert(mesh->colors.end(), old_colors.begin() + old_begin,
+                            old_colors.begin() + old_end);
+      }
+      for (size_t i = old_begin; i < old_end; ++i) {
+        mesh->indices.push_back(next_mesh_index++);
+      }
+    }
+    vertex_offsets->back() = mesh->vertices.size();
+  }
+
+  /// Colors the vertices from begin on, by their nearest voxel.
+  void colorVertices(const BlockType& block, size_t begin, Mesh* mesh) {
+    DCHECK(mesh != nullptr);
+    DCHECK_EQ(mesh->colors.size(), mesh->vertices.size());
 
     // Use nearest-neighbor search.
-    for (size_t i = 0; i < mesh->vertices.size(); i++) {
+    for (size_t i = begin; i < mesh->vertices.size(); i++) {
       const Point& vertex = mesh->vertices[i];
       VoxelIndex voxel_index = block.computeVoxelIndexFromCoordinates(vertex);
       if (block.isValidVoxelIndex(voxel_index)) {
-        const VoxelType& voxel = block.getVoxelByVoxelIndex(voxel_index);
+        typename BlockType::ConstVoxelRef voxel =
+            block.getVoxelByVoxelIndex(voxel_index);
         utils::getColorIfValid(voxel, config_.min_weight, &(mesh->colors[i]));
       } else {
-        const typename Block<VoxelType>::ConstPtr neighbor_block =
+        const typename BlockType::ConstPtr neighbor_block =
             sdf_layer_const_->getBlockPtrByCoordinates(vertex);
-        const VoxelType& voxel = neighbor_block->getVoxelByCoordinates(vertex);
+        typename BlockType::ConstVoxelRef voxel =
+            neighbor_block->getVoxelByCoordinates(vertex);
         utils::getColorIfValid(voxel, config_.min_weight, &(mesh->colors[i]));
       }
     }
   }
 
- protected:
   MeshIntegratorConfig config_;
 
   /**
@@ -390,8 +670,8 @@ class MeshIntegrator {
    * the updated flag) and mutable layer (in case you do want to clear the
    * updated flag).
    */
-  Layer<VoxelType>* sdf_layer_mutable_;
-  const Layer<VoxelType>* sdf_layer_const_;
+  LayerType* sdf_layer_mutable_;
+  const LayerType* sdf_layer_const_;
 
   MeshLayer* mesh_layer_;
 
@@ -405,8 +685,18 @@ class MeshIntegrator {
   FloatingPoint voxels_per_side_inv_;
   FloatingPoint block_size_inv_;
 
+  // Subblocks the meshes are extracted in.
+  size_t subblock_voxels_per_side_;
+  size_t subblocks_per_side_;
+  size_t num_subblocks_;
+
   // Cached index map.
   Eigen::Matrix<int, 3, 8> cube_index_offsets_;
+
+  /// Of the blocks meshed before, see updateMeshForBlock.
+  SubblockOffsetsMap subblock_offsets_;
+
+  ThreadPool::Ptr thread_pool_;
 };
 
 }  // namespace voxblox
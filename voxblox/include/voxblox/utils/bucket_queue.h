@@ -1,13 +1,19 @@
 #ifndef VOXBLOX_UTILS_BUCKET_QUEUE_H_
 #define VOXBLOX_UTILS_BUCKET_QUEUE_H_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <deque>
+#include <functional>
 #include <queue>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
 
 #include "voxblox/core/common.h"
+#include "voxblox/utils/flat_hash_map.h"
 
 namespace voxblox {
 /**
@@ -20,7 +26,9 @@ class BucketQueue {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-  BucketQueue() : last_bucket_index_(0) {}
+  BucketQueue()
+      : num_buckets_(0), max_val_(0.0), last_bucket_index_(0),
+        num_elements_(0) {}
   explicit BucketQueue(int num_buckets, double max_val)
       : num_buckets_(num_buckets),
         max_val_(max_val),
@@ -79,8 +87,24 @@ class BucketQueue {
     return buckets_[last_bucket_index_].front();
   }
 
+  /**
+   * Index of the bucket of the front element. Elements are popped bucket by
+   * bucket, in the order they were pushed within a bucket.
+   */
+  int frontBucketIndex() {
+    CHECK_NE(num_buckets_, 0);
+    CHECK(!empty());
+    while (buckets_[last_bucket_index_].empty() &&
+           last_bucket_index_ < num_buckets_) {
+      last_bucket_index_++;
+    }
+    return last_bucket_index_;
+  }
+
   bool empty() { return num_elements_ == 0; }
 
+  size_t size() const { return num_elements_; }
+
   void clear() {
     buckets_.clear();
     buckets_.resize(num_buckets_);
@@ -98,5 +122,337 @@ class BucketQueue {
   /// This is also to speed up empty checks.
   size_t num_elements_;
 };
+
+/**
+ * Bucketed priority queue with the same order as BucketQueue, but with every
+ * bucket a ring buffer in contiguous memory that is kept when the queue is
+ * cleared, and a bitmap of the non-empty buckets so the front bucket is found
+ * with a find-first-set instead of a scan over the empty buckets.
+ *
+ * With decrease-key enabled, a key is queued at most once: pushing a queued key
+ * again with a value in a lower bucket moves it to the back of that bucket,
+ * otherwise it keeps its place. Every key then gets a slot that tracks its
+ * current entry, the entry left behind in the higher bucket is skipped when it
+ * is reached. The slots are found in a FlatHashMap, so KeyHash has to mix its
+ * input well.
+ */
+template <typename T, typename KeyHash = std::hash<T>>
+class RingBucketQueue {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  RingBucketQueue() : num_buckets_(0), max_val_(0.0) {}
+  RingBucketQueue(int num_buckets, double max_val) {
+    setNumBuckets(num_buckets, max_val);
+  }
+
+  /// WARNING: will CLEAR THE QUEUE!
+  void setNumBuckets(int num_buckets, double max_val) {
+    CHECK_GT(num_buckets, 0);
+    num_buckets_ = num_buckets;
+    max_val_ = max_val;
+    buckets_.resize(num_buckets_);
+    non_empty_buckets_.resize((num_buckets_ + kBitsPerWord - 1) / kBitsPerWord);
+    clear();
+  }
+
+  /// WARNING: will CLEAR THE QUEUE!
+  void setDecreaseKey(bool decrease_key) {
+    decrease_key_ = decrease_key;
+    for (Ring& ring : buckets_) {
+      ring.tags.resize(decrease_key_ ? ring.capacity : 0u);
+    }
+    clear();
+  }
+
+  void push(const T& key, double value) {
+    CHECK_NE(num_buckets_, 0);
+    const int bucket_index = getBucketIndex(value);
+    if (!decrease_key_) {
+      pushEntry(bucket_index, key, Tag());
+      ++num_elements_;
+      return;
+    }
+
+    const auto result =
+        key_slots_.emplace(key, static_cast<uint32_t>(slots_.size()));
+    if (result.second) {
+      slots_.push_back(Slot{kNotQueued, 0u});
+    }
+    const uint32_t slot_index = result.first->second;
+    Slot& slot = slots_[slot_index];
+    if (slot.bucket_index == kNotQueued) {
+      ++num_elements_;
+    } else if (bucket_index >= slot.bucket_index) {
+      return;
+    }
+    slot.bucket_index = bucket_index;
+    ++slot.generation;
+    pushEntry(bucket_index, key, Tag{slot_index, slot.generation});
+  }
+
+  void pop() {
+    if (empty()) {
+      return;
+    }
+    Ring& ring = buckets_[findFrontBucket()];
+    if (decrease_key_) {
+      slots_[ring.tags[ring.head].slot_index].bucket_index = kNotQueued;
+    }
+    popEntry(&ring);
+    --num_elements_;
+    // The next entry of the ring can only be stale with decrease-key.
+    if (ring.size == 0u || decrease_key_) {
+      front_bucket_index_ = -1;
+    }
+    if (decrease_key_ && empty()) {
+      // Drops the slots and the entries left behind with them.
+      clear();
+    }
+  }
+
+  T front() {
+    CHECK(!empty());
+    const Ring& ring = buckets_[findFrontBucket()];
+    return ring.keys[ring.head];
+  }
+
+  /**
+   * Index of the bucket of the front element. Elements are popped bucket by
+   * bucket, in the order they were pushed within a bucket.
+   */
+  int frontBucketIndex() {
+    CHECK_NE(num_buckets_, 0);
+    CHECK(!empty());
+    return findFrontBucket();
+  }
+
+  bool empty() const { return num_elements_ == 0u; }
+
+  size_t size() const { return num_elements_; }
+
+  /// Keeps the memory of the buckets to reuse it.
+  void clear() {
+    for (Ring& ring : buckets_) {
+      ring.head = 0u;
+      ring.size = 0u;
+    }
+    std::fill(non_empty_buckets_.begin(), non_empty_buckets_.end(), 0u);
+    first_word_ = 0u;
+    front_bucket_index_ = -1;
+    num_elements_ = 0u;
+    key_slots_.clear();
+    slots_.clear();
+  }
+
+ private:
+  static constexpr int kNotQueued = -1;
+  static constexpr size_t kBitsPerWord = 64u;
+
+  /// Tracks the slot of a key in the ring if decrease-key is enabled.
+  struct Tag {
+    uint32_t slot_index;
+    /// The entry is stale if the key was pushed again since.
+    uint32_t generation;
+  };
+
+  struct Slot {
+    /// Bucket of the current entry of the key, or kNotQueued.
+    int bucket_index;
+    uint32_t generation;
+  };
+
+  /**
+   * FIFO of a bucket, the capacity is a power of two. The tags are kept apart
+   * from the keys so they only take memory with decrease-key.
+   */
+  struct Ring {
+    AlignedVector<T> keys;
+    std::vector<Tag> tags;
+    size_t capacity = 0u;
+    size_t head = 0u;
+    size_t size = 0u;
+  };
+
+  int getBucketIndex(double value) const {
+    if (value > max_val_) {
+      value = max_val_;
+    }
+    const int bucket_index =
+        std::floor(std::abs(value) / max_val_ * (num_buckets_ - 1));
+    return std::min(bucket_index, num_buckets_ - 1);
+  }
+
+  /// frontBucketIndex() without the checks, the queue must not be empty.
+  int findFrontBucket() {
+    if (front_bucket_index_ >= 0) {
+      return front_bucket_index_;
+    }
+    while (true) {
+      while (non_empty_buckets_[first_word_] == 0u) {
+        ++first_word_;
+      }
+      const int bucket_index =
+          static_cast<int>(first_word_ * kBitsPerWord) +
+          __builtin_ctzll(non_empty_buckets_[first_word_]);
+      Ring& ring = buckets_[bucket_index];
+      while (ring.size > 0u && isStale(ring)) {
+        popEntry(&ring);
+      }
+      if (ring.size > 0u) {
+        front_bucket_index_ = bucket_index;
+        return bucket_index;
+      }
+    }
+  }
+
+  /// True if the front entry of the ring was left behind by a decreased key.
+  bool isStale(const Ring& ring) const {
+    if (!decrease_key_) {
+      return false;
+    }
+    const Tag& tag = ring.tags[ring.head];
+    return slots_[tag.slot_index].generation != tag.generation;
+  }
+
+  void pushEntry(int bucket_index, const T& key, const Tag& tag) {
+    Ring& ring = buckets_[bucket_index];
+    if (ring.size == ring.capacity) {
+      grow(&ring);
+    }
+    const size_t position = (ring.head + ring.size) & (ring.capacity - 1u);
+    ring.keys[position] = key;
+    if (decrease_key_) {
+      ring.tags[position] = tag;
+    }
+    ++ring.size;
+
+    const size_t word = bucket_index / kBitsPerWord;
+    non_empty_buckets_[word] |= uint64_t{1} << (bucket_index % kBitsPerWord);
+    first_word_ = std::min(first_word_, word);
+    if (bucket_index < front_bucket_index_) {
+      front_bucket_index_ = bucket_index;
+    }
+  }
+
+  /// Unwraps the ring into twice the capacity.
+  void grow(Ring* ring) {
+    const size_t capacity = std::max<size_t>(2u * ring->capacity, 16u);
+    std::rotate(ring->keys.begin(), ring->keys.begin() + ring->head,
+                ring->keys.end());
+    ring->keys.resize(capacity);
+    if (decrease_key_) {
+      std::rotate(ring->tags.begin(), ring->tags.begin() + ring->head,
+                  ring->tags.end());
+      ring->tags.resize(capacity);
+    }
+    ring->capacity = capacity;
+    ring->head = 0u;
+  }
+
+  void popEntry(Ring* ring) {
+    ring->head = (ring->head + 1u) & (ring->capacity - 1u);
+    --ring->size;
+    if (ring->size == 0u) {
+      ring->head = 0u;
+      const size_t bucket_index = ring - buckets_.data();
+      non_empty_buckets_[bucket_index / kBitsPerWord] &=
+          ~(uint64_t{1} << (bucket_index % kBitsPerWord));
+    }
+  }
+
+  int num_buckets_;
+  double max_val_;
+  bool decrease_key_ = false;
+
+  AlignedVector<Ring> buckets_;
+  /// One bit per bucket, set if its ring is not empty.
+  std::vector<uint64_t> non_empty_buckets_;
+  /// No bits are set in the words before this one.
+  size_t first_word_ = 0u;
+  /// Bucket of the front element, or -1 if it has to be looked up.
+  int front_bucket_index_ = -1;
+  /// Number of queued keys, without the entries left behind.
+  size_t num_elements_ = 0u;
+
+  /// Slots of the keys pushed since the queue was last empty.
+  FlatHashMap<T, uint32_t, KeyHash> key_slots_;
+  std::vector<Slot> slots_;
+};
+
+template <typename T, typename KeyHash>
+constexpr int RingBucketQueue<T, KeyHash>::kNotQueued;
+template <typename T, typename KeyHash>
+constexpr size_t RingBucketQueue<T, KeyHash>::kBitsPerWord;
+
+/**
+ * A BucketQueue, or a RingBucketQueue with decrease-key if setDecreaseKey is
+ * called with true. Lets the choice between the two be made at runtime, e.g.
+ * from a config.
+ */
+template <typename T, typename KeyHash = std::hash<T>>
+class SelectableBucketQueue {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  SelectableBucketQueue() : decrease_key_(false) {}
+
+  /// WARNING: will CLEAR THE QUEUE!
+  void setNumBuckets(int num_buckets, double max_val) {
+    bucket_queue_.setNumBuckets(num_buckets, max_val);
+    ring_bucket_queue_.setNumBuckets(num_buckets, max_val);
+  }
+
+  /// Only call this while the queue is empty.
+  void setDecreaseKey(bool decrease_key) {
+    DCHECK(empty());
+    decrease_key_ = decrease_key;
+    ring_bucket_queue_.setDecreaseKey(decrease_key);
+  }
+
+  void push(const T& key, double value) {
+    if (decrease_key_) {
+      ring_bucket_queue_.push(key, value);
+    } else {
+      bucket_queue_.push(key, value);
+    }
+  }
+
+  void pop() {
+    if (decrease_key_) {
+      ring_bucket_queue_.pop();
+    } else {
+      bucket_queue_.pop();
+    }
+  }
+
+  T front() {
+    return decrease_key_ ? ring_bucket_queue_.front() : bucket_queue_.front();
+  }
+
+  int frontBucketIndex() {
+    return decrease_key_ ? ring_bucket_queue_.frontBucketIndex()
+                         : bucket_queue_.frontBucketIndex();
+  }
+
+  bool empty() {
+    return decrease_key_ ? ring_bucket_queue_.empty() : bucket_queue_.empty();
+  }
+
+  size_t size() const {
+    return decrease_key_ ? ring_bucket_queue_.size() : bucket_queue_.size();
+  }
+
+  void clear() {
+    bucket_queue_.clear();
+    ring_bucket_queue_.clear();
+  }
+
+ private:
+  bool decrease_key_;
+  BucketQueue<T> bucket_queue_;
+  RingBucketQueue<T, KeyHash> ring_bucket_queue_;
+};
+
 }  // namespace voxblox
 #endif  // VOXBLOX_UTILS_BUCKET_QUEUE_H_
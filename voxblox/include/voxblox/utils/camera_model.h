@@ -11,6 +11,26 @@
 
 namespace voxblox {
 
+/**
+ * Pinhole intrinsics of an organized depth image, u indexes the columns and v
+ * the rows of the image.
+ */
+struct CameraIntrinsics {
+  int width = 640;
+  int height = 480;
+  float fx = 525.0f;
+  float fy = 525.0f;
+  float cx = 319.5f;
+  float cy = 239.5f;
+};
+
+/**
+ * Row major image of the depths along the optical axis in meters, pixels
+ * without a measurement hold 0 or NaN.
+ */
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    DepthImage;
+
 /**
  * Represents a plane in Hesse normal form (normal + distance) for faster
  * distance calculations to points.
@@ -0,0 +1,115 @@
+#ifndef VOXBLOX_UTILS_DISTANCE_TRANSFORM_H_
+#define VOXBLOX_UTILS_DISTANCE_TRANSFORM_H_
+
+#include <limits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/block_hash.h"
+#include "voxblox/core/common.h"
+#include "voxblox/utils/thread_pool.h"
+
+namespace voxblox {
+
+/**
+ * Exact squared euclidean distance transform of a sampled function, after
+ * P. Felzenszwalb and D. Huttenlocher, Distance Transforms of Sampled
+ * Functions. Computes distances[q] = min_p (q - p)^2 + values[p] over the n
+ * samples in linear time, closest[q] is the minimizing p or -1 if all values
+ * are infinite. vertices and boundaries are buffers of at least n and n + 1
+ * elements.
+ */
+void computeDistanceTransform1D(const float* values, int n, float* distances,
+                                int* closest, int* vertices,
+                                float* boundaries);
+
+/**
+ * Exact euclidean distance transform over the voxels of a sparse set of
+ * blocks. Computes for every voxel the squared distance to the closest site
+ * in voxels, and which site that is, by running the 1D transform along x, y
+ * and z, see computeDistanceTransform1D.
+ *
+ * The transform is dense within the blocks added, the rows of every axis run
+ * through the added blocks that follow each other along it. Blocks that are
+ * not added act as if they were far away, so the distances of a voxel are
+ * exact if all blocks within the distance to its closest site are added.
+ */
+class BlockDistanceTransform {
+ public:
+  /// Site index of voxels without a site in reach.
+  static constexpr int kNoSite = -1;
+
+  explicit BlockDistanceTransform(size_t voxels_per_side);
+
+  /// Removes all blocks and sites.
+  void clear();
+
+  /**
+   * Adds the block and all blocks within a cube of margin blocks around it.
+   * Allocates the memory of the new blocks.
+   */
+  void addBlock(const BlockIndex& block_index, int margin = 0);
+
+  /**
+   * Makes the voxel at global_index the site with the given index, which must
+   * not be negative. The block of the voxel must have been added.
+   */
+  void addSite(const GlobalIndex& global_index, int site_index);
+
+  /**
+   * Runs the transform on num_threads threads, using the workers of
+   * thread_pool if there is more than one.
+   */
+  void compute(size_t num_threads = 1u, ThreadPool* thread_pool = nullptr);
+
+  bool hasBlock(const BlockIndex& block_index) const {
+    return block_slots_.count(block_index) > 0u;
+  }
+  size_t getNumberOfBlocks() const { return block_indices_.size(); }
+
+  /**
+   * Index of the closest site of the voxel with the linear index lin_index in
+   * the added block block_index, kNoSite if there is none, and the squared
+   * distance to it in voxels.
+   */
+  inline int getClosestSite(const BlockIndex& block_index, size_t lin_index,
+                            float* squared_distance) const {
+    DCHECK(squared_distance != nullptr);
+    const AnyIndexHashMapType<size_t>::type::const_iterator it =
+        block_slots_.find(block_index);
+    CHECK(it != block_slots_.end());
+    const size_t voxel_idx = it->second * num_voxels_per_block_ + lin_index;
+    *squared_distance = squared_distances_[voxel_idx];
+    return sites_[voxel_idx];
+  }
+
+ private:
+  /// Blocks following each other along an axis.
+  struct BlockRun {
+    std::vector<size_t> slots;
+  };
+
+  /// Splits the added blocks into runs along the axis.
+  void getBlockRuns(int axis, std::vector<BlockRun>* runs) const;
+
+  /// Transforms all rows of a run of blocks along the axis.
+  void transformRun(int axis, const BlockRun& run, std::vector<float>* values,
+                    std::vector<float>* distances, std::vector<int>* closest,
+                    std::vector<int>* sites, std::vector<int>* vertices,
+                    std::vector<float>* boundaries);
+
+  const size_t voxels_per_side_;
+  const size_t num_voxels_per_block_;
+
+  AnyIndexHashMapType<size_t>::type block_slots_;
+  BlockIndexList block_indices_;
+
+  /// Per voxel of the added blocks, in the order of their slots.
+  std::vector<float> squared_distances_;
+  std::vector<int> sites_;
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_UTILS_DISTANCE_TRANSFORM_H_
@@ -228,8 +228,12 @@ VoxelEvaluationResult computeVoxelError(
 template <>
 bool isObservedVoxel(const TsdfVoxel& voxel);
 template <>
+bool isObservedVoxel(const CompactTsdfVoxel& voxel);
+template <>
 bool isObservedVoxel(const EsdfVoxel& voxel);
 template <>
+bool isObservedVoxel(const CompactEsdfVoxel& voxel);
+template <>
 FloatingPoint getVoxelSdf(const TsdfVoxel& voxel);
 template <>
 FloatingPoint getVoxelSdf(const EsdfVoxel& voxel);
@@ -0,0 +1,400 @@
+#ifndef VOXBLOX_UTILS_FLAT_HASH_MAP_H_
+#define VOXBLOX_UTILS_FLAT_HASH_MAP_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/common.h"
+
+namespace voxblox {
+
+/**
+ * Open-addressing hash map using robin hood hashing with linear probing and
+ * backward shift deletion. All elements are stored in a single contiguous
+ * array, so a lookup touches one or two cache lines instead of chasing the
+ * per-node pointers of std::unordered_map, and iterating the map is a linear
+ * scan.
+ *
+ * The interface mirrors the subset of std::unordered_map used throughout
+ * voxblox (find, emplace, insert, erase, operator[], iteration, ...). The main
+ * difference is that ANY insertion or erasure may move elements around, so all
+ * iterators, pointers and references into the map are invalidated by it.
+ *
+ * The slot is picked from the LOWEST bits of the hash, hence the hasher needs
+ * to mix its input well, see AnyIndexMixingHash.
+ */
+template <typename KeyType, typename ValueType, typename Hasher,
+          typename KeyEqual = std::equal_to<KeyType>>
+class FlatHashMap {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef KeyType key_type;
+  typedef ValueType mapped_type;
+  typedef std::pair<const KeyType, ValueType> value_type;
+  typedef size_t size_type;
+  typedef Hasher hasher;
+  typedef KeyEqual key_equal;
+
+  template <bool kIsConst>
+  class IteratorBase {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename FlatHashMap::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<kIsConst, const value_type*,
+                                      value_type*>::type pointer;
+    typedef typename std::conditional<kIsConst, const value_type&,
+                                      value_type&>::type reference;
+    typedef typename std::conditional<kIsConst, const FlatHashMap*,
+                                      FlatHashMap*>::type MapPointer;
+
+    IteratorBase() : map_(nullptr), slot_(0u) {}
+    IteratorBase(MapPointer map, size_t slot) : map_(map), slot_(slot) {}
+
+    /// Allow conversion from iterator to const_iterator.
+    template <bool kOtherIsConst,
+              typename = typename std::enable_if<kIsConst &&
+                                                 !kOtherIsConst>::type>
+    IteratorBase(const IteratorBase<kOtherIsConst>& other)  // NOLINT
+        : map_(other.map_), slot_(other.slot_) {}
+
+    reference operator*() const { return map_->slots_[slot_]; }
+    pointer operator->() const { return &(map_->slots_[slot_]); }
+
+    IteratorBase& operator++() {
+      slot_ = map_->nextOccupiedSlot(slot_ + 1u);
+      return *this;
+    }
+
+    IteratorBase operator++(int) {
+      IteratorBase previous = *this;
+      ++(*this);
+      return previous;
+    }
+
+    template <bool kOtherIsConst>
+    bool operator==(const IteratorBase<kOtherIsConst>& other) const {
+      return slot_ == other.slot_;
+    }
+    template <bool kOtherIsConst>
+    bool operator!=(const IteratorBase<kOtherIsConst>& other) const {
+      return slot_ != other.slot_;
+    }
+
+   private:
+    friend class FlatHashMap;
+    template <bool>
+    friend class IteratorBase;
+
+    MapPointer map_;
+    size_t slot_;
+  };
+
+  typedef IteratorBase<false> iterator;
+  typedef IteratorBase<true> const_iterator;
+
+  FlatHashMap()
+      : slots_(nullptr), probe_lengths_(), capacity_(0u), size_(0u) {}
+
+  explicit FlatHashMap(size_t num_elements) : FlatHashMap() {
+    reserve(num_elements);
+  }
+
+  FlatHashMap(const FlatHashMap& other) : FlatHashMap() {
+    reserve(other.size());
+    for (const value_type& element : other) {
+      insertUniqueKey(element.first, element.second);
+    }
+  }
+
+  FlatHashMap(FlatHashMap&& other) noexcept : FlatHashMap() { swap(other); }
+
+  FlatHashMap& operator=(FlatHashMap other) {
+    swap(other);
+    return *this;
+  }
+
+  ~FlatHashMap() {
+    clear();
+    deallocate();
+  }
+
+  void swap(FlatHashMap& other) noexcept {
+    std::swap(slots_, other.slots_);
+    probe_lengths_.swap(other.probe_lengths_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(size_, other.size_);
+  }
+
+  iterator begin() { return iterator(this, nextOccupiedSlot(0u)); }
+  const_iterator begin() const {
+    return const_iterator(this, nextOccupiedSlot(0u));
+  }
+  const_iterator cbegin() const { return begin(); }
+  iterator end() { return iterator(this, capacity_); }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+  const_iterator cend() const { return end(); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0u; }
+  size_t bucket_count() const { return capacity_; }
+  float load_factor() const {
+    return (capacity_ == 0u) ? 0.0f
+                             : static_cast<float>(size_) /
+                                   static_cast<float>(capacity_);
+  }
+
+  iterator find(const KeyType& key) { return iterator(this, findSlot(key)); }
+  const_iterator find(const KeyType& key) const {
+    return const_iterator(this, findSlot(key));
+  }
+
+  size_t count(const KeyType& key) const {
+    return (findSlot(key) != capacity_) ? 1u : 0u;
+  }
+
+  template <typename... Arguments>
+  std::pair<iterator, bool> emplace(const KeyType& key,
+                                    Arguments&&... arguments) {
+    const size_t slot = findSlot(key);
+    if (slot != capacity_) {
+      return std::make_pair(iterator(this, slot), false);
+    }
+    const size_t new_slot = insertUniqueKey(
+        key, ValueType(std::forward<Arguments>(arguments)...));
+    return std::make_pair(iterator(this, new_slot), true);
+  }
+
+  std::pair<iterator, bool> insert(const value_type& key_value_pair) {
+    return emplace(key_value_pair.first, key_value_pair.second);
+  }
+
+  ValueType& operator[](const KeyType& key) {
+    return emplace(key).first->second;
+  }
+
+  ValueType& at(const KeyType& key) {
+    const size_t slot = findSlot(key);
+    CHECK_NE(slot, capacity_) << "Key not found in FlatHashMap.";
+    return slots_[slot].second;
+  }
+  const ValueType& at(const KeyType& key) const {
+    const size_t slot = findSlot(key);
+    CHECK_NE(slot, capacity_) << "Key not found in FlatHashMap.";
+    return slots_[slot].second;
+  }
+
+  size_t erase(const KeyType& key) {
+    const size_t slot = findSlot(key);
+    if (slot == capacity_) {
+      return 0u;
+    }
+    eraseSlot(slot);
+    return 1u;
+  }
+
+  /// Destroys all elements but keeps the allocated slots.
+  void clear() {
+    if (size_ > 0u) {
+      for (size_t slot = 0u; slot < capacity_; ++slot) {
+        if (probe_lengths_[slot] != kEmpty) {
+          slots_[slot].~value_type();
+          probe_lengths_[slot] = kEmpty;
+        }
+      }
+      size_ = 0u;
+    }
+  }
+
+  /// Makes sure num_elements can be inserted without rehashing.
+  void reserve(size_t num_elements) {
+    size_t new_capacity = kMinCapacity;
+    while (maxElementsForCapacity(new_capacity) < num_elements) {
+      new_capacity *= 2u;
+    }
+    if (new_capacity > capacity_) {
+      rehash(new_capacity);
+    }
+  }
+
+ private:
+  /// Probe length of an empty slot, occupied slots store distance + 1.
+  static constexpr uint8_t kEmpty = 0u;
+  static constexpr uint8_t kMaxProbeLength =
+      std::numeric_limits<uint8_t>::max();
+  static constexpr size_t kMinCapacity = 16u;
+
+  /// Max load factor of 7/8, robin hood hashing copes well with high loads.
+  static size_t maxElementsForCapacity(size_t capacity) {
+    return capacity - capacity / 8u;
+  }
+
+  size_t homeSlot(const KeyType& key) const {
+    return hasher_(key) & (capacity_ - 1u);
+  }
+
+  size_t nextOccupiedSlot(size_t slot) const {
+    while (slot < capacity_ && probe_lengths_[slot] == kEmpty) {
+      ++slot;
+    }
+    return slot;
+  }
+
+  /// Returns capacity_ if the key is not in the map.
+  size_t findSlot(const KeyType& key) const {
+    if (size_ == 0u) {
+      return capacity_;
+    }
+    const size_t mask = capacity_ - 1u;
+    size_t slot = homeSlot(key);
+    for (uint8_t probe_length = 1u;; ++probe_length) {
+      const uint8_t slot_probe_length = probe_lengths_[slot];
+      // Robin hood invariant: once we hit a slot whose element is closer to
+      // its home than we would be, the key cannot be further down the array.
+      if (slot_probe_length < probe_length) {
+        return capacity_;
+      }
+      if (slot_probe_length == probe_length &&
+          key_equal_(slots_[slot].first, key)) {
+        return slot;
+      }
+      slot = (slot + 1u) & mask;
+    }
+  }
+
+  /**
+   * Inserts a key that is known NOT to be in the map, growing it if required.
+   * Returns the slot the new element ended up in.
+   */
+  size_t insertUniqueKey(KeyType key, ValueType value) {
+    if (size_ + 1u > maxElementsForCapacity(capacity_)) {
+      rehash(std::max(kMinCapacity, 2u * capacity_));
+    }
+
+    const KeyType inserted_key = key;
+    const size_t mask = capacity_ - 1u;
+    size_t inserted_slot = capacity_;
+    size_t slot = homeSlot(key);
+    uint8_t probe_length = 1u;
+    while (true) {
+      if (probe_lengths_[slot] == kEmpty) {
+        new (&slots_[slot]) value_type(std::move(key), std::move(value));
+        probe_lengths_[slot] = probe_length;
+        ++size_;
+        return (inserted_slot == capacity_) ? slot : inserted_slot;
+      }
+      if (probe_lengths_[slot] < probe_length) {
+        // Take the slot from the element that is closer to its home and carry
+        // on inserting the displaced element instead.
+        KeyType displaced_key = slots_[slot].first;
+        ValueType displaced_value = std::move(slots_[slot].second);
+        slots_[slot].~value_type();
+        new (&slots_[slot]) value_type(std::move(key), std::move(value));
+        std::swap(probe_length, probe_lengths_[slot]);
+        key = std::move(displaced_key);
+        value = std::move(displaced_value);
+        if (inserted_slot == capacity_) {
+          inserted_slot = slot;
+        }
+      }
+      slot = (slot + 1u) & mask;
+      if (++probe_length == kMaxProbeLength) {
+        // Only happens with a very poor hash, make room and start over with
+        // the element we are currently carrying.
+        VLOG(1) << "FlatHashMap probe length exceeded, growing from "
+                << capacity_ << " slots.";
+        rehash(2u * capacity_);
+        insertUniqueKey(std::move(key), std::move(value));
+        return findSlot(inserted_key);
+      }
+    }
+  }
+
+  void eraseSlot(size_t slot) {
+    const size_t mask = capacity_ - 1u;
+    slots_[slot].~value_type();
+    --size_;
+    // Backward shift: pull all following elements of the cluster one slot
+    // closer to their home, which keeps lookups tombstone free.
+    size_t next_slot = (slot + 1u) & mask;
+    while (probe_lengths_[next_slot] > 1u) {
+      new (&slots_[slot]) value_type(std::move(slots_[next_slot]));
+      slots_[next_slot].~value_type();
+      probe_lengths_[slot] = probe_lengths_[next_slot] - 1u;
+      slot = next_slot;
+      next_slot = (next_slot + 1u) & mask;
+    }
+    probe_lengths_[slot] = kEmpty;
+  }
+
+  void rehash(size_t new_capacity) {
+    DCHECK_GE(maxElementsForCapacity(new_capacity), size_);
+    DCHECK_EQ(new_capacity & (new_capacity - 1u), 0u);
+
+    value_type* old_slots = slots_;
+    std::vector<uint8_t> old_probe_lengths;
+    old_probe_lengths.swap(probe_lengths_);
+    const size_t old_capacity = capacity_;
+
+    slots_ = allocator_.allocate(new_capacity);
+    probe_lengths_.assign(new_capacity, kEmpty);
+    capacity_ = new_capacity;
+    size_ = 0u;
+
+    for (size_t slot = 0u; slot < old_capacity; ++slot) {
+      if (old_probe_lengths[slot] != kEmpty) {
+        value_type& element = old_slots[slot];
+        insertUniqueKey(element.first, std::move(element.second));
+        element.~value_type();
+      }
+    }
+    if (old_slots != nullptr) {
+      allocator_.deallocate(old_slots, old_capacity);
+    }
+  }
+
+  void deallocate() {
+    if (slots_ != nullptr) {
+      allocator_.deallocate(slots_, capacity_);
+      slots_ = nullptr;
+    }
+    probe_lengths_.clear();
+    capacity_ = 0u;
+  }
+
+  /// Raw storage, only slots with a non-empty probe length are constructed.
+  value_type* slots_;
+  std::vector<uint8_t> probe_lengths_;
+  size_t capacity_;
+  size_t size_;
+
+  Eigen::aligned_allocator<value_type> allocator_;
+  Hasher hasher_;
+  KeyEqual key_equal_;
+};
+
+template <typename KeyType, typename ValueType, typename Hasher,
+          typename KeyEqual>
+constexpr uint8_t FlatHashMap<KeyType, ValueType, Hasher, KeyEqual>::kEmpty;
+template <typename KeyType, typename ValueType, typename Hasher,
+          typename KeyEqual>
+constexpr uint8_t
+    FlatHashMap<KeyType, ValueType, Hasher, KeyEqual>::kMaxProbeLength;
+template <typename KeyType, typename ValueType, typename Hasher,
+          typename KeyEqual>
+constexpr size_t
+    FlatHashMap<KeyType, ValueType, Hasher, KeyEqual>::kMinCapacity;
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_UTILS_FLAT_HASH_MAP_H_
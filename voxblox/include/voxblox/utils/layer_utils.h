@@ -118,6 +118,20 @@ bool isSameVoxel(const EsdfVoxel& voxel_A, const EsdfVoxel& voxel_B);
 template <>
 bool isSameVoxel(const OccupancyVoxel& voxel_A, const OccupancyVoxel& voxel_B);
 
+/**
+ * Quantizes all blocks of tsdf_layer into compact_layer, replacing blocks that
+ * already exist there. Distances are normalized to truncation_distance and
+ * clamped to it.
+ */
+void compressTsdfLayer(const Layer<TsdfVoxel>& tsdf_layer,
+                       FloatingPoint truncation_distance,
+                       Layer<CompactTsdfVoxel>* compact_layer);
+
+/// Inverse of compressTsdfLayer, up to the quantization error.
+void decompressTsdfLayer(const Layer<CompactTsdfVoxel>& compact_layer,
+                         FloatingPoint truncation_distance,
+                         Layer<TsdfVoxel>* tsdf_layer);
+
 /**
  * This function will shift all the blocks such that the new grid origin will be
  * close to the centroid of all allocated blocks. The new_layer_origin is the
@@ -3,11 +3,42 @@
 
 #include "voxblox/core/common.h"
 #include "voxblox/core/voxel.h"
+#include "voxblox/core/voxel_storage.h"
+#include "voxblox/utils/voxel_utils.h"
 
 namespace voxblox {
 
 namespace utils {
 
+/**
+ * Returns false if no cube inside the block can produce triangles, i.e. the
+ * observed voxels of the block do not change sign. Only answered for the
+ * layouts that can be scanned cheaply, the others always return true.
+ */
+template <typename VoxelStorage>
+inline bool mayContainSurface(const VoxelStorage& /*voxels*/,
+                              size_t /*num_voxels*/,
+                              const FloatingPoint /*min_weight*/) {
+  return true;
+}
+
+/// Reduces over the contiguous distance and weight planes.
+inline bool mayContainSurface(const SoaVoxelStorage<TsdfVoxel>& voxels,
+                              size_t num_voxels,
+                              const FloatingPoint min_weight) {
+  const float* distances = voxels.distances();
+  const float* weights = voxels.weights();
+  bool has_negative = false;
+  bool has_positive = false;
+  for (size_t i = 0u; i < num_voxels; ++i) {
+    const bool observed = weights[i] > min_weight;
+    // Same sign convention as the marching cubes.
+    has_negative |= observed & (distances[i] < 0.0f);
+    has_positive |= observed & (distances[i] >= 0.0f);
+  }
+  return has_negative && has_positive;
+}
+
 template <typename VoxelType>
 bool getSdfIfValid(const VoxelType& voxel, const FloatingPoint min_weight,
                    FloatingPoint* sdf);
@@ -23,6 +54,34 @@ inline bool getSdfIfValid(const TsdfVoxel& voxel,
   return true;
 }
 
+template <>
+inline bool getSdfIfValid(const ConstTsdfVoxelRef& voxel,
+                          const FloatingPoint min_weight, FloatingPoint* sdf) {
+  DCHECK(sdf != nullptr);
+  if (voxel.weight <= min_weight) {
+    return false;
+  }
+  *sdf = voxel.distance;
+  return true;
+}
+
+/**
+ * Returns the distance normalized to the truncation distance. Marching cubes
+ * only uses the ratios between distances, so the mesh is the same as for the
+ * metric distance.
+ */
+template <>
+inline bool getSdfIfValid(const CompactTsdfVoxel& voxel,
+                          const FloatingPoint min_weight, FloatingPoint* sdf) {
+  DCHECK(sdf != nullptr);
+  if (getCompactTsdfWeight(voxel) <= min_weight) {
+    return false;
+  }
+  constexpr FloatingPoint kUnitTruncationDistance = 1.0;
+  *sdf = getCompactTsdfDistance(voxel, kUnitTruncationDistance);
+  return true;
+}
+
 template <>
 inline bool getSdfIfValid(const EsdfVoxel& voxel,
                           const FloatingPoint /*min_weight*/,
@@ -50,6 +109,28 @@ inline bool getColorIfValid(const TsdfVoxel& voxel,
   return true;
 }
 
+template <>
+inline bool getColorIfValid(const ConstTsdfVoxelRef& voxel,
+                            const FloatingPoint min_weight, Color* color) {
+  DCHECK(color != nullptr);
+  if (voxel.weight <= min_weight) {
+    return false;
+  }
+  *color = voxel.color;
+  return true;
+}
+
+template <>
+inline bool getColorIfValid(const CompactTsdfVoxel& voxel,
+                            const FloatingPoint min_weight, Color* color) {
+  DCHECK(color != nullptr);
+  if (getCompactTsdfWeight(voxel) <= min_weight) {
+    return false;
+  }
+  *color = voxel.color;
+  return true;
+}
+
 template <>
 inline bool getColorIfValid(const EsdfVoxel& voxel,
                             const FloatingPoint /*min_weight*/, Color* color) {
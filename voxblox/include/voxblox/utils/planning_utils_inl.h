@@ -93,6 +93,8 @@ void fillSphereAroundPoint(const Point& center, const FloatingPoint radius,
         voxel.hallucinated = true;
         voxel.fixed = true;
         block_ptr->updated().set();
+        block_ptr->markVoxelDirty(
+            block_ptr->computeLinearIndexFromVoxelIndex(voxel_index));
         block_ptr->has_data() = true;
       }
     }
@@ -128,6 +130,8 @@ void clearSphereAroundPoint(const Point& center, const FloatingPoint radius,
         voxel.hallucinated = true;
         voxel.fixed = true;
         block_ptr->updated().set();
+        block_ptr->markVoxelDirty(
+            block_ptr->computeLinearIndexFromVoxelIndex(voxel_index));
         block_ptr->has_data() = true;
       }
     }
@@ -0,0 +1,132 @@
+#ifndef VOXBLOX_UTILS_THREAD_POOL_H_
+#define VOXBLOX_UTILS_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace voxblox {
+
+/**
+ * Persistent pool of worker threads, so the integrators, the mesh integrator
+ * and ICP do not have to start and join threads on every call. One pool can be
+ * shared by all of them.
+ *
+ * Every worker owns a task queue. A task goes to the queue of the worker named
+ * by its affinity hint, so tasks that repeatedly get the same hint tend to run
+ * on the same worker and find their data in its cache, or to the queues in
+ * turn if it has none. Workers run their own tasks newest first and steal the
+ * oldest tasks of the other workers once their queue runs dry. A thread
+ * waiting for a group of tasks runs queued tasks itself in the meantime, which
+ * makes it safe to wait for tasks from within a task and to share the pool
+ * between threads.
+ */
+class ThreadPool {
+ public:
+  typedef std::shared_ptr<ThreadPool> Ptr;
+  typedef std::function<void()> Task;
+
+  /// Affinity hint of tasks that may run on any worker.
+  static constexpr int kNoAffinity = -1;
+
+  /// Tracks a batch of submitted tasks, see wait().
+  class TaskGroup {
+   public:
+    TaskGroup() : num_pending_tasks_(0u) {}
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    bool done() const { return num_pending_tasks_ == 0u; }
+
+   private:
+    friend class ThreadPool;
+
+    std::atomic<size_t> num_pending_tasks_;
+    std::mutex mutex_;
+    std::condition_variable done_condition_;
+  };
+
+  /**
+   * Starts num_threads workers. Without workers all tasks run on the threads
+   * that wait for them.
+   */
+  explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency());
+
+  /// Finishes all queued tasks and joins the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t num_threads() const { return workers_.size(); }
+
+  /**
+   * Queues a task as part of group, which has to outlive the task. affinity is
+   * the index of the preferred worker, modulo the number of workers. Thread
+   * safe.
+   */
+  void submit(const Task& task, TaskGroup* group, int affinity = kNoAffinity);
+
+  /**
+   * Returns once all tasks of the group finished, running queued tasks on the
+   * calling thread until then. Thread safe.
+   */
+  void wait(TaskGroup* group);
+
+  /**
+   * Runs task(0) to task(num_tasks - 1) with task i preferring worker i and
+   * returns once all are done, the calling thread works on them as well. A
+   * single task runs directly on the calling thread. Thread safe.
+   */
+  void runTasks(size_t num_tasks, const std::function<void(size_t)>& task);
+
+  /**
+   * Index of the worker of this pool that calls this function, kNoAffinity if
+   * the calling thread is not a worker of this pool.
+   */
+  int getWorkerIndex() const;
+
+ private:
+  struct QueuedTask {
+    Task task;
+    TaskGroup* group;
+  };
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<QueuedTask> tasks;
+  };
+
+  /// Queues the task without waking up a worker.
+  void enqueue(const Task& task, TaskGroup* group, int affinity);
+  void wakeWorkers();
+
+  /**
+   * Takes the newest task of the own queue of the calling worker or else the
+   * oldest task of any other queue.
+   */
+  bool popTask(QueuedTask* queued_task);
+  void runTask(QueuedTask* queued_task);
+
+  void workerLoop(size_t worker_idx);
+
+  std::vector<std::thread> workers_;
+  /// One queue per worker, or a single one without workers.
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+
+  std::atomic<size_t> num_queued_tasks_;
+  std::atomic<size_t> next_queue_;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_condition_;
+  bool stop_;
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_UTILS_THREAD_POOL_H_
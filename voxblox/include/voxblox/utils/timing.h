@@ -171,9 +171,11 @@ class Timing {
   static double GetMaxSeconds(std::string const& tag);
   static double GetHz(size_t handle);
   static double GetHz(std::string const& tag);
+  /// Prints all timers that took samples since the last reset.
   static void Print(std::ostream& out);
   static std::string Print();
   static std::string SecondsToTimeString(double seconds);
+  /// Discards all samples, handles remain valid.
   static void Reset();
   static const map_t& GetTimers() { return Instance().tagMap_; }
 
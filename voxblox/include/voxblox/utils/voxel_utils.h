@@ -1,6 +1,12 @@
 #ifndef VOXBLOX_UTILS_VOXEL_UTILS_H_
 #define VOXBLOX_UTILS_VOXEL_UTILS_H_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glog/logging.h>
+
 #include "voxblox/core/color.h"
 #include "voxblox/core/common.h"
 #include "voxblox/core/voxel.h"
@@ -19,6 +25,75 @@ template <>
 void mergeVoxelAIntoVoxelB(const OccupancyVoxel& voxel_A,
                            OccupancyVoxel* voxel_B);
 
+/// Merging is independent of the truncation distance, as both voxels share it.
+template <>
+void mergeVoxelAIntoVoxelB(const CompactTsdfVoxel& voxel_A,
+                           CompactTsdfVoxel* voxel_B);
+
+/// Conversion between float and IEEE 754 half precision, rounds to nearest.
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t half);
+
+/// Distance of a compact voxel in meters.
+inline float getCompactTsdfDistance(const CompactTsdfVoxel& voxel,
+                                    FloatingPoint truncation_distance) {
+  return static_cast<float>(voxel.distance) * truncation_distance /
+         CompactTsdfVoxel::kMaxDistance;
+}
+
+/// Distances beyond the truncation distance are clamped.
+inline void setCompactTsdfDistance(float distance,
+                                   FloatingPoint truncation_distance,
+                                   CompactTsdfVoxel* voxel) {
+  DCHECK(voxel != nullptr);
+  DCHECK_GT(truncation_distance, 0.0);
+  const float normalized_distance =
+      static_cast<float>(distance / truncation_distance);
+  const float clamped_distance =
+      std::max(-1.0f, std::min(1.0f, normalized_distance));
+  voxel->distance = static_cast<int16_t>(
+      std::round(clamped_distance * CompactTsdfVoxel::kMaxDistance));
+}
+
+inline float getCompactTsdfWeight(const CompactTsdfVoxel& voxel) {
+  return halfToFloat(voxel.weight);
+}
+
+inline void setCompactTsdfWeight(float weight, CompactTsdfVoxel* voxel) {
+  DCHECK(voxel != nullptr);
+  voxel->weight = floatToHalf(weight);
+}
+
+void compressTsdfVoxel(const TsdfVoxel& voxel,
+                       FloatingPoint truncation_distance,
+                       CompactTsdfVoxel* compact_voxel);
+
+void decompressTsdfVoxel(const CompactTsdfVoxel& compact_voxel,
+                         FloatingPoint truncation_distance, TsdfVoxel* voxel);
+
+/// Parent offset of an ESDF voxel of either layout, see EsdfVoxel::parent.
+inline SignedIndex getEsdfParent(const EsdfVoxel& voxel) {
+  return voxel.parent;
+}
+
+inline SignedIndex getEsdfParent(const CompactEsdfVoxel& voxel) {
+  return voxel.parent.cast<IndexElement>();
+}
+
+inline void setEsdfParent(const SignedIndex& parent, EsdfVoxel* voxel) {
+  DCHECK(voxel != nullptr);
+  voxel->parent = parent;
+}
+
+/// Offsets beyond CompactEsdfVoxel::kMaxParentOffset are clamped.
+inline void setEsdfParent(const SignedIndex& parent, CompactEsdfVoxel* voxel) {
+  DCHECK(voxel != nullptr);
+  const IndexElement max_offset = CompactEsdfVoxel::kMaxParentOffset;
+  voxel->parent = parent.cwiseMax(-max_offset)
+                      .cwiseMin(max_offset)
+                      .cast<CompactEsdfVoxel::ParentType::Scalar>();
+}
+
 }  // namespace voxblox
 
 #endif  // VOXBLOX_UTILS_VOXEL_UTILS_H_
@@ -240,17 +240,20 @@ size_t ICP::runICP(const Layer<TsdfVoxel>& tsdf_layer, const Pointcloud& points,
   base_info_vector.head<3>().setConstant(config_.inital_translation_weighting);
   base_info_vector.tail<3>().setConstant(config_.inital_rotation_weighting);
 
-  std::list<std::thread> threads;
   atomic_idx_.store(0);
   size_t num_updates = 0;
 
-  for (size_t i = 0; i < config_.num_threads; ++i) {
-    threads.emplace_back(&ICP::runThread, this, shuffled_points,
-                         refined_T_tsdf_sensor, &base_info_vector,
-                         &num_updates);
-  }
-  for (std::thread& thread : threads) {
-    thread.join();
+  auto run_thread = [&](size_t /*task_idx*/) {
+    runThread(shuffled_points, refined_T_tsdf_sensor, &base_info_vector,
+              &num_updates);
+  };
+  if (config_.num_threads <= 1u) {
+    run_thread(0u);
+  } else {
+    if (!thread_pool_) {
+      thread_pool_ = std::make_shared<ThreadPool>(config_.num_threads - 1u);
+    }
+    thread_pool_->runTasks(config_.num_threads, run_thread);
   }
 
   interpolator_.reset();
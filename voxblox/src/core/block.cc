@@ -1,6 +1,7 @@
 #include "voxblox/core/block.h"
 
 #include "voxblox/core/voxel.h"
+#include "voxblox/utils/voxel_utils.h"
 
 namespace voxblox {
 
@@ -34,9 +35,14 @@ void serializeDirection(const Eigen::Vector3i& parent_direction,
   // Layout:
   // | 3x8bit (int8_t) for parent (X,Y,Z) | 8bit ESDF |
 
-  *data |= static_cast<uint32_t>(static_cast<int8_t>(parent_direction_x) << 24);
-  *data |= static_cast<uint32_t>(static_cast<int8_t>(parent_direction_y) << 16);
-  *data |= static_cast<uint32_t>(static_cast<int8_t>(parent_direction_z) << 8);
+  // Through uint8_t, so the sign of negative offsets does not spill into the
+  // bytes above.
+  *data |= static_cast<uint32_t>(static_cast<uint8_t>(parent_direction_x))
+           << 24;
+  *data |= static_cast<uint32_t>(static_cast<uint8_t>(parent_direction_y))
+           << 16;
+  *data |= static_cast<uint32_t>(static_cast<uint8_t>(parent_direction_z))
+           << 8;
 }
 
 Eigen::Vector3i deserializeDirection(const uint32_t data) {
@@ -61,6 +67,86 @@ Eigen::Vector3i deserializeDirection(const uint32_t data) {
   return parent_direction;
 }
 
+// Shared by the TSDF blocks of all storage layouts.
+template <typename TsdfVoxelRefType>
+void deserializeTsdfVoxel(const uint32_t* data, TsdfVoxelRefType&& voxel) {
+  const uint32_t bytes_1 = data[0];
+  const uint32_t bytes_2 = data[1];
+  const uint32_t bytes_3 = data[2];
+
+  // TODO(mfehr, helenol): find a better way to do this!
+
+  memcpy(&(voxel.distance), &bytes_1, sizeof(bytes_1));
+  memcpy(&(voxel.weight), &bytes_2, sizeof(bytes_2));
+
+  voxel.color.r = static_cast<uint8_t>(bytes_3 >> 24);
+  voxel.color.g = static_cast<uint8_t>((bytes_3 & 0x00FF0000) >> 16);
+  voxel.color.b = static_cast<uint8_t>((bytes_3 & 0x0000FF00) >> 8);
+  voxel.color.a = static_cast<uint8_t>(bytes_3 & 0x000000FF);
+}
+
+template <typename TsdfVoxelRefType>
+void serializeTsdfVoxel(const TsdfVoxelRefType& voxel,
+                        std::vector<uint32_t>* data) {
+  // TODO(mfehr, helenol): find a better way to do this!
+  const uint32_t* bytes_1_ptr =
+      reinterpret_cast<const uint32_t*>(&voxel.distance);
+  data->push_back(*bytes_1_ptr);
+
+  const uint32_t* bytes_2_ptr =
+      reinterpret_cast<const uint32_t*>(&voxel.weight);
+  data->push_back(*bytes_2_ptr);
+
+  data->push_back(static_cast<uint32_t>(voxel.color.a) |
+                  (static_cast<uint32_t>(voxel.color.b) << 8) |
+                  (static_cast<uint32_t>(voxel.color.g) << 16) |
+                  (static_cast<uint32_t>(voxel.color.r) << 24));
+}
+
+// Shared by the ESDF blocks of both voxel layouts, which are serialized alike.
+template <typename EsdfVoxelType>
+void deserializeEsdfVoxel(const uint32_t* data, EsdfVoxelType* voxel) {
+  // Layout:
+  // | 32 bit sdf | 3x8bit (int8_t) parent | 8 bit flags|
+
+  const uint32_t bytes_1 = data[0];
+  const uint32_t bytes_2 = data[1];
+
+  memcpy(&(voxel->distance), &bytes_1, sizeof(bytes_1));
+
+  voxel->observed = static_cast<bool>(bytes_2 & 0x00000001);
+  voxel->hallucinated = static_cast<bool>((bytes_2 & 0x00000002));
+  voxel->in_queue = static_cast<bool>((bytes_2 & 0x00000004));
+  voxel->fixed = static_cast<bool>((bytes_2 & 0x00000008));
+
+  setEsdfParent(deserializeDirection(bytes_2), voxel);
+}
+
+template <typename EsdfVoxelType>
+void serializeEsdfVoxel(const EsdfVoxelType& voxel,
+                        std::vector<uint32_t>* data) {
+  // Current Layout:
+  // | 32 bit sdf | 3x8bit (int8_t) parent | 8 bit flags|
+
+  const uint32_t* bytes_1_ptr =
+      reinterpret_cast<const uint32_t*>(&voxel.distance);
+  data->push_back(*bytes_1_ptr);
+
+  uint32_t bytes_2 = 0u;
+  serializeDirection(getEsdfParent(voxel), &bytes_2);
+
+  uint8_t flag_byte = 0b00000000;
+  flag_byte |= static_cast<uint8_t>(voxel.observed ? 0b00000001 : 0b00000000);
+  flag_byte |=
+      static_cast<uint8_t>(voxel.hallucinated ? 0b00000010 : 0b00000000);
+  flag_byte |= static_cast<uint8_t>(voxel.in_queue ? 0b00000100 : 0b00000000);
+  flag_byte |= static_cast<uint8_t>(voxel.fixed ? 0b00001000 : 0b00000000);
+
+  bytes_2 |= static_cast<uint32_t>(flag_byte) & 0x000000FF;
+
+  data->push_back(bytes_2);
+}
+
 // Deserialization functions:
 template <>
 void Block<TsdfVoxel>::deserializeFromIntegers(
@@ -71,22 +157,50 @@ void Block<TsdfVoxel>::deserializeFromIntegers(
   for (size_t voxel_idx = 0u, data_idx = 0u;
        voxel_idx < num_voxels_ && data_idx < num_data_packets;
        ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
-    const uint32_t bytes_1 = data[data_idx];
-    const uint32_t bytes_2 = data[data_idx + 1u];
-    const uint32_t bytes_3 = data[data_idx + 2u];
+    deserializeTsdfVoxel(&data[data_idx], voxels_[voxel_idx]);
+  }
+  recomputeObservedMask();
+}
 
-    TsdfVoxel& voxel = voxels_[voxel_idx];
+template <>
+void Block<TsdfVoxel, SoaVoxelStorage>::deserializeFromIntegers(
+    const std::vector<uint32_t>& data) {
+  constexpr size_t kNumDataPacketsPerVoxel = 3u;
+  const size_t num_data_packets = data.size();
+  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, num_data_packets);
+  for (size_t voxel_idx = 0u, data_idx = 0u;
+       voxel_idx < num_voxels_ && data_idx < num_data_packets;
+       ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
+    deserializeTsdfVoxel(&data[data_idx], voxels_[voxel_idx]);
+  }
+  recomputeObservedMask();
+}
 
-    // TODO(mfehr, helenol): find a better way to do this!
+template <>
+void Block<CompactTsdfVoxel>::deserializeFromIntegers(
+    const std::vector<uint32_t>& data) {
+  constexpr size_t kNumDataPacketsPerVoxel = 2u;
+  const size_t num_data_packets = data.size();
+  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, num_data_packets);
+  for (size_t voxel_idx = 0u, data_idx = 0u;
+       voxel_idx < num_voxels_ && data_idx < num_data_packets;
+       ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
+    const uint32_t bytes_1 = data[data_idx];
+    const uint32_t bytes_2 = data[data_idx + 1u];
 
-    memcpy(&(voxel.distance), &bytes_1, sizeof(bytes_1));
-    memcpy(&(voxel.weight), &bytes_2, sizeof(bytes_2));
+    CompactTsdfVoxel& voxel = voxels_[voxel_idx];
 
-    voxel.color.r = static_cast<uint8_t>(bytes_3 >> 24);
-    voxel.color.g = static_cast<uint8_t>((bytes_3 & 0x00FF0000) >> 16);
-    voxel.color.b = static_cast<uint8_t>((bytes_3 & 0x0000FF00) >> 8);
-    voxel.color.a = static_cast<uint8_t>(bytes_3 & 0x000000FF);
+    // Layout:
+    // | 16bit fixed point distance | 16bit half weight |
+    voxel.distance = static_cast<int16_t>(bytes_1 >> 16);
+    voxel.weight = static_cast<uint16_t>(bytes_1 & 0x0000FFFF);
+
+    voxel.color.r = static_cast<uint8_t>(bytes_2 >> 24);
+    voxel.color.g = static_cast<uint8_t>((bytes_2 & 0x00FF0000) >> 16);
+    voxel.color.b = static_cast<uint8_t>((bytes_2 & 0x0000FF00) >> 8);
+    voxel.color.a = static_cast<uint8_t>(bytes_2 & 0x000000FF);
   }
+  recomputeObservedMask();
 }
 
 template <>
@@ -106,6 +220,7 @@ void Block<OccupancyVoxel>::deserializeFromIntegers(
     memcpy(&(voxel.probability_log), &bytes_1, sizeof(bytes_1));
     voxel.observed = static_cast<bool>(bytes_2 & 0x000000FF);
   }
+  recomputeObservedMask();
 }
 
 template <>
@@ -117,23 +232,23 @@ void Block<EsdfVoxel>::deserializeFromIntegers(
   for (size_t voxel_idx = 0u, data_idx = 0u;
        voxel_idx < num_voxels_ && data_idx < num_data_packets;
        ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
-    // Layout:
-    // | 32 bit sdf | 3x8bit (int8_t) parent | 8 bit flags|
-
-    const uint32_t bytes_1 = data[data_idx];
-    const uint32_t bytes_2 = data[data_idx + 1u];
-
-    EsdfVoxel& voxel = voxels_[voxel_idx];
-
-    memcpy(&(voxel.distance), &bytes_1, sizeof(bytes_1));
-
-    voxel.observed = static_cast<bool>(bytes_2 & 0x00000001);
-    voxel.hallucinated = static_cast<bool>((bytes_2 & 0x00000002));
-    voxel.in_queue = static_cast<bool>((bytes_2 & 0x00000004));
-    voxel.fixed = static_cast<bool>((bytes_2 & 0x00000008));
+    deserializeEsdfVoxel(&data[data_idx], &voxels_[voxel_idx]);
+  }
+  recomputeObservedMask();
+}
 
-    voxel.parent = deserializeDirection(bytes_2);
+template <>
+void Block<CompactEsdfVoxel>::deserializeFromIntegers(
+    const std::vector<uint32_t>& data) {
+  constexpr size_t kNumDataPacketsPerVoxel = 2u;
+  const size_t num_data_packets = data.size();
+  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, num_data_packets);
+  for (size_t voxel_idx = 0u, data_idx = 0u;
+       voxel_idx < num_voxels_ && data_idx < num_data_packets;
+       ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
+    deserializeEsdfVoxel(&data[data_idx], &voxels_[voxel_idx]);
   }
+  recomputeObservedMask();
 }
 
 template <>
@@ -153,6 +268,7 @@ void Block<IntensityVoxel>::deserializeFromIntegers(
     memcpy(&(voxel.intensity), &bytes_1, sizeof(bytes_1));
     memcpy(&(voxel.weight), &bytes_2, sizeof(bytes_2));
   }
+  recomputeObservedMask();
 }
 
 // Serialization functions:
@@ -163,16 +279,39 @@ void Block<TsdfVoxel>::serializeToIntegers(std::vector<uint32_t>* data) const {
   data->clear();
   data->reserve(num_voxels_ * kNumDataPacketsPerVoxel);
   for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
-    const TsdfVoxel& voxel = voxels_[voxel_idx];
+    serializeTsdfVoxel(voxels_[voxel_idx], data);
+  }
+  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, data->size());
+}
 
-    // TODO(mfehr, helenol): find a better way to do this!
-    const uint32_t* bytes_1_ptr =
-        reinterpret_cast<const uint32_t*>(&voxel.distance);
-    data->push_back(*bytes_1_ptr);
+template <>
+void Block<TsdfVoxel, SoaVoxelStorage>::serializeToIntegers(
+    std::vector<uint32_t>* data) const {
+  CHECK_NOTNULL(data);
+  constexpr size_t kNumDataPacketsPerVoxel = 3u;
+  data->clear();
+  data->reserve(num_voxels_ * kNumDataPacketsPerVoxel);
+  for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
+    serializeTsdfVoxel(voxels_[voxel_idx], data);
+  }
+  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, data->size());
+}
 
-    const uint32_t* bytes_2_ptr =
-        reinterpret_cast<const uint32_t*>(&voxel.weight);
-    data->push_back(*bytes_2_ptr);
+template <>
+void Block<CompactTsdfVoxel>::serializeToIntegers(
+    std::vector<uint32_t>* data) const {
+  CHECK_NOTNULL(data);
+  constexpr size_t kNumDataPacketsPerVoxel = 2u;
+  data->clear();
+  data->reserve(num_voxels_ * kNumDataPacketsPerVoxel);
+  for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
+    const CompactTsdfVoxel& voxel = voxels_[voxel_idx];
+
+    // Layout:
+    // | 16bit fixed point distance | 16bit half weight |
+    data->push_back(
+        (static_cast<uint32_t>(static_cast<uint16_t>(voxel.distance)) << 16) |
+        static_cast<uint32_t>(voxel.weight));
 
     data->push_back(static_cast<uint32_t>(voxel.color.a) |
                     (static_cast<uint32_t>(voxel.color.b) << 8) |
@@ -207,28 +346,20 @@ void Block<EsdfVoxel>::serializeToIntegers(std::vector<uint32_t>* data) const {
   data->clear();
   data->reserve(num_voxels_ * kNumDataPacketsPerVoxel);
   for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
-    const EsdfVoxel& voxel = voxels_[voxel_idx];
-
-    // Current Layout:
-    // | 32 bit sdf | 3x8bit (int8_t) parent | 8 bit flags|
-
-    const uint32_t* bytes_1_ptr =
-        reinterpret_cast<const uint32_t*>(&voxel.distance);
-    data->push_back(*bytes_1_ptr);
-
-    uint32_t bytes_2 = 0u;
-    serializeDirection(voxel.parent, &bytes_2);
-
-    uint8_t flag_byte = 0b00000000;
-    flag_byte |= static_cast<uint8_t>(voxel.observed ? 0b00000001 : 0b00000000);
-    flag_byte |=
-        static_cast<uint8_t>(voxel.hallucinated ? 0b00000010 : 0b00000000);
-    flag_byte |= static_cast<uint8_t>(voxel.in_queue ? 0b00000100 : 0b00000000);
-    flag_byte |= static_cast<uint8_t>(voxel.fixed ? 0b00001000 : 0b00000000);
-
-    bytes_2 |= static_cast<uint32_t>(flag_byte) & 0x000000FF;
+    serializeEsdfVoxel(voxels_[voxel_idx], data);
+  }
+  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, data->size());
+}
 
-    data->push_back(bytes_2);
+template <>
+void Block<CompactEsdfVoxel>::serializeToIntegers(
+    std::vector<uint32_t>* data) const {
+  CHECK_NOTNULL(data);
+  constexpr size_t kNumDataPacketsPerVoxel = 2u;
+  data->clear();
+  data->reserve(num_voxels_ * kNumDataPacketsPerVoxel);
+  for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
+    serializeEsdfVoxel(voxels_[voxel_idx], data);
   }
   CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, data->size());
 }
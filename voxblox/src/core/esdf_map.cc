@@ -1,25 +1,35 @@
 #include "voxblox/core/esdf_map.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "voxblox/utils/distance_transform.h"
+#include "voxblox/utils/timing.h"
+
 namespace voxblox {
 
-bool EsdfMap::getDistanceAtPosition(const Eigen::Vector3d& position,
-                                    double* distance) const {
+template <typename EsdfVoxelType>
+bool EsdfMapBase<EsdfVoxelType>::getDistanceAtPosition(
+    const Eigen::Vector3d& position, double* distance) const {
   constexpr bool interpolate = true;
   return getDistanceAtPosition(position, interpolate, distance);
 }
 
-bool EsdfMap::getDistanceAtPosition(const Eigen::Vector3d& position,
-                                    bool interpolate, double* distance) const {
+template <typename EsdfVoxelType>
+bool EsdfMapBase<EsdfVoxelType>::getDistanceAtPosition(
+    const Eigen::Vector3d& position, bool interpolate, double* distance) const {
   FloatingPoint distance_fp;
   bool success = interpolator_.getDistance(position.cast<FloatingPoint>(),
                                            &distance_fp, interpolate);
   if (success) {
     *distance = static_cast<double>(distance_fp);
+    applyCoarseLevel(position, distance);
   }
   return success;
 }
 
-bool EsdfMap::getDistanceAndGradientAtPosition(
+template <typename EsdfVoxelType>
+bool EsdfMapBase<EsdfVoxelType>::getDistanceAndGradientAtPosition(
     const Eigen::Vector3d& position, double* distance,
     Eigen::Vector3d* gradient) const {
   constexpr bool interpolate = true;
@@ -27,7 +37,8 @@ bool EsdfMap::getDistanceAndGradientAtPosition(
                                           gradient);
 }
 
-bool EsdfMap::getDistanceAndGradientAtPosition(
+template <typename EsdfVoxelType>
+bool EsdfMapBase<EsdfVoxelType>::getDistanceAndGradientAtPosition(
     const Eigen::Vector3d& position, bool interpolate, double* distance,
     Eigen::Vector3d* gradient) const {
   FloatingPoint distance_fp = 0.0;
@@ -46,26 +57,154 @@ bool EsdfMap::getDistanceAndGradientAtPosition(
 
   *distance = static_cast<double>(distance_fp);
   *gradient = gradient_fp.cast<double>();
+  if (success) {
+    applyCoarseLevel(position, distance);
+  }
 
   return success;
 }
 
-bool EsdfMap::isObserved(const Eigen::Vector3d& position) const {
+template <typename EsdfVoxelType>
+bool EsdfMapBase<EsdfVoxelType>::isObserved(
+    const Eigen::Vector3d& position) const {
   // Get the block.
-  Block<EsdfVoxel>::Ptr block_ptr =
+  typename Block<EsdfVoxelType>::Ptr block_ptr =
       esdf_layer_->getBlockPtrByCoordinates(position.cast<FloatingPoint>());
   if (block_ptr) {
-    const EsdfVoxel& voxel =
+    const EsdfVoxelType& voxel =
         block_ptr->getVoxelByCoordinates(position.cast<FloatingPoint>());
     return voxel.observed;
   }
   return false;
 }
 
+template <typename EsdfVoxelType>
+bool EsdfMapBase<EsdfVoxelType>::getCoarseDistanceAtPosition(
+    const Eigen::Vector3d& position, double* distance) const {
+  CHECK_NOTNULL(distance);
+  if (!coarse_layer_) {
+    return false;
+  }
+  const Point point = position.cast<FloatingPoint>();
+  const Block<EsdfVoxel>::ConstPtr block_ptr =
+      coarse_layer_->getBlockPtrByCoordinates(point);
+  if (!block_ptr) {
+    return false;
+  }
+  const VoxelIndex voxel_index =
+      block_ptr->computeTruncatedVoxelIndexFromCoordinates(point);
+  const EsdfVoxel& voxel = block_ptr->getVoxelByVoxelIndex(voxel_index);
+  if (!voxel.observed) {
+    return false;
+  }
+
+  // The distance holds between the centers of the blocks, the position is
+  // somewhere in its block and the occupied voxel somewhere in the other one.
+  const FloatingPoint half_block_diagonal = 0.5 * std::sqrt(3.0) * block_size_;
+  const FloatingPoint offset =
+      (point - block_ptr->computeCoordinatesFromVoxelIndex(voxel_index)).norm();
+  *distance = static_cast<double>(
+      std::max(voxel.distance - offset - half_block_diagonal, 0.0f));
+  return true;
+}
+
+template <typename EsdfVoxelType>
+void EsdfMapBase<EsdfVoxelType>::applyCoarseLevel(
+    const Eigen::Vector3d& position, double* distance) const {
+  DCHECK(distance != nullptr);
+  double coarse_distance;
+  if (coarse_layer_ && *distance >= fine_max_distance_m_ &&
+      getCoarseDistanceAtPosition(position, &coarse_distance)) {
+    *distance = std::max(*distance, coarse_distance);
+  }
+}
+
+template <typename EsdfVoxelType>
+void EsdfMapBase<EsdfVoxelType>::updateCoarseLevel(
+    FloatingPoint fine_max_distance_m) {
+  CHECK(usesCoarseLevel());
+  timing::Timer coarse_timer("esdf/coarse_level");
+  fine_max_distance_m_ = fine_max_distance_m;
+  const size_t voxels_per_side = esdf_layer_->voxels_per_side();
+  if (coarse_layer_) {
+    coarse_layer_->removeAllBlocks();
+  } else {
+    coarse_layer_ = std::make_shared<Layer<EsdfVoxel>>(block_size_,
+                                                       voxels_per_side);
+  }
+
+  // Every observed block of the ESDF is a voxel of the coarse level, whose
+  // global index is the block index. The ones holding an occupied voxel are
+  // the sites of the distance transform.
+  const FloatingPoint voxels_per_side_inv =
+      1.0 / static_cast<FloatingPoint>(voxels_per_side);
+  const int margin = static_cast<int>(
+      std::ceil(coarse_max_distance_m_ / coarse_layer_->block_size()));
+  BlockDistanceTransform distance_transform(voxels_per_side);
+  BlockIndexList blocks;
+  esdf_layer_->getAllAllocatedBlocks(&blocks);
+  for (const BlockIndex& block_index : blocks) {
+    const Block<EsdfVoxelType>& block =
+        esdf_layer_->getBlockByIndex(block_index);
+    bool observed = false;
+    bool occupied = false;
+    for (size_t lin_index = 0u; lin_index < block.num_voxels(); ++lin_index) {
+      const EsdfVoxelType& voxel = block.getVoxelByLinearIndex(lin_index);
+      if (voxel.observed) {
+        observed = true;
+        if (voxel.distance <= 0.0f) {
+          occupied = true;
+          break;
+        }
+      }
+    }
+    if (!observed) {
+      continue;
+    }
+
+    const GlobalIndex coarse_index = block_index.cast<LongIndexElement>();
+    const BlockIndex coarse_block_index =
+        getBlockIndexFromGlobalVoxelIndex(coarse_index, voxels_per_side_inv);
+    if (!coarse_layer_->hasBlock(coarse_block_index)) {
+      distance_transform.addBlock(coarse_block_index, margin);
+    }
+    coarse_layer_->allocateBlockPtrByIndex(coarse_block_index)
+        ->getVoxelByVoxelIndex(
+            getLocalFromGlobalVoxelIndex(coarse_index, voxels_per_side))
+        .observed = true;
+    if (occupied) {
+      distance_transform.addSite(coarse_index, 0);
+    }
+  }
+  distance_transform.compute();
+
+  BlockIndexList coarse_blocks;
+  coarse_layer_->getAllAllocatedBlocks(&coarse_blocks);
+  const FloatingPoint coarse_voxel_size = coarse_layer_->voxel_size();
+  for (const BlockIndex& coarse_block_index : coarse_blocks) {
+    Block<EsdfVoxel>& coarse_block =
+        coarse_layer_->getBlockByIndex(coarse_block_index);
+    for (size_t lin_index = 0u; lin_index < coarse_block.num_voxels();
+         ++lin_index) {
+      EsdfVoxel& coarse_voxel = coarse_block.getVoxelByLinearIndex(lin_index);
+      if (!coarse_voxel.observed) {
+        continue;
+      }
+      float squared_distance;
+      distance_transform.getClosestSite(coarse_block_index, lin_index,
+                                        &squared_distance);
+      coarse_voxel.distance =
+          std::min(std::sqrt(squared_distance) * coarse_voxel_size,
+                   coarse_max_distance_m_);
+    }
+  }
+}
+
 // NOTE(mereweth@jpl.nasa.gov) - this function is a convenience function for
 // Python bindings. std::exceptions are bound to Python exceptions by pybind11,
 // allowing them to be handled in Python code idiomatically.
-void EsdfMap::batchGetDistanceAtPosition(
+template <typename EsdfVoxelType>
+void EsdfMapBase<EsdfVoxelType>::batchGetDistanceAtPosition(
     EigenDRef<const Eigen::Matrix<double, 3, Eigen::Dynamic>>& positions,
     Eigen::Ref<Eigen::VectorXd> distances,
     Eigen::Ref<Eigen::VectorXi> observed) const {
@@ -85,7 +224,8 @@ void EsdfMap::batchGetDistanceAtPosition(
 // NOTE(mereweth@jpl.nasa.gov) - this function is a convenience function for
 // Python bindings. std::exceptions are bound to Python exceptions by pybind11,
 // allowing them to be handled in Python code idiomatically.
-void EsdfMap::batchGetDistanceAndGradientAtPosition(
+template <typename EsdfVoxelType>
+void EsdfMapBase<EsdfVoxelType>::batchGetDistanceAndGradientAtPosition(
     EigenDRef<const Eigen::Matrix<double, 3, Eigen::Dynamic>>& positions,
     Eigen::Ref<Eigen::VectorXd> distances,
     EigenDRef<Eigen::Matrix<double, 3, Eigen::Dynamic>>& gradients,
@@ -114,7 +254,8 @@ void EsdfMap::batchGetDistanceAndGradientAtPosition(
 // NOTE(mereweth@jpl.nasa.gov) - this function is a convenience function for
 // Python bindings. std::exceptions are bound to Python exceptions by pybind11,
 // allowing them to be handled in Python code idiomatically.
-void EsdfMap::batchIsObserved(
+template <typename EsdfVoxelType>
+void EsdfMapBase<EsdfVoxelType>::batchIsObserved(
     EigenDRef<const Eigen::Matrix<double, 3, Eigen::Dynamic>>& positions,
     Eigen::Ref<Eigen::VectorXi> observed) const {
   if (observed.size() < positions.cols()) {
@@ -126,7 +267,8 @@ void EsdfMap::batchIsObserved(
   }
 }
 
-unsigned int EsdfMap::coordPlaneSliceGetDistance(
+template <typename EsdfVoxelType>
+unsigned int EsdfMapBase<EsdfVoxelType>::coordPlaneSliceGetDistance(
     unsigned int free_plane_index, double free_plane_val,
     EigenDRef<Eigen::Matrix<double, 3, Eigen::Dynamic>>& positions,
     Eigen::Ref<Eigen::VectorXd> distances, unsigned int max_points) const {
@@ -145,7 +287,7 @@ unsigned int EsdfMap::coordPlaneSliceGetDistance(
   // Layer This extra bookeeping will make this much faster
   for (const BlockIndex& index : blocks) {
     // Iterate over all voxels in said blocks.
-    const Block<EsdfVoxel>& block = esdf_layer_->getBlockByIndex(index);
+    const Block<EsdfVoxelType>& block = esdf_layer_->getBlockByIndex(index);
 
     Point origin = block.origin();
     if (std::abs(origin(free_plane_index) - free_plane_val) >
@@ -156,7 +298,7 @@ unsigned int EsdfMap::coordPlaneSliceGetDistance(
     for (size_t linear_index = 0; linear_index < num_voxels_per_block;
          ++linear_index) {
       Point coord = block.computeCoordinatesFromLinearIndex(linear_index);
-      const EsdfVoxel& voxel = block.getVoxelByLinearIndex(linear_index);
+      const EsdfVoxelType& voxel = block.getVoxelByLinearIndex(linear_index);
       if (std::abs(coord(free_plane_index) - free_plane_val) <=
           block.voxel_size()) {
         double distance;
@@ -193,4 +335,7 @@ unsigned int EsdfMap::coordPlaneSliceGetDistance(
   return count;
 }
 
+template class EsdfMapBase<EsdfVoxel>;
+template class EsdfMapBase<CompactEsdfVoxel>;
+
 }  // namespace voxblox
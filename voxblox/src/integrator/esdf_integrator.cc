@@ -1,28 +1,45 @@
 #include "voxblox/integrator/esdf_integrator.h"
 
 #include "voxblox/utils/planning_utils.h"
+#include "voxblox/utils/voxel_utils.h"
 
 namespace voxblox {
 
-EsdfIntegrator::EsdfIntegrator(const Config& config,
-                               Layer<TsdfVoxel>* tsdf_layer,
-                               Layer<EsdfVoxel>* esdf_layer)
-    : config_(config), tsdf_layer_(tsdf_layer), esdf_layer_(esdf_layer) {
+template <typename EsdfVoxelType>
+EsdfIntegratorBase<EsdfVoxelType>::EsdfIntegratorBase(
+    const Config& config, Layer<TsdfVoxel>* tsdf_layer, EsdfLayer* esdf_layer)
+    : EsdfIntegratorBase(config, esdf_layer) {
+  tsdf_layer_ = tsdf_layer;
   CHECK(tsdf_layer_);
+
+  CHECK_EQ(esdf_layer_->voxels_per_side(), tsdf_layer_->voxels_per_side());
+  CHECK_NEAR(esdf_layer_->voxel_size(), tsdf_layer_->voxel_size(), 1e-6);
+}
+
+template <typename EsdfVoxelType>
+EsdfIntegratorBase<EsdfVoxelType>::EsdfIntegratorBase(const Config& config,
+                                                      EsdfLayer* esdf_layer)
+    : config_(config),
+      tsdf_layer_(nullptr),
+      esdf_layer_(esdf_layer),
+      distance_transform_(CHECK_NOTNULL(esdf_layer)->voxels_per_side()) {
   CHECK(esdf_layer_);
 
   voxels_per_side_ = esdf_layer_->voxels_per_side();
+  voxels_per_side_inv_ = 1.0 / voxels_per_side_;
   voxel_size_ = esdf_layer_->voxel_size();
 
-  CHECK_EQ(esdf_layer_->voxels_per_side(), tsdf_layer_->voxels_per_side());
-  CHECK_NEAR(esdf_layer_->voxel_size(), tsdf_layer_->voxel_size(), 1e-6);
+  CHECK_GT(config_.propagation_threads, 0u);
 
   open_.setNumBuckets(config_.num_buckets, config_.max_distance_m);
+  open_.setDecreaseKey(config_.decrease_key_queue);
 }
 
 // Used for planning - allocates sphere around as observed but occupied,
 // and clears space in a sphere around current position.
-void EsdfIntegrator::addNewRobotPosition(const Point& position) {
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::addNewRobotPosition(
+    const Point& position) {
   timing::Timer clear_timer("esdf/clear_radius");
 
   // First set all in inner sphere to free.
@@ -33,13 +50,14 @@ void EsdfIntegrator::addNewRobotPosition(const Point& position) {
   sphere_timer.Stop();
   for (const std::pair<BlockIndex, VoxelIndexList>& kv : block_voxel_list) {
     // Get block.
-    Block<EsdfVoxel>::Ptr block_ptr = esdf_layer_->getBlockPtrByIndex(kv.first);
+    typename Block<EsdfVoxelType>::Ptr block_ptr =
+        esdf_layer_->getBlockPtrByIndex(kv.first);
 
     for (const VoxelIndex& voxel_index : kv.second) {
       if (!block_ptr->isValidVoxelIndex(voxel_index)) {
         continue;
       }
-      EsdfVoxel& esdf_voxel = block_ptr->getVoxelByVoxelIndex(voxel_index);
+      EsdfVoxelType& esdf_voxel = block_ptr->getVoxelByVoxelIndex(voxel_index);
       // We can clear unobserved or hallucinated voxels.
       if (!esdf_voxel.observed || esdf_voxel.hallucinated) {
         if (esdf_voxel.hallucinated) {
@@ -65,13 +83,14 @@ void EsdfIntegrator::addNewRobotPosition(const Point& position) {
   outer_sphere_timer.Stop();
   for (const std::pair<BlockIndex, VoxelIndexList>& kv : block_voxel_list_occ) {
     // Get block.
-    Block<EsdfVoxel>::Ptr block_ptr = esdf_layer_->getBlockPtrByIndex(kv.first);
+    typename Block<EsdfVoxelType>::Ptr block_ptr =
+        esdf_layer_->getBlockPtrByIndex(kv.first);
 
     for (const VoxelIndex& voxel_index : kv.second) {
       if (!block_ptr->isValidVoxelIndex(voxel_index)) {
         continue;
       }
-      EsdfVoxel& esdf_voxel = block_ptr->getVoxelByVoxelIndex(voxel_index);
+      EsdfVoxelType& esdf_voxel = block_ptr->getVoxelByVoxelIndex(voxel_index);
       if (!esdf_voxel.observed) {
         esdf_voxel.distance = -config_.default_distance_m;
         esdf_voxel.observed = true;
@@ -91,7 +110,75 @@ void EsdfIntegrator::addNewRobotPosition(const Point& position) {
   clear_timer.Stop();
 }
 
-void EsdfIntegrator::updateFromTsdfLayerBatch() {
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::setRollingWindowCenter(
+    const Point& position) {
+  CHECK(hasRollingWindow());
+  const BlockIndex window_min =
+      esdf_layer_->computeBlockIndexFromCoordinates(position) -
+      BlockIndex::Constant(config_.rolling_window_blocks / 2);
+  if (rolling_window_set_ && window_min == rolling_window_min_) {
+    return;
+  }
+  timing::Timer window_timer("esdf/rolling_window");
+
+  const bool had_window = rolling_window_set_;
+  const BlockIndex old_window_min = rolling_window_min_;
+  rolling_window_set_ = true;
+  rolling_window_min_ = window_min;
+
+  auto evict_block = [this](const BlockIndex& block_index) {
+    if (!isInRollingWindow(block_index) && esdf_layer_->hasBlock(block_index)) {
+      esdf_layer_->removeBlock(block_index);
+      updated_blocks_.erase(block_index);
+    }
+  };
+  auto for_each_block_in_window =
+      [this](const BlockIndex& min,
+             const std::function<void(const BlockIndex&)>& function) {
+    BlockIndex block_index;
+    for (block_index.x() = min.x();
+         block_index.x() < min.x() + config_.rolling_window_blocks;
+         ++block_index.x()) {
+      for (block_index.y() = min.y();
+           block_index.y() < min.y() + config_.rolling_window_blocks;
+           ++block_index.y()) {
+        for (block_index.z() = min.z();
+             block_index.z() < min.z() + config_.rolling_window_blocks;
+             ++block_index.z()) {
+          function(block_index);
+        }
+      }
+    }
+  };
+
+  if (had_window) {
+    for_each_block_in_window(old_window_min, evict_block);
+  } else {
+    BlockIndexList esdf_blocks;
+    esdf_layer_->getAllAllocatedBlocks(&esdf_blocks);
+    for (const BlockIndex& block_index : esdf_blocks) {
+      evict_block(block_index);
+    }
+  }
+
+  // The blocks that entered the window are propagated like the ones changed
+  // by addNewRobotPosition, all of their TSDF voxels are read again.
+  if (tsdf_layer_ == nullptr) {
+    return;
+  }
+  for_each_block_in_window(window_min, [&](const BlockIndex& block_index) {
+    const bool entered = had_window ? !isInWindow(old_window_min, block_index)
+                                    : !esdf_layer_->hasBlock(block_index);
+    if (entered && tsdf_layer_->hasBlock(block_index)) {
+      updated_blocks_.insert(block_index);
+    }
+  });
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::updateFromTsdfLayerBatch() {
+  CHECK(tsdf_layer_ != nullptr);
   esdf_layer_->removeAllBlocks();
   BlockIndexList tsdf_blocks;
   tsdf_layer_->getAllAllocatedBlocks(&tsdf_blocks);
@@ -101,222 +188,362 @@ void EsdfIntegrator::updateFromTsdfLayerBatch() {
   updateFromTsdfBlocks(tsdf_blocks);
 }
 
-void EsdfIntegrator::updateFromTsdfLayer(bool clear_updated_flag) {
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::updateFromTsdfLayer(
+    bool clear_updated_flag) {
+  CHECK(tsdf_layer_ != nullptr);
+  if (isUpdateTimeLimited()) {
+    updateFromTsdfLayerTimeLimited(clear_updated_flag);
+    return;
+  }
   BlockIndexList tsdf_blocks;
-  tsdf_layer_->getAllUpdatedBlocks(Update::kEsdf, &tsdf_blocks);
-  tsdf_blocks.insert(tsdf_blocks.end(), updated_blocks_.begin(),
-                     updated_blocks_.end());
-  updated_blocks_.clear();
+  getUpdatedBlocks(&tsdf_blocks);
   const bool kIncremental = true;
   updateFromTsdfBlocks(tsdf_blocks, kIncremental);
 
   if (clear_updated_flag) {
-    for (const BlockIndex& block_index : tsdf_blocks) {
-      if (tsdf_layer_->hasBlock(block_index)) {
-        tsdf_layer_->getBlockByIndex(block_index)
-            .updated()
-            .reset(Update::kEsdf);
-      }
+    clearUpdatedFlags(tsdf_blocks);
+  }
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::getUpdatedBlocks(
+    BlockIndexList* tsdf_blocks) {
+  CHECK_NOTNULL(tsdf_blocks);
+  tsdf_layer_->getAllUpdatedBlocks(Update::kEsdf, tsdf_blocks);
+  // The ESDF voxels of these blocks changed without their TSDF voxels, so all
+  // of them are propagated again.
+  for (const BlockIndex& block_index : updated_blocks_) {
+    if (tsdf_layer_->hasBlock(block_index)) {
+      tsdf_layer_->getBlockByIndex(block_index)
+          .markAllVoxelsDirty(Update::kEsdf);
     }
   }
+  tsdf_blocks->insert(tsdf_blocks->end(), updated_blocks_.begin(),
+                      updated_blocks_.end());
+  updated_blocks_.clear();
 }
 
-void EsdfIntegrator::updateFromTsdfBlocks(const BlockIndexList& tsdf_blocks,
-                                          bool incremental) {
-  CHECK_EQ(tsdf_layer_->voxels_per_side(), esdf_layer_->voxels_per_side());
-  timing::Timer esdf_timer("esdf");
-
-  // Go through all blocks in TSDF and copy their values for relevant voxels.
-  size_t num_lower = 0u;
-  size_t num_raise = 0u;
-  size_t num_new = 0u;
-  timing::Timer propagate_timer("esdf/propagate_tsdf");
-  VLOG(3) << "[ESDF update]: Propagating " << tsdf_blocks.size()
-          << " updated blocks from the TSDF.";
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::clearUpdatedFlags(
+    const BlockIndexList& tsdf_blocks) {
   for (const BlockIndex& block_index : tsdf_blocks) {
-    Block<TsdfVoxel>::ConstPtr tsdf_block =
-        tsdf_layer_->getBlockPtrByIndex(block_index);
-    if (!tsdf_block) {
-      continue;
+    if (tsdf_layer_->hasBlock(block_index)) {
+      Block<TsdfVoxel>& tsdf_block = tsdf_layer_->getBlockByIndex(block_index);
+      tsdf_block.updated().reset(Update::kEsdf);
+      tsdf_block.clearDirtyVoxels(Update::kEsdf);
     }
+  }
+}
 
-    // Allocate the same block in the ESDF layer.
-    // Block indices are the same across all layers.
-    Block<EsdfVoxel>::Ptr esdf_block =
-        esdf_layer_->allocateBlockPtrByIndex(block_index);
-    esdf_block->set_updated(true);
-
-    const size_t num_voxels_per_block = tsdf_block->num_voxels();
-    for (size_t lin_index = 0u; lin_index < num_voxels_per_block; ++lin_index) {
-      const TsdfVoxel& tsdf_voxel =
-          tsdf_block->getVoxelByLinearIndex(lin_index);
-      // If this voxel is unobserved in the original map, skip it.
-      if (tsdf_voxel.weight < config_.min_weight) {
-        if (!incremental && config_.add_occupied_crust) {
-          // Create a little crust of occupied voxels around.
-          EsdfVoxel& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
-          esdf_voxel.distance = -config_.default_distance_m;
-          esdf_voxel.observed = true;
-          esdf_voxel.hallucinated = true;
-          esdf_voxel.fixed = false;
-        }
-        continue;
-      }
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::updateFromTsdfLayerTimeLimited(
+    bool clear_updated_flag) {
+  timing::Timer time_limited_timer("esdf/time_limited");
+  update_start_time_ = std::chrono::steady_clock::now();
+  limit_update_time_ = true;
 
-      EsdfVoxel& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
-      VoxelIndex voxel_index =
-          esdf_block->computeVoxelIndexFromLinearIndex(lin_index);
-      GlobalIndex global_index = getGlobalVoxelIndexFromBlockAndVoxelIndex(
-          block_index, voxel_index, voxels_per_side_);
+  // Finish what the last update left in the raise and open sets first.
+  processRaiseSet();
+  processOpenSet();
 
-      const bool tsdf_fixed = isFixed(tsdf_voxel.distance);
-      // If there was nothing there before:
-      if (!esdf_voxel.observed || esdf_voxel.hallucinated) {
-        if (esdf_voxel.hallucinated) {
-          raise_.push(global_index);
-        }
-        if (tsdf_fixed) {
-          // In fixed band, just add and lock it.
-          esdf_voxel.distance = tsdf_voxel.distance;
-          esdf_voxel.fixed = true;
-          // Also add it to open so it can update the neighbors.
+  // Closest blocks to the priority center first.
+  BlockIndexList tsdf_blocks;
+  getUpdatedBlocks(&tsdf_blocks);
+  const FloatingPoint block_size = esdf_layer_->block_size();
+  std::vector<std::pair<FloatingPoint, size_t>> block_distances;
+  block_distances.reserve(tsdf_blocks.size());
+  for (size_t i = 0u; i < tsdf_blocks.size(); ++i) {
+    block_distances.emplace_back(
+        (getCenterPointFromGridIndex(tsdf_blocks[i], block_size) -
+         update_priority_center_)
+            .norm(),
+        i);
+  }
+  std::sort(block_distances.begin(), block_distances.end());
+
+  // Propagates rings of blocks one block wide, and at least the first one so
+  // every update makes progress.
+  const bool kIncremental = true;
+  size_t num_propagated_blocks = 0u;
+  BlockIndexList ring_blocks;
+  while (num_propagated_blocks < block_distances.size() &&
+         (num_propagated_blocks == 0u || isUpdateTimeLeft())) {
+    const FloatingPoint ring_end =
+        block_distances[num_propagated_blocks].first + block_size;
+    ring_blocks.clear();
+    while (num_propagated_blocks < block_distances.size() &&
+           block_distances[num_propagated_blocks].first < ring_end) {
+      ring_blocks.push_back(
+          tsdf_blocks[block_distances[num_propagated_blocks].second]);
+      ++num_propagated_blocks;
+    }
+    updateFromTsdfBlocks(ring_blocks, kIncremental);
+    if (clear_updated_flag) {
+      clearUpdatedFlags(ring_blocks);
+    }
+  }
+
+  // The blocks left whose TSDF is not flagged as updated are carried over.
+  num_backlog_blocks_ = block_distances.size() - num_propagated_blocks;
+  for (size_t i = num_propagated_blocks; i < block_distances.size(); ++i) {
+    const BlockIndex& block_index = tsdf_blocks[block_distances[i].second];
+    if (!tsdf_layer_->hasBlock(block_index) ||
+        !tsdf_layer_->getBlockByIndex(block_index)
+             .updated()
+             .test(Update::kEsdf)) {
+      updated_blocks_.insert(block_index);
+    }
+  }
+  limit_update_time_ = false;
+  time_limited_timer.Stop();
+  VLOG(3) << "[ESDF update]: propagated " << num_propagated_blocks
+          << " blocks, left " << num_backlog_blocks_ << " blocks and "
+          << raise_.size() + open_.size() << " queued voxels.";
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::updateFromTsdfBlocks(
+    const BlockIndexList& tsdf_blocks, bool incremental) {
+  CHECK(tsdf_layer_ != nullptr)
+      << "No TSDF layer set, pass the TSDF layer explicitly.";
+  updateFromTsdfBlocks(*tsdf_layer_, tsdf_blocks, incremental);
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::updateFromTsdfBlocks(
+    const Layer<CompactTsdfVoxel>& tsdf_layer,
+    FloatingPoint truncation_distance, const BlockIndexList& tsdf_blocks,
+    bool incremental) {
+  updateFromTsdfBlocksImpl(
+      tsdf_layer, tsdf_blocks, incremental,
+      [truncation_distance](const CompactTsdfVoxel& voxel, float* distance,
+                            float* weight) {
+        *distance = getCompactTsdfDistance(voxel, truncation_distance);
+        *weight = getCompactTsdfWeight(voxel);
+      });
+}
+
+template <typename EsdfVoxelType>
+typename EsdfIntegratorBase<EsdfVoxelType>::TsdfPropagation
+EsdfIntegratorBase<EsdfVoxelType>::propagateTsdfVoxel(
+    const BlockIndex& block_index, size_t lin_index, float tsdf_distance,
+    float tsdf_weight, bool incremental, Block<EsdfVoxelType>* esdf_block) {
+  DCHECK(esdf_block != nullptr);
+  // If this voxel is unobserved in the original map, skip it.
+  if (tsdf_weight < config_.min_weight) {
+    if (!incremental && config_.add_occupied_crust) {
+      // Create a little crust of occupied voxels around.
+      EsdfVoxelType& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
+      esdf_voxel.distance = -config_.default_distance_m;
+      esdf_voxel.observed = true;
+      esdf_voxel.hallucinated = true;
+      esdf_voxel.fixed = false;
+    }
+    return TsdfPropagation::kNone;
+  }
+
+  EsdfVoxelType& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
+  VoxelIndex voxel_index =
+      esdf_block->computeVoxelIndexFromLinearIndex(lin_index);
+  GlobalIndex global_index = getGlobalVoxelIndexFromBlockAndVoxelIndex(
+      block_index, voxel_index, voxels_per_side_);
+
+  const bool tsdf_fixed = isFixed(tsdf_distance);
+  TsdfPropagation propagation = TsdfPropagation::kNone;
+  // If there was nothing there before:
+  if (!esdf_voxel.observed || esdf_voxel.hallucinated) {
+    if (esdf_voxel.hallucinated) {
+      raise_.push(global_index);
+    }
+    if (tsdf_fixed) {
+      // In fixed band, just add and lock it.
+      esdf_voxel.distance = tsdf_distance;
+      esdf_voxel.fixed = true;
+      // Also add it to open so it can update the neighbors.
+      esdf_voxel.in_queue = true;
+      open_.push(global_index, esdf_voxel.distance);
+    } else {
+      // Not in the fixed band. Just copy the sign.
+      esdf_voxel.distance =
+          signum(tsdf_distance) * (config_.default_distance_m);
+      esdf_voxel.fixed = false;
+
+      if (incremental) {
+        if (updateVoxelFromNeighbors(global_index)) {
           esdf_voxel.in_queue = true;
           open_.push(global_index, esdf_voxel.distance);
+        }
+      }
+    }
+    // No matter what, basically, the parent is reset.
+    esdf_voxel.parent.setZero();
+    propagation = TsdfPropagation::kNew;
+  } else {
+    // If this voxel DID exist before.
+    // There are three main options:
+    // (1a) unfix: if was fixed before but not anymore, raise.
+    // (1) lower: esdf or tsdf is fixed, and tsdf is closer to surface than
+    // it used to be.
+    // (2) raise: esdf or tsdf is fixed, and tsdf is further from surface
+    // than it used to be.
+    // (3) sign flip: tsdf and esdf have different signs, otherwise the
+    // lower and raise rules apply as above.
+    if (tsdf_fixed || esdf_voxel.fixed) {
+      if (!tsdf_fixed) {
+        // New case: have to raise the voxel
+        esdf_voxel.distance =
+            signum(tsdf_distance) * config_.default_distance_m;
+        esdf_voxel.parent.setZero();
+        esdf_voxel.fixed = false;
+        raise_.push(global_index);
+        esdf_voxel.in_queue = true;
+        open_.push(global_index, esdf_voxel.distance);
+        propagation = TsdfPropagation::kRaise;
+      } else if ((esdf_voxel.distance > 0.0f &&
+                  tsdf_distance + config_.min_diff_m <
+                      esdf_voxel.distance) ||
+                 (esdf_voxel.distance <= 0.0f &&
+                  tsdf_distance - config_.min_diff_m >
+                      esdf_voxel.distance)) {
+        // Lower.
+        esdf_voxel.fixed = tsdf_fixed;
+        if (esdf_voxel.fixed) {
+          esdf_voxel.distance = tsdf_distance;
         } else {
-          // Not in the fixed band. Just copy the sign.
           esdf_voxel.distance =
-              signum(tsdf_voxel.distance) * (config_.default_distance_m);
-          esdf_voxel.fixed = false;
-
-          if (incremental) {
-            if (updateVoxelFromNeighbors(global_index)) {
-              esdf_voxel.in_queue = true;
-              open_.push(global_index, esdf_voxel.distance);
-            }
-          }
+              signum(tsdf_distance) * config_.default_distance_m;
         }
-        // No matter what, basically, the parent is reset.
         esdf_voxel.parent.setZero();
-        num_new++;
-      } else {
-        // If this voxel DID exist before.
-        // There are three main options:
-        // (1a) unfix: if was fixed before but not anymore, raise.
-        // (1) lower: esdf or tsdf is fixed, and tsdf is closer to surface than
-        // it used to be.
-        // (2) raise: esdf or tsdf is fixed, and tsdf is further from surface
-        // than it used to be.
-        // (3) sign flip: tsdf and esdf have different signs, otherwise the
-        // lower and raise rules apply as above.
-        if (tsdf_fixed || esdf_voxel.fixed) {
-          if (!tsdf_fixed) {
-            // New case: have to raise the voxel
-            esdf_voxel.distance =
-                signum(tsdf_voxel.distance) * config_.default_distance_m;
-            esdf_voxel.parent.setZero();
-            esdf_voxel.fixed = false;
-            raise_.push(global_index);
-            esdf_voxel.in_queue = true;
-            open_.push(global_index, esdf_voxel.distance);
-            num_raise++;
-          } else if ((esdf_voxel.distance > 0.0f &&
-                      tsdf_voxel.distance + config_.min_diff_m <
-                          esdf_voxel.distance) ||
-                     (esdf_voxel.distance <= 0.0f &&
-                      tsdf_voxel.distance - config_.min_diff_m >
-                          esdf_voxel.distance)) {
-            // Lower.
-            esdf_voxel.fixed = tsdf_fixed;
-            if (esdf_voxel.fixed) {
-              esdf_voxel.distance = tsdf_voxel.distance;
-            } else {
-              esdf_voxel.distance =
-                  signum(tsdf_voxel.distance) * config_.default_distance_m;
-            }
-            esdf_voxel.parent.setZero();
-            esdf_voxel.in_queue = true;
-            open_.push(global_index, esdf_voxel.distance);
-            num_lower++;
-          } else if ((esdf_voxel.distance > 0.0f &&
-                      tsdf_voxel.distance - config_.min_diff_m >
-                          esdf_voxel.distance) ||
-                     (esdf_voxel.distance <= 0.0f &&
-                      tsdf_voxel.distance + config_.min_diff_m <
-                          esdf_voxel.distance)) {
-            // Raise.
-            esdf_voxel.fixed = tsdf_fixed;
-            if (esdf_voxel.fixed) {
-              esdf_voxel.distance = tsdf_voxel.distance;
-            } else {
-              esdf_voxel.distance =
-                  signum(tsdf_voxel.distance) * config_.default_distance_m;
-            }
-            esdf_voxel.parent.setZero();
-            raise_.push(global_index);
-            esdf_voxel.in_queue = true;
-            open_.push(global_index, esdf_voxel.distance);
-            num_raise++;
-          }
-        } else if (signum(tsdf_voxel.distance) != signum(esdf_voxel.distance)) {
-          // This means ESDF was positive and TSDF is negative.
-          // So lower.
-          if (tsdf_voxel.distance < esdf_voxel.distance) {
-            esdf_voxel.distance =
-                signum(tsdf_voxel.distance) * config_.default_distance_m;
-            esdf_voxel.parent.setZero();
-            esdf_voxel.in_queue = true;
-            open_.push(global_index, esdf_voxel.distance);
-            num_lower++;
-          } else {
-            // Otherwise ESDF was negative and TSDF is positive.
-            // So raise.
-            esdf_voxel.distance =
-                signum(tsdf_voxel.distance) * config_.default_distance_m;
-            esdf_voxel.parent.setZero();
-            raise_.push(global_index);
-            num_raise++;
-          }
+        esdf_voxel.in_queue = true;
+        open_.push(global_index, esdf_voxel.distance);
+        propagation = TsdfPropagation::kLower;
+      } else if ((esdf_voxel.distance > 0.0f &&
+                  tsdf_distance - config_.min_diff_m >
+                      esdf_voxel.distance) ||
+                 (esdf_voxel.distance <= 0.0f &&
+                  tsdf_distance + config_.min_diff_m <
+                      esdf_voxel.distance)) {
+        // Raise.
+        esdf_voxel.fixed = tsdf_fixed;
+        if (esdf_voxel.fixed) {
+          esdf_voxel.distance = tsdf_distance;
+        } else {
+          esdf_voxel.distance =
+              signum(tsdf_distance) * config_.default_distance_m;
         }
-        // Otherwise we just don't care. Not fixed voxels that match the right
-        // sign can be whatever value that they want to be.
+        esdf_voxel.parent.setZero();
+        raise_.push(global_index);
+        esdf_voxel.in_queue = true;
+        open_.push(global_index, esdf_voxel.distance);
+        propagation = TsdfPropagation::kRaise;
+      } else if (!esdf_voxel.fixed) {
+        // Newly fixed within min_diff_m of its propagated distance. Fixing it
+        // anyway keeps the fixed voxels independent of the propagation order,
+        // which differs between serial and parallel propagation.
+        esdf_voxel.fixed = true;
+        esdf_voxel.distance = tsdf_distance;
+        esdf_voxel.parent.setZero();
+        esdf_voxel.in_queue = true;
+        open_.push(global_index, esdf_voxel.distance);
+        propagation = TsdfPropagation::kLower;
+      }
+    } else if (signum(tsdf_distance) != signum(esdf_voxel.distance)) {
+      // This means ESDF was positive and TSDF is negative.
+      // So lower.
+      if (tsdf_distance < esdf_voxel.distance) {
+        esdf_voxel.distance =
+            signum(tsdf_distance) * config_.default_distance_m;
+        esdf_voxel.parent.setZero();
+        esdf_voxel.in_queue = true;
+        open_.push(global_index, esdf_voxel.distance);
+        propagation = TsdfPropagation::kLower;
+      } else {
+        // Otherwise ESDF was negative and TSDF is positive.
+        // So raise.
+        esdf_voxel.distance =
+            signum(tsdf_distance) * config_.default_distance_m;
+        esdf_voxel.parent.setZero();
+        raise_.push(global_index);
+        propagation = TsdfPropagation::kRaise;
       }
-
-      esdf_voxel.observed = true;
-      esdf_voxel.hallucinated = false;
     }
+    // Otherwise we just don't care. Not fixed voxels that match the right
+    // sign can be whatever value that they want to be.
   }
 
-  propagate_timer.Stop();
-  VLOG(3) << "[ESDF update]: Lower: " << num_lower << " Raise: " << num_raise
-          << " New: " << num_new;
-
-  timing::Timer raise_timer("esdf/raise_esdf");
-  processRaiseSet();
-  raise_timer.Stop();
-
-  timing::Timer update_timer("esdf/update_esdf");
-  processOpenSet();
-  update_timer.Stop();
+  esdf_voxel.observed = true;
+  esdf_voxel.hallucinated = false;
+  return propagation;
+}
 
-  esdf_timer.Stop();
+template <typename EsdfVoxelType>
+typename EsdfIntegratorBase<EsdfVoxelType>::RaiseAction
+EsdfIntegratorBase<EsdfVoxelType>::raiseNeighbor(
+    const SignedIndex& direction, EsdfVoxelType* neighbor_voxel) const {
+  DCHECK(neighbor_voxel != nullptr);
+  // Don't touch unobserved voxels and can't do anything with fixed
+  // voxels.
+  if (!neighbor_voxel->observed || neighbor_voxel->fixed) {
+    return RaiseAction::kNone;
+  }
+  const SignedIndex neighbor_parent = getEsdfParent(*neighbor_voxel);
+  bool is_neighbors_parent = (neighbor_parent == -direction);
+  if (config_.full_euclidean_distance) {
+    Point voxel_parent_direction =
+        neighbor_parent.cast<FloatingPoint>().normalized();
+    voxel_parent_direction = Point(std::round(voxel_parent_direction.x()),
+                                   std::round(voxel_parent_direction.y()),
+                                   std::round(voxel_parent_direction.z()));
+    is_neighbors_parent = (voxel_parent_direction.cast<int>() == -direction);
+  }
+  // This will never update fixed voxels as they are their own parents.
+  if (is_neighbors_parent) {
+    // This is the case where we are the parent of this one, so we
+    // should clear it and raise it.
+    neighbor_voxel->distance =
+        signum(neighbor_voxel->distance) * config_.default_distance_m;
+    neighbor_voxel->parent.setZero();
+    return RaiseAction::kRaise;
+  }
+  // If it's not in the queue, then add it to open so it can update
+  // our weights back.
+  if (!neighbor_voxel->in_queue) {
+    neighbor_voxel->in_queue = true;
+    return RaiseAction::kOpen;
+  }
+  return RaiseAction::kNone;
 }
 
 // The raise set is always empty in batch operations.
-void EsdfIntegrator::processRaiseSet() {
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::processRaiseSet() {
+  if (config_.propagation_threads > 1u) {
+    processRaiseSetParallel();
+    return;
+  }
   size_t num_updates = 0u;
   // For the raise set, get all the neighbors, then:
   // (1) if the neighbor's parent is the current voxel, add it to the raise
   //     queue.
   // (2) if the neighbor's parent differs, add it to open (we will have to
   //    update our current distances, of course).
-  GlobalIndexVector neighbors;
   Neighborhood<>::IndexMatrix neighbor_indices;
   while (!raise_.empty()) {
+    // Reading the clock only every so many voxels keeps it cheap.
+    if ((num_updates + 1u) % kUpdateTimeCheckInterval == 0u &&
+        !isUpdateTimeLeft()) {
+      break;
+    }
     const GlobalIndex global_index = raise_.front();
     raise_.pop();
 
-    EsdfVoxel* voxel = esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
-    CHECK_NOTNULL(voxel);
+    EsdfVoxelType* voxel = esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
+    // Voxels queued by an earlier, time limited update are gone if their
+    // block was removed since, e.g. by the rolling window.
+    if (voxel == nullptr) {
+      continue;
+    }
 
     // Get the global indices of neighbors.
     Neighborhood<>::getFromGlobalIndex(global_index, &neighbor_indices);
@@ -325,42 +552,21 @@ void EsdfIntegrator::processRaiseSet() {
     for (unsigned int idx = 0u; idx < neighbor_indices.cols(); ++idx) {
       const GlobalIndex& neighbor_index = neighbor_indices.col(idx);
 
-      EsdfVoxel* neighbor_voxel =
+      EsdfVoxelType* neighbor_voxel =
           esdf_layer_->getVoxelPtrByGlobalIndex(neighbor_index);
       if (neighbor_voxel == nullptr) {
         continue;
       }
-      // Don't touch unobserved voxels and can't do anything with fixed
-      // voxels.
-      if (!neighbor_voxel->observed || neighbor_voxel->fixed) {
-        continue;
-      }
-      SignedIndex direction = (neighbor_index - global_index).cast<int>();
-      bool is_neighbors_parent = (neighbor_voxel->parent == -direction);
-      if (config_.full_euclidean_distance) {
-        Point voxel_parent_direction =
-            neighbor_voxel->parent.cast<FloatingPoint>().normalized();
-        voxel_parent_direction = Point(std::round(voxel_parent_direction.x()),
-                                       std::round(voxel_parent_direction.y()),
-                                       std::round(voxel_parent_direction.z()));
-        is_neighbors_parent =
-            (voxel_parent_direction.cast<int>() == -direction);
-      }
-      // This will never update fixed voxels as they are their own parents.
-      if (is_neighbors_parent) {
-        // This is the case where we are the parent of this one, so we
-        // should clear it and raise it.
-        neighbor_voxel->distance =
-            signum(neighbor_voxel->distance) * config_.default_distance_m;
-        neighbor_voxel->parent.setZero();
-        raise_.push(neighbor_index);
-      } else {
-        // If it's not in the queue, then add it to open so it can update
-        // our weights back.
-        if (!neighbor_voxel->in_queue) {
+      switch (raiseNeighbor(NeighborhoodLookupTables::kOffsets.col(idx),
+                            neighbor_voxel)) {
+        case RaiseAction::kRaise:
+          raise_.push(neighbor_index);
+          break;
+        case RaiseAction::kOpen:
           open_.push(neighbor_index, neighbor_voxel->distance);
-          neighbor_voxel->in_queue = true;
-        }
+          break;
+        case RaiseAction::kNone:
+          break;
       }
     }
     num_updates++;
@@ -368,19 +574,151 @@ void EsdfIntegrator::processRaiseSet() {
   VLOG(3) << "[ESDF update]: raised " << num_updates << " voxels.";
 }
 
-void EsdfIntegrator::processOpenSet() {
-  size_t num_updates = 0u;
-  size_t num_inside = 0u;
-  size_t num_outside = 0u;
-  size_t num_flipped = 0u;
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::openVoxelsAroundBlocks(
+    const BlockIndexList& new_blocks) {
+  if (new_blocks.empty()) {
+    return;
+  }
+  const IndexSet new_block_set(new_blocks.begin(), new_blocks.end());
+  const LongIndexElement voxels_per_side =
+      static_cast<LongIndexElement>(voxels_per_side_);
+  size_t num_opened = 0u;
+  for (const BlockIndex& block_index : new_blocks) {
+    // The one voxel thick shell around the block.
+    const GlobalIndex shell_min =
+        block_index.cast<LongIndexElement>() * voxels_per_side -
+        GlobalIndex::Ones();
+    GlobalIndex offset;
+    for (offset.x() = 0; offset.x() <= voxels_per_side + 1; ++offset.x()) {
+      for (offset.y() = 0; offset.y() <= voxels_per_side + 1; ++offset.y()) {
+        for (offset.z() = 0; offset.z() <= voxels_per_side + 1;
+             ++offset.z()) {
+          if ((offset.array() > 0).all() &&
+              (offset.array() <= voxels_per_side).all()) {
+            continue;
+          }
+          const GlobalIndex global_index = shell_min + offset;
+          if (new_block_set.count(getBlockIndexFromGlobalVoxelIndex(
+                  global_index, voxels_per_side_inv_)) > 0u) {
+            continue;
+          }
+          EsdfVoxelType* voxel =
+              esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
+          if (voxel == nullptr || !voxel->observed || voxel->in_queue ||
+              voxel->distance >= config_.max_distance_m ||
+              voxel->distance <= -config_.max_distance_m) {
+            continue;
+          }
+          voxel->in_queue = true;
+          open_.push(global_index, voxel->distance);
+          ++num_opened;
+        }
+      }
+    }
+  }
+  VLOG(3) << "[ESDF update]: opened " << num_opened
+          << " voxels around the new blocks.";
+}
+
+template <typename EsdfVoxelType>
+bool EsdfIntegratorBase<EsdfVoxelType>::updateNeighbor(
+    FloatingPoint distance, const SignedIndex& parent,
+    unsigned int neighbor_idx, EsdfVoxelType* neighbor_voxel,
+    OpenSetStats* stats) const {
+  DCHECK(neighbor_voxel != nullptr);
+  DCHECK(stats != nullptr);
+  // Don't touch unobserved voxels and can't do anything with fixed
+  // voxels.
+  if (!neighbor_voxel->observed || neighbor_voxel->fixed) {
+    return false;
+  }
+
+  const SignedIndex& direction =
+      NeighborhoodLookupTables::kOffsets.col(neighbor_idx);
+  FloatingPoint neighbor_distance =
+      NeighborhoodLookupTables::kDistances[neighbor_idx] * voxel_size_;
+  SignedIndex new_parent = -direction;
+  if (config_.full_euclidean_distance) {
+    // In this case, the new parent is is actually the parent of the
+    // current voxel.
+    // And the distance is... Well, complicated.
+    new_parent = parent - direction;
+    neighbor_distance =
+        voxel_size_ * (new_parent.cast<FloatingPoint>().norm() -
+                       parent.cast<FloatingPoint>().norm());
+
+    if (neighbor_distance < 0.0) {
+      return false;
+    }
+  }
+
+  // Both are OUTSIDE the surface.
+  if (distance > 0 && neighbor_voxel->distance > 0) {
+    if (distance + neighbor_distance + config_.min_diff_m <
+        neighbor_voxel->distance) {
+      stats->num_updates++;
+      stats->num_outside++;
+      neighbor_voxel->distance = distance + neighbor_distance;
+      // Also update parent.
+      setEsdfParent(new_parent, neighbor_voxel);
+      return true;
+    }
+    // Next case is both INSIDE the surface.
+  } else if (distance <= 0 && neighbor_voxel->distance <= 0) {
+    if (distance - neighbor_distance - config_.min_diff_m >
+        neighbor_voxel->distance) {
+      stats->num_updates++;
+      stats->num_inside++;
+      neighbor_voxel->distance = distance - neighbor_distance;
+      // Also update parent.
+      setEsdfParent(new_parent, neighbor_voxel);
+      return true;
+    }
+    // Final case is if the signs are different.
+  } else {
+    const FloatingPoint potential_distance =
+        distance - signum(distance) * neighbor_distance;
+    if (std::abs(potential_distance - neighbor_voxel->distance) >
+        neighbor_distance) {
+      stats->num_updates++;
+      stats->num_flipped++;
+      if (signum(potential_distance) == neighbor_voxel->distance) {
+        neighbor_voxel->distance = potential_distance;
+      } else {
+        neighbor_voxel->distance =
+            signum(neighbor_voxel->distance) * neighbor_distance;
+      }
+      // Also update parent.
+      setEsdfParent(new_parent, neighbor_voxel);
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::processOpenSet() {
+  if (config_.propagation_threads > 1u) {
+    processOpenSetParallel();
+    return;
+  }
+  OpenSetStats stats;
   Neighborhood<>::IndexMatrix neighbor_indices;
 
+  size_t num_popped = 0u;
   while (!open_.empty()) {
+    if (++num_popped % kUpdateTimeCheckInterval == 0u && !isUpdateTimeLeft()) {
+      break;
+    }
     GlobalIndex global_index = open_.front();
     open_.pop();
 
-    EsdfVoxel* voxel = esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
-    CHECK_NOTNULL(voxel);
+    EsdfVoxelType* voxel = esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
+    // Skip the voxels of blocks removed since they were queued.
+    if (voxel == nullptr) {
+      continue;
+    }
     voxel->in_queue = false;
 
     // Skip voxels that are unobserved or outside the ranges we care about.
@@ -394,120 +732,388 @@ void EsdfIntegrator::processOpenSet() {
     // Go through the neighbors and see if we can update any of them.
     for (unsigned int idx = 0u; idx < neighbor_indices.cols(); ++idx) {
       const GlobalIndex& neighbor_index = neighbor_indices.col(idx);
-      const SignedIndex& direction =
-          NeighborhoodLookupTables::kOffsets.col(idx);
-      FloatingPoint distance =
-          NeighborhoodLookupTables::kDistances[idx] * voxel_size_;
 
-      EsdfVoxel* neighbor_voxel =
+      EsdfVoxelType* neighbor_voxel =
           esdf_layer_->getVoxelPtrByGlobalIndex(neighbor_index);
       if (neighbor_voxel == nullptr) {
         continue;
       }
 
-      // Don't touch unobserved voxels and can't do anything with fixed
-      // voxels.
-      if (!neighbor_voxel->observed || neighbor_voxel->fixed) {
-        continue;
+      if (updateNeighbor(voxel->distance, getEsdfParent(*voxel), idx,
+                         neighbor_voxel, &stats)) {
+        // Push into the queue if necessary.
+        if (config_.multi_queue || config_.decrease_key_queue ||
+            !neighbor_voxel->in_queue) {
+          open_.push(neighbor_index, neighbor_voxel->distance);
+          neighbor_voxel->in_queue = true;
+        }
       }
+    }
+  }
 
-      SignedIndex new_parent = -direction;
-      if (config_.full_euclidean_distance) {
-        // In this case, the new parent is is actually the parent of the
-        // current voxel.
-        // And the distance is... Well, complicated.
-        new_parent = voxel->parent - direction;
-        distance = voxel_size_ * (new_parent.cast<FloatingPoint>().norm() -
-                                  voxel->parent.cast<FloatingPoint>().norm());
-
-        if (distance < 0.0) {
-          continue;
+  VLOG(3) << "[ESDF update]: made " << stats.num_updates
+          << " voxel updates, of which outside: " << stats.num_outside
+          << " inside: " << stats.num_inside
+          << " flipped: " << stats.num_flipped;
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::runPropagationRounds(
+    const std::function<void(size_t, const PropagationMessage&)>& receive,
+    const std::function<void(size_t, PropagationMessages*)>& propagate) {
+  const size_t num_threads = config_.propagation_threads;
+  for (std::vector<PropagationMessages>& messages : messages_) {
+    messages.resize(num_threads * num_threads);
+    for (PropagationMessages& thread_messages : messages) {
+      thread_messages.clear();
+    }
+  }
+  if (!thread_pool_) {
+    thread_pool_ = std::make_shared<ThreadPool>(num_threads - 1u);
+  }
+
+  size_t num_rounds = 0u;
+  bool messages_sent = true;
+  while (messages_sent) {
+    // The messages of the last round are only read and the ones of this round
+    // are only written by their sender, so the threads never share a voxel.
+    const std::vector<PropagationMessages>& received =
+        messages_[num_rounds % 2u];
+    std::vector<PropagationMessages>& sent = messages_[(num_rounds + 1u) % 2u];
+    thread_pool_->runTasks(num_threads, [&](size_t thread_idx) {
+      for (size_t sender_idx = 0u; sender_idx < num_threads; ++sender_idx) {
+        for (const PropagationMessage& message :
+             received[sender_idx * num_threads + thread_idx]) {
+          receive(thread_idx, message);
         }
       }
+      PropagationMessages* outbox = &sent[thread_idx * num_threads];
+      for (size_t receiver_idx = 0u; receiver_idx < num_threads;
+           ++receiver_idx) {
+        outbox[receiver_idx].clear();
+      }
+      propagate(thread_idx, outbox);
+    });
+    ++num_rounds;
 
-      // Both are OUTSIDE the surface.
-      if (voxel->distance > 0 && neighbor_voxel->distance > 0) {
-        if (voxel->distance + distance + config_.min_diff_m <
-            neighbor_voxel->distance) {
-          num_updates++;
-          num_outside++;
-          neighbor_voxel->distance = voxel->distance + distance;
-          // Also update parent.
-          neighbor_voxel->parent = new_parent;
-          // Push into the queue if necessary.
-          if (config_.multi_queue || !neighbor_voxel->in_queue) {
-            open_.push(neighbor_index, neighbor_voxel->distance);
-            neighbor_voxel->in_queue = true;
-          }
+    messages_sent = false;
+    for (const PropagationMessages& thread_messages : sent) {
+      if (!thread_messages.empty()) {
+        messages_sent = true;
+        break;
+      }
+    }
+  }
+  VLOG(3) << "[ESDF update]: propagated in " << num_rounds << " rounds.";
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::processRaiseSetParallel() {
+  const size_t num_threads = config_.propagation_threads;
+  propagation_threads_.resize(num_threads);
+  while (!raise_.empty()) {
+    const GlobalIndex& global_index = raise_.front();
+    propagation_threads_[getPropagationThread(global_index)].raise.push(
+        global_index);
+    raise_.pop();
+  }
+
+  auto receive = [this](size_t thread_idx, const PropagationMessage& message) {
+    EsdfVoxelType* neighbor_voxel =
+        esdf_layer_->getVoxelPtrByGlobalIndex(message.neighbor_index);
+    if (neighbor_voxel == nullptr) {
+      return;
+    }
+    PropagationThread& thread = propagation_threads_[thread_idx];
+    switch (raiseNeighbor(
+        NeighborhoodLookupTables::kOffsets.col(message.neighbor_idx),
+        neighbor_voxel)) {
+      case RaiseAction::kRaise:
+        thread.raise.push(message.neighbor_index);
+        break;
+      case RaiseAction::kOpen:
+        thread.opened.push_back(message.neighbor_index);
+        break;
+      case RaiseAction::kNone:
+        break;
+    }
+  };
+
+  auto propagate = [this, &receive](size_t thread_idx,
+                                    PropagationMessages* outbox) {
+    PropagationThread& thread = propagation_threads_[thread_idx];
+    Neighborhood<>::IndexMatrix neighbor_indices;
+    PropagationMessage message;
+    while (!thread.raise.empty()) {
+      const GlobalIndex global_index = thread.raise.front();
+      thread.raise.pop();
+      Neighborhood<>::getFromGlobalIndex(global_index, &neighbor_indices);
+      const bool neighbors_in_own_block = hasNeighborsInOwnBlock(global_index);
+      for (unsigned int idx = 0u; idx < neighbor_indices.cols(); ++idx) {
+        message.neighbor_index = neighbor_indices.col(idx);
+        message.neighbor_idx = idx;
+        const size_t neighbor_thread_idx =
+            neighbors_in_own_block
+                ? thread_idx
+                : getPropagationThread(message.neighbor_index);
+        if (neighbor_thread_idx == thread_idx) {
+          receive(thread_idx, message);
+        } else {
+          outbox[neighbor_thread_idx].push_back(message);
         }
-        // Next case is both INSIDE the surface.
-      } else if (voxel->distance <= 0 && neighbor_voxel->distance <= 0) {
-        if (voxel->distance - distance - config_.min_diff_m >
-            neighbor_voxel->distance) {
-          num_updates++;
-          num_inside++;
-          neighbor_voxel->distance = voxel->distance - distance;
-          // Also update parent.
-          neighbor_voxel->parent = new_parent;
-          // Push into the queue if necessary.
-          if (config_.multi_queue || !neighbor_voxel->in_queue) {
-            open_.push(neighbor_index, neighbor_voxel->distance);
-            neighbor_voxel->in_queue = true;
-          }
+      }
+    }
+  };
+
+  runPropagationRounds(receive, propagate);
+
+  for (PropagationThread& thread : propagation_threads_) {
+    for (const GlobalIndex& global_index : thread.opened) {
+      const EsdfVoxelType* voxel =
+          esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
+      open_.push(global_index, voxel->distance);
+    }
+    thread.opened.clear();
+  }
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::processOpenSetParallel() {
+  const size_t num_threads = config_.propagation_threads;
+  propagation_threads_.resize(num_threads);
+  for (PropagationThread& thread : propagation_threads_) {
+    thread.open.setNumBuckets(config_.num_buckets, config_.max_distance_m);
+    thread.open.setDecreaseKey(config_.decrease_key_queue);
+    thread.stats = OpenSetStats();
+  }
+  while (!open_.empty()) {
+    const GlobalIndex global_index = open_.front();
+    open_.pop();
+    const EsdfVoxelType* voxel =
+        esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
+    // Skip the voxels of blocks removed since they were queued.
+    if (voxel == nullptr) {
+      continue;
+    }
+    propagation_threads_[getPropagationThread(global_index)].open.push(
+        global_index, voxel->distance);
+  }
+
+  auto receive = [this](size_t thread_idx, const PropagationMessage& message) {
+    EsdfVoxelType* neighbor_voxel =
+        esdf_layer_->getVoxelPtrByGlobalIndex(message.neighbor_index);
+    if (neighbor_voxel == nullptr) {
+      return;
+    }
+    PropagationThread& thread = propagation_threads_[thread_idx];
+    if (updateNeighbor(message.distance, message.parent, message.neighbor_idx,
+                       neighbor_voxel, &thread.stats)) {
+      if (config_.multi_queue || config_.decrease_key_queue ||
+          !neighbor_voxel->in_queue) {
+        thread.open.push(message.neighbor_index, neighbor_voxel->distance);
+        neighbor_voxel->in_queue = true;
+      }
+    }
+  };
+
+  // Like the single threaded open set the voxels are propagated bucket by
+  // bucket, which keeps voxels from being updated again and again with the
+  // distances of the far voxels of other threads.
+  int max_bucket_index = 0;
+  auto propagate = [this, &receive, &max_bucket_index](
+                       size_t thread_idx, PropagationMessages* outbox) {
+    PropagationThread& thread = propagation_threads_[thread_idx];
+    Neighborhood<>::IndexMatrix neighbor_indices;
+    PropagationMessage message;
+    while (!thread.open.empty() &&
+           thread.open.frontBucketIndex() <= max_bucket_index) {
+      const GlobalIndex global_index = thread.open.front();
+      thread.open.pop();
+
+      EsdfVoxelType* voxel =
+          esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
+      if (voxel == nullptr) {
+        continue;
+      }
+      voxel->in_queue = false;
+
+      // Skip voxels that are unobserved or outside the ranges we care about.
+      if (!voxel->observed || voxel->distance >= config_.max_distance_m ||
+          voxel->distance <= -config_.max_distance_m) {
+        continue;
+      }
+
+      // The neighbors in the blocks of this thread are updated right away,
+      // the others by their threads in the next round.
+      Neighborhood<>::getFromGlobalIndex(global_index, &neighbor_indices);
+      const bool neighbors_in_own_block = hasNeighborsInOwnBlock(global_index);
+      message.parent = getEsdfParent(*voxel);
+      message.distance = voxel->distance;
+      for (unsigned int idx = 0u; idx < neighbor_indices.cols(); ++idx) {
+        message.neighbor_index = neighbor_indices.col(idx);
+        message.neighbor_idx = idx;
+        const size_t neighbor_thread_idx =
+            neighbors_in_own_block
+                ? thread_idx
+                : getPropagationThread(message.neighbor_index);
+        if (neighbor_thread_idx == thread_idx) {
+          receive(thread_idx, message);
+        } else {
+          outbox[neighbor_thread_idx].push_back(message);
         }
-        // Final case is if the signs are different.
-      } else {
-        const FloatingPoint potential_distance =
-            voxel->distance - signum(voxel->distance) * distance;
-        if (std::abs(potential_distance - neighbor_voxel->distance) >
-            distance) {
-          if (signum(potential_distance) == neighbor_voxel->distance) {
-            num_updates++;
-            num_flipped++;
-            neighbor_voxel->distance = potential_distance;
-            // Also update parent.
-            neighbor_voxel->parent = new_parent;
-            // Push into the queue if necessary.
-            if (config_.multi_queue || !neighbor_voxel->in_queue) {
-              open_.push(neighbor_index, neighbor_voxel->distance);
-              neighbor_voxel->in_queue = true;
-            }
-          } else {
-            num_updates++;
-            num_flipped++;
-            neighbor_voxel->distance =
-                signum(neighbor_voxel->distance) * distance;
-            // Also update parent.
-            neighbor_voxel->parent = new_parent;
-            // Push into the queue if necessary.
-            if (config_.multi_queue || !neighbor_voxel->in_queue) {
-              open_.push(neighbor_index, neighbor_voxel->distance);
-              neighbor_voxel->in_queue = true;
-            }
-          }
+      }
+    }
+  };
+
+  while (true) {
+    bool open_set_empty = true;
+    for (PropagationThread& thread : propagation_threads_) {
+      if (!thread.open.empty()) {
+        const int front_bucket_index = thread.open.frontBucketIndex();
+        if (open_set_empty || front_bucket_index < max_bucket_index) {
+          max_bucket_index = front_bucket_index;
         }
+        open_set_empty = false;
+      }
+    }
+    if (open_set_empty) {
+      break;
+    }
+    runPropagationRounds(receive, propagate);
+  }
+
+  OpenSetStats stats;
+  for (const PropagationThread& thread : propagation_threads_) {
+    stats.num_updates += thread.stats.num_updates;
+    stats.num_inside += thread.stats.num_inside;
+    stats.num_outside += thread.stats.num_outside;
+    stats.num_flipped += thread.stats.num_flipped;
+  }
+  VLOG(3) << "[ESDF update]: made " << stats.num_updates
+          << " voxel updates with " << num_threads
+          << " threads, of which outside: " << stats.num_outside
+          << " inside: " << stats.num_inside
+          << " flipped: " << stats.num_flipped;
+}
+
+template <typename EsdfVoxelType>
+void EsdfIntegratorBase<EsdfVoxelType>::computeExactDistances() {
+  // All observed voxels are set below, nothing is left to propagate.
+  open_.clear();
+  raise_ = AlignedQueue<GlobalIndex>();
+
+  BlockIndexList blocks;
+  esdf_layer_->getAllAllocatedBlocks(&blocks);
+  // The distances of the voxels within max_distance_m of the closest fixed
+  // voxel are only exact if all blocks between them take part.
+  const int margin = static_cast<int>(
+      std::ceil(config_.max_distance_m / esdf_layer_->block_size()));
+  distance_transform_.clear();
+  for (const BlockIndex& block_index : blocks) {
+    distance_transform_.addBlock(block_index, margin);
+  }
+
+  GlobalIndexVector site_indices;
+  std::vector<FloatingPoint> site_distances;
+  for (const BlockIndex& block_index : blocks) {
+    const Block<EsdfVoxelType>& block =
+        esdf_layer_->getBlockByIndex(block_index);
+    for (size_t lin_index = 0u; lin_index < block.num_voxels(); ++lin_index) {
+      const EsdfVoxelType& voxel = block.getVoxelByLinearIndex(lin_index);
+      if (voxel.observed && voxel.fixed) {
+        const GlobalIndex global_index =
+            getGlobalVoxelIndexFromBlockAndVoxelIndex(
+                block_index,
+                block.computeVoxelIndexFromLinearIndex(lin_index),
+                voxels_per_side_);
+        distance_transform_.addSite(global_index,
+                                    static_cast<int>(site_indices.size()));
+        site_indices.push_back(global_index);
+        site_distances.push_back(voxel.distance);
       }
     }
   }
+  VLOG(3) << "[ESDF update]: exact distances to " << site_indices.size()
+          << " fixed voxels over " << distance_transform_.getNumberOfBlocks()
+          << " blocks.";
+
+  if (config_.propagation_threads > 1u && !thread_pool_) {
+    thread_pool_ =
+        std::make_shared<ThreadPool>(config_.propagation_threads - 1u);
+  }
+  distance_transform_.compute(config_.propagation_threads, thread_pool_.get());
+
+  for (const BlockIndex& block_index : blocks) {
+    Block<EsdfVoxelType>& block = esdf_layer_->getBlockByIndex(block_index);
+    for (size_t lin_index = 0u; lin_index < block.num_voxels(); ++lin_index) {
+      EsdfVoxelType& voxel = block.getVoxelByLinearIndex(lin_index);
+      voxel.in_queue = false;
+      if (!voxel.observed || voxel.fixed) {
+        continue;
+      }
+      const bool outside = voxel.distance > 0.0f;
+      voxel.distance = (outside ? 1.0f : -1.0f) * config_.default_distance_m;
+      voxel.parent.setZero();
 
-  VLOG(3) << "[ESDF update]: made " << num_updates
-          << " voxel updates, of which outside: " << num_outside
-          << " inside: " << num_inside << " flipped: " << num_flipped;
+      float squared_distance;
+      const int site = distance_transform_.getClosestSite(
+          block_index, lin_index, &squared_distance);
+      if (site == BlockDistanceTransform::kNoSite) {
+        continue;
+      }
+      // Through the closest fixed voxel to the surface, which is on the
+      // other side of the fixed voxel or between it and this voxel.
+      FloatingPoint distance = std::sqrt(squared_distance) * voxel_size_;
+      const FloatingPoint site_distance = site_distances[site];
+      if ((site_distance > 0.0f) == outside) {
+        distance += std::abs(site_distance);
+      } else {
+        distance = std::max<FloatingPoint>(
+            distance - std::abs(site_distance), 0.0f);
+      }
+      if (distance > config_.max_distance_m) {
+        continue;
+      }
+      voxel.distance = outside ? distance : -distance;
+
+      const GlobalIndex global_index =
+          getGlobalVoxelIndexFromBlockAndVoxelIndex(
+              block_index, block.computeVoxelIndexFromLinearIndex(lin_index),
+              voxels_per_side_);
+      const SignedIndex site_direction =
+          (site_indices[site] - global_index).cast<IndexElement>();
+      if (config_.full_euclidean_distance) {
+        setEsdfParent(site_direction, &voxel);
+      } else {
+        // The neighbor towards the closest fixed voxel.
+        const Point direction =
+            site_direction.cast<FloatingPoint>().normalized();
+        setEsdfParent(SignedIndex(std::round(direction.x()),
+                                  std::round(direction.y()),
+                                  std::round(direction.z())),
+                      &voxel);
+      }
+    }
+  }
 }
 
-bool EsdfIntegrator::updateVoxelFromNeighbors(const GlobalIndex& global_index) {
-  EsdfVoxel* voxel = esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
+template <typename EsdfVoxelType>
+bool EsdfIntegratorBase<EsdfVoxelType>::updateVoxelFromNeighbors(
+    const GlobalIndex& global_index) {
+  EsdfVoxelType* voxel = esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
   CHECK_NOTNULL(voxel);
   // Get the global indices of neighbors.
   Neighborhood<>::IndexMatrix neighbor_indices;
   Neighborhood<>::getFromGlobalIndex(global_index, &neighbor_indices);
 
-  // Go through the neighbors and see if we can update any of them.
+  // Take the distance through the closest neighbor of the same sign.
+  bool updated = false;
   for (unsigned int idx = 0u; idx < neighbor_indices.cols(); ++idx) {
     const GlobalIndex& neighbor_index = neighbor_indices.col(idx);
-    const FloatingPoint distance = Neighborhood<>::kDistances[idx];
+    const FloatingPoint distance =
+        Neighborhood<>::kDistances[idx] * voxel_size_;
 
-    EsdfVoxel* neighbor_voxel =
+    EsdfVoxelType* neighbor_voxel =
         esdf_layer_->getVoxelPtrByGlobalIndex(neighbor_index);
     if (neighbor_voxel == nullptr) {
       continue;
@@ -518,15 +1124,20 @@ bool EsdfIntegrator::updateVoxelFromNeighbors(const GlobalIndex& global_index) {
       continue;
     }
     if (signum(neighbor_voxel->distance) == signum(voxel->distance)) {
-      if (std::abs(neighbor_voxel->distance) < std::abs(voxel->distance)) {
-        voxel->distance =
-            neighbor_voxel->distance + signum(voxel->distance) * distance;
-        voxel->parent = -(neighbor_index - global_index).cast<int>();
-        return true;
+      const FloatingPoint new_distance =
+          neighbor_voxel->distance + signum(voxel->distance) * distance;
+      if (std::abs(new_distance) < std::abs(voxel->distance)) {
+        voxel->distance = new_distance;
+        setEsdfParent(-(neighbor_index - global_index).cast<IndexElement>(),
+                      voxel);
+        updated = true;
       }
     }
   }
-  return false;
+  return updated;
 }
 
+template class EsdfIntegratorBase<EsdfVoxel>;
+template class EsdfIntegratorBase<CompactEsdfVoxel>;
+
 }  // namespace voxblox
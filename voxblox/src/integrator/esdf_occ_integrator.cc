@@ -23,64 +23,73 @@ void EsdfOccIntegrator::updateFromOccLayerBatch() {
   updateFromOccBlocks(occ_blocks);
 }
 
-void EsdfOccIntegrator::updateFromOccBlocks(const BlockIndexList& occ_blocks) {
+void EsdfOccIntegrator::updateFromOccLayer(bool clear_updated_flag) {
+  BlockIndexList occ_blocks;
+  occ_layer_->getAllUpdatedBlocks(Update::kEsdf, &occ_blocks);
+  const bool kIncremental = true;
+  updateFromOccBlocks(occ_blocks, kIncremental);
+
+  if (clear_updated_flag) {
+    for (const BlockIndex& block_index : occ_blocks) {
+      Block<OccupancyVoxel>& occ_block =
+          occ_layer_->getBlockByIndex(block_index);
+      occ_block.updated().reset(Update::kEsdf);
+      occ_block.clearDirtyVoxels(Update::kEsdf);
+    }
+  }
+}
+
+void EsdfOccIntegrator::updateFromOccBlocks(const BlockIndexList& occ_blocks,
+                                            bool incremental) {
   DCHECK_EQ(occ_layer_->voxels_per_side(), esdf_layer_->voxels_per_side());
   timing::Timer esdf_timer("esdf_occ");
 
-  // Get a specific list of voxels in the TSDF layer, and propagate out from
-  // there.
-  // Go through all blocks in TSDF and copy their values for relevant voxels.
+  // Get a specific list of voxels in the occupancy layer, and propagate out
+  // from there.
+  // Go through all blocks in the occupancy layer and copy their values for
+  // relevant voxels.
   size_t num_lower = 0u;
   size_t num_raise = 0u;
   size_t num_new = 0u;
   timing::Timer propagate_timer("esdf_occ/propagate_tsdf");
   VLOG(3) << "[ESDF update]: Propagating " << occ_blocks.size()
-          << " updated blocks from the TSDF.";
+          << " updated blocks from the occupancy layer.";
   for (const BlockIndex& block_index : occ_blocks) {
     const Block<OccupancyVoxel>& occ_block =
         occ_layer_->getBlockByIndex(block_index);
 
     // Allocate the same block in the ESDF layer.
     // Block indices are the same across all layers.
+    const bool new_esdf_block = !esdf_layer_->hasBlock(block_index);
     Block<EsdfVoxel>::Ptr esdf_block =
         esdf_layer_->allocateBlockPtrByIndex(block_index);
 
-    // TODO(helenol): assumes that TSDF and ESDF layer are the same size.
-    // This will not always be true...
-    const size_t num_voxels_per_block = occ_block.num_voxels();
-
-    for (size_t lin_index = 0u; lin_index < num_voxels_per_block; ++lin_index) {
-      const OccupancyVoxel& occ_voxel =
-          occ_block.getVoxelByLinearIndex(lin_index);
-
-      if (!occ_voxel.observed) {
-        continue;
+    auto propagate_voxel = [&](size_t lin_index) {
+      switch (propagateOccVoxel(block_index, lin_index,
+                                occ_block.getVoxelByLinearIndex(lin_index),
+                                incremental, esdf_block.get())) {
+        case OccPropagation::kNew:
+          num_new++;
+          break;
+        case OccPropagation::kLower:
+          num_lower++;
+          break;
+        case OccPropagation::kRaise:
+          num_raise++;
+          break;
+        case OccPropagation::kNone:
+          break;
       }
-
-      EsdfVoxel& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
-      VoxelIndex voxel_index =
-          esdf_block->computeVoxelIndexFromLinearIndex(lin_index);
-      // Check for frontier voxels.
-      // This is the check for the lower frontier.
-      // If the occupancy voxel is occupied... Count unknown as free.
-      if (occ_voxel.probability_log > 0.0) {
-        // Assume batch for now.
-        esdf_voxel.distance = 0.0;
-        esdf_voxel.observed = true;
-        esdf_voxel.fixed = true;
-        esdf_voxel.parent.setZero();
-
-        esdf_voxel.in_queue = true;
-        open_.push(std::make_pair(block_index, voxel_index),
-                   esdf_voxel.distance);
-        num_lower++;
-      } else {
-        esdf_voxel.distance = config_.default_distance_m;
-        esdf_voxel.observed = true;
-        esdf_voxel.fixed = false;
-        esdf_voxel.parent.setZero();
-        // No need to push to open...
-        num_new++;
+    };
+
+    if (incremental && !new_esdf_block) {
+      // The other voxels kept their occupancy since the last update.
+      occ_block.forEachDirtyVoxel(Update::kEsdf, propagate_voxel);
+    } else {
+      const size_t num_voxels_per_block = occ_block.num_voxels();
+      for (size_t lin_index = 0u; lin_index < num_voxels_per_block;
+           ++lin_index) {
+        propagate_voxel(lin_index);
       }
     }
   }
@@ -89,8 +98,7 @@ void EsdfOccIntegrator::updateFromOccBlocks(const BlockIndexList& occ_blocks) {
           << " New: " << num_new;
 
   timing::Timer raise_timer("esdf_occ/raise_esdf");
-  // Process the open set now.
-  // processRaiseSet();
+  processRaiseSet();
   raise_timer.Stop();
 
   timing::Timer update_timer("esdf_occ/update_esdf");
@@ -101,6 +109,150 @@ void EsdfOccIntegrator::updateFromOccBlocks(const BlockIndexList& occ_blocks) {
   esdf_timer.Stop();
 }
 
+EsdfOccIntegrator::OccPropagation EsdfOccIntegrator::propagateOccVoxel(
+    const BlockIndex& block_index, size_t lin_index,
+    const OccupancyVoxel& occ_voxel, bool incremental,
+    Block<EsdfVoxel>* esdf_block) {
+  DCHECK(esdf_block != nullptr);
+  if (!occ_voxel.observed) {
+    return OccPropagation::kNone;
+  }
+
+  EsdfVoxel& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
+  const VoxelKey voxel_key(
+      block_index, esdf_block->computeVoxelIndexFromLinearIndex(lin_index));
+  // If the occupancy voxel is occupied... Count unknown as free.
+  const bool occupied = occ_voxel.probability_log > 0.0;
+
+  // If there was nothing there before, or everything is recomputed:
+  if (!incremental || !esdf_voxel.observed) {
+    esdf_voxel.observed = true;
+    esdf_voxel.parent.setZero();
+    if (occupied) {
+      esdf_voxel.distance = 0.0;
+      esdf_voxel.fixed = true;
+      esdf_voxel.in_queue = true;
+      open_.push(voxel_key, esdf_voxel.distance);
+      return OccPropagation::kLower;
+    }
+    esdf_voxel.distance = config_.default_distance_m;
+    esdf_voxel.fixed = false;
+    esdf_voxel.in_queue = false;
+    // In batch the occupied voxels reach all new voxels, here the distances
+    // of the existing voxels around it have to be pulled in.
+    if (incremental && updateVoxelFromNeighbors(voxel_key, &esdf_voxel)) {
+      esdf_voxel.in_queue = true;
+      open_.push(voxel_key, esdf_voxel.distance);
+    }
+    return OccPropagation::kNew;
+  }
+
+  // If this voxel DID exist before, only a change of its occupancy matters.
+  if (occupied == esdf_voxel.fixed) {
+    return OccPropagation::kNone;
+  }
+  esdf_voxel.parent.setZero();
+  if (occupied) {
+    // Lower: it is a new source of the distances around it.
+    esdf_voxel.distance = 0.0;
+    esdf_voxel.fixed = true;
+    esdf_voxel.in_queue = true;
+    open_.push(voxel_key, esdf_voxel.distance);
+    return OccPropagation::kLower;
+  }
+  // Raise: the distances that came from it have to be invalidated.
+  esdf_voxel.distance = config_.default_distance_m;
+  esdf_voxel.fixed = false;
+  raise_.push(voxel_key);
+  return OccPropagation::kRaise;
+}
+
+bool EsdfOccIntegrator::updateVoxelFromNeighbors(const VoxelKey& voxel_key,
+                                                 EsdfVoxel* esdf_voxel) const {
+  DCHECK(esdf_voxel != nullptr);
+  AlignedVector<VoxelKey> neighbors;
+  AlignedVector<float> distances;
+  AlignedVector<Eigen::Vector3i> directions;
+  getNeighborsAndDistances(voxel_key.first, voxel_key.second, &neighbors,
+                           &distances, &directions);
+
+  bool updated = false;
+  for (size_t i = 0; i < neighbors.size(); ++i) {
+    Block<EsdfVoxel>::ConstPtr neighbor_block =
+        esdf_layer_->getBlockPtrByIndex(neighbors[i].first);
+    if (!neighbor_block) {
+      continue;
+    }
+    const EsdfVoxel& neighbor_voxel =
+        neighbor_block->getVoxelByVoxelIndex(neighbors[i].second);
+    if (!neighbor_voxel.observed ||
+        neighbor_voxel.distance >= config_.max_distance_m) {
+      continue;
+    }
+    const FloatingPoint distance =
+        neighbor_voxel.distance + distances[i] * esdf_voxel_size_;
+    if (distance < esdf_voxel->distance) {
+      esdf_voxel->distance = distance;
+      esdf_voxel->parent = directions[i];
+      updated = true;
+    }
+  }
+  return updated && esdf_voxel->distance < config_.max_distance_m;
+}
+
+void EsdfOccIntegrator::processRaiseSet() {
+  size_t num_updates = 0u;
+  // For the raise set, get all the neighbors, then:
+  // (1) if the neighbor's parent is the current voxel, add it to the raise
+  //     queue.
+  // (2) if the neighbor's parent differs, add it to open (we will have to
+  //    update our current distances, of course).
+  AlignedVector<VoxelKey> neighbors;
+  AlignedVector<float> distances;
+  AlignedVector<Eigen::Vector3i> directions;
+  while (!raise_.empty()) {
+    const VoxelKey kv = raise_.front();
+    raise_.pop();
+
+    neighbors.clear();
+    distances.clear();
+    directions.clear();
+    getNeighborsAndDistances(kv.first, kv.second, &neighbors, &distances,
+                             &directions);
+
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+      Block<EsdfVoxel>::Ptr neighbor_block =
+          esdf_layer_->getBlockPtrByIndex(neighbors[i].first);
+      if (!neighbor_block) {
+        continue;
+      }
+      EsdfVoxel& neighbor_voxel =
+          neighbor_block->getVoxelByVoxelIndex(neighbors[i].second);
+
+      // Don't touch unobserved voxels. Occupied voxels are never raised, but
+      // unlike the fixed band of a TSDF they are the only source of the
+      // distances, so they are opened as well to fill the raised voxels.
+      if (!neighbor_voxel.observed) {
+        continue;
+      }
+      if (!neighbor_voxel.fixed && neighbor_voxel.parent == -directions[i]) {
+        // This is the case where we are the parent of this one, so we
+        // should clear it and raise it.
+        neighbor_voxel.distance = config_.default_distance_m;
+        neighbor_voxel.parent.setZero();
+        raise_.push(neighbors[i]);
+      } else if (!neighbor_voxel.in_queue) {
+        // If it's not in the queue, then add it to open so it can update
+        // the raised voxels back.
+        neighbor_voxel.in_queue = true;
+        open_.push(neighbors[i], neighbor_voxel.distance);
+      }
+    }
+    num_updates++;
+  }
+  VLOG(3) << "[ESDF update]: raised " << num_updates << " voxels.";
+}
+
 void EsdfOccIntegrator::processOpenSet() {
   size_t num_updates = 0u;
   while (!open_.empty()) {
@@ -151,15 +303,18 @@ void EsdfOccIntegrator::processOpenSet() {
       EsdfVoxel& neighbor_voxel =
           neighbor_block->getVoxelByVoxelIndex(neighbor_voxel_index);
 
-      if (!neighbor_voxel.observed) {
+      // Occupied voxels have no inside distance, they stay at zero. In an
+      // incremental update a free voxel can still carry a stale distance
+      // when it is popped next to a voxel that just became occupied.
+      if (!neighbor_voxel.observed || neighbor_voxel.fixed) {
         continue;
       }
 
       const FloatingPoint distance_to_neighbor =
           distances[i] * esdf_voxel_size_;
 
-      if (!neighbor_voxel.fixed && esdf_voxel.distance + distance_to_neighbor <
-                                       neighbor_voxel.distance) {
+      if (esdf_voxel.distance + distance_to_neighbor <
+          neighbor_voxel.distance) {
         neighbor_voxel.distance = esdf_voxel.distance + distance_to_neighbor;
         // Also update parent.
         neighbor_voxel.parent = -directions[i];
@@ -171,17 +326,6 @@ void EsdfOccIntegrator::processOpenSet() {
           }
         }
       }
-
-      if (neighbor_voxel.fixed && esdf_voxel.distance - distance_to_neighbor >
-                                      neighbor_voxel.distance) {
-        neighbor_voxel.distance = esdf_voxel.distance - distance_to_neighbor;
-        // Also update parent.
-        neighbor_voxel.parent = -directions[i];
-        if (!neighbor_voxel.in_queue) {
-          open_.push(neighbors[i], neighbor_voxel.distance);
-          neighbor_voxel.in_queue = true;
-        }
-      }
     }
 
     num_updates++;
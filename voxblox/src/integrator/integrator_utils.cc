@@ -1,5 +1,9 @@
 #include "voxblox/integrator/integrator_utils.h"
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 namespace voxblox {
 
 ThreadSafeIndex* ThreadSafeIndexFactory::get(const std::string& mode,
@@ -14,6 +18,18 @@ ThreadSafeIndex* ThreadSafeIndexFactory::get(const std::string& mode,
   return nullptr;
 }
 
+ThreadSafeIndex* ThreadSafeIndexFactory::get(
+    const std::string& mode, const std::vector<FloatingPoint>& ranges) {
+  if (mode == "mixed") {
+    return new MixedThreadSafeIndex(ranges.size());
+  } else if (mode == "sorted") {
+    return new SortedThreadSafeIndex(ranges);
+  } else {
+    LOG(FATAL) << "Unknown integration order mode: '" << mode << "'!";
+  }
+  return nullptr;
+}
+
 ThreadSafeIndex::ThreadSafeIndex(size_t number_of_points)
     : atomic_idx_(0), number_of_points_(number_of_points) {}
 
@@ -36,6 +52,20 @@ SortedThreadSafeIndex::SortedThreadSafeIndex(const Pointcloud& points_C)
          const std::pair<size_t, double>& b) { return a.second < b.second; });
 }
 
+SortedThreadSafeIndex::SortedThreadSafeIndex(
+    const std::vector<FloatingPoint>& ranges)
+    : ThreadSafeIndex(ranges.size()) {
+  indices_and_squared_norms_.reserve(ranges.size());
+  for (size_t idx = 0u; idx < ranges.size(); ++idx) {
+    indices_and_squared_norms_.emplace_back(idx, ranges[idx] * ranges[idx]);
+  }
+
+  std::sort(
+      indices_and_squared_norms_.begin(), indices_and_squared_norms_.end(),
+      [](const std::pair<size_t, double>& a,
+         const std::pair<size_t, double>& b) { return a.second < b.second; });
+}
+
 // returns true if index is valid, false otherwise
 bool ThreadSafeIndex::getNextIndex(size_t* idx) {
   DCHECK(idx != nullptr);
@@ -49,6 +79,10 @@ bool ThreadSafeIndex::getNextIndex(size_t* idx) {
   }
 }
 
+size_t ThreadSafeIndex::getNumReadIndices() const {
+  return std::min(atomic_idx_.load(), number_of_points_);
+}
+
 void ThreadSafeIndex::reset() { atomic_idx_.store(0); }
 
 size_t MixedThreadSafeIndex::getNextIndexImpl(size_t sequential_idx) {
@@ -129,7 +163,10 @@ void RayCaster::setupRayCaster(const Point& start_scaled,
   if (std::isnan(start_scaled.x()) || std::isnan(start_scaled.y()) ||
       std::isnan(start_scaled.z()) || std::isnan(end_scaled.x()) ||
       std::isnan(end_scaled.y()) || std::isnan(end_scaled.z())) {
+    // A ray without any voxel.
+    curr_index_ = GlobalIndex::Zero();
     ray_length_in_steps_ = 0;
+    current_step_ = 1;
     return;
   }
 
@@ -178,4 +215,196 @@ void RayCaster::setupRayCaster(const Point& start_scaled,
                                        : ray_step_signs_.z() / ray_scaled.z());
 }
 
+constexpr size_t BatchRayCaster::kMaxNumRays;
+
+BatchRayCaster::BatchRayCaster() : num_rays_(0u) {}
+
+size_t BatchRayCaster::addRay(const RayCaster& ray_caster) {
+  CHECK(!full());
+  const size_t ray_idx = num_rays_++;
+  for (int axis = 0; axis < 3; ++axis) {
+    t_to_next_boundary_[axis][ray_idx] = ray_caster.t_to_next_boundary_[axis];
+    t_step_size_[axis][ray_idx] = ray_caster.t_step_size_[axis];
+    ray_step_signs_[axis][ray_idx] = ray_caster.ray_step_signs_[axis];
+  }
+  start_indices_[ray_idx] = ray_caster.curr_index_;
+  num_indices_[ray_idx] =
+      (ray_caster.current_step_ > ray_caster.ray_length_in_steps_)
+          ? 0u
+          : ray_caster.ray_length_in_steps_ + 1u - ray_caster.current_step_;
+  return ray_idx;
+}
+
+void BatchRayCaster::castRays() {
+  size_t max_num_indices = 0u;
+  for (size_t ray_idx = 0u; ray_idx < num_rays_; ++ray_idx) {
+    max_num_indices = std::max(max_num_indices, num_indices_[ray_idx]);
+  }
+  // Unused lanes are traversed as well, they stay at their first voxel.
+  for (size_t ray_idx = num_rays_; ray_idx < kMaxNumRays; ++ray_idx) {
+    for (int axis = 0; axis < 3; ++axis) {
+      t_to_next_boundary_[axis][ray_idx] = 0.0f;
+      t_step_size_[axis][ray_idx] = 0.0f;
+      ray_step_signs_[axis][ray_idx] = 0;
+    }
+  }
+  for (std::vector<int32_t>& offsets : offsets_) {
+    if (offsets.size() < max_num_indices * kMaxNumRays) {
+      offsets.resize(max_num_indices * kMaxNumRays);
+    }
+  }
+
+#ifdef __AVX2__
+  castRaysAvx2(max_num_indices);
+#else
+  castRaysScalar();
+#endif
+}
+
+void BatchRayCaster::castRaysScalar() {
+  for (size_t ray_idx = 0u; ray_idx < num_rays_; ++ray_idx) {
+    float t_x = t_to_next_boundary_[0][ray_idx];
+    float t_y = t_to_next_boundary_[1][ray_idx];
+    float t_z = t_to_next_boundary_[2][ray_idx];
+    int32_t offset[3] = {0, 0, 0};
+    for (size_t step_idx = 0u; step_idx < num_indices_[ray_idx]; ++step_idx) {
+      const size_t buffer_idx = step_idx * kMaxNumRays + ray_idx;
+      offsets_[0][buffer_idx] = offset[0];
+      offsets_[1][buffer_idx] = offset[1];
+      offsets_[2][buffer_idx] = offset[2];
+
+      // Same tie breaking as minCoeff in RayCaster::nextRayIndex, the first
+      // smallest axis wins and comparisons with NaN fail.
+      const bool y_smaller = t_y < t_x;
+      if (t_z < (y_smaller ? t_y : t_x)) {
+        offset[2] += ray_step_signs_[2][ray_idx];
+        t_z += t_step_size_[2][ray_idx];
+      } else if (y_smaller) {
+        offset[1] += ray_step_signs_[1][ray_idx];
+        t_y += t_step_size_[1][ray_idx];
+      } else {
+        offset[0] += ray_step_signs_[0][ray_idx];
+        t_x += t_step_size_[0][ray_idx];
+      }
+    }
+  }
+}
+
+#ifdef __AVX2__
+void BatchRayCaster::castRaysAvx2(const size_t max_num_indices) {
+  static_assert(kMaxNumRays == 8u, "The AVX2 kernel casts eight rays.");
+
+  __m256 t_x = _mm256_loadu_ps(t_to_next_boundary_[0].data());
+  __m256 t_y = _mm256_loadu_ps(t_to_next_boundary_[1].data());
+  __m256 t_z = _mm256_loadu_ps(t_to_next_boundary_[2].data());
+  const __m256 t_step_x = _mm256_loadu_ps(t_step_size_[0].data());
+  const __m256 t_step_y = _mm256_loadu_ps(t_step_size_[1].data());
+  const __m256 t_step_z = _mm256_loadu_ps(t_step_size_[2].data());
+  const __m256i sign_x = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(ray_step_signs_[0].data()));
+  const __m256i sign_y = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(ray_step_signs_[1].data()));
+  const __m256i sign_z = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(ray_step_signs_[2].data()));
+
+  const __m256 all_lanes = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  __m256i offset_x = _mm256_setzero_si256();
+  __m256i offset_y = _mm256_setzero_si256();
+  __m256i offset_z = _mm256_setzero_si256();
+
+  // Lanes keep stepping past the end of their ray, these indices are not read.
+  for (size_t step_idx = 0u; step_idx < max_num_indices; ++step_idx) {
+    const size_t buffer_idx = step_idx * kMaxNumRays;
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&offsets_[0][buffer_idx]),
+                        offset_x);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&offsets_[1][buffer_idx]),
+                        offset_y);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&offsets_[2][buffer_idx]),
+                        offset_z);
+
+    // Same tie breaking as minCoeff in RayCaster::nextRayIndex, the first
+    // smallest axis wins and comparisons with NaN fail.
+    const __m256 y_smaller = _mm256_cmp_ps(t_y, t_x, _CMP_LT_OQ);
+    const __m256 t_min_xy = _mm256_blendv_ps(t_x, t_y, y_smaller);
+    const __m256 step_z = _mm256_cmp_ps(t_z, t_min_xy, _CMP_LT_OQ);
+    const __m256 step_y = _mm256_andnot_ps(step_z, y_smaller);
+    const __m256 step_x =
+        _mm256_andnot_ps(_mm256_or_ps(step_z, y_smaller), all_lanes);
+
+    t_x = _mm256_blendv_ps(t_x, _mm256_add_ps(t_x, t_step_x), step_x);
+    t_y = _mm256_blendv_ps(t_y, _mm256_add_ps(t_y, t_step_y), step_y);
+    t_z = _mm256_blendv_ps(t_z, _mm256_add_ps(t_z, t_step_z), step_z);
+    offset_x = _mm256_add_epi32(
+        offset_x, _mm256_and_si256(_mm256_castps_si256(step_x), sign_x));
+    offset_y = _mm256_add_epi32(
+        offset_y, _mm256_and_si256(_mm256_castps_si256(step_y), sign_y));
+    offset_z = _mm256_add_epi32(
+        offset_z, _mm256_and_si256(_mm256_castps_si256(step_z), sign_z));
+  }
+}
+#endif
+
+void HierarchicalIndexBuffer::addVoxel(const BlockIndex& block_idx,
+                                       const VoxelIndex& voxel_idx) {
+  if (num_blocks_ == 0u ||
+      blocks_[last_block_slot_].block_index != block_idx) {
+    const std::pair<FlatAnyIndexHashMapType<size_t>::type::iterator, bool>
+        insertion = block_slots_.emplace(block_idx, num_blocks_);
+    last_block_slot_ = insertion.first->second;
+    if (insertion.second) {
+      if (num_blocks_ == blocks_.size()) {
+        blocks_.emplace_back();
+      }
+      BlockVoxels& block_voxels = blocks_[num_blocks_];
+      block_voxels.block_index = block_idx;
+      block_voxels.voxel_indices.clear();
+      ++num_blocks_;
+    }
+  }
+  blocks_[last_block_slot_].voxel_indices.push_back(voxel_idx);
+}
+
+void getHierarchicalIndexAlongRay(const Point& start, const Point& end,
+                                  size_t voxels_per_side,
+                                  FloatingPoint voxel_size,
+                                  FloatingPoint truncation_distance,
+                                  bool voxel_carving_enabled,
+                                  HierarchicalIndexBuffer* hierarchical_idx) {
+  CHECK_NOTNULL(hierarchical_idx);
+  hierarchical_idx->clear();
+
+  FloatingPoint voxels_per_side_inv = 1.0 / voxels_per_side;
+  FloatingPoint voxel_size_inv = 1.0 / voxel_size;
+
+  const Ray unit_ray = (end - start).normalized();
+
+  const Point ray_end = end + unit_ray * truncation_distance;
+  const Point ray_start =
+      voxel_carving_enabled ? start : (end - unit_ray * truncation_distance);
+
+  const Point start_scaled = ray_start * voxel_size_inv;
+  const Point end_scaled = ray_end * voxel_size_inv;
+
+  RayCaster ray_caster(start_scaled, end_scaled);
+  GlobalIndex global_voxel_idx;
+  while (ray_caster.nextRayIndex(&global_voxel_idx)) {
+    BlockIndex block_idx = getBlockIndexFromGlobalVoxelIndex(
+        global_voxel_idx, voxels_per_side_inv);
+    VoxelIndex local_voxel_idx =
+        getLocalFromGlobalVoxelIndex(global_voxel_idx, voxels_per_side);
+
+    if (local_voxel_idx.x() < 0) {
+      local_voxel_idx.x() += voxels_per_side;
+    }
+    if (local_voxel_idx.y() < 0) {
+      local_voxel_idx.y() += voxels_per_side;
+    }
+    if (local_voxel_idx.z() < 0) {
+      local_voxel_idx.z() += voxels_per_side;
+    }
+
+    hierarchical_idx->addVoxel(block_idx, local_voxel_idx);
+  }
+}
+
 }  // namespace voxblox
@@ -0,0 +1,271 @@
+#include "voxblox/integrator/pointcloud_downsampler.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+#include "voxblox/utils/timing.h"
+
+namespace voxblox {
+
+namespace {
+
+/// Spreads the lowest 21 bits of x out to every third bit.
+inline uint64_t spreadBits(uint64_t x) {
+  x &= 0x1fffffu;
+  x = (x | x << 32) & 0x1f00000000ffffu;
+  x = (x | x << 16) & 0x1f0000ff0000ffu;
+  x = (x | x << 8) & 0x100f00f00f00f00fu;
+  x = (x | x << 4) & 0x10c30c30c30c30c3u;
+  x = (x | x << 2) & 0x1249249249249249u;
+  return x;
+}
+
+/// Interleaves the lowest 21 bits of the coordinates of cell.
+inline uint64_t getMortonCode(const GlobalIndex& cell) {
+  return spreadBits(cell.x()) | (spreadBits(cell.y()) << 1) |
+         (spreadBits(cell.z()) << 2);
+}
+
+/// Range of the items of task task_idx if num_items are split evenly.
+inline void getTaskRange(const size_t num_items, const size_t task_idx,
+                         const size_t num_tasks, size_t* begin, size_t* end) {
+  *begin = num_items * task_idx / num_tasks;
+  *end = num_items * (task_idx + 1u) / num_tasks;
+}
+
+}  // namespace
+
+PointcloudDownsampler::PointcloudDownsampler(const Config& config)
+    : config_(config) {
+  CHECK_GT(config_.voxel_size, 0.0);
+  voxel_size_inv_ = 1.0 / config_.voxel_size;
+  if (config_.num_threads == 0u) {
+    LOG(WARNING) << "Automatic core count failed, defaulting to 1 threads";
+    config_.num_threads = 1u;
+  }
+}
+
+void PointcloudDownsampler::runTasks(const size_t num_tasks,
+                                     const std::function<void(size_t)>& task) {
+  if (num_tasks == 1u) {
+    task(0u);
+    return;
+  }
+  if (!thread_pool_) {
+    // The calling thread makes up for the missing worker.
+    thread_pool_ = std::make_shared<ThreadPool>(config_.num_threads - 1u);
+  }
+  thread_pool_->runTasks(num_tasks, task);
+}
+
+void PointcloudDownsampler::downsample(const Pointcloud& points,
+                                       const Colors& colors,
+                                       Pointcloud* downsampled_points,
+                                       Colors* downsampled_colors,
+                                       std::vector<float>* weights) {
+  CHECK_EQ(points.size(), colors.size());
+  CHECK_NOTNULL(downsampled_points);
+  CHECK_NOTNULL(downsampled_colors);
+  CHECK_NOTNULL(weights);
+  CHECK_LT(points.size(), std::numeric_limits<uint32_t>::max());
+  timing::Timer downsample_timer("downsample_pointcloud");
+
+  const size_t num_points = points.size();
+  const size_t num_tasks = std::max<size_t>(
+      std::min(config_.num_threads, num_points / kMinPointsPerTask), 1u);
+
+  // Bounds of the occupied cells.
+  task_min_cells_.assign(num_tasks,
+                         GlobalIndex::Constant(
+                             std::numeric_limits<LongIndexElement>::max()));
+  task_max_cells_.assign(num_tasks,
+                         GlobalIndex::Constant(
+                             std::numeric_limits<LongIndexElement>::lowest()));
+  runTasks(num_tasks, [&](size_t task_idx) {
+    size_t begin, end;
+    getTaskRange(num_points, task_idx, num_tasks, &begin, &end);
+    GlobalIndex& min_cell = task_min_cells_[task_idx];
+    GlobalIndex& max_cell = task_max_cells_[task_idx];
+    for (size_t i = begin; i < end; ++i) {
+      if (!points[i].allFinite()) {
+        continue;
+      }
+      const GlobalIndex cell =
+          getGridIndexFromPoint<GlobalIndex>(points[i], voxel_size_inv_);
+      min_cell = min_cell.cwiseMin(cell);
+      max_cell = max_cell.cwiseMax(cell);
+    }
+  });
+  GlobalIndex min_cell = task_min_cells_.front();
+  GlobalIndex max_cell = task_max_cells_.front();
+  for (size_t task_idx = 1u; task_idx < num_tasks; ++task_idx) {
+    min_cell = min_cell.cwiseMin(task_min_cells_[task_idx]);
+    max_cell = max_cell.cwiseMax(task_max_cells_[task_idx]);
+  }
+  if ((min_cell.array() > max_cell.array()).any()) {
+    // No finite points.
+    downsampled_points->clear();
+    downsampled_colors->clear();
+    weights->clear();
+    return;
+  }
+
+  // Only the bits that differ between the cells are sorted by. Invalid points
+  // get a key above all Morton codes, so they end up behind the valid ones.
+  const LongIndexElement max_offset = (max_cell - min_cell).maxCoeff();
+  int bits_per_axis = 1;
+  while (bits_per_axis < kBitsPerAxis && (max_offset >> bits_per_axis) != 0) {
+    ++bits_per_axis;
+  }
+  const uint64_t invalid_key = static_cast<uint64_t>(1u) << (3 * bits_per_axis);
+  const LongIndexElement offset_limit = static_cast<LongIndexElement>(1)
+                                        << bits_per_axis;
+
+  sorted_keys_.resize(num_points);
+  sorted_point_indices_.resize(num_points);
+  runTasks(num_tasks, [&](size_t task_idx) {
+    size_t begin, end;
+    getTaskRange(num_points, task_idx, num_tasks, &begin, &end);
+    for (size_t i = begin; i < end; ++i) {
+      sorted_point_indices_[i] = static_cast<uint32_t>(i);
+      sorted_keys_[i] = invalid_key;
+      if (!points[i].allFinite()) {
+        continue;
+      }
+      const GlobalIndex offset =
+          getGridIndexFromPoint<GlobalIndex>(points[i], voxel_size_inv_) -
+          min_cell;
+      if (offset.maxCoeff() < offset_limit) {
+        sorted_keys_[i] = getMortonCode(offset);
+      }
+    }
+  });
+
+  sortByKey(num_points, 3 * bits_per_axis + 1, num_tasks);
+
+  const size_t num_valid_points =
+      std::lower_bound(sorted_keys_.begin(), sorted_keys_.begin() + num_points,
+                       invalid_key) -
+      sorted_keys_.begin();
+  LOG_IF(WARNING, max_offset >= offset_limit)
+      << "The pointcloud spans more than 2^" << kBitsPerAxis
+      << " cells, dropped the points beyond.";
+
+  // Count the cells of every task, a task starts at the first point of a cell.
+  task_num_cells_.assign(num_tasks, 0u);
+  runTasks(num_tasks, [&](size_t task_idx) {
+    const size_t begin =
+        getCellAlignedBegin(task_idx, num_tasks, num_valid_points);
+    const size_t end =
+        getCellAlignedBegin(task_idx + 1u, num_tasks, num_valid_points);
+    size_t num_cells = 0u;
+    for (size_t i = begin; i < end; ++i) {
+      if (i == begin || sorted_keys_[i] != sorted_keys_[i - 1u]) {
+        ++num_cells;
+      }
+    }
+    task_num_cells_[task_idx] = num_cells;
+  });
+  size_t num_cells = 0u;
+  for (size_t& task_num_cells : task_num_cells_) {
+    const size_t first_cell = num_cells;
+    num_cells += task_num_cells;
+    task_num_cells = first_cell;
+  }
+
+  downsampled_points->resize(num_cells);
+  downsampled_colors->resize(num_cells);
+  weights->resize(num_cells);
+  runTasks(num_tasks, [&](size_t task_idx) {
+    const size_t begin =
+        getCellAlignedBegin(task_idx, num_tasks, num_valid_points);
+    const size_t end =
+        getCellAlignedBegin(task_idx + 1u, num_tasks, num_valid_points);
+    size_t cell_idx = task_num_cells_[task_idx];
+    size_t i = begin;
+    while (i < end) {
+      const uint64_t key = sorted_keys_[i];
+      Point point_sum = Point::Zero();
+      uint32_t r = 0u, g = 0u, b = 0u, a = 0u;
+      uint32_t num_cell_points = 0u;
+      for (; i < end && sorted_keys_[i] == key; ++i) {
+        const uint32_t point_idx = sorted_point_indices_[i];
+        point_sum += points[point_idx];
+        const Color& color = colors[point_idx];
+        r += color.r;
+        g += color.g;
+        b += color.b;
+        a += color.a;
+        ++num_cell_points;
+      }
+      const uint32_t half = num_cell_points / 2u;
+      (*downsampled_points)[cell_idx] =
+          point_sum / static_cast<FloatingPoint>(num_cell_points);
+      (*downsampled_colors)[cell_idx] =
+          Color((r + half) / num_cell_points, (g + half) / num_cell_points,
+                (b + half) / num_cell_points, (a + half) / num_cell_points);
+      (*weights)[cell_idx] = static_cast<float>(num_cell_points);
+      ++cell_idx;
+    }
+  });
+}
+
+void PointcloudDownsampler::sortByKey(const size_t num_points,
+                                      const int num_bits,
+                                      const size_t num_tasks) {
+  key_buffer_.resize(num_points);
+  point_index_buffer_.resize(num_points);
+  task_histograms_.resize(num_tasks);
+
+  // Least significant digit first, every pass is stable.
+  for (int shift = 0; shift < num_bits; shift += kRadixBits) {
+    runTasks(num_tasks, [&](size_t task_idx) {
+      size_t begin, end;
+      getTaskRange(num_points, task_idx, num_tasks, &begin, &end);
+      Histogram& histogram = task_histograms_[task_idx];
+      histogram.fill(0u);
+      for (size_t i = begin; i < end; ++i) {
+        ++histogram[(sorted_keys_[i] >> shift) & (kRadixSize - 1u)];
+      }
+    });
+
+    // Ordered by digit and then by task, which keeps the sort stable.
+    size_t offset = 0u;
+    for (size_t digit = 0u; digit < kRadixSize; ++digit) {
+      for (Histogram& histogram : task_histograms_) {
+        const size_t count = histogram[digit];
+        histogram[digit] = offset;
+        offset += count;
+      }
+    }
+
+    runTasks(num_tasks, [&](size_t task_idx) {
+      size_t begin, end;
+      getTaskRange(num_points, task_idx, num_tasks, &begin, &end);
+      Histogram& offsets = task_histograms_[task_idx];
+      for (size_t i = begin; i < end; ++i) {
+        const size_t idx =
+            offsets[(sorted_keys_[i] >> shift) & (kRadixSize - 1u)]++;
+        key_buffer_[idx] = sorted_keys_[i];
+        point_index_buffer_[idx] = sorted_point_indices_[i];
+      }
+    });
+    sorted_keys_.swap(key_buffer_);
+    sorted_point_indices_.swap(point_index_buffer_);
+  }
+}
+
+size_t PointcloudDownsampler::getCellAlignedBegin(
+    const size_t task_idx, const size_t num_tasks,
+    const size_t num_points) const {
+  size_t begin, end;
+  getTaskRange(num_points, task_idx, num_tasks, &begin, &end);
+  while (begin > 0u && begin < num_points &&
+         sorted_keys_[begin] == sorted_keys_[begin - 1u]) {
+    ++begin;
+  }
+  return begin;
+}
+
+}  // namespace voxblox
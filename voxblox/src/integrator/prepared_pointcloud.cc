@@ -0,0 +1,107 @@
+#include "voxblox/integrator/prepared_pointcloud.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace voxblox {
+
+void PreparedPointcloud::prepare(const Config& config,
+                                 const Transformation& T_G_C,
+                                 const Pointcloud& points_C,
+                                 const bool freespace_points) {
+  CHECK_LT(points_C.size(), std::numeric_limits<uint32_t>::max());
+  num_input_points_ = points_C.size();
+  freespace_points_ = freespace_points;
+  const bool clear_far_points = config.allow_clear || freespace_points;
+
+  // Sized for all points, shrunk to the kept ones below.
+  const size_t num_points = points_C.size();
+  x_C_.resize(num_points);
+  y_C_.resize(num_points);
+  z_C_.resize(num_points);
+  ranges_.resize(num_points);
+  point_indices_.resize(num_points);
+  is_clearing_.resize(num_points);
+
+  // Fixed size, so the ranges of a chunk are computed with aligned packets.
+  typedef Eigen::Array<FloatingPoint, kChunkSize, 1> ChunkArray;
+  ChunkArray x = ChunkArray::Zero();
+  ChunkArray y = ChunkArray::Zero();
+  ChunkArray z = ChunkArray::Zero();
+  ChunkArray ranges;
+
+  size_t num_kept_points = 0u;
+  for (size_t chunk_begin = 0u; chunk_begin < num_points;
+       chunk_begin += kChunkSize) {
+    const int chunk_size = static_cast<int>(
+        std::min<size_t>(kChunkSize, num_points - chunk_begin));
+    for (int i = 0; i < chunk_size; ++i) {
+      const Point& point_C = points_C[chunk_begin + i];
+      x[i] = point_C.x();
+      y[i] = point_C.y();
+      z[i] = point_C.z();
+    }
+    ranges = (x.square() + y.square() + z.square()).sqrt();
+
+    for (int i = 0; i < chunk_size; ++i) {
+      const FloatingPoint range = ranges[i];
+      // Points with NaN or infinite coordinates have a range of the same kind.
+      if (!(range >= config.min_ray_length_m) || !std::isfinite(range)) {
+        continue;
+      }
+      bool is_clearing = freespace_points;
+      if (range > config.max_ray_length_m) {
+        if (!clear_far_points) {
+          continue;
+        }
+        is_clearing = true;
+      }
+      x_C_[num_kept_points] = x[i];
+      y_C_[num_kept_points] = y[i];
+      z_C_[num_kept_points] = z[i];
+      ranges_[num_kept_points] = range;
+      point_indices_[num_kept_points] =
+          static_cast<uint32_t>(chunk_begin + i);
+      is_clearing_[num_kept_points] = is_clearing ? 1u : 0u;
+      ++num_kept_points;
+    }
+  }
+
+  x_C_.resize(num_kept_points);
+  y_C_.resize(num_kept_points);
+  z_C_.resize(num_kept_points);
+  ranges_.resize(num_kept_points);
+  point_indices_.resize(num_kept_points);
+  is_clearing_.resize(num_kept_points);
+
+  setTransform(T_G_C);
+}
+
+void PreparedPointcloud::setTransform(const Transformation& T_G_C) {
+  T_G_C_ = T_G_C;
+
+  const size_t num_points = size();
+  x_G_.resize(num_points);
+  y_G_.resize(num_points);
+  z_G_.resize(num_points);
+
+  typedef Eigen::Array<FloatingPoint, Eigen::Dynamic, 1> Array;
+  const Eigen::Map<const Array> x_C(x_C_.data(), num_points);
+  const Eigen::Map<const Array> y_C(y_C_.data(), num_points);
+  const Eigen::Map<const Array> z_C(z_C_.data(), num_points);
+
+  const Eigen::Matrix<FloatingPoint, 3, 3> R_G_C = T_G_C.getRotationMatrix();
+  const Point& t_G_C = T_G_C.getPosition();
+  Eigen::Map<Array>(x_G_.data(), num_points) = R_G_C(0, 0) * x_C +
+                                               R_G_C(0, 1) * y_C +
+                                               R_G_C(0, 2) * z_C + t_G_C.x();
+  Eigen::Map<Array>(y_G_.data(), num_points) = R_G_C(1, 0) * x_C +
+                                               R_G_C(1, 1) * y_C +
+                                               R_G_C(1, 2) * z_C + t_G_C.y();
+  Eigen::Map<Array>(z_G_.data(), num_points) = R_G_C(2, 0) * x_C +
+                                               R_G_C(2, 1) * y_C +
+                                               R_G_C(2, 2) * z_C + t_G_C.z();
+}
+
+}  // namespace voxblox
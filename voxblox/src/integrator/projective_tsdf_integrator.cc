@@ -0,0 +1,459 @@
+#include "voxblox/integrator/tsdf_integrator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace voxblox {
+
+namespace {
+
+/**
+ * Projects point_C into the image, pixels cover [u - 0.5, u + 0.5). Returns
+ * false if the point is behind the camera or outside of the image.
+ */
+inline bool projectToPixel(const CameraIntrinsics& intrinsics,
+                           const Point& point_C, int* u, int* v) {
+  if (!(point_C.z() > kEpsilon)) {
+    return false;
+  }
+  const FloatingPoint inv_z = 1.0 / point_C.z();
+  const FloatingPoint u_f =
+      std::floor(intrinsics.fx * point_C.x() * inv_z + intrinsics.cx + 0.5);
+  const FloatingPoint v_f =
+      std::floor(intrinsics.fy * point_C.y() * inv_z + intrinsics.cy + 0.5);
+  if (u_f < 0.0 || u_f >= intrinsics.width || v_f < 0.0 ||
+      v_f >= intrinsics.height) {
+    return false;
+  }
+  *u = static_cast<int>(u_f);
+  *v = static_cast<int>(v_f);
+  return true;
+}
+
+}  // namespace
+
+ProjectiveTsdfIntegrator::ProjectiveTsdfIntegrator(const Config& config,
+                                                   Layer<TsdfVoxel>* layer)
+    : TsdfIntegratorBase(config, layer) {
+  // The CameraModel looks along x with y to the left and z up, the optical
+  // frame along z with x to the right and y down.
+  Eigen::Matrix<FloatingPoint, 3, 3> R_C_M;
+  R_C_M << 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 1.0, 0.0, 0.0;
+  T_C_M_ = Transformation(Quaternion(R_C_M), Point::Zero());
+
+  setCameraIntrinsics(config.projective_camera_intrinsics);
+}
+
+void ProjectiveTsdfIntegrator::setCameraIntrinsics(
+    const CameraIntrinsics& intrinsics) {
+  CHECK_GT(intrinsics.width, 0);
+  CHECK_GT(intrinsics.height, 0);
+  CHECK_GT(intrinsics.fx, 0.0f);
+  CHECK_GT(intrinsics.fy, 0.0f);
+  intrinsics_ = intrinsics;
+
+  // A symmetric frustum that contains every pixel of the image.
+  const double tan_half_horizontal_fov =
+      std::max(intrinsics.cx + 0.5, intrinsics.width - intrinsics.cx - 0.5) /
+      intrinsics.fx;
+  const double tan_half_vertical_fov =
+      std::max(intrinsics.cy + 0.5, intrinsics.height - intrinsics.cy - 0.5) /
+      intrinsics.fy;
+  camera_model_.setIntrinsicsFromFoV(2.0 * std::atan(tan_half_horizontal_fov),
+                                     2.0 * std::atan(tan_half_vertical_fov),
+                                     voxel_size_, config_.max_ray_length_m);
+}
+
+void ProjectiveTsdfIntegrator::integratePointCloud(
+    const Transformation& T_G_C, const Pointcloud& points_C,
+    const Colors& colors, const bool freespace_points) {
+  CHECK_EQ(points_C.size(), colors.size());
+  // The cost does not depend on the points, none are dropped for time.
+  setIntegrationStats(points_C.size(), 0u);
+  LOG_IF(WARNING, freespace_points)
+      << "The projective integrator does not support freespace points, "
+         "ignoring the point cloud.";
+  if (freespace_points) {
+    return;
+  }
+
+  timing::Timer render_timer("integrate/projective/render");
+  rendered_depth_image_.setZero(intrinsics_.height, intrinsics_.width);
+  rendered_colors_.assign(rendered_depth_image_.size(), Color());
+  for (size_t i = 0u; i < points_C.size(); ++i) {
+    renderPoint(points_C[i], colors[i]);
+  }
+  render_timer.Stop();
+
+  integrateDepthImage(T_G_C, rendered_depth_image_, rendered_colors_);
+}
+
+void ProjectiveTsdfIntegrator::integratePreparedPointCloud(
+    const PreparedPointcloud& prepared_points, const Colors& colors) {
+  CHECK_EQ(prepared_points.getNumInputPoints(), colors.size());
+  setIntegrationStats(prepared_points.getNumInputPoints(), 0u);
+  LOG_IF(WARNING, prepared_points.areFreespacePoints())
+      << "The projective integrator does not support freespace points, "
+         "ignoring the point cloud.";
+  if (prepared_points.areFreespacePoints()) {
+    return;
+  }
+
+  timing::Timer render_timer("integrate/projective/render");
+  rendered_depth_image_.setZero(intrinsics_.height, intrinsics_.width);
+  rendered_colors_.assign(rendered_depth_image_.size(), Color());
+  for (size_t i = 0u; i < prepared_points.size(); ++i) {
+    renderPoint(prepared_points.getPointC(i),
+                colors[prepared_points.getPointIndex(i)]);
+  }
+  render_timer.Stop();
+
+  integrateDepthImage(prepared_points.getTransform(), rendered_depth_image_,
+                      rendered_colors_);
+}
+
+void ProjectiveTsdfIntegrator::renderPoint(const Point& point_C,
+                                           const Color& color) {
+  int u, v;
+  if (!projectToPixel(intrinsics_, point_C, &u, &v)) {
+    return;
+  }
+  // Keep the closest point of every pixel.
+  float& depth = rendered_depth_image_(v, u);
+  if (depth > 0.0f && depth <= point_C.z()) {
+    return;
+  }
+  depth = point_C.z();
+  rendered_colors_[v * intrinsics_.width + u] = color;
+}
+
+void ProjectiveTsdfIntegrator::integrateDepthImage(
+    const Transformation& T_G_C, const DepthImage& depth_image,
+    const Colors& colors) {
+  timing::Timer integrate_timer("integrate/projective");
+  CHECK_EQ(depth_image.cols(), intrinsics_.width);
+  CHECK_EQ(depth_image.rows(), intrinsics_.height);
+  CHECK(colors.empty() ||
+        colors.size() == static_cast<size_t>(depth_image.size()));
+
+  timing::Timer view_timer("integrate/projective/blocks_in_view");
+  getBlocksInView(T_G_C, &blocks_in_view_);
+  view_timer.Stop();
+
+  const size_t num_threads = config_.integrator_threads;
+  thread_new_blocks_.resize(num_threads);
+  thread_scratch_blocks_.resize(num_threads);
+
+  timing::Timer update_timer("integrate/projective/update_blocks");
+  const Transformation T_C_G = T_G_C.inverse();
+  std::atomic<size_t> next_block(0u);
+  runIntegrationTasks([&](size_t task_idx) {
+    integrateBlocks(T_C_G, depth_image, colors, task_idx, &next_block);
+  });
+  update_timer.Stop();
+
+  timing::Timer insertion_timer("inserting_missed_blocks");
+  for (std::vector<std::pair<BlockIndex, Block<TsdfVoxel>::Ptr>>& new_blocks :
+       thread_new_blocks_) {
+    for (const std::pair<BlockIndex, Block<TsdfVoxel>::Ptr>& kv : new_blocks) {
+      layer_->insertBlock(kv);
+    }
+    new_blocks.clear();
+  }
+  insertion_timer.Stop();
+
+  integrate_timer.Stop();
+}
+
+void ProjectiveTsdfIntegrator::getBlocksInView(const Transformation& T_G_C,
+                                               BlockIndexList* blocks) {
+  DCHECK(blocks != nullptr);
+  camera_model_.setCameraPose(T_G_C * T_C_M_);
+
+  Point aabb_min, aabb_max;
+  camera_model_.getAabb(&aabb_min, &aabb_max);
+  const BlockIndex min_block_idx =
+      getGridIndexFromPoint<BlockIndex>(aabb_min, block_size_inv_);
+  const BlockIndex max_block_idx =
+      getGridIndexFromPoint<BlockIndex>(aabb_max, block_size_inv_);
+
+  // A block overlaps the frustum if its bounding sphere is not fully outside
+  // of any of the bounding planes.
+  const FloatingPoint block_radius = 0.5 * std::sqrt(3.0) * block_size_;
+  const Point half_block = Point::Constant(0.5 * block_size_);
+  const AlignedVector<Plane>& planes = camera_model_.getBoundingPlanes();
+
+  blocks->clear();
+  BlockIndex block_idx;
+  for (block_idx.x() = min_block_idx.x(); block_idx.x() <= max_block_idx.x();
+       ++block_idx.x()) {
+    for (block_idx.y() = min_block_idx.y();
+         block_idx.y() <= max_block_idx.y(); ++block_idx.y()) {
+      for (block_idx.z() = min_block_idx.z();
+           block_idx.z() <= max_block_idx.z(); ++block_idx.z()) {
+        const Point block_center =
+            getOriginPointFromGridIndex(block_idx, block_size_) + half_block;
+        bool in_view = true;
+        for (const Plane& plane : planes) {
+          if (block_center.dot(plane.normal()) - plane.distance() <
+              -block_radius) {
+            in_view = false;
+            break;
+          }
+        }
+        if (in_view) {
+          blocks->push_back(block_idx);
+        }
+      }
+    }
+  }
+}
+
+void ProjectiveTsdfIntegrator::integrateBlocks(
+    const Transformation& T_C_G, const DepthImage& depth_image,
+    const Colors& colors, const size_t thread_idx,
+    std::atomic<size_t>* next_block) {
+  DCHECK(next_block != nullptr);
+  Block<TsdfVoxel>::Ptr& scratch_block = thread_scratch_blocks_[thread_idx];
+  std::vector<std::pair<BlockIndex, Block<TsdfVoxel>::Ptr>>& new_blocks =
+      thread_new_blocks_[thread_idx];
+
+  size_t block_work_idx;
+  while ((block_work_idx = (*next_block)++) < blocks_in_view_.size()) {
+    const BlockIndex& block_idx = blocks_in_view_[block_work_idx];
+
+    // Only this thread works on the block, the layer is not modified until all
+    // threads are done.
+    Block<TsdfVoxel>::Ptr block = layer_->getBlockPtrByIndex(block_idx);
+    if (block) {
+      if (integrateBlock(T_C_G, depth_image, colors, block.get()) > 0u) {
+        block->updated().set();
+      }
+      continue;
+    }
+
+    const Point origin = getOriginPointFromGridIndex(block_idx, block_size_);
+    if (scratch_block) {
+      scratch_block->reinitialize(origin);
+    } else {
+      scratch_block = layer_->allocateDetachedBlock(block_idx);
+    }
+    if (integrateBlock(T_C_G, depth_image, colors, scratch_block.get()) > 0u) {
+      scratch_block->updated().set();
+      new_blocks.emplace_back(block_idx, scratch_block);
+      scratch_block.reset();
+    }
+  }
+}
+
+size_t ProjectiveTsdfIntegrator::integrateBlock(const Transformation& T_C_G,
+                                                const DepthImage& depth_image,
+                                                const Colors& colors,
+                                                Block<TsdfVoxel>* block) const {
+  DCHECK(block != nullptr);
+  const Point step_C = T_C_G.getRotation().rotate(Point(voxel_size_, 0.0, 0.0));
+
+  size_t num_updated_voxels = 0u;
+  for (size_t z = 0u; z < voxels_per_side_; ++z) {
+    for (size_t y = 0u; y < voxels_per_side_; ++y) {
+      const Point first_voxel_G =
+          block->origin() + Point(0.5, y + 0.5, z + 0.5) * voxel_size_;
+      const Point first_voxel_C = T_C_G * first_voxel_G;
+      const size_t first_linear_idx =
+          voxels_per_side_ * (y + voxels_per_side_ * z);
+#ifdef __AVX2__
+      num_updated_voxels += updateVoxelRowAvx2(
+          first_voxel_C, step_C, 0u, voxels_per_side_, depth_image, colors,
+          first_linear_idx, block);
+#else
+      num_updated_voxels +=
+          updateVoxelRow(first_voxel_C, step_C, 0u, voxels_per_side_,
+                         depth_image, colors, first_linear_idx, block);
+#endif
+    }
+  }
+  return num_updated_voxels;
+}
+
+size_t ProjectiveTsdfIntegrator::updateVoxelRow(
+    const Point& first_voxel_C, const Point& step_C, const size_t x_begin,
+    const size_t x_end, const DepthImage& depth_image, const Colors& colors,
+    const size_t first_linear_idx, Block<TsdfVoxel>* block) const {
+  const float truncation_distance = config_.default_truncation_distance;
+
+  size_t num_updated_voxels = 0u;
+  for (size_t x = x_begin; x < x_end; ++x) {
+    const Point voxel_C =
+        first_voxel_C + static_cast<FloatingPoint>(x) * step_C;
+    int u, v;
+    if (!projectToPixel(intrinsics_, voxel_C, &u, &v)) {
+      continue;
+    }
+    const float depth = depth_image(v, u);
+    if (!(depth > 0.0f)) {
+      continue;
+    }
+
+    // Distances along the viewing ray of the voxel.
+    const FloatingPoint voxel_distance = voxel_C.norm();
+    const FloatingPoint ray_scale = voxel_distance / voxel_C.z();
+    const FloatingPoint point_distance = depth * ray_scale;
+    if (point_distance < config_.min_ray_length_m ||
+        (point_distance > config_.max_ray_length_m &&
+         !config_.allow_clear) ||
+        voxel_distance > config_.max_ray_length_m) {
+      continue;
+    }
+    const float sdf = (depth - voxel_C.z()) * ray_scale;
+    if (sdf < -truncation_distance ||
+        (sdf > truncation_distance && !config_.voxel_carving_enabled)) {
+      continue;
+    }
+
+    updateVoxel(sdf, depth, v * intrinsics_.width + u, colors,
+                first_linear_idx + x, block);
+    ++num_updated_voxels;
+  }
+  return num_updated_voxels;
+}
+
+#ifdef __AVX2__
+size_t ProjectiveTsdfIntegrator::updateVoxelRowAvx2(
+    const Point& first_voxel_C, const Point& step_C, const size_t x_begin,
+    const size_t x_end, const DepthImage& depth_image, const Colors& colors,
+    const size_t first_linear_idx, Block<TsdfVoxel>* block) const {
+  static_assert(std::is_same<FloatingPoint, float>::value,
+                "The AVX2 kernel works on single precision points.");
+  constexpr size_t kNumLanes = 8u;
+
+  const __m256 lane_offsets = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256 first_x = _mm256_set1_ps(first_voxel_C.x());
+  const __m256 first_y = _mm256_set1_ps(first_voxel_C.y());
+  const __m256 first_z = _mm256_set1_ps(first_voxel_C.z());
+  const __m256 step_x = _mm256_set1_ps(step_C.x());
+  const __m256 step_y = _mm256_set1_ps(step_C.y());
+  const __m256 step_z = _mm256_set1_ps(step_C.z());
+  const __m256 fx = _mm256_set1_ps(intrinsics_.fx);
+  const __m256 fy = _mm256_set1_ps(intrinsics_.fy);
+  const __m256 cx = _mm256_set1_ps(intrinsics_.cx + 0.5f);
+  const __m256 cy = _mm256_set1_ps(intrinsics_.cy + 0.5f);
+  const __m256 width = _mm256_set1_ps(intrinsics_.width);
+  const __m256 height = _mm256_set1_ps(intrinsics_.height);
+  const __m256i width_i = _mm256_set1_epi32(intrinsics_.width);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 epsilon = _mm256_set1_ps(kEpsilon);
+  const __m256 min_ray_length = _mm256_set1_ps(config_.min_ray_length_m);
+  const __m256 max_ray_length = _mm256_set1_ps(config_.max_ray_length_m);
+  const __m256 truncation_distance =
+      _mm256_set1_ps(config_.default_truncation_distance);
+  const __m256 negative_truncation_distance =
+      _mm256_set1_ps(-config_.default_truncation_distance);
+
+  alignas(32) float sdfs[kNumLanes];
+  alignas(32) float depths[kNumLanes];
+  alignas(32) int pixel_indices[kNumLanes];
+
+  size_t num_updated_voxels = 0u;
+  size_t x = x_begin;
+  for (; x + kNumLanes <= x_end; x += kNumLanes) {
+    const __m256 lane_x = _mm256_add_ps(_mm256_set1_ps(x), lane_offsets);
+    const __m256 voxel_x = _mm256_fmadd_ps(lane_x, step_x, first_x);
+    const __m256 voxel_y = _mm256_fmadd_ps(lane_x, step_y, first_y);
+    const __m256 voxel_z = _mm256_fmadd_ps(lane_x, step_z, first_z);
+
+    // Project all voxels in front of the camera into the image.
+    __m256 valid = _mm256_cmp_ps(voxel_z, epsilon, _CMP_GT_OQ);
+    const __m256 inv_z = _mm256_div_ps(_mm256_set1_ps(1.0f), voxel_z);
+    const __m256 u = _mm256_floor_ps(
+        _mm256_fmadd_ps(_mm256_mul_ps(fx, voxel_x), inv_z, cx));
+    const __m256 v = _mm256_floor_ps(
+        _mm256_fmadd_ps(_mm256_mul_ps(fy, voxel_y), inv_z, cy));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, width, _CMP_LT_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, height, _CMP_LT_OQ));
+    if (_mm256_movemask_ps(valid) == 0) {
+      continue;
+    }
+
+    // Gather the depths of the valid lanes.
+    const __m256i pixel_idx = _mm256_and_si256(
+        _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(v), width_i),
+                         _mm256_cvttps_epi32(u)),
+        _mm256_castps_si256(valid));
+    const __m256 depth = _mm256_mask_i32gather_ps(zero, depth_image.data(),
+                                                  pixel_idx, valid, 4);
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(depth, zero, _CMP_GT_OQ));
+
+    // Distances along the viewing rays of the voxels.
+    const __m256 voxel_distance = _mm256_sqrt_ps(_mm256_fmadd_ps(
+        voxel_x, voxel_x,
+        _mm256_fmadd_ps(voxel_y, voxel_y, _mm256_mul_ps(voxel_z, voxel_z))));
+    const __m256 ray_scale = _mm256_mul_ps(voxel_distance, inv_z);
+    const __m256 point_distance = _mm256_mul_ps(depth, ray_scale);
+    valid = _mm256_and_ps(
+        valid, _mm256_cmp_ps(point_distance, min_ray_length, _CMP_GE_OQ));
+    if (!config_.allow_clear) {
+      valid = _mm256_and_ps(
+          valid, _mm256_cmp_ps(point_distance, max_ray_length, _CMP_LE_OQ));
+    }
+    valid = _mm256_and_ps(
+        valid, _mm256_cmp_ps(voxel_distance, max_ray_length, _CMP_LE_OQ));
+
+    const __m256 sdf = _mm256_mul_ps(_mm256_sub_ps(depth, voxel_z), ray_scale);
+    valid = _mm256_and_ps(
+        valid,
+        _mm256_cmp_ps(sdf, negative_truncation_distance, _CMP_GE_OQ));
+    if (!config_.voxel_carving_enabled) {
+      valid = _mm256_and_ps(
+          valid, _mm256_cmp_ps(sdf, truncation_distance, _CMP_LE_OQ));
+    }
+
+    int lane_mask = _mm256_movemask_ps(valid);
+    if (lane_mask == 0) {
+      continue;
+    }
+
+    // The voxels themselves are fused one by one.
+    _mm256_store_ps(sdfs, sdf);
+    _mm256_store_ps(depths, depth);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(pixel_indices), pixel_idx);
+    while (lane_mask != 0) {
+      const int lane = __builtin_ctz(lane_mask);
+      lane_mask &= lane_mask - 1;
+      updateVoxel(sdfs[lane], depths[lane], pixel_indices[lane], colors,
+                  first_linear_idx + x + lane, block);
+      ++num_updated_voxels;
+    }
+  }
+
+  return num_updated_voxels + updateVoxelRow(first_voxel_C, step_C, x, x_end,
+                                              depth_image, colors,
+                                              first_linear_idx, block);
+}
+#endif
+
+void ProjectiveTsdfIntegrator::updateVoxel(const float sdf, const float depth,
+                                           const size_t pixel_idx,
+                                           const Colors& colors,
+                                           const size_t linear_idx,
+                                           Block<TsdfVoxel>* block) const {
+  DCHECK(block != nullptr);
+  // Like for rays, the weight only depends on the depth of the measured point.
+  const float weight =
+      computeUpdatedWeight(sdf, getVoxelWeight(Point(0.0, 0.0, depth)));
+
+  TsdfVoxel& voxel = block->getVoxelByLinearIndex(linear_idx);
+  const Color color = colors.empty() ? voxel.color : colors[pixel_idx];
+  fuseTsdfMeasurement(sdf, weight, color, &voxel);
+  if (config_.track_dirty_voxels) {
+    block->markVoxelDirty(linear_idx);
+  }
+}
+
+}  // namespace voxblox
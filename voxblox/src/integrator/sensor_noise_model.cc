@@ -0,0 +1,61 @@
+#include "voxblox/integrator/sensor_noise_model.h"
+
+namespace voxblox {
+
+SensorNoiseModel::Type SensorNoiseModel::getTypeFromName(
+    const std::string& type_name) {
+  if (type_name == "inverse_square_depth") {
+    return Type::kInverseSquareDepth;
+  } else if (type_name == "lidar") {
+    return Type::kLidar;
+  } else if (type_name == "rgbd") {
+    return Type::kRgbd;
+  }
+  LOG(FATAL) << "Unknown sensor noise model: " << type_name;
+  return Type::kInverseSquareDepth;
+}
+
+SensorNoiseModel::SensorNoiseModel(const Config& config) : config_(config) {
+  CHECK_GT(config_.max_range_m, 0.0);
+  bin_size_inv_ = static_cast<FloatingPoint>(kNumBins) / config_.max_range_m;
+  max_scaled_range_ = static_cast<FloatingPoint>(kNumBins);
+
+  weights_.resize(kNumBins + 1u);
+  for (size_t i = 1u; i <= kNumBins; ++i) {
+    weights_[i] = computeWeightAtRange(i / bin_size_inv_);
+  }
+  // Never looked up, see getWeightAtRange.
+  weights_[0] = weights_[1];
+}
+
+float SensorNoiseModel::computeNoise(const FloatingPoint range) const {
+  switch (config_.type) {
+    case Type::kInverseSquareDepth:
+      return range;
+    case Type::kLidar:
+      return config_.lidar_noise_m + config_.lidar_noise_per_m * range;
+    case Type::kRgbd: {
+      const FloatingPoint offset_range = range - config_.rgbd_noise_offset_m;
+      return config_.rgbd_noise_m +
+             config_.rgbd_noise_quadratic * offset_range * offset_range;
+    }
+    default:
+      LOG(FATAL) << "Unknown sensor noise model type: "
+                 << static_cast<int>(config_.type);
+      break;
+  }
+  return 1.0f;
+}
+
+float SensorNoiseModel::computeWeightAtRange(const FloatingPoint range) const {
+  const float noise = computeNoise(range);
+  // Only the inverse square depth model is noise free, at zero depth, which
+  // getWeightAtRange gives no weight either.
+  if (noise < kFloatEpsilon) {
+    return 0.0f;
+  }
+  const float reference_noise = computeNoise(1.0);
+  return (reference_noise * reference_noise) / (noise * noise);
+}
+
+}  // namespace voxblox
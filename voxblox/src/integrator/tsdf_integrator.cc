@@ -1,10 +1,36 @@
 #include "voxblox/integrator/tsdf_integrator.h"
 
 #include <iostream>
-#include <list>
+
+#include "voxblox/utils/voxel_utils.h"
 
 namespace voxblox {
 
+namespace {
+
+/// The weight table covers the rays up to their maximum length.
+SensorNoiseModel::Config getSensorNoiseModelConfig(
+    const TsdfIntegratorBase::Config& config) {
+  SensorNoiseModel::Config sensor_noise_model_config;
+  sensor_noise_model_config.type =
+      SensorNoiseModel::getTypeFromName(config.sensor_noise_model);
+  sensor_noise_model_config.max_range_m = config.max_ray_length_m;
+  return sensor_noise_model_config;
+}
+
+/// Moves the blocks allocated during integration into the layer.
+template <typename VoxelType>
+void insertStoredBlocks(ConcurrentBlockMap<Block<VoxelType>>* new_blocks,
+                        Layer<VoxelType>* layer) {
+  new_blocks->forEachBlock([layer](const BlockIndex& block_idx,
+                                   const typename Block<VoxelType>::Ptr& block) {
+    layer->insertBlock(std::make_pair(block_idx, block));
+  });
+  new_blocks->clear();
+}
+
+}  // namespace
+
 TsdfIntegratorBase::Ptr TsdfIntegratorFactory::create(
     const std::string& integrator_type_name,
     const TsdfIntegratorBase::Config& config, Layer<TsdfVoxel>* layer) {
@@ -37,6 +63,14 @@ TsdfIntegratorBase::Ptr TsdfIntegratorFactory::create(
     case TsdfIntegratorType::kFast:
       return TsdfIntegratorBase::Ptr(new FastTsdfIntegrator(config, layer));
       break;
+    case TsdfIntegratorType::kPartitioned:
+      return TsdfIntegratorBase::Ptr(
+          new PartitionedTsdfIntegrator(config, layer));
+      break;
+    case TsdfIntegratorType::kProjective:
+      return TsdfIntegratorBase::Ptr(
+          new ProjectiveTsdfIntegrator(config, layer));
+      break;
     default:
       LOG(FATAL) << "Unknown TSDF integrator type: "
                  << static_cast<int>(integrator_type);
@@ -52,9 +86,24 @@ TsdfIntegratorBase::Ptr TsdfIntegratorFactory::create(
 
 TsdfIntegratorBase::TsdfIntegratorBase(const Config& config,
                                        Layer<TsdfVoxel>* layer)
-    : config_(config) {
+    : TsdfIntegratorBase(config) {
   setLayer(layer);
+}
 
+TsdfIntegratorBase::TsdfIntegratorBase(const Config& config,
+                                       Layer<CompactTsdfVoxel>* layer)
+    : TsdfIntegratorBase(config) {
+  setLayer(layer);
+}
+
+TsdfIntegratorBase::TsdfIntegratorBase(const Config& config)
+    : config_(config),
+      point_weights_(nullptr),
+      layer_(nullptr),
+      compact_layer_(nullptr),
+      sensor_noise_model_(getSensorNoiseModelConfig(config)),
+      new_blocks_(config.num_block_map_shards),
+      new_compact_blocks_(config.num_block_map_shards) {
   if (config_.integrator_threads == 0) {
     LOG(WARNING) << "Automatic core count failed, defaulting to 1 threads";
     config_.integrator_threads = 1;
@@ -65,108 +114,118 @@ TsdfIntegratorBase::TsdfIntegratorBase(const Config& config,
   }
 }
 
-void TsdfIntegratorBase::setLayer(Layer<TsdfVoxel>* layer) {
-  CHECK_NOTNULL(layer);
-
-  layer_ = layer;
+void TsdfIntegratorBase::integratePointCloud(const Transformation& T_G_C,
+                                             const Pointcloud& points_C,
+                                             const Colors& colors,
+                                             const bool freespace_points) {
+  CHECK_EQ(points_C.size(), colors.size());
+  timing::Timer prepare_timer("integrate/prepare_points");
+  preparePointcloud(T_G_C, points_C, freespace_points, &prepared_points_);
+  prepare_timer.Stop();
+  integratePreparedPointCloud(prepared_points_, colors);
+}
 
-  voxel_size_ = layer_->voxel_size();
-  block_size_ = layer_->block_size();
-  voxels_per_side_ = layer_->voxels_per_side();
+void TsdfIntegratorBase::preparePointcloud(
+    const Transformation& T_G_C, const Pointcloud& points_C,
+    const bool freespace_points, PreparedPointcloud* prepared_points) const {
+  CHECK_NOTNULL(prepared_points);
+  PreparedPointcloud::Config prepare_config;
+  prepare_config.min_ray_length_m = config_.min_ray_length_m;
+  prepare_config.max_ray_length_m = config_.max_ray_length_m;
+  prepare_config.allow_clear = config_.allow_clear;
+  prepared_points->prepare(prepare_config, T_G_C, points_C, freespace_points);
+}
 
-  voxel_size_inv_ = 1.0 / voxel_size_;
-  block_size_inv_ = 1.0 / block_size_;
-  voxels_per_side_inv_ = 1.0 / voxels_per_side_;
+void TsdfIntegratorBase::integrateWeightedPointCloud(
+    const Transformation& T_G_C, const Pointcloud& points_C,
+    const Colors& colors, const std::vector<float>& point_weights,
+    const bool freespace_points) {
+  CHECK_EQ(points_C.size(), point_weights.size());
+  point_weights_ = &point_weights;
+  integratePointCloud(T_G_C, points_C, colors, freespace_points);
+  point_weights_ = nullptr;
 }
 
-// Will return a pointer to a voxel located at global_voxel_idx in the tsdf
-// layer. Thread safe.
-// Takes in the last_block_idx and last_block to prevent unneeded map lookups.
-// If the block this voxel would be in has not been allocated, a block in
-// temp_block_map_ is created/accessed and a voxel from this map is returned
-// instead. Unlike the layer, accessing temp_block_map_ is controlled via a
-// mutex allowing it to grow during integration.
-// These temporary blocks can be merged into the layer later by calling
-// updateLayerWithStoredBlocks()
-TsdfVoxel* TsdfIntegratorBase::allocateStorageAndGetVoxelPtr(
-    const GlobalIndex& global_voxel_idx, Block<TsdfVoxel>::Ptr* last_block,
-    BlockIndex* last_block_idx) {
-  DCHECK(last_block != nullptr);
-  DCHECK(last_block_idx != nullptr);
-
-  const BlockIndex block_idx =
-      getBlockIndexFromGlobalVoxelIndex(global_voxel_idx, voxels_per_side_inv_);
-
-  if ((block_idx != *last_block_idx) || (*last_block == nullptr)) {
-    *last_block = layer_->getBlockPtrByIndex(block_idx);
-    *last_block_idx = block_idx;
+void TsdfIntegratorBase::runIntegrationTasks(
+    const std::function<void(size_t)>& task) {
+  thread_ray_casters_.resize(config_.integrator_threads);
+  if (config_.integrator_threads == 1u) {
+    task(0u);
+    return;
+  }
+  if (!thread_pool_) {
+    // The calling thread makes up for the missing worker.
+    thread_pool_ =
+        std::make_shared<ThreadPool>(config_.integrator_threads - 1u);
   }
+  thread_pool_->runTasks(config_.integrator_threads, task);
+}
 
-  // If no block at this location currently exists, we allocate a temporary
-  // voxel that will be merged into the map later
-  if (*last_block == nullptr) {
-    // To allow temp_block_map_ to grow we can only let one thread in at once
-    std::lock_guard<std::mutex> lock(temp_block_mutex_);
+void TsdfIntegratorBase::setLayer(Layer<TsdfVoxel>* layer) {
+  CHECK_NOTNULL(layer);
 
-    typename Layer<TsdfVoxel>::BlockHashMap::iterator it =
-        temp_block_map_.find(block_idx);
-    if (it != temp_block_map_.end()) {
-      *last_block = it->second;
-    } else {
-      auto insert_status = temp_block_map_.emplace(
-          block_idx, std::make_shared<Block<TsdfVoxel>>(
-                         voxels_per_side_, voxel_size_,
-                         getOriginPointFromGridIndex(block_idx, block_size_)));
+  layer_ = layer;
+  compact_layer_ = nullptr;
+  cacheLayerSizes(layer_->voxel_size(), layer_->voxels_per_side());
+}
 
-      DCHECK(insert_status.second) << "Block already exists when allocating at "
-                                   << block_idx.transpose();
+void TsdfIntegratorBase::setLayer(Layer<CompactTsdfVoxel>* layer) {
+  CHECK_NOTNULL(layer);
 
-      *last_block = insert_status.first->second;
-    }
-  }
+  layer_ = nullptr;
+  compact_layer_ = layer;
+  cacheLayerSizes(compact_layer_->voxel_size(),
+                  compact_layer_->voxels_per_side());
+}
 
-  (*last_block)->updated().set();
+void TsdfIntegratorBase::cacheLayerSizes(FloatingPoint voxel_size,
+                                         size_t voxels_per_side) {
+  voxel_size_ = voxel_size;
+  voxels_per_side_ = voxels_per_side;
+  block_size_ = voxel_size_ * voxels_per_side_;
 
-  const VoxelIndex local_voxel_idx =
-      getLocalFromGlobalVoxelIndex(global_voxel_idx, voxels_per_side_);
+  voxel_size_inv_ = 1.0 / voxel_size_;
+  block_size_inv_ = 1.0 / block_size_;
+  voxels_per_side_inv_ = 1.0 / voxels_per_side_;
 
-  return &((*last_block)->getVoxelByVoxelIndex(local_voxel_idx));
+  // The dropoff starts one voxel behind the surface.
+  dropoff_slope_ =
+      1.0f / (config_.default_truncation_distance - voxel_size_);
 }
 
 // NOT thread safe
 void TsdfIntegratorBase::updateLayerWithStoredBlocks() {
-  BlockIndex last_block_idx;
-  Block<TsdfVoxel>::Ptr block = nullptr;
-
-  for (const std::pair<const BlockIndex, Block<TsdfVoxel>::Ptr>&
-           temp_block_pair : temp_block_map_) {
-    layer_->insertBlock(temp_block_pair);
+  if (compact_layer_ != nullptr) {
+    insertStoredBlocks(&new_compact_blocks_, compact_layer_);
+  } else {
+    insertStoredBlocks(&new_blocks_, layer_);
   }
-
-  temp_block_map_.clear();
 }
 
-// Updates tsdf_voxel. Thread safe.
-void TsdfIntegratorBase::updateTsdfVoxel(const Point& origin,
-                                         const Point& point_G,
-                                         const GlobalIndex& global_voxel_idx,
-                                         const Color& color, const float weight,
-                                         TsdfVoxel* tsdf_voxel) {
-  DCHECK(tsdf_voxel != nullptr);
+void TsdfIntegratorBase::computeTsdfMeasurement(
+    const Point& origin, const Point& point_G,
+    const GlobalIndex& global_voxel_idx, const float weight, float* sdf,
+    float* updated_weight) const {
+  DCHECK(sdf != nullptr);
+  DCHECK(updated_weight != nullptr);
 
   const Point voxel_center =
       getCenterPointFromGridIndex(global_voxel_idx, voxel_size_);
 
-  const float sdf = computeDistance(origin, point_G, voxel_center);
+  *sdf = computeDistance(origin, point_G, voxel_center);
+  *updated_weight = computeUpdatedWeight(*sdf, weight);
+}
 
+float TsdfIntegratorBase::computeUpdatedWeight(const float sdf,
+                                               const float weight) const {
   float updated_weight = weight;
   // Compute updated weight in case we use weight dropoff. It's easier here
   // that in getVoxelWeight as here we have the actual SDF for the voxel
   // already computed.
   const FloatingPoint dropoff_epsilon = voxel_size_;
   if (config_.use_weight_dropoff && sdf < -dropoff_epsilon) {
-    updated_weight = weight * (config_.default_truncation_distance + sdf) /
-                     (config_.default_truncation_distance - dropoff_epsilon);
+    updated_weight =
+        weight * (config_.default_truncation_distance + sdf) * dropoff_slope_;
     updated_weight = std::max(updated_weight, 0.0f);
   }
 
@@ -181,11 +240,16 @@ void TsdfIntegratorBase::updateTsdfVoxel(const Point& origin,
       updated_weight *= config_.sparsity_compensation_factor;
     }
   }
+  return updated_weight;
+}
 
-  // Lookup the mutex that is responsible for this voxel and lock it
-  std::lock_guard<std::mutex> lock(mutexes_.get(global_voxel_idx));
+void TsdfIntegratorBase::fuseTsdfMeasurement(const float sdf,
+                                             const float weight,
+                                             const Color& color,
+                                             TsdfVoxel* tsdf_voxel) const {
+  DCHECK(tsdf_voxel != nullptr);
 
-  const float new_weight = tsdf_voxel->weight + updated_weight;
+  const float new_weight = tsdf_voxel->weight + weight;
 
   // it is possible to have weights very close to zero, due to the limited
   // precision of floating points dividing by this small value can cause nans
@@ -194,13 +258,12 @@ void TsdfIntegratorBase::updateTsdfVoxel(const Point& origin,
   }
 
   const float new_sdf =
-      (sdf * updated_weight + tsdf_voxel->distance * tsdf_voxel->weight) /
-      new_weight;
+      (sdf * weight + tsdf_voxel->distance * tsdf_voxel->weight) / new_weight;
 
   // color blending is expensive only do it close to the surface
   if (std::abs(sdf) < config_.default_truncation_distance) {
     tsdf_voxel->color = Color::blendTwoColors(
-        tsdf_voxel->color, tsdf_voxel->weight, color, updated_weight);
+        tsdf_voxel->color, tsdf_voxel->weight, color, weight);
   }
   tsdf_voxel->distance =
       (new_sdf > 0.0) ? std::min(config_.default_truncation_distance, new_sdf)
@@ -208,6 +271,21 @@ void TsdfIntegratorBase::updateTsdfVoxel(const Point& origin,
   tsdf_voxel->weight = std::min(config_.max_weight, new_weight);
 }
 
+void TsdfIntegratorBase::fuseTsdfMeasurement(
+    const float sdf, const float weight, const Color& color,
+    CompactTsdfVoxel* tsdf_voxel) const {
+  DCHECK(tsdf_voxel != nullptr);
+
+  // The fused distance is clamped to the truncation distance, so it always
+  // fits the quantization range.
+  TsdfVoxel decompressed_voxel;
+  decompressTsdfVoxel(*tsdf_voxel, config_.default_truncation_distance,
+                      &decompressed_voxel);
+  fuseTsdfMeasurement(sdf, weight, color, &decompressed_voxel);
+  compressTsdfVoxel(decompressed_voxel, config_.default_truncation_distance,
+                    tsdf_voxel);
+}
+
 // Thread safe.
 // Figure out whether the voxel is behind or in front of the surface.
 // To do this, project the voxel_center onto the ray from origin to point G.
@@ -227,172 +305,186 @@ float TsdfIntegratorBase::computeDistance(const Point& origin,
   return sdf;
 }
 
-// Thread safe.
-float TsdfIntegratorBase::getVoxelWeight(const Point& point_C) const {
-  if (config_.use_const_weight) {
-    return 1.0f;
-  }
-  const FloatingPoint dist_z = std::abs(point_C.z());
-  if (dist_z > kEpsilon) {
-    return 1.0f / (dist_z * dist_z);
-  }
-  return 0.0f;
-}
-
-void SimpleTsdfIntegrator::integratePointCloud(const Transformation& T_G_C,
-                                               const Pointcloud& points_C,
-                                               const Colors& colors,
-                                               const bool freespace_points) {
+void SimpleTsdfIntegrator::integratePreparedPointCloud(
+    const PreparedPointcloud& prepared_points, const Colors& colors) {
   timing::Timer integrate_timer("integrate/simple");
-  CHECK_EQ(points_C.size(), colors.size());
+  CHECK_EQ(prepared_points.getNumInputPoints(), colors.size());
 
-  std::unique_ptr<ThreadSafeIndex> index_getter(
-      ThreadSafeIndexFactory::get(config_.integration_order_mode, points_C));
+  startIntegrationTimer();
 
-  std::list<std::thread> integration_threads;
-  for (size_t i = 0; i < config_.integrator_threads; ++i) {
-    integration_threads.emplace_back(&SimpleTsdfIntegrator::integrateFunction,
-                                     this, T_G_C, points_C, colors,
-                                     freespace_points, index_getter.get());
-  }
+  std::unique_ptr<ThreadSafeIndex> index_getter(ThreadSafeIndexFactory::get(
+      config_.integration_order_mode, prepared_points.getRanges()));
 
-  for (std::thread& thread : integration_threads) {
-    thread.join();
-  }
+  runIntegrationTasks([&](size_t task_idx) {
+    if (compact_layer_ != nullptr) {
+      integrateFunction<CompactTsdfVoxel>(prepared_points, colors,
+                                          index_getter.get(),
+                                          &thread_ray_casters_[task_idx]);
+    } else {
+      integrateFunction<TsdfVoxel>(prepared_points, colors,
+                                   index_getter.get(),
+                                   &thread_ray_casters_[task_idx]);
+    }
+  });
   integrate_timer.Stop();
 
+  setIntegrationStats(
+      prepared_points.getNumInputPoints(),
+      prepared_points.size() - index_getter->getNumReadIndices());
+
   timing::Timer insertion_timer("inserting_missed_blocks");
   updateLayerWithStoredBlocks();
   insertion_timer.Stop();
 }
 
-void SimpleTsdfIntegrator::integrateFunction(const Transformation& T_G_C,
-                                             const Pointcloud& points_C,
-                                             const Colors& colors,
-                                             const bool freespace_points,
-                                             ThreadSafeIndex* index_getter) {
+template <typename VoxelType>
+void SimpleTsdfIntegrator::integrateFunction(
+    const PreparedPointcloud& prepared_points, const Colors& colors,
+    ThreadSafeIndex* index_getter, BatchRayCaster* ray_caster) {
   DCHECK(index_getter != nullptr);
-
-  size_t point_idx;
-  while (index_getter->getNextIndex(&point_idx)) {
-    const Point& point_C = points_C[point_idx];
-    const Color& color = colors[point_idx];
-    bool is_clearing;
-    if (!isPointValid(point_C, freespace_points, &is_clearing)) {
-      continue;
+  DCHECK(ray_caster != nullptr);
+
+  const Point& origin = prepared_points.getOrigin();
+  std::array<size_t, BatchRayCaster::kMaxNumRays> ray_point_indices;
+  bool points_left = true;
+  while (points_left) {
+    ray_caster->clear();
+    size_t i;
+    while (!ray_caster->full()) {
+      points_left = isIntegrationTimeLeft() && index_getter->getNextIndex(&i);
+      if (!points_left) {
+        break;
+      }
+      const size_t ray_idx = ray_caster->addRay(RayCaster(
+          origin, prepared_points.getPointG(i), prepared_points.isClearing(i),
+          config_.voxel_carving_enabled, config_.max_ray_length_m,
+          voxel_size_inv_, config_.default_truncation_distance));
+      ray_point_indices[ray_idx] = i;
     }
-
-    const Point origin = T_G_C.getPosition();
-    const Point point_G = T_G_C * point_C;
-
-    RayCaster ray_caster(origin, point_G, is_clearing,
-                         config_.voxel_carving_enabled,
-                         config_.max_ray_length_m, voxel_size_inv_,
-                         config_.default_truncation_distance);
-
-    Block<TsdfVoxel>::Ptr block = nullptr;
-    BlockIndex block_idx;
-    GlobalIndex global_voxel_idx;
-    while (ray_caster.nextRayIndex(&global_voxel_idx)) {
-      TsdfVoxel* voxel =
-          allocateStorageAndGetVoxelPtr(global_voxel_idx, &block, &block_idx);
-
-      const float weight = getVoxelWeight(point_C);
-
-      updateTsdfVoxel(origin, point_G, global_voxel_idx, color, weight, voxel);
+    ray_caster->castRays();
+
+    for (size_t ray_idx = 0u; ray_idx < ray_caster->num_rays(); ++ray_idx) {
+      const size_t i = ray_point_indices[ray_idx];
+      const size_t point_idx = prepared_points.getPointIndex(i);
+      const Color& color = colors[point_idx];
+      const Point point_G = prepared_points.getPointG(i);
+      // The same for every voxel of the ray.
+      const float weight =
+          getPointWeight(prepared_points.getPointC(i), point_idx);
+
+      typename Block<VoxelType>::Ptr block = nullptr;
+      BlockIndex block_idx;
+      for (size_t voxel_idx = 0u;
+           voxel_idx < ray_caster->getNumIndices(ray_idx); ++voxel_idx) {
+        const GlobalIndex global_voxel_idx =
+            ray_caster->getIndex(ray_idx, voxel_idx);
+        VoxelType* voxel =
+            allocateStorageAndGetVoxelPtr(global_voxel_idx, &block, &block_idx);
+
+        updateTsdfVoxel(origin, point_G, global_voxel_idx, color, weight,
+                        voxel);
+      }
     }
   }
 }
 
-void MergedTsdfIntegrator::integratePointCloud(const Transformation& T_G_C,
-                                               const Pointcloud& points_C,
-                                               const Colors& colors,
-                                               const bool freespace_points) {
+void MergedTsdfIntegrator::integratePreparedPointCloud(
+    const PreparedPointcloud& prepared_points, const Colors& colors) {
   timing::Timer integrate_timer("integrate/merged");
-  CHECK_EQ(points_C.size(), colors.size());
+  CHECK_EQ(prepared_points.getNumInputPoints(), colors.size());
+
+  startIntegrationTimer();
 
   // Pre-compute a list of unique voxels to end on.
-  // Create a hashmap: VOXEL INDEX -> index in original cloud.
-  LongIndexHashMapType<AlignedVector<size_t>>::type voxel_map;
+  // Create a hashmap: VOXEL INDEX -> index in prepared cloud.
+  VoxelPointMap voxel_map;
   // This is a hash map (same as above) to all the indices that need to be
   // cleared.
-  LongIndexHashMapType<AlignedVector<size_t>>::type clear_map;
+  VoxelPointMap clear_map;
+  // The entries of the maps in integration order.
+  VoxelPointList voxel_list;
+  VoxelPointList clear_list;
 
-  std::unique_ptr<ThreadSafeIndex> index_getter(
-      ThreadSafeIndexFactory::get(config_.integration_order_mode, points_C));
+  std::unique_ptr<ThreadSafeIndex> index_getter(ThreadSafeIndexFactory::get(
+      config_.integration_order_mode, prepared_points.getRanges()));
 
-  bundleRays(T_G_C, points_C, freespace_points, index_getter.get(), &voxel_map,
-             &clear_map);
+  size_t num_dropped_points =
+      bundleRays(prepared_points, index_getter.get(), &voxel_map, &voxel_list,
+                 &clear_map, &clear_list);
 
-  integrateRays(T_G_C, points_C, colors, config_.enable_anti_grazing, false,
-                voxel_map, clear_map);
+  num_dropped_points +=
+      integrateRays(prepared_points, colors, config_.enable_anti_grazing,
+                    false, voxel_map, voxel_list);
 
   timing::Timer clear_timer("integrate/clear");
 
-  integrateRays(T_G_C, points_C, colors, config_.enable_anti_grazing, true,
-                voxel_map, clear_map);
+  num_dropped_points +=
+      integrateRays(prepared_points, colors, config_.enable_anti_grazing,
+                    true, voxel_map, clear_list);
 
   clear_timer.Stop();
 
   integrate_timer.Stop();
+
+  setIntegrationStats(prepared_points.getNumInputPoints(), num_dropped_points);
 }
 
-void MergedTsdfIntegrator::bundleRays(
-    const Transformation& T_G_C, const Pointcloud& points_C,
-    const bool freespace_points, ThreadSafeIndex* index_getter,
-    LongIndexHashMapType<AlignedVector<size_t>>::type* voxel_map,
-    LongIndexHashMapType<AlignedVector<size_t>>::type* clear_map) {
+size_t MergedTsdfIntegrator::bundleRays(
+    const PreparedPointcloud& prepared_points, ThreadSafeIndex* index_getter,
+    VoxelPointMap* voxel_map, VoxelPointList* voxel_list,
+    VoxelPointMap* clear_map, VoxelPointList* clear_list) {
   DCHECK(voxel_map != nullptr);
+  DCHECK(voxel_list != nullptr);
   DCHECK(clear_map != nullptr);
-
-  size_t point_idx;
-  while (index_getter->getNextIndex(&point_idx)) {
-    const Point& point_C = points_C[point_idx];
-    bool is_clearing;
-    if (!isPointValid(point_C, freespace_points, &is_clearing)) {
-      continue;
-    }
-
-    const Point point_G = T_G_C * point_C;
-
-    GlobalIndex voxel_index =
-        getGridIndexFromPoint<GlobalIndex>(point_G, voxel_size_inv_);
-
-    if (is_clearing) {
-      (*clear_map)[voxel_index].push_back(point_idx);
-    } else {
-      (*voxel_map)[voxel_index].push_back(point_idx);
+  DCHECK(clear_list != nullptr);
+
+  size_t i;
+  while (isIntegrationTimeLeft() && index_getter->getNextIndex(&i)) {
+    GlobalIndex voxel_index = getGridIndexFromPoint<GlobalIndex>(
+        prepared_points.getPointG(i), voxel_size_inv_);
+
+    const bool is_clearing = prepared_points.isClearing(i);
+    VoxelPointMap* map = is_clearing ? clear_map : voxel_map;
+    VoxelPointList* list = is_clearing ? clear_list : voxel_list;
+    const std::pair<VoxelPointMap::iterator, bool> insert_status =
+        map->emplace(voxel_index, AlignedVector<size_t>());
+    if (insert_status.second) {
+      list->push_back(&(*insert_status.first));
     }
+    insert_status.first->second.push_back(i);
   }
 
-  VLOG(3) << "Went from " << points_C.size() << " points to "
-          << voxel_map->size() << " raycasts  and " << clear_map->size()
-          << " clear rays.";
+  VLOG(3) << "Went from " << prepared_points.getNumInputPoints()
+          << " points to " << voxel_map->size() << " raycasts  and "
+          << clear_map->size() << " clear rays.";
+
+  return prepared_points.size() - index_getter->getNumReadIndices();
 }
 
-void MergedTsdfIntegrator::integrateVoxel(
-    const Transformation& T_G_C, const Pointcloud& points_C,
-    const Colors& colors, bool enable_anti_grazing, bool clearing_ray,
-    const std::pair<GlobalIndex, AlignedVector<size_t>>& kv,
-    const LongIndexHashMapType<AlignedVector<size_t>>::type& voxel_map) {
+bool MergedTsdfIntegrator::mergePoints(
+    const PreparedPointcloud& prepared_points, const Colors& colors,
+    bool clearing_ray, const VoxelPointMap::value_type& kv,
+    MergedRay* merged_ray) const {
+  DCHECK(merged_ray != nullptr);
   if (kv.second.empty()) {
-    return;
+    return false;
   }
 
-  const Point& origin = T_G_C.getPosition();
   Color merged_color;
-  Point merged_point_C = Point::Zero();
+  Point merged_point_G = Point::Zero();
   FloatingPoint merged_weight = 0.0;
 
-  for (const size_t pt_idx : kv.second) {
-    const Point& point_C = points_C[pt_idx];
-    const Color& color = colors[pt_idx];
+  for (const size_t i : kv.second) {
+    const size_t point_idx = prepared_points.getPointIndex(i);
+    const Color& color = colors[point_idx];
 
-    const float point_weight = getVoxelWeight(point_C);
+    const float point_weight =
+        getPointWeight(prepared_points.getPointC(i), point_idx);
     if (point_weight < kEpsilon) {
       continue;
     }
-    merged_point_C = (merged_point_C * merged_weight + point_C * point_weight) /
+    merged_point_G = (merged_point_G * merged_weight +
+                      prepared_points.getPointG(i) * point_weight) /
                      (merged_weight + point_weight);
     merged_color =
         Color::blendTwoColors(merged_color, merged_weight, color, point_weight);
@@ -404,126 +496,135 @@ void MergedTsdfIntegrator::integrateVoxel(
     }
   }
 
-  const Point merged_point_G = T_G_C * merged_point_C;
-
-  RayCaster ray_caster(origin, merged_point_G, clearing_ray,
-                       config_.voxel_carving_enabled, config_.max_ray_length_m,
-                       voxel_size_inv_, config_.default_truncation_distance);
+  merged_ray->voxel_idx = &kv.first;
+  merged_ray->point_G = merged_point_G;
+  merged_ray->color = merged_color;
+  merged_ray->weight = merged_weight;
+  return true;
+}
 
-  GlobalIndex global_voxel_idx;
-  while (ray_caster.nextRayIndex(&global_voxel_idx)) {
-    if (enable_anti_grazing) {
-      // Check if this one is already the the block hash map for this
-      // insertion. Skip this to avoid grazing.
-      if ((clearing_ray || global_voxel_idx != kv.first) &&
-          voxel_map.find(global_voxel_idx) != voxel_map.end()) {
-        continue;
+void MergedTsdfIntegrator::integrateMergedRays(
+    const Point& origin, bool enable_anti_grazing, bool clearing_ray,
+    const MergedRay* merged_rays, const BatchRayCaster& ray_caster,
+    const VoxelPointMap& voxel_map) {
+  DCHECK(merged_rays != nullptr);
+
+  for (size_t ray_idx = 0u; ray_idx < ray_caster.num_rays(); ++ray_idx) {
+    const MergedRay& merged_ray = merged_rays[ray_idx];
+    for (size_t i = 0u; i < ray_caster.getNumIndices(ray_idx); ++i) {
+      const GlobalIndex global_voxel_idx = ray_caster.getIndex(ray_idx, i);
+      if (enable_anti_grazing) {
+        // Check if this one is already the the block hash map for this
+        // insertion. Skip this to avoid grazing.
+        if ((clearing_ray || global_voxel_idx != *merged_ray.voxel_idx) &&
+            voxel_map.find(global_voxel_idx) != voxel_map.end()) {
+          continue;
+        }
       }
-    }
 
-    Block<TsdfVoxel>::Ptr block = nullptr;
-    BlockIndex block_idx;
-    TsdfVoxel* voxel =
-        allocateStorageAndGetVoxelPtr(global_voxel_idx, &block, &block_idx);
+      Block<TsdfVoxel>::Ptr block = nullptr;
+      BlockIndex block_idx;
+      TsdfVoxel* voxel =
+          allocateStorageAndGetVoxelPtr(global_voxel_idx, &block, &block_idx);
 
-    updateTsdfVoxel(origin, merged_point_G, global_voxel_idx, merged_color,
-                    merged_weight, voxel);
+      updateTsdfVoxel(origin, merged_ray.point_G, global_voxel_idx,
+                      merged_ray.color, merged_ray.weight, voxel);
+    }
   }
 }
 
-void MergedTsdfIntegrator::integrateVoxels(
-    const Transformation& T_G_C, const Pointcloud& points_C,
-    const Colors& colors, bool enable_anti_grazing, bool clearing_ray,
-    const LongIndexHashMapType<AlignedVector<size_t>>::type& voxel_map,
-    const LongIndexHashMapType<AlignedVector<size_t>>::type& clear_map,
+size_t MergedTsdfIntegrator::integrateVoxels(
+    const PreparedPointcloud& prepared_points, const Colors& colors,
+    bool enable_anti_grazing, bool clearing_ray,
+    const VoxelPointMap& voxel_map, const VoxelPointList& voxel_list,
     size_t thread_idx) {
-  LongIndexHashMapType<AlignedVector<size_t>>::type::const_iterator it;
-  size_t map_size;
-  if (clearing_ray) {
-    it = clear_map.begin();
-    map_size = clear_map.size();
-  } else {
-    it = voxel_map.begin();
-    map_size = voxel_map.size();
-  }
-
-  for (size_t i = 0; i < map_size; ++i) {
-    if (((i + thread_idx + 1) % config_.integrator_threads) == 0) {
-      integrateVoxel(T_G_C, points_C, colors, enable_anti_grazing, clearing_ray,
-                     *it, voxel_map);
+  DCHECK_LT(thread_idx, thread_ray_casters_.size());
+  const Point& origin = prepared_points.getOrigin();
+  BatchRayCaster& ray_caster = thread_ray_casters_[thread_idx];
+  std::array<MergedRay, BatchRayCaster::kMaxNumRays> merged_rays;
+
+  size_t num_dropped_points = 0u;
+  ray_caster.clear();
+  for (size_t i = thread_idx; i < voxel_list.size();
+       i += config_.integrator_threads) {
+    const VoxelPointMap::value_type& kv = *voxel_list[i];
+    if (!isIntegrationTimeLeft()) {
+      num_dropped_points += kv.second.size();
+      continue;
+    }
+    MergedRay merged_ray;
+    if (mergePoints(prepared_points, colors, clearing_ray, kv, &merged_ray)) {
+      merged_rays[ray_caster.addRay(RayCaster(
+          origin, merged_ray.point_G, clearing_ray,
+          config_.voxel_carving_enabled, config_.max_ray_length_m,
+          voxel_size_inv_, config_.default_truncation_distance))] = merged_ray;
+      if (ray_caster.full()) {
+        ray_caster.castRays();
+        integrateMergedRays(origin, enable_anti_grazing, clearing_ray,
+                            merged_rays.data(), ray_caster, voxel_map);
+        ray_caster.clear();
+      }
     }
-    ++it;
   }
+  ray_caster.castRays();
+  integrateMergedRays(origin, enable_anti_grazing, clearing_ray,
+                      merged_rays.data(), ray_caster, voxel_map);
+  return num_dropped_points;
 }
 
-void MergedTsdfIntegrator::integrateRays(
-    const Transformation& T_G_C, const Pointcloud& points_C,
-    const Colors& colors, bool enable_anti_grazing, bool clearing_ray,
-    const LongIndexHashMapType<AlignedVector<size_t>>::type& voxel_map,
-    const LongIndexHashMapType<AlignedVector<size_t>>::type& clear_map) {
-  // if only 1 thread just do function call, otherwise spawn threads
-  if (config_.integrator_threads == 1) {
-    constexpr size_t thread_idx = 0;
-    integrateVoxels(T_G_C, points_C, colors, enable_anti_grazing, clearing_ray,
-                    voxel_map, clear_map, thread_idx);
-  } else {
-    std::list<std::thread> integration_threads;
-    for (size_t i = 0; i < config_.integrator_threads; ++i) {
-      integration_threads.emplace_back(
-          &MergedTsdfIntegrator::integrateVoxels, this, T_G_C, points_C, colors,
-          enable_anti_grazing, clearing_ray, voxel_map, clear_map, i);
-    }
-
-    for (std::thread& thread : integration_threads) {
-      thread.join();
-    }
-  }
+size_t MergedTsdfIntegrator::integrateRays(
+    const PreparedPointcloud& prepared_points, const Colors& colors,
+    bool enable_anti_grazing, bool clearing_ray,
+    const VoxelPointMap& voxel_map, const VoxelPointList& voxel_list) {
+  std::atomic<size_t> num_dropped_points(0u);
+  runIntegrationTasks([&](size_t task_idx) {
+    num_dropped_points +=
+        integrateVoxels(prepared_points, colors, enable_anti_grazing,
+                        clearing_ray, voxel_map, voxel_list, task_idx);
+  });
 
   timing::Timer insertion_timer("inserting_missed_blocks");
   updateLayerWithStoredBlocks();
 
   insertion_timer.Stop();
+  return num_dropped_points;
 }
 
-void FastTsdfIntegrator::integrateFunction(const Transformation& T_G_C,
-                                           const Pointcloud& points_C,
-                                           const Colors& colors,
-                                           const bool freespace_points,
-                                           ThreadSafeIndex* index_getter) {
+void FastTsdfIntegrator::integrateFunction(
+    const PreparedPointcloud& prepared_points, const Colors& colors,
+    ThreadSafeIndex* index_getter) {
   DCHECK(index_getter != nullptr);
 
-  size_t point_idx;
-  while (index_getter->getNextIndex(&point_idx) &&
-         (std::chrono::duration_cast<std::chrono::microseconds>(
-              std::chrono::steady_clock::now() - integration_start_time_)
-              .count() < config_.max_integration_time_s * 1000000)) {
-    const Point& point_C = points_C[point_idx];
+  const Point& origin = prepared_points.getOrigin();
+  size_t i;
+  // The time is checked first so that no point is read and then dropped.
+  while (isIntegrationTimeLeft() && index_getter->getNextIndex(&i)) {
+    const size_t point_idx = prepared_points.getPointIndex(i);
     const Color& color = colors[point_idx];
-    bool is_clearing;
-    if (!isPointValid(point_C, freespace_points, &is_clearing)) {
-      continue;
-    }
-
-    const Point origin = T_G_C.getPosition();
-    const Point point_G = T_G_C * point_C;
+    const Point point_G = prepared_points.getPointG(i);
     // Checks to see if another ray in this scan has already started 'close'
     // to this location. If it has then we skip ray casting this point. We
     // measure if a start location is 'close' to another points by inserting
     // the point into a set of voxels. This voxel set has a resolution
     // start_voxel_subsampling_factor times higher then the voxel size.
-    GlobalIndex global_voxel_idx;
-    global_voxel_idx = getGridIndexFromPoint<GlobalIndex>(
+    GlobalIndex global_voxel_idx = getGridIndexFromPoint<GlobalIndex>(
         point_G, config_.start_voxel_subsampling_factor * voxel_size_inv_);
     if (!start_voxel_approx_set_.replaceHash(global_voxel_idx)) {
       continue;
     }
 
+    // The rays are cast lazily, so a ray that is cut off below is never
+    // traversed further.
     constexpr bool cast_from_origin = false;
-    RayCaster ray_caster(origin, point_G, is_clearing,
+    RayCaster ray_caster(origin, point_G, prepared_points.isClearing(i),
                          config_.voxel_carving_enabled,
                          config_.max_ray_length_m, voxel_size_inv_,
                          config_.default_truncation_distance, cast_from_origin);
 
+    // The same for every voxel of the ray.
+    const float weight =
+        getPointWeight(prepared_points.getPointC(i), point_idx);
+
     int64_t consecutive_ray_collisions = 0;
 
     Block<TsdfVoxel>::Ptr block = nullptr;
@@ -545,21 +646,17 @@ void FastTsdfIntegrator::integrateFunction(const Transformation& T_G_C,
       TsdfVoxel* voxel =
           allocateStorageAndGetVoxelPtr(global_voxel_idx, &block, &block_idx);
 
-      const float weight = getVoxelWeight(point_C);
-
       updateTsdfVoxel(origin, point_G, global_voxel_idx, color, weight, voxel);
     }
   }
 }
 
-void FastTsdfIntegrator::integratePointCloud(const Transformation& T_G_C,
-                                             const Pointcloud& points_C,
-                                             const Colors& colors,
-                                             const bool freespace_points) {
+void FastTsdfIntegrator::integratePreparedPointCloud(
+    const PreparedPointcloud& prepared_points, const Colors& colors) {
   timing::Timer integrate_timer("integrate/fast");
-  CHECK_EQ(points_C.size(), colors.size());
+  CHECK_EQ(prepared_points.getNumInputPoints(), colors.size());
 
-  integration_start_time_ = std::chrono::steady_clock::now();
+  startIntegrationTimer();
 
   static int64_t reset_counter = 0;
   if ((++reset_counter) >= config_.clear_checks_every_n_frames) {
@@ -568,27 +665,189 @@ void FastTsdfIntegrator::integratePointCloud(const Transformation& T_G_C,
     voxel_observed_approx_set_.resetApproxSet();
   }
 
-  std::unique_ptr<ThreadSafeIndex> index_getter(
-      ThreadSafeIndexFactory::get(config_.integration_order_mode, points_C));
-
-  std::list<std::thread> integration_threads;
-  for (size_t i = 0; i < config_.integrator_threads; ++i) {
-    integration_threads.emplace_back(&FastTsdfIntegrator::integrateFunction,
-                                     this, T_G_C, points_C, colors,
-                                     freespace_points, index_getter.get());
-  }
+  std::unique_ptr<ThreadSafeIndex> index_getter(ThreadSafeIndexFactory::get(
+      config_.integration_order_mode, prepared_points.getRanges()));
 
-  for (std::thread& thread : integration_threads) {
-    thread.join();
-  }
+  runIntegrationTasks([&](size_t /*task_idx*/) {
+    integrateFunction(prepared_points, colors, index_getter.get());
+  });
 
   integrate_timer.Stop();
 
+  setIntegrationStats(
+      prepared_points.getNumInputPoints(),
+      prepared_points.size() - index_getter->getNumReadIndices());
+
   timing::Timer insertion_timer("inserting_missed_blocks");
   updateLayerWithStoredBlocks();
   insertion_timer.Stop();
 }
 
+void PartitionedTsdfIntegrator::integratePreparedPointCloud(
+    const PreparedPointcloud& prepared_points, const Colors& colors) {
+  timing::Timer integrate_timer("integrate/partitioned");
+  CHECK_EQ(prepared_points.getNumInputPoints(), colors.size());
+
+  startIntegrationTimer();
+
+  const size_t num_threads = config_.integrator_threads;
+  thread_voxel_indices_.resize(num_threads);
+  thread_block_segments_.resize(num_threads);
+
+  timing::Timer bin_timer("integrate/partitioned/bin_rays");
+  std::unique_ptr<ThreadSafeIndex> index_getter(ThreadSafeIndexFactory::get(
+      config_.integration_order_mode, prepared_points.getRanges()));
+  runIntegrationTasks([&](size_t task_idx) {
+    binRays(prepared_points, task_idx, index_getter.get());
+  });
+  bin_timer.Stop();
+  setIntegrationStats(
+      prepared_points.getNumInputPoints(),
+      prepared_points.size() - index_getter->getNumReadIndices());
+
+  // Gathering the segments of each block and allocating the new blocks is
+  // done by this thread alone, so the blocks go straight into the layer.
+  timing::Timer gather_timer("integrate/partitioned/gather_blocks");
+  blocks_to_integrate_.clear();
+  AnyIndexHashMapType<size_t>::type block_work_indices;
+  for (BlockSegmentMap& block_segments : thread_block_segments_) {
+    for (BlockSegmentMap::value_type& kv : block_segments) {
+      auto insert_status =
+          block_work_indices.emplace(kv.first, blocks_to_integrate_.size());
+      if (insert_status.second) {
+        blocks_to_integrate_.emplace_back();
+        BlockWork& block_work = blocks_to_integrate_.back();
+        block_work.block_idx = kv.first;
+        block_work.block = layer_->allocateBlockPtrByIndex(kv.first);
+        block_work.segments.swap(kv.second);
+      } else {
+        std::vector<RaySegment>& segments =
+            blocks_to_integrate_[insert_status.first->second].segments;
+        segments.insert(segments.end(), kv.second.begin(), kv.second.end());
+      }
+    }
+    block_segments.clear();
+  }
+  gather_timer.Stop();
+
+  timing::Timer update_timer("integrate/partitioned/update_blocks");
+  std::atomic<size_t> next_block(0u);
+  runIntegrationTasks([&](size_t /*task_idx*/) {
+    integrateBlocks(prepared_points, colors, &next_block);
+  });
+  update_timer.Stop();
+
+  integrate_timer.Stop();
+}
+
+void PartitionedTsdfIntegrator::binRays(
+    const PreparedPointcloud& prepared_points, size_t thread_idx,
+    ThreadSafeIndex* index_getter) {
+  DCHECK(index_getter != nullptr);
+  DCHECK_LT(thread_idx, thread_voxel_indices_.size());
+
+  std::vector<uint32_t>& voxel_indices = thread_voxel_indices_[thread_idx];
+  BlockSegmentMap& block_segments = thread_block_segments_[thread_idx];
+  voxel_indices.clear();
+
+  const Point& origin = prepared_points.getOrigin();
+  size_t i;
+  while (isIntegrationTimeLeft() && index_getter->getNextIndex(&i)) {
+    RayCaster ray_caster(origin, prepared_points.getPointG(i),
+                         prepared_points.isClearing(i),
+                         config_.voxel_carving_enabled,
+                         config_.max_ray_length_m, voxel_size_inv_,
+                         config_.default_truncation_distance);
+
+    // A new segment starts whenever the ray enters another block.
+    RaySegment segment;
+    segment.point_idx = i;
+    segment.thread_idx = thread_idx;
+    segment.begin = voxel_indices.size();
+    BlockIndex segment_block_idx;
+    bool has_segment = false;
+
+    GlobalIndex global_voxel_idx;
+    while (ray_caster.nextRayIndex(&global_voxel_idx)) {
+      const BlockIndex block_idx = getBlockIndexFromGlobalVoxelIndex(
+          global_voxel_idx, voxels_per_side_inv_);
+      if (!has_segment || block_idx != segment_block_idx) {
+        if (has_segment) {
+          segment.end = voxel_indices.size();
+          block_segments[segment_block_idx].push_back(segment);
+        }
+        segment.begin = voxel_indices.size();
+        segment_block_idx = block_idx;
+        has_segment = true;
+      }
+      const VoxelIndex local_voxel_idx =
+          getLocalFromGlobalVoxelIndex(global_voxel_idx, voxels_per_side_);
+      voxel_indices.push_back(static_cast<uint32_t>(
+          local_voxel_idx.x() +
+          voxels_per_side_ *
+              (local_voxel_idx.y() + local_voxel_idx.z() * voxels_per_side_)));
+    }
+    if (has_segment) {
+      segment.end = voxel_indices.size();
+      block_segments[segment_block_idx].push_back(segment);
+    }
+  }
+}
+
+void PartitionedTsdfIntegrator::integrateBlocks(
+    const PreparedPointcloud& prepared_points, const Colors& colors,
+    std::atomic<size_t>* next_block) {
+  DCHECK(next_block != nullptr);
+  size_t block_work_idx;
+  while ((block_work_idx = next_block->fetch_add(1u)) <
+         blocks_to_integrate_.size()) {
+    integrateBlock(prepared_points, colors,
+                   &blocks_to_integrate_[block_work_idx]);
+  }
+}
+
+void PartitionedTsdfIntegrator::integrateBlock(
+    const PreparedPointcloud& prepared_points, const Colors& colors,
+    BlockWork* block_work) {
+  DCHECK(block_work != nullptr);
+  Block<TsdfVoxel>& block = *block_work->block;
+  block.updated().set();
+
+  // Fusing in point order makes the result independent of the binning.
+  std::sort(block_work->segments.begin(), block_work->segments.end());
+
+  const Point& origin = prepared_points.getOrigin();
+  for (const RaySegment& segment : block_work->segments) {
+    const size_t point_idx = prepared_points.getPointIndex(segment.point_idx);
+    const Point point_G = prepared_points.getPointG(segment.point_idx);
+    const Color& color = colors[point_idx];
+    const float weight =
+        getPointWeight(prepared_points.getPointC(segment.point_idx), point_idx);
+
+    const std::vector<uint32_t>& voxel_indices =
+        thread_voxel_indices_[segment.thread_idx];
+    for (size_t i = segment.begin; i < segment.end; ++i) {
+      const size_t linear_idx = voxel_indices[i];
+      const GlobalIndex global_voxel_idx =
+          getGlobalVoxelIndexFromBlockAndVoxelIndex(
+              block_work->block_idx,
+              block.computeVoxelIndexFromLinearIndex(linear_idx),
+              voxels_per_side_);
+
+      float sdf;
+      float updated_weight;
+      computeTsdfMeasurement(origin, point_G, global_voxel_idx, weight, &sdf,
+                             &updated_weight);
+      // This thread owns the block, no other thread touches the voxel.
+      fuseTsdfMeasurement(sdf, updated_weight, color,
+                          &block.getVoxelByLinearIndex(linear_idx));
+      if (config_.track_dirty_voxels) {
+        block.markVoxelDirty(linear_idx);
+      }
+    }
+  }
+}
+
 std::string TsdfIntegratorBase::Config::print() const {
   std::stringstream ss;
   // clang-format off
@@ -600,18 +859,27 @@ std::string TsdfIntegratorBase::Config::print() const {
   ss << " - min_ray_length_m:                          " << min_ray_length_m << "\n";
   ss << " - max_ray_length_m:                          " << max_ray_length_m << "\n";
   ss << " - use_const_weight:                          " << use_const_weight << "\n";
+  ss << " - sensor_noise_model:                        " << sensor_noise_model << "\n";
   ss << " - allow_clear:                               " << allow_clear << "\n";
   ss << " - use_weight_dropoff:                        " << use_weight_dropoff << "\n";
   ss << " - use_sparsity_compensation_factor:          " << use_sparsity_compensation_factor << "\n";
   ss << " - sparsity_compensation_factor:              "  << sparsity_compensation_factor << "\n";
   ss << " - integrator_threads:                        " << integrator_threads << "\n";
+  ss << " - num_block_map_shards:                      " << num_block_map_shards << "\n";
+  ss << " - use_voxel_spin_locks:                      " << use_voxel_spin_locks << "\n";
+  ss << " - integration_order_mode:                    " << integration_order_mode << "\n";
+  ss << " - max_integration_time_s:                    " << max_integration_time_s << "\n";
+  ss << " - track_dirty_voxels:                        " << track_dirty_voxels << "\n";
   ss << " MergedTsdfIntegrator: \n";
   ss << " - enable_anti_grazing:                       " << enable_anti_grazing << "\n";
   ss << " FastTsdfIntegrator: \n";
   ss << " - start_voxel_subsampling_factor:            " << start_voxel_subsampling_factor << "\n";
   ss << " - max_consecutive_ray_collisions:            " << max_consecutive_ray_collisions << "\n";
   ss << " - clear_checks_every_n_frames:               " << clear_checks_every_n_frames << "\n";
-  ss << " - max_integration_time_s:                    " << max_integration_time_s << "\n";
+  ss << " ProjectiveTsdfIntegrator: \n";
+  ss << " - projective_camera_intrinsics:              " << projective_camera_intrinsics.width << "x" << projective_camera_intrinsics.height
+     << " fx " << projective_camera_intrinsics.fx << " fy " << projective_camera_intrinsics.fy
+     << " cx " << projective_camera_intrinsics.cx << " cy " << projective_camera_intrinsics.cy << "\n";
   ss << "==============================================================\n";
   // clang-format on
   return ss.str();
@@ -0,0 +1,233 @@
+#include "voxblox/utils/distance_transform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+
+namespace voxblox {
+
+constexpr int BlockDistanceTransform::kNoSite;
+
+void computeDistanceTransform1D(const float* values, const int n,
+                                float* distances, int* closest, int* vertices,
+                                float* boundaries) {
+  DCHECK(values != nullptr);
+  DCHECK(distances != nullptr);
+  DCHECK(closest != nullptr);
+  DCHECK(vertices != nullptr);
+  DCHECK(boundaries != nullptr);
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+  // Lower envelope of the parabolas rooted at the samples with finite values,
+  // vertices[k] is the root of the k-th parabola of the envelope, which is the
+  // lowest from boundaries[k] to boundaries[k + 1].
+  int k = -1;
+  for (int q = 0; q < n; ++q) {
+    if (!(values[q] < kInfinity)) {
+      continue;
+    }
+    const float value_q = values[q] + static_cast<float>(q) * q;
+    float s = -kInfinity;
+    while (k >= 0) {
+      const int p = vertices[k];
+      s = (value_q - (values[p] + static_cast<float>(p) * p)) /
+          static_cast<float>(2 * (q - p));
+      if (s > boundaries[k]) {
+        break;
+      }
+      --k;
+    }
+    ++k;
+    vertices[k] = q;
+    boundaries[k] = k == 0 ? -kInfinity : s;
+    boundaries[k + 1] = kInfinity;
+  }
+
+  if (k < 0) {
+    std::fill(distances, distances + n, kInfinity);
+    std::fill(closest, closest + n, -1);
+    return;
+  }
+
+  k = 0;
+  for (int q = 0; q < n; ++q) {
+    while (boundaries[k + 1] < static_cast<float>(q)) {
+      ++k;
+    }
+    const int p = vertices[k];
+    distances[q] = static_cast<float>(q - p) * (q - p) + values[p];
+    closest[q] = p;
+  }
+}
+
+BlockDistanceTransform::BlockDistanceTransform(const size_t voxels_per_side)
+    : voxels_per_side_(voxels_per_side),
+      num_voxels_per_block_(voxels_per_side * voxels_per_side *
+                            voxels_per_side) {
+  CHECK_GT(voxels_per_side_, 0u);
+}
+
+void BlockDistanceTransform::clear() {
+  block_slots_.clear();
+  block_indices_.clear();
+  squared_distances_.clear();
+  sites_.clear();
+}
+
+void BlockDistanceTransform::addBlock(const BlockIndex& block_index,
+                                      const int margin) {
+  CHECK_GE(margin, 0);
+  BlockIndex offset;
+  for (offset.z() = -margin; offset.z() <= margin; ++offset.z()) {
+    for (offset.y() = -margin; offset.y() <= margin; ++offset.y()) {
+      for (offset.x() = -margin; offset.x() <= margin; ++offset.x()) {
+        const BlockIndex neighbor_index = block_index + offset;
+        if (block_slots_.emplace(neighbor_index, block_indices_.size())
+                .second) {
+          block_indices_.push_back(neighbor_index);
+        }
+      }
+    }
+  }
+  squared_distances_.resize(block_indices_.size() * num_voxels_per_block_,
+                            std::numeric_limits<float>::infinity());
+  sites_.resize(block_indices_.size() * num_voxels_per_block_, kNoSite);
+}
+
+void BlockDistanceTransform::addSite(const GlobalIndex& global_index,
+                                     const int site_index) {
+  CHECK_GE(site_index, 0);
+  const BlockIndex block_index = getBlockIndexFromGlobalVoxelIndex(
+      global_index, 1.0 / static_cast<FloatingPoint>(voxels_per_side_));
+  const AnyIndexHashMapType<size_t>::type::const_iterator it =
+      block_slots_.find(block_index);
+  CHECK(it != block_slots_.end()) << "The block of the site was not added.";
+  const GlobalIndex voxel_index =
+      global_index - block_index.cast<LongIndexElement>() *
+                         static_cast<LongIndexElement>(voxels_per_side_);
+  const size_t voxel_idx =
+      it->second * num_voxels_per_block_ +
+      static_cast<size_t>(voxel_index.x() +
+                          voxels_per_side_ * (voxel_index.y() +
+                                              voxels_per_side_ *
+                                                  voxel_index.z()));
+  squared_distances_[voxel_idx] = 0.0f;
+  sites_[voxel_idx] = site_index;
+}
+
+void BlockDistanceTransform::getBlockRuns(
+    const int axis, std::vector<BlockRun>* runs) const {
+  DCHECK(runs != nullptr);
+  runs->clear();
+  // Sorted by the other two coordinates first, so the blocks of a run follow
+  // each other.
+  const int axis_1 = (axis + 1) % 3;
+  const int axis_2 = (axis + 2) % 3;
+  std::vector<size_t> slots(block_indices_.size());
+  for (size_t slot = 0u; slot < slots.size(); ++slot) {
+    slots[slot] = slot;
+  }
+  std::sort(slots.begin(), slots.end(), [&](size_t a, size_t b) {
+    const BlockIndex& index_a = block_indices_[a];
+    const BlockIndex& index_b = block_indices_[b];
+    return std::make_tuple(index_a[axis_2], index_a[axis_1], index_a[axis]) <
+           std::make_tuple(index_b[axis_2], index_b[axis_1], index_b[axis]);
+  });
+
+  for (size_t i = 0u; i < slots.size(); ++i) {
+    const BlockIndex& block_index = block_indices_[slots[i]];
+    if (i == 0u) {
+      runs->emplace_back();
+    } else {
+      const BlockIndex& last_block_index = block_indices_[slots[i - 1u]];
+      if (last_block_index[axis_1] != block_index[axis_1] ||
+          last_block_index[axis_2] != block_index[axis_2] ||
+          last_block_index[axis] + 1 != block_index[axis]) {
+        runs->emplace_back();
+      }
+    }
+    runs->back().slots.push_back(slots[i]);
+  }
+}
+
+void BlockDistanceTransform::transformRun(
+    const int axis, const BlockRun& run, std::vector<float>* values,
+    std::vector<float>* distances, std::vector<int>* closest,
+    std::vector<int>* sites, std::vector<int>* vertices,
+    std::vector<float>* boundaries) {
+  const size_t row_length = run.slots.size() * voxels_per_side_;
+  values->resize(row_length);
+  distances->resize(row_length);
+  closest->resize(row_length);
+  sites->resize(row_length);
+  vertices->resize(row_length);
+  boundaries->resize(row_length + 1u);
+
+  // Strides of the linear voxel indices along the axis and across the rows.
+  const size_t strides[3] = {1u, voxels_per_side_,
+                             voxels_per_side_ * voxels_per_side_};
+  const size_t stride = strides[axis];
+  const size_t stride_1 = strides[(axis + 1) % 3];
+  const size_t stride_2 = strides[(axis + 2) % 3];
+
+  for (size_t i_2 = 0u; i_2 < voxels_per_side_; ++i_2) {
+    for (size_t i_1 = 0u; i_1 < voxels_per_side_; ++i_1) {
+      const size_t row_offset = i_1 * stride_1 + i_2 * stride_2;
+
+      // The row is gathered, so the transform runs on contiguous memory.
+      size_t q = 0u;
+      for (const size_t slot : run.slots) {
+        const size_t block_offset = slot * num_voxels_per_block_ + row_offset;
+        for (size_t i = 0u; i < voxels_per_side_; ++i, ++q) {
+          const size_t voxel_idx = block_offset + i * stride;
+          (*values)[q] = squared_distances_[voxel_idx];
+          (*sites)[q] = sites_[voxel_idx];
+        }
+      }
+
+      computeDistanceTransform1D(values->data(), static_cast<int>(row_length),
+                                 distances->data(), closest->data(),
+                                 vertices->data(), boundaries->data());
+
+      q = 0u;
+      for (const size_t slot : run.slots) {
+        const size_t block_offset = slot * num_voxels_per_block_ + row_offset;
+        for (size_t i = 0u; i < voxels_per_side_; ++i, ++q) {
+          const size_t voxel_idx = block_offset + i * stride;
+          squared_distances_[voxel_idx] = (*distances)[q];
+          sites_[voxel_idx] =
+              (*closest)[q] < 0 ? kNoSite : (*sites)[(*closest)[q]];
+        }
+      }
+    }
+  }
+}
+
+void BlockDistanceTransform::compute(const size_t num_threads,
+                                     ThreadPool* thread_pool) {
+  CHECK_GT(num_threads, 0u);
+  CHECK(num_threads == 1u || thread_pool != nullptr);
+
+  std::vector<BlockRun> runs;
+  for (int axis = 0; axis < 3; ++axis) {
+    // The runs of an axis share no voxels, so the threads take them in turn.
+    getBlockRuns(axis, &runs);
+    std::atomic<size_t> next_run_idx(0u);
+    auto transform_runs = [&](size_t /*task_idx*/) {
+      std::vector<float> values, distances, boundaries;
+      std::vector<int> closest, sites, vertices;
+      size_t run_idx;
+      while ((run_idx = next_run_idx++) < runs.size()) {
+        transformRun(axis, runs[run_idx], &values, &distances, &closest,
+                     &sites, &vertices, &boundaries);
+      }
+    };
+    if (num_threads == 1u) {
+      transform_runs(0u);
+    } else {
+      thread_pool->runTasks(num_threads, transform_runs);
+    }
+  }
+}
+
+}  // namespace voxblox
@@ -2,6 +2,7 @@
 
 #include "voxblox/core/layer.h"
 #include "voxblox/core/voxel.h"
+#include "voxblox/utils/voxel_utils.h"
 
 namespace voxblox {
 
@@ -77,11 +78,21 @@ bool isObservedVoxel(const TsdfVoxel& voxel) {
   return voxel.weight > 1e-6;
 }
 
+template <>
+bool isObservedVoxel(const CompactTsdfVoxel& voxel) {
+  return getCompactTsdfWeight(voxel) > 1e-6;
+}
+
 template <>
 bool isObservedVoxel(const EsdfVoxel& voxel) {
   return voxel.observed;
 }
 
+template <>
+bool isObservedVoxel(const CompactEsdfVoxel& voxel) {
+  return voxel.observed;
+}
+
 template <>
 FloatingPoint getVoxelSdf(const TsdfVoxel& voxel) {
   return voxel.distance;
@@ -1,5 +1,7 @@
 #include "voxblox/utils/layer_utils.h"
 
+#include "voxblox/utils/voxel_utils.h"
+
 namespace voxblox {
 
 namespace utils {
@@ -51,5 +53,59 @@ bool isSameVoxel(const OccupancyVoxel& voxel_A, const OccupancyVoxel& voxel_B) {
   return is_the_same;
 }
 
+namespace {
+
+/**
+ * Copies all blocks of layer_in into layer_out, converting every observed
+ * voxel. The others are default constructed on both sides.
+ */
+template <typename VoxelTypeIn, typename VoxelTypeOut, typename Converter>
+void convertLayer(const Layer<VoxelTypeIn>& layer_in, const Converter& convert,
+                  Layer<VoxelTypeOut>* layer_out) {
+  CHECK_NOTNULL(layer_out);
+  CHECK_EQ(layer_in.voxels_per_side(), layer_out->voxels_per_side());
+  CHECK_NEAR(layer_in.voxel_size(), layer_out->voxel_size(), 1e-6);
+
+  BlockIndexList block_indices;
+  layer_in.getAllAllocatedBlocks(&block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    const Block<VoxelTypeIn>& block_in = layer_in.getBlockByIndex(block_index);
+    // Start from a fresh block, as only the observed voxels are written.
+    layer_out->removeBlock(block_index);
+    typename Block<VoxelTypeOut>::Ptr block_out =
+        layer_out->allocateBlockPtrByIndex(block_index);
+    block_in.forEachObservedVoxel([&](size_t i) {
+      convert(block_in.getVoxelByLinearIndex(i),
+              &block_out->getVoxelByLinearIndex(i));
+    });
+    block_out->set_has_data(block_in.has_data());
+    block_out->updated() = block_in.updated();
+  }
+}
+
+}  // namespace
+
+void compressTsdfLayer(const Layer<TsdfVoxel>& tsdf_layer,
+                       FloatingPoint truncation_distance,
+                       Layer<CompactTsdfVoxel>* compact_layer) {
+  convertLayer(tsdf_layer,
+               [truncation_distance](const TsdfVoxel& voxel,
+                                     CompactTsdfVoxel* compact_voxel) {
+                 compressTsdfVoxel(voxel, truncation_distance, compact_voxel);
+               },
+               compact_layer);
+}
+
+void decompressTsdfLayer(const Layer<CompactTsdfVoxel>& compact_layer,
+                         FloatingPoint truncation_distance,
+                         Layer<TsdfVoxel>* tsdf_layer) {
+  convertLayer(compact_layer,
+               [truncation_distance](const CompactTsdfVoxel& compact_voxel,
+                                     TsdfVoxel* voxel) {
+                 decompressTsdfVoxel(compact_voxel, truncation_distance, voxel);
+               },
+               tsdf_layer);
+}
+
 }  // namespace utils
 }  // namespace voxblox
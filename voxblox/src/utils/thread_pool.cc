@@ -0,0 +1,170 @@
+#include "voxblox/utils/thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace voxblox {
+
+namespace {
+
+/// Pool and index of the worker running on this thread, if any.
+thread_local const ThreadPool* tls_thread_pool = nullptr;
+thread_local int tls_worker_idx = ThreadPool::kNoAffinity;
+
+}  // namespace
+
+constexpr int ThreadPool::kNoAffinity;
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : num_queued_tasks_(0u), next_queue_(0u), stop_(false) {
+  const size_t num_queues = std::max<size_t>(num_threads, 1u);
+  queues_.reserve(num_queues);
+  for (size_t i = 0u; i < num_queues; ++i) {
+    queues_.emplace_back(new WorkerQueue());
+  }
+  workers_.reserve(num_threads);
+  for (size_t i = 0u; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stop_ = true;
+  }
+  wake_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(const Task& task, TaskGroup* group,
+                        const int affinity) {
+  enqueue(task, group, affinity);
+  wakeWorkers();
+}
+
+void ThreadPool::wait(TaskGroup* group) {
+  CHECK_NOTNULL(group);
+  QueuedTask queued_task;
+  while (!group->done()) {
+    if (popTask(&queued_task)) {
+      runTask(&queued_task);
+      continue;
+    }
+    // All remaining tasks of the group are running on other threads.
+    std::unique_lock<std::mutex> lock(group->mutex_);
+    group->done_condition_.wait(lock, [group]() { return group->done(); });
+  }
+  // The last task signals the group while holding its mutex, so the group may
+  // only go out of scope after taking the mutex once more.
+  std::lock_guard<std::mutex> lock(group->mutex_);
+}
+
+void ThreadPool::runTasks(const size_t num_tasks,
+                          const std::function<void(size_t)>& task) {
+  if (num_tasks == 1u) {
+    task(0u);
+    return;
+  }
+  TaskGroup group;
+  for (size_t i = 0u; i < num_tasks; ++i) {
+    enqueue([&task, i]() { task(i); }, &group, static_cast<int>(i));
+  }
+  wakeWorkers();
+  wait(&group);
+}
+
+int ThreadPool::getWorkerIndex() const {
+  return (tls_thread_pool == this) ? tls_worker_idx : kNoAffinity;
+}
+
+void ThreadPool::enqueue(const Task& task, TaskGroup* group,
+                         const int affinity) {
+  CHECK_NOTNULL(group);
+  const size_t queue_idx =
+      (affinity >= 0) ? static_cast<size_t>(affinity) % queues_.size()
+                      : next_queue_++ % queues_.size();
+  ++group->num_pending_tasks_;
+
+  WorkerQueue& queue = *queues_[queue_idx];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  queue.tasks.push_back(QueuedTask{task, group});
+  ++num_queued_tasks_;
+}
+
+void ThreadPool::wakeWorkers() {
+  // Taking the mutex orders the wake up after the check of sleeping workers.
+  { std::lock_guard<std::mutex> lock(wake_mutex_); }
+  wake_condition_.notify_all();
+}
+
+bool ThreadPool::popTask(QueuedTask* queued_task) {
+  DCHECK(queued_task != nullptr);
+  if (num_queued_tasks_ == 0u) {
+    return false;
+  }
+
+  const int worker_idx = getWorkerIndex();
+  if (worker_idx != kNoAffinity) {
+    WorkerQueue& queue = *queues_[worker_idx];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      *queued_task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      --num_queued_tasks_;
+      return true;
+    }
+  }
+
+  // Steal, starting with the next worker to spread the thieves.
+  const size_t first_queue_idx =
+      (worker_idx == kNoAffinity) ? 0u : static_cast<size_t>(worker_idx) + 1u;
+  for (size_t i = 0u; i < queues_.size(); ++i) {
+    WorkerQueue& queue = *queues_[(first_queue_idx + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      *queued_task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      --num_queued_tasks_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::runTask(QueuedTask* queued_task) {
+  DCHECK(queued_task != nullptr);
+  queued_task->task();
+  queued_task->task = nullptr;
+
+  TaskGroup* group = queued_task->group;
+  std::lock_guard<std::mutex> lock(group->mutex_);
+  if (--group->num_pending_tasks_ == 0u) {
+    group->done_condition_.notify_all();
+  }
+}
+
+void ThreadPool::workerLoop(const size_t worker_idx) {
+  tls_thread_pool = this;
+  tls_worker_idx = static_cast<int>(worker_idx);
+
+  QueuedTask queued_task;
+  while (true) {
+    if (popTask(&queued_task)) {
+      runTask(&queued_task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_condition_.wait(
+        lock, [this]() { return stop_ || num_queued_tasks_ > 0u; });
+    if (stop_ && num_queued_tasks_ == 0u) {
+      return;
+    }
+  }
+}
+
+}  // namespace voxblox
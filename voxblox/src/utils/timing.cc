@@ -183,6 +183,9 @@ void Timing::Print(std::ostream& out) {
   out << "-----------\n";
   for (typename map_t::value_type t : tagMap) {
     size_t i = t.second;
+    if (GetNumSamples(i) == 0) {
+      continue;
+    }
     out.width((std::streamsize)Instance().maxTagLength_);
     out.setf(std::ios::left, std::ios::adjustfield);
     out << t.first << "\t";
@@ -215,7 +218,10 @@ std::string Timing::Print() {
 
 void Timing::Reset() {
   std::lock_guard<std::mutex> lock(Instance().mutex_);
-  Instance().tagMap_.clear();
+  // Keep the tags, handles stay valid so that timers can cache them.
+  for (TimerMapValue& timer : Instance().timers_) {
+    timer = TimerMapValue();
+  }
 }
 
 }  // namespace timing
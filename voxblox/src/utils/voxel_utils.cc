@@ -1,5 +1,7 @@
 #include "voxblox/utils/voxel_utils.h"
 
+#include <cstring>
+
 #include "voxblox/core/color.h"
 #include "voxblox/core/common.h"
 #include "voxblox/core/voxel.h"
@@ -38,4 +40,111 @@ void mergeVoxelAIntoVoxelB(const OccupancyVoxel& voxel_A,
   voxel_B->observed = voxel_B->observed || voxel_A.observed;
 }
 
+template <>
+void mergeVoxelAIntoVoxelB(const CompactTsdfVoxel& voxel_A,
+                           CompactTsdfVoxel* voxel_B) {
+  // With a unit truncation distance the distances are just the normalized
+  // fixed point values.
+  constexpr FloatingPoint kUnitTruncationDistance = 1.0;
+  TsdfVoxel tsdf_voxel_A;
+  TsdfVoxel tsdf_voxel_B;
+  decompressTsdfVoxel(voxel_A, kUnitTruncationDistance, &tsdf_voxel_A);
+  decompressTsdfVoxel(*voxel_B, kUnitTruncationDistance, &tsdf_voxel_B);
+  mergeVoxelAIntoVoxelB(tsdf_voxel_A, &tsdf_voxel_B);
+  compressTsdfVoxel(tsdf_voxel_B, kUnitTruncationDistance, voxel_B);
+}
+
+uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+  const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFFu);
+  uint32_t mantissa = bits & 0x007FFFFFu;
+
+  if (exponent == 0xFF) {
+    // Inf stays inf, NaN stays NaN.
+    return sign | 0x7C00u | (mantissa != 0u ? 0x0200u : 0u);
+  }
+  const int32_t half_exponent = exponent - 127 + 15;
+  if (half_exponent >= 0x1F) {
+    // Too large, saturate to inf.
+    return sign | 0x7C00u;
+  }
+  if (half_exponent <= 0) {
+    // Subnormal or zero.
+    if (half_exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x00800000u;
+    const uint32_t shift = static_cast<uint32_t>(14 - half_exponent);
+    uint32_t half_mantissa = mantissa >> shift;
+    // Round to nearest, ties to even.
+    const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+    const uint32_t halfway = 1u << (shift - 1u);
+    if (remainder > halfway ||
+        (remainder == halfway && (half_mantissa & 1u) != 0u)) {
+      ++half_mantissa;
+    }
+    return sign | static_cast<uint16_t>(half_mantissa);
+  }
+
+  uint32_t half = (static_cast<uint32_t>(half_exponent) << 10) |
+                  (mantissa >> 13);
+  // Round to nearest, ties to even. A carry into the exponent is correct and
+  // may round up to inf.
+  const uint32_t remainder = mantissa & 0x1FFFu;
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u) != 0u)) {
+    ++half;
+  }
+  return sign | static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+  uint32_t exponent = (half >> 10) & 0x1Fu;
+  uint32_t mantissa = half & 0x03FFu;
+
+  uint32_t bits;
+  if (exponent == 0x1Fu) {
+    bits = sign | 0x7F800000u | (mantissa << 13);
+  } else if (exponent == 0u) {
+    if (mantissa == 0u) {
+      bits = sign;
+    } else {
+      // Normalize the subnormal half.
+      exponent = 127 - 15 + 1;
+      while ((mantissa & 0x0400u) == 0u) {
+        mantissa <<= 1;
+        --exponent;
+      }
+      mantissa &= 0x03FFu;
+      bits = sign | (exponent << 23) | (mantissa << 13);
+    }
+  } else {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void compressTsdfVoxel(const TsdfVoxel& voxel,
+                       FloatingPoint truncation_distance,
+                       CompactTsdfVoxel* compact_voxel) {
+  DCHECK(compact_voxel != nullptr);
+  setCompactTsdfDistance(voxel.distance, truncation_distance, compact_voxel);
+  setCompactTsdfWeight(voxel.weight, compact_voxel);
+  compact_voxel->color = voxel.color;
+}
+
+void decompressTsdfVoxel(const CompactTsdfVoxel& compact_voxel,
+                         FloatingPoint truncation_distance, TsdfVoxel* voxel) {
+  DCHECK(voxel != nullptr);
+  voxel->distance = getCompactTsdfDistance(compact_voxel, truncation_distance);
+  voxel->weight = getCompactTsdfWeight(compact_voxel);
+  voxel->color = compact_voxel.color;
+}
+
 }  // namespace voxblox
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/integrator/integrator_utils.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class BatchRayCasterTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<FloatingPoint> coordinate(-50.0, 50.0);
+    std::uniform_int_distribution<int> special_case(0, 9);
+    for (size_t i = 0u; i < kNumRays; ++i) {
+      Point start(coordinate(gen), coordinate(gen), coordinate(gen));
+      Point end(coordinate(gen), coordinate(gen), coordinate(gen));
+      switch (special_case(gen)) {
+        case 0:
+          // Parallel to an axis.
+          end.y() = start.y();
+          end.z() = start.z();
+          break;
+        case 1:
+          // Within a plane through voxel corners.
+          end.x() = start.x() = std::round(start.x());
+          break;
+        case 2:
+          end = start;
+          break;
+        case 3:
+          end.z() = std::numeric_limits<FloatingPoint>::quiet_NaN();
+          break;
+        default:
+          break;
+      }
+      starts_.push_back(start);
+      ends_.push_back(end);
+    }
+  }
+
+  static constexpr size_t kNumRays = 10000u;
+
+  AlignedVector<Point> starts_;
+  AlignedVector<Point> ends_;
+};
+
+TEST_F(BatchRayCasterTest, MatchesRayCaster) {
+  BatchRayCaster batch_ray_caster;
+  size_t num_indices = 0u;
+  for (size_t batch_size = 1u; batch_size <= BatchRayCaster::kMaxNumRays;
+       ++batch_size) {
+    for (size_t first_ray = 0u; first_ray + batch_size <= kNumRays;
+         first_ray += batch_size) {
+      batch_ray_caster.clear();
+      for (size_t i = first_ray; i < first_ray + batch_size; ++i) {
+        EXPECT_EQ(batch_ray_caster.addRay(RayCaster(starts_[i], ends_[i])),
+                  i - first_ray);
+      }
+      EXPECT_EQ(batch_ray_caster.num_rays(), batch_size);
+      EXPECT_EQ(batch_ray_caster.full(),
+                batch_size == BatchRayCaster::kMaxNumRays);
+      batch_ray_caster.castRays();
+
+      for (size_t ray_idx = 0u; ray_idx < batch_size; ++ray_idx) {
+        RayCaster ray_caster(starts_[first_ray + ray_idx],
+                             ends_[first_ray + ray_idx]);
+        GlobalIndex expected_index;
+        size_t step_idx = 0u;
+        while (ray_caster.nextRayIndex(&expected_index)) {
+          ASSERT_LT(step_idx, batch_ray_caster.getNumIndices(ray_idx));
+          ASSERT_EQ(batch_ray_caster.getIndex(ray_idx, step_idx),
+                    expected_index);
+          ++step_idx;
+        }
+        ASSERT_EQ(batch_ray_caster.getNumIndices(ray_idx), step_idx);
+        num_indices += step_idx;
+      }
+    }
+  }
+  EXPECT_GT(num_indices, 0u);
+}
+
+TEST_F(BatchRayCasterTest, MatchesIntegrationRays) {
+  // The rays of the integrators, cast towards or away from the sensor.
+  constexpr FloatingPoint kVoxelSizeInv = 10.0;
+  constexpr FloatingPoint kMaxRayLength = 20.0;
+  constexpr FloatingPoint kTruncationDistance = 0.3;
+  BatchRayCaster batch_ray_caster;
+  for (size_t i = 0u; i < kNumRays; ++i) {
+    const bool is_clearing = (i % 3u == 0u);
+    const bool voxel_carving_enabled = (i % 5u != 0u);
+    const bool cast_from_origin = (i % 2u == 0u);
+    const Point origin = starts_[i] / kVoxelSizeInv;
+    const Point point_G = ends_[i] / kVoxelSizeInv;
+
+    batch_ray_caster.clear();
+    batch_ray_caster.addRay(RayCaster(
+        origin, point_G, is_clearing, voxel_carving_enabled, kMaxRayLength,
+        kVoxelSizeInv, kTruncationDistance, cast_from_origin));
+    batch_ray_caster.castRays();
+
+    RayCaster ray_caster(origin, point_G, is_clearing, voxel_carving_enabled,
+                         kMaxRayLength, kVoxelSizeInv, kTruncationDistance,
+                         cast_from_origin);
+    GlobalIndex expected_index;
+    size_t step_idx = 0u;
+    while (ray_caster.nextRayIndex(&expected_index)) {
+      ASSERT_LT(step_idx, batch_ray_caster.getNumIndices(0u));
+      ASSERT_EQ(batch_ray_caster.getIndex(0u, step_idx), expected_index);
+      ++step_idx;
+    }
+    ASSERT_EQ(batch_ray_caster.getNumIndices(0u), step_idx);
+  }
+}
+
+TEST_F(BatchRayCasterTest, Benchmark) {
+  constexpr int kNumRepetitions = 10;
+  timing::Timing::Reset();
+
+  AlignedVector<RayCaster> ray_casters;
+  for (size_t i = 0u; i < kNumRays; ++i) {
+    ray_casters.emplace_back(starts_[i], ends_[i]);
+  }
+
+  int64_t scalar_checksum = 0;
+  for (int repetition = 0; repetition < kNumRepetitions; ++repetition) {
+    timing::Timer timer("cast_rays/ray_caster");
+    for (RayCaster ray_caster : ray_casters) {
+      GlobalIndex index;
+      while (ray_caster.nextRayIndex(&index)) {
+        scalar_checksum += index.x() + index.y() + index.z();
+      }
+    }
+    timer.Stop();
+  }
+
+  int64_t batch_checksum = 0;
+  const size_t num_rays = kNumRays;
+  BatchRayCaster batch_ray_caster;
+  for (int repetition = 0; repetition < kNumRepetitions; ++repetition) {
+    timing::Timer timer("cast_rays/batch_ray_caster");
+    for (size_t first_ray = 0u; first_ray < num_rays;
+         first_ray += BatchRayCaster::kMaxNumRays) {
+      batch_ray_caster.clear();
+      for (size_t i = first_ray;
+           i < std::min(first_ray + BatchRayCaster::kMaxNumRays, num_rays);
+           ++i) {
+        batch_ray_caster.addRay(ray_casters[i]);
+      }
+      batch_ray_caster.castRays();
+      for (size_t ray_idx = 0u; ray_idx < batch_ray_caster.num_rays();
+           ++ray_idx) {
+        for (size_t i = 0u; i < batch_ray_caster.getNumIndices(ray_idx);
+             ++i) {
+          const GlobalIndex index = batch_ray_caster.getIndex(ray_idx, i);
+          batch_checksum += index.x() + index.y() + index.z();
+        }
+      }
+    }
+    timer.Stop();
+  }
+  EXPECT_EQ(batch_checksum, scalar_checksum);
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
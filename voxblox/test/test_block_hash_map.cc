@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/block_hash.h"
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/utils/flat_hash_map.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class BlockHashMapTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<> dis(-kIndexRange, kIndexRange);
+    for (size_t i = 0u; i < kNumIndices; ++i) {
+      indices_.emplace_back(dis(gen), dis(gen), dis(gen));
+    }
+  }
+
+  static constexpr int kIndexRange = 50;
+  static constexpr size_t kNumIndices = 20000u;
+
+  BlockIndexList indices_;
+};
+
+TEST_F(BlockHashMapTest, MatchesUnorderedMap) {
+  AnyIndexHashMapType<int>::type reference_map;
+  FlatAnyIndexHashMapType<int>::type flat_map;
+
+  // Mix insertions and erasures to exercise the robin hood displacement and
+  // the backward shift deletion.
+  for (size_t i = 0u; i < indices_.size(); ++i) {
+    const BlockIndex& index = indices_[i];
+    if (i % 3u == 2u) {
+      EXPECT_EQ(reference_map.erase(index), flat_map.erase(index));
+    } else {
+      const bool inserted_reference =
+          reference_map.emplace(index, static_cast<int>(i)).second;
+      std::pair<FlatAnyIndexHashMapType<int>::type::iterator, bool>
+          insert_status = flat_map.emplace(index, static_cast<int>(i));
+      EXPECT_EQ(inserted_reference, insert_status.second);
+      EXPECT_EQ(insert_status.first->first, index);
+      EXPECT_EQ(insert_status.first->second, reference_map[index]);
+    }
+    ASSERT_EQ(reference_map.size(), flat_map.size());
+  }
+
+  for (const BlockIndex& index : indices_) {
+    ASSERT_EQ(reference_map.count(index), flat_map.count(index));
+    if (reference_map.count(index) > 0u) {
+      EXPECT_EQ(reference_map[index], flat_map.find(index)->second);
+    } else {
+      EXPECT_TRUE(flat_map.find(index) == flat_map.end());
+    }
+  }
+
+  // Iteration visits every element exactly once.
+  size_t num_visited = 0u;
+  for (const std::pair<const BlockIndex, int>& kv : flat_map) {
+    EXPECT_EQ(reference_map.count(kv.first), 1u);
+    EXPECT_EQ(reference_map[kv.first], kv.second);
+    ++num_visited;
+  }
+  EXPECT_EQ(num_visited, reference_map.size());
+
+  FlatAnyIndexHashMapType<int>::type flat_map_copy(flat_map);
+  flat_map.clear();
+  EXPECT_TRUE(flat_map.empty());
+  EXPECT_TRUE(flat_map.begin() == flat_map.end());
+  EXPECT_EQ(flat_map_copy.size(), reference_map.size());
+  for (const std::pair<const BlockIndex, int>& kv : reference_map) {
+    EXPECT_EQ(flat_map_copy.at(kv.first), kv.second);
+  }
+}
+
+TEST_F(BlockHashMapTest, LayerWithEitherMap) {
+  constexpr FloatingPoint kVoxelSize = 0.1;
+  constexpr size_t kVoxelsPerSide = 8u;
+  Layer<TsdfVoxel> flat_layer(kVoxelSize, kVoxelsPerSide);
+  Layer<TsdfVoxel, AnyIndexHashMapType> node_layer(kVoxelSize, kVoxelsPerSide);
+
+  for (size_t i = 0u; i < 1000u; ++i) {
+    const BlockIndex& index = indices_[i];
+    const float distance = static_cast<float>(i);
+    Block<TsdfVoxel>::Ptr flat_block =
+        flat_layer.allocateBlockPtrByIndex(index);
+    Block<TsdfVoxel>::Ptr node_block =
+        node_layer.allocateBlockPtrByIndex(index);
+    flat_block->getVoxelByLinearIndex(0u).distance = distance;
+    node_block->getVoxelByLinearIndex(0u).distance = distance;
+  }
+  flat_layer.removeDistantBlocks(Point::Zero(), 2.0);
+  node_layer.removeDistantBlocks(Point::Zero(), 2.0);
+
+  ASSERT_EQ(flat_layer.getNumberOfAllocatedBlocks(),
+            node_layer.getNumberOfAllocatedBlocks());
+  BlockIndexList flat_blocks;
+  flat_layer.getAllAllocatedBlocks(&flat_blocks);
+  for (const BlockIndex& index : flat_blocks) {
+    ASSERT_TRUE(node_layer.hasBlock(index));
+    EXPECT_EQ(
+        flat_layer.getBlockByIndex(index).getVoxelByLinearIndex(0u).distance,
+        node_layer.getBlockByIndex(index).getVoxelByLinearIndex(0u).distance);
+  }
+}
+
+template <typename BlockHashMap>
+void benchmarkBlockHashMap(const std::string& name,
+                           const BlockIndexList& indices) {
+  BlockHashMap block_map;
+
+  timing::Timer insert_timer(name + "/insert");
+  for (const BlockIndex& index : indices) {
+    block_map.emplace(index, Block<TsdfVoxel>::Ptr());
+  }
+  insert_timer.Stop();
+
+  size_t num_found = 0u;
+  timing::Timer lookup_timer(name + "/lookup");
+  for (const BlockIndex& index : indices) {
+    num_found += block_map.count(index);
+  }
+  lookup_timer.Stop();
+  EXPECT_EQ(num_found, indices.size());
+
+  size_t num_iterated = 0u;
+  timing::Timer iterate_timer(name + "/iterate");
+  for (const typename BlockHashMap::value_type& kv : block_map) {
+    num_iterated += (kv.second == nullptr) ? 1u : 0u;
+  }
+  iterate_timer.Stop();
+  EXPECT_EQ(num_iterated, indices.size());
+}
+
+TEST_F(BlockHashMapTest, Benchmark) {
+  // 2^20 blocks in a dense cube, i.e. a map of 1M+ blocks.
+  constexpr int kSideLength = 1 << 7;
+  BlockIndexList dense_indices;
+  dense_indices.reserve(kSideLength * kSideLength * kSideLength / 2);
+  for (int x = 0; x < kSideLength; ++x) {
+    for (int y = 0; y < kSideLength; ++y) {
+      for (int z = 0; z < kSideLength / 2; ++z) {
+        dense_indices.emplace_back(x - kSideLength / 2, y, z);
+      }
+    }
+  }
+  std::shuffle(dense_indices.begin(), dense_indices.end(), std::mt19937(1));
+
+  timing::Timing::Reset();
+  benchmarkBlockHashMap<Layer<TsdfVoxel, AnyIndexHashMapType>::BlockHashMap>(
+      "unordered_map", dense_indices);
+  benchmarkBlockHashMap<Layer<TsdfVoxel>::BlockHashMap>("flat_hash_map",
+                                                         dense_indices);
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
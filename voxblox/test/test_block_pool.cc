@@ -0,0 +1,147 @@
+#include <iostream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/block_pool.h"
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class BlockPoolTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+  }
+
+  /// Allocates a row of blocks along x and marks every voxel as observed.
+  void allocateRow(int first_x, int num_blocks) {
+    for (int x = first_x; x < first_x + num_blocks; ++x) {
+      Block<TsdfVoxel>::Ptr block =
+          layer_->allocateBlockPtrByIndex(BlockIndex(x, 0, 0));
+      for (size_t i = 0u; i < block->num_voxels(); ++i) {
+        block->getVoxelByLinearIndex(i).weight = 1.0f;
+      }
+      block->set_has_data(true);
+      block->updated().set();
+    }
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 8u;
+
+  Layer<TsdfVoxel>::Ptr layer_;
+};
+
+TEST_F(BlockPoolTest, RecycledBlocksAreReset) {
+  constexpr int kNumBlocks = 10;
+  allocateRow(0, kNumBlocks);
+  EXPECT_EQ(layer_->getBlockPool().getNumPooledBlocks(), 0u);
+
+  layer_->removeAllBlocks();
+  EXPECT_EQ(layer_->getNumberOfAllocatedBlocks(), 0u);
+  EXPECT_EQ(layer_->getBlockPool().getNumPooledBlocks(),
+            static_cast<size_t>(kNumBlocks));
+
+  const size_t num_hits_before = layer_->getBlockPool().getNumHits();
+  const size_t num_hit_samples_before =
+      timing::Timing::GetNumSamples("block_pool/hit");
+  for (int x = -kNumBlocks; x < 0; ++x) {
+    const BlockIndex block_index(x, 0, 0);
+    Block<TsdfVoxel>::Ptr block = layer_->allocateBlockPtrByIndex(block_index);
+    EXPECT_EQ(block->block_index(), block_index);
+    EXPECT_FALSE(block->has_data());
+    EXPECT_FALSE(block->updated().any());
+    for (size_t i = 0u; i < block->num_voxels(); ++i) {
+      ASSERT_EQ(block->getVoxelByLinearIndex(i).weight, 0.0f);
+    }
+  }
+  EXPECT_EQ(layer_->getBlockPool().getNumHits() - num_hits_before,
+            static_cast<size_t>(kNumBlocks));
+  EXPECT_EQ(
+      timing::Timing::GetNumSamples("block_pool/hit") - num_hit_samples_before,
+      static_cast<size_t>(kNumBlocks));
+  EXPECT_EQ(layer_->getBlockPool().getNumPooledBlocks(), 0u);
+}
+
+TEST_F(BlockPoolTest, ReferencedBlocksAreNotRecycled) {
+  allocateRow(0, 2);
+  Block<TsdfVoxel>::Ptr held_block =
+      layer_->getBlockPtrByIndex(BlockIndex(0, 0, 0));
+
+  layer_->removeBlock(BlockIndex(0, 0, 0));
+  layer_->removeBlock(BlockIndex(1, 0, 0));
+  EXPECT_EQ(layer_->getBlockPool().getNumPooledBlocks(), 1u);
+
+  // The block we still hold must stay untouched by later allocations.
+  allocateRow(5, 2);
+  EXPECT_TRUE(held_block->has_data());
+  EXPECT_EQ(held_block->block_index(), BlockIndex(0, 0, 0));
+}
+
+TEST_F(BlockPoolTest, HighWaterMark) {
+  constexpr size_t kMaxNumPooledBlocks = 4u;
+  layer_->setMaxNumPooledBlocks(kMaxNumPooledBlocks);
+  allocateRow(0, 10);
+
+  layer_->removeDistantBlocks(Point::Zero(), 0.0);
+  EXPECT_EQ(layer_->getNumberOfAllocatedBlocks(), 1u);
+  EXPECT_EQ(layer_->getBlockPool().getNumPooledBlocks(), kMaxNumPooledBlocks);
+
+  layer_->setMaxNumPooledBlocks(1u);
+  EXPECT_EQ(layer_->getBlockPool().getNumPooledBlocks(), 1u);
+
+  layer_->setMaxNumPooledBlocks(0u);
+  layer_->removeAllBlocks();
+  EXPECT_EQ(layer_->getBlockPool().getNumPooledBlocks(), 0u);
+}
+
+TEST_F(BlockPoolTest, Benchmark) {
+  // Simulates a robot driving along x that keeps a window of blocks around
+  // itself, i.e. every step allocates a slice of blocks in front and removes
+  // one behind.
+  constexpr int kWindowHalfSize = 8;
+  constexpr int kNumSteps = 200;
+  const FloatingPoint block_size = kVoxelSize * kVoxelsPerSide;
+
+  const size_t kMaxNumPooledBlocks[] = {
+      0u, BlockPool<TsdfVoxel>::kDefaultMaxNumPooledBlocks};
+
+  timing::Timing::Reset();
+  for (const size_t max_num_pooled_blocks : kMaxNumPooledBlocks) {
+    SetUp();
+    layer_->setMaxNumPooledBlocks(max_num_pooled_blocks);
+    const std::string name =
+        max_num_pooled_blocks == 0u ? "no_pool" : "block_pool";
+
+    timing::Timer churn_timer(name + "/churn");
+    for (int step = 0; step < kNumSteps; ++step) {
+      for (int y = -kWindowHalfSize; y < kWindowHalfSize; ++y) {
+        for (int z = -kWindowHalfSize; z < kWindowHalfSize; ++z) {
+          layer_->allocateBlockPtrByIndex(
+              BlockIndex(step + kWindowHalfSize, y, z));
+        }
+      }
+      const Point robot_position(step * block_size, 0.0, 0.0);
+      layer_->removeDistantBlocks(robot_position,
+                                  2.0 * kWindowHalfSize * block_size);
+    }
+    churn_timer.Stop();
+
+    std::cout << name << " hit rate: " << layer_->getBlockPool().getHitRate()
+              << std::endl;
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
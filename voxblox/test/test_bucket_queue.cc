@@ -1,6 +1,15 @@
+#include <cstdlib>
+#include <limits>
+#include <iostream>
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include "voxblox/core/common.h"
 #include "voxblox/utils/bucket_queue.h"
+#include "voxblox/utils/neighbor_tools.h"
+#include "voxblox/utils/timing.h"
 
 namespace voxblox {
 
@@ -64,6 +73,225 @@ TEST(BucketQueueTest, GetSmallestValue) {
   }
 }
 
+TEST(BucketQueueTest, RingBucketQueueSameOrder) {
+  std::srand(0);
+  constexpr double kMaxDistance = 20.0;
+
+  // More than one word of the bitmap.
+  for (const int num_buckets : {20, 150}) {
+    BucketQueue<size_t> bucket_queue(num_buckets, kMaxDistance);
+    RingBucketQueue<size_t> ring_bucket_queue(num_buckets, kMaxDistance);
+
+    // Interleaved, so the rings wrap around and grow.
+    size_t key = 0u;
+    for (int round = 0; round < 50; ++round) {
+      const int num_pushes = std::rand() % 100;  // NOLINT
+      for (int i = 0; i < num_pushes; ++i, ++key) {
+        // Also values beyond the maximum.
+        const double value =
+            randomDoubleInRange(-1.5 * kMaxDistance, 1.5 * kMaxDistance);
+        bucket_queue.push(key, value);
+        ring_bucket_queue.push(key, value);
+      }
+      const int num_pops = std::rand() % 100;  // NOLINT
+      for (int i = 0; i < num_pops && !bucket_queue.empty(); ++i) {
+        ASSERT_FALSE(ring_bucket_queue.empty());
+        EXPECT_EQ(ring_bucket_queue.frontBucketIndex(),
+                  bucket_queue.frontBucketIndex());
+        EXPECT_EQ(ring_bucket_queue.front(), bucket_queue.front());
+        bucket_queue.pop();
+        ring_bucket_queue.pop();
+      }
+    }
+    while (!bucket_queue.empty()) {
+      ASSERT_FALSE(ring_bucket_queue.empty());
+      EXPECT_EQ(ring_bucket_queue.front(), bucket_queue.front());
+      bucket_queue.pop();
+      ring_bucket_queue.pop();
+    }
+    EXPECT_TRUE(ring_bucket_queue.empty());
+
+    ring_bucket_queue.push(1u, 0.0);
+    ring_bucket_queue.clear();
+    EXPECT_TRUE(ring_bucket_queue.empty());
+  }
+}
+
+TEST(BucketQueueTest, RingBucketQueueDecreaseKey) {
+  constexpr int kNumBuckets = 10;
+  constexpr double kMaxDistance = 9.0;
+  RingBucketQueue<size_t> bucket_queue(kNumBuckets, kMaxDistance);
+  bucket_queue.setDecreaseKey(true);
+
+  bucket_queue.push(0u, 5.0);
+  bucket_queue.push(1u, 5.0);
+  bucket_queue.push(2u, 7.0);
+  bucket_queue.push(3u, 2.0);
+  // A lower bucket moves the key, the same or a higher one keeps its place.
+  bucket_queue.push(2u, 3.0);
+  bucket_queue.push(0u, 5.5);
+  bucket_queue.push(3u, 8.0);
+  EXPECT_EQ(bucket_queue.size(), 4u);
+
+  std::vector<size_t> keys;
+  std::vector<int> bucket_indices;
+  while (!bucket_queue.empty()) {
+    bucket_indices.push_back(bucket_queue.frontBucketIndex());
+    keys.push_back(bucket_queue.front());
+    bucket_queue.pop();
+  }
+  EXPECT_EQ(keys, std::vector<size_t>({3u, 2u, 0u, 1u}));
+  EXPECT_EQ(bucket_indices, std::vector<int>({2, 3, 5, 5}));
+
+  // Popped keys are queued again, and the left behind entry of key 2 in
+  // bucket 7 is not mistaken for it.
+  bucket_queue.push(2u, 8.0);
+  EXPECT_EQ(bucket_queue.size(), 1u);
+  EXPECT_EQ(bucket_queue.frontBucketIndex(), 8);
+  EXPECT_EQ(bucket_queue.front(), 2u);
+  bucket_queue.pop();
+  EXPECT_TRUE(bucket_queue.empty());
+}
+
+TEST(BucketQueueTest, SelectableBucketQueue) {
+  constexpr int kNumBuckets = 10;
+  constexpr double kMaxDistance = 9.0;
+  SelectableBucketQueue<size_t> bucket_queue;
+  bucket_queue.setNumBuckets(kNumBuckets, kMaxDistance);
+
+  // Without decrease-key every push is queued.
+  for (const bool decrease_key : {false, true}) {
+    bucket_queue.setDecreaseKey(decrease_key);
+    bucket_queue.push(0u, 5.0);
+    bucket_queue.push(1u, 7.0);
+    bucket_queue.push(0u, 2.0);
+    EXPECT_EQ(bucket_queue.size(), decrease_key ? 2u : 3u);
+
+    std::vector<size_t> keys;
+    while (!bucket_queue.empty()) {
+      keys.push_back(bucket_queue.front());
+      bucket_queue.pop();
+    }
+    EXPECT_EQ(keys, decrease_key ? std::vector<size_t>({0u, 1u})
+                                 : std::vector<size_t>({0u, 0u, 1u}));
+  }
+}
+
+/**
+ * Dijkstra-like wavefront through a grid from its center, with the keys pushed
+ * again whenever their distance decreases.
+ */
+template <typename QueueType>
+size_t propagateWavefront(int grid_size, QueueType* queue) {
+  std::vector<float> distances(grid_size * grid_size * grid_size,
+                               std::numeric_limits<float>::max());
+  auto get_key = [grid_size](const GlobalIndex& index) {
+    return static_cast<size_t>(index.x() +
+                               grid_size * (index.y() + grid_size * index.z()));
+  };
+  const GlobalIndex center = GlobalIndex::Constant(grid_size / 2);
+  distances[get_key(center)] = 0.0f;
+  queue->push(get_key(center), 0.0);
+
+  size_t num_pops = 0u;
+  Neighborhood<>::IndexMatrix neighbor_indices;
+  while (!queue->empty()) {
+    const size_t key = queue->front();
+    queue->pop();
+    ++num_pops;
+    const GlobalIndex index(key % grid_size, (key / grid_size) % grid_size,
+                            key / (grid_size * grid_size));
+    Neighborhood<>::getFromGlobalIndex(index, &neighbor_indices);
+    for (unsigned int idx = 0u; idx < neighbor_indices.cols(); ++idx) {
+      const GlobalIndex& neighbor_index = neighbor_indices.col(idx);
+      if ((neighbor_index.array() < 0).any() ||
+          (neighbor_index.array() >= grid_size).any()) {
+        continue;
+      }
+      const float distance =
+          distances[key] + NeighborhoodLookupTables::kDistances[idx];
+      const size_t neighbor_key = get_key(neighbor_index);
+      if (distance < distances[neighbor_key]) {
+        distances[neighbor_key] = distance;
+        queue->push(neighbor_key, distance);
+      }
+    }
+  }
+  return num_pops;
+}
+
+TEST(BucketQueueTest, Benchmark) {
+  constexpr int kNumBuckets = 20;
+  constexpr double kMaxDistance = 20.0;
+  constexpr size_t kNumElements = 100000u;
+  constexpr int kNumRepetitions = 5;
+  constexpr int kGridSize = 40;
+  timing::Timing::Reset();
+
+  std::srand(0);
+  std::vector<double> values(kNumElements);
+  for (double& value : values) {
+    value = randomDoubleInRange(-kMaxDistance, kMaxDistance);
+  }
+
+  // The queues are reused like the open set of the ESDF integrator.
+  BucketQueue<size_t> bucket_queue(kNumBuckets, kMaxDistance);
+  RingBucketQueue<size_t> ring_bucket_queue(kNumBuckets, kMaxDistance);
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    timing::Timer bucket_timer("push_pop/bucket_queue");
+    for (size_t key = 0u; key < kNumElements; ++key) {
+      bucket_queue.push(key, values[key]);
+    }
+    while (!bucket_queue.empty()) {
+      bucket_queue.front();
+      bucket_queue.pop();
+    }
+    bucket_timer.Stop();
+
+    timing::Timer ring_timer("push_pop/ring_bucket_queue");
+    for (size_t key = 0u; key < kNumElements; ++key) {
+      ring_bucket_queue.push(key, values[key]);
+    }
+    while (!ring_bucket_queue.empty()) {
+      ring_bucket_queue.front();
+      ring_bucket_queue.pop();
+    }
+    ring_timer.Stop();
+  }
+
+  // Duplicates in the bucket queues against decrease-key.
+  const int max_wavefront_distance = kGridSize;
+  bucket_queue.setNumBuckets(kNumBuckets, max_wavefront_distance);
+  ring_bucket_queue.setNumBuckets(kNumBuckets, max_wavefront_distance);
+  RingBucketQueue<size_t> decrease_key_queue(kNumBuckets,
+                                             max_wavefront_distance);
+  decrease_key_queue.setDecreaseKey(true);
+  size_t num_pops = 0u;
+  size_t num_ring_pops = 0u;
+  size_t num_decrease_key_pops = 0u;
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    timing::Timer bucket_timer("wavefront/bucket_queue");
+    num_pops = propagateWavefront(kGridSize, &bucket_queue);
+    bucket_timer.Stop();
+
+    timing::Timer ring_timer("wavefront/ring_bucket_queue");
+    num_ring_pops = propagateWavefront(kGridSize, &ring_bucket_queue);
+    ring_timer.Stop();
+
+    timing::Timer decrease_key_timer("wavefront/decrease_key");
+    num_decrease_key_pops = propagateWavefront(kGridSize, &decrease_key_queue);
+    decrease_key_timer.Stop();
+  }
+  std::cout << "Wavefront pops with duplicates: " << num_pops
+            << ", with decrease-key: " << num_decrease_key_pops << std::endl;
+  EXPECT_EQ(num_ring_pops, num_pops);
+  EXPECT_EQ(num_decrease_key_pops,
+            static_cast<size_t>(kGridSize * kGridSize * kGridSize));
+  EXPECT_GE(num_pops, num_decrease_key_pops);
+
+  std::cout << timing::Timing::Print();
+}
+
 }  // namespace voxblox
 
 int main(int argc, char** argv) {
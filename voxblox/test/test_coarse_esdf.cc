@@ -0,0 +1,170 @@
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/esdf_map.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class CoarseEsdfTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // Sparse obstacles without a ground plane, so most of the space is far
+    // from any surface.
+    world_.setBounds(Point(-8.0, -8.0, -1.0), Point(8.0, 8.0, 3.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addObject(std::unique_ptr<Object>(
+        new Cube(Point(-5.0, 4.0, 1.0), Point(2.0, 2.0, 2.0), Color::Green())));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(5.0, -4.0, 1.0), 0.5, Color::Blue())));
+
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    world_.generateSdfFromWorld(kTruncationDistance, tsdf_layer_.get());
+
+    esdf_config_.max_distance_m = kFineMaxDistance;
+    esdf_config_.default_distance_m = kFineMaxDistance;
+    esdf_config_.min_distance_m = kTruncationDistance / 2.0;
+
+    map_config_.esdf_voxel_size = kVoxelSize;
+    map_config_.esdf_voxels_per_side = kVoxelsPerSide;
+    map_config_.coarse_max_distance_m = kCoarseMaxDistance;
+  }
+
+  Eigen::Vector3d getRandomPosition() {
+    std::uniform_real_distribution<double> horizontal(-7.5, 7.5);
+    std::uniform_real_distribution<double> vertical(-0.5, 2.5);
+    return Eigen::Vector3d(horizontal(gen_), horizontal(gen_), vertical(gen_));
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.2;
+  static constexpr size_t kVoxelsPerSide = 8u;
+  static constexpr FloatingPoint kTruncationDistance = 3 * kVoxelSize;
+  static constexpr FloatingPoint kFineMaxDistance = 1.0;
+  static constexpr FloatingPoint kCoarseMaxDistance = 10.0;
+
+  SimulationWorld world_;
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+  EsdfIntegrator::Config esdf_config_;
+  EsdfMap::Config map_config_;
+  std::mt19937 gen_;
+};
+
+TEST_F(CoarseEsdfTest, LowerBoundBeyondFineDistance) {
+  const FloatingPoint fine_max_distance = kFineMaxDistance;
+  const FloatingPoint coarse_max_distance = kCoarseMaxDistance;
+  EsdfMap esdf_map(map_config_);
+  EsdfMap fine_esdf_map(map_config_);
+  fine_esdf_map.setCoarseMaxDistance(0.0);
+  EXPECT_TRUE(esdf_map.usesCoarseLevel());
+  EXPECT_FALSE(fine_esdf_map.usesCoarseLevel());
+  EsdfIntegrator(esdf_config_, tsdf_layer_.get(), esdf_map.getEsdfLayerPtr())
+      .updateFromTsdfLayerBatch();
+  EsdfIntegrator(esdf_config_, tsdf_layer_.get(),
+                 fine_esdf_map.getEsdfLayerPtr())
+      .updateFromTsdfLayerBatch();
+  esdf_map.updateCoarseLevel(fine_max_distance);
+  ASSERT_TRUE(esdf_map.getCoarseLayerPtr() != nullptr);
+  EXPECT_EQ(esdf_map.getCoarseLayerPtr()->voxel_size(), esdf_map.block_size());
+
+  size_t num_extended = 0u;
+  for (size_t i = 0u; i < 2000u; ++i) {
+    const Eigen::Vector3d position = getRandomPosition();
+    double fine_distance, distance;
+    const bool observed =
+        fine_esdf_map.getDistanceAtPosition(position, &fine_distance);
+    ASSERT_EQ(esdf_map.getDistanceAtPosition(position, &distance), observed);
+    if (!observed) {
+      continue;
+    }
+
+    // Near surfaces the fine level is used as is.
+    if (fine_distance < fine_max_distance) {
+      EXPECT_EQ(distance, fine_distance);
+      continue;
+    }
+    EXPECT_GE(distance, fine_distance);
+    EXPECT_LE(distance, coarse_max_distance);
+    const FloatingPoint true_distance = world_.getDistanceToPoint(
+        position.cast<FloatingPoint>(), 2.0 * coarse_max_distance);
+    EXPECT_LE(distance, true_distance + kVoxelSize) << position.transpose();
+
+    double gradient_distance;
+    Eigen::Vector3d gradient;
+    esdf_map.getDistanceAndGradientAtPosition(position, &gradient_distance,
+                                              &gradient);
+    EXPECT_EQ(gradient_distance, distance);
+    if (distance > fine_distance) {
+      ++num_extended;
+    }
+  }
+  std::cout << "Extended " << num_extended << " of 2000 distances."
+            << std::endl;
+  EXPECT_GT(num_extended, 100u);
+}
+
+TEST_F(CoarseEsdfTest, TracksFineLayer) {
+  EsdfMap esdf_map(map_config_);
+  EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                 esdf_map.getEsdfLayerPtr());
+  esdf_integrator.updateFromTsdfLayerBatch();
+  esdf_map.updateCoarseLevel(kFineMaxDistance);
+
+  // Far from all obstacles, until one shows up next to it.
+  const Eigen::Vector3d position(5.0, 5.0, 1.0);
+  double distance;
+  ASSERT_TRUE(esdf_map.getDistanceAtPosition(position, &distance));
+  EXPECT_GT(distance, 3.0);
+
+  world_.addObject(std::unique_ptr<Object>(
+      new Sphere(Point(5.0, 6.5, 1.0), 0.5, Color::Pink())));
+  world_.generateSdfFromWorld(kTruncationDistance, tsdf_layer_.get());
+  esdf_integrator.updateFromTsdfLayerBatch();
+  esdf_map.updateCoarseLevel(kFineMaxDistance);
+  ASSERT_TRUE(esdf_map.getDistanceAtPosition(position, &distance));
+  EXPECT_LE(distance, 1.0 + kVoxelSize);
+}
+
+TEST_F(CoarseEsdfTest, Benchmark) {
+  constexpr int kNumRepetitions = 3;
+  timing::Timing::Reset();
+
+  EsdfMap esdf_map(map_config_);
+  EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                 esdf_map.getEsdfLayerPtr());
+  EsdfIntegrator::Config long_range_config = esdf_config_;
+  long_range_config.max_distance_m = 5.0;
+  long_range_config.default_distance_m = 5.0;
+  Layer<EsdfVoxel> long_range_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator long_range_esdf_integrator(
+      long_range_config, tsdf_layer_.get(), &long_range_esdf_layer);
+
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    timing::Timer coarse_timer("batch/fine_1m_coarse_10m");
+    esdf_integrator.updateFromTsdfLayerBatch();
+    esdf_map.updateCoarseLevel(kFineMaxDistance);
+    coarse_timer.Stop();
+
+    timing::Timer long_range_timer("batch/fine_5m");
+    long_range_esdf_integrator.updateFromTsdfLayerBatch();
+    long_range_timer.Stop();
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,187 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/esdf_map.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/voxel_utils.h"
+
+using namespace voxblox;  // NOLINT
+
+class CompactEsdfVoxelTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-3.0, -3.0, -1.0), Point(3.0, 3.0, 3.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addObject(std::unique_ptr<Object>(
+        new Cube(Point(-2.0, 2.0, 0.5), Point(1.0, 1.0, 1.0), Color::Green())));
+    world_.addGroundLevel(0.0);
+
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    world_.generateSdfFromWorld(kTruncationDistance, tsdf_layer_.get());
+
+    esdf_config_.min_distance_m = kTruncationDistance / 2.0;
+  }
+
+  /**
+   * Expects the voxels of both layers to be the same, returns the number of
+   * observed voxels.
+   */
+  static size_t compareLayers(const Layer<EsdfVoxel>& layer,
+                              const Layer<CompactEsdfVoxel>& compact_layer) {
+    BlockIndexList blocks;
+    layer.getAllAllocatedBlocks(&blocks);
+    EXPECT_EQ(compact_layer.getNumberOfAllocatedBlocks(), blocks.size());
+    size_t num_observed = 0u;
+    for (const BlockIndex& block_index : blocks) {
+      const Block<EsdfVoxel>& block = layer.getBlockByIndex(block_index);
+      const Block<CompactEsdfVoxel>& compact_block =
+          compact_layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        const CompactEsdfVoxel& compact_voxel =
+            compact_block.getVoxelByLinearIndex(i);
+        EXPECT_EQ(voxel.distance, compact_voxel.distance);
+        EXPECT_EQ(voxel.observed, compact_voxel.observed);
+        EXPECT_EQ(voxel.hallucinated, compact_voxel.hallucinated);
+        EXPECT_EQ(voxel.in_queue, compact_voxel.in_queue);
+        EXPECT_EQ(voxel.fixed, compact_voxel.fixed);
+        EXPECT_EQ(voxel.parent, getEsdfParent(compact_voxel));
+        num_observed += voxel.observed ? 1u : 0u;
+      }
+    }
+    return num_observed;
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+  static constexpr FloatingPoint kTruncationDistance = 3 * kVoxelSize;
+
+  SimulationWorld world_;
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+  EsdfIntegrator::Config esdf_config_;
+};
+
+TEST_F(CompactEsdfVoxelTest, Layout) {
+  EXPECT_EQ(sizeof(CompactEsdfVoxel), 8u);
+  EXPECT_LT(2u * sizeof(CompactEsdfVoxel), sizeof(EsdfVoxel));
+  EXPECT_EQ(getVoxelType<CompactEsdfVoxel>(), getVoxelType<EsdfVoxel>());
+
+  CompactEsdfVoxel voxel;
+  EXPECT_FALSE(voxel.observed || voxel.hallucinated || voxel.in_queue ||
+               voxel.fixed);
+  EXPECT_EQ(getEsdfParent(voxel), SignedIndex::Zero());
+  setEsdfParent(SignedIndex(-3, 0, 127), &voxel);
+  EXPECT_EQ(getEsdfParent(voxel), SignedIndex(-3, 0, 127));
+  setEsdfParent(SignedIndex(200, -200, 5), &voxel);
+  EXPECT_EQ(getEsdfParent(voxel), SignedIndex(127, -127, 5));
+}
+
+TEST_F(CompactEsdfVoxelTest, IntegratorMatches) {
+  for (const bool full_euclidean_distance : {false, true}) {
+    for (const bool exact_batch_distance : {false, true}) {
+      EsdfIntegrator::Config config = esdf_config_;
+      config.full_euclidean_distance = full_euclidean_distance;
+      config.exact_batch_distance = exact_batch_distance;
+      Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+      Layer<CompactEsdfVoxel> compact_esdf_layer(kVoxelSize, kVoxelsPerSide);
+      EsdfIntegrator esdf_integrator(config, tsdf_layer_.get(), &esdf_layer);
+      CompactEsdfIntegrator compact_esdf_integrator(config, tsdf_layer_.get(),
+                                                    &compact_esdf_layer);
+      esdf_integrator.updateFromTsdfLayerBatch();
+      compact_esdf_integrator.updateFromTsdfLayerBatch();
+      EXPECT_GT(compareLayers(esdf_layer, compact_esdf_layer), 0u);
+      EXPECT_LT(2u * compact_esdf_layer.getMemorySize(),
+                esdf_layer.getMemorySize());
+
+      // Clearing space around a robot raises and lowers voxels incrementally.
+      for (const Point& position :
+           {Point(1.5, 0.0, 1.0), Point(0.0, -2.0, 1.0)}) {
+        esdf_integrator.addNewRobotPosition(position);
+        compact_esdf_integrator.addNewRobotPosition(position);
+        constexpr bool kClearUpdatedFlag = false;
+        esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+        compact_esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+      }
+      EXPECT_GT(compareLayers(esdf_layer, compact_esdf_layer), 0u);
+    }
+  }
+}
+
+TEST_F(CompactEsdfVoxelTest, Serialization) {
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator(esdf_config_, tsdf_layer_.get(), &esdf_layer)
+      .updateFromTsdfLayerBatch();
+
+  // Either layout reads the blocks of the other.
+  BlockIndexList blocks;
+  esdf_layer.getAllAllocatedBlocks(&blocks);
+  Layer<CompactEsdfVoxel> compact_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  Layer<EsdfVoxel> round_trip_layer(kVoxelSize, kVoxelsPerSide);
+  for (const BlockIndex& block_index : blocks) {
+    std::vector<uint32_t> data;
+    esdf_layer.getBlockByIndex(block_index).serializeToIntegers(&data);
+    Block<CompactEsdfVoxel>& compact_block =
+        *compact_esdf_layer.allocateBlockPtrByIndex(block_index);
+    compact_block.deserializeFromIntegers(data);
+
+    std::vector<uint32_t> compact_data;
+    compact_block.serializeToIntegers(&compact_data);
+    EXPECT_EQ(compact_data, data);
+    round_trip_layer.allocateBlockPtrByIndex(block_index)
+        ->deserializeFromIntegers(compact_data);
+  }
+  EXPECT_GT(compareLayers(esdf_layer, compact_esdf_layer), 0u);
+  EXPECT_GT(compareLayers(round_trip_layer, compact_esdf_layer), 0u);
+}
+
+TEST_F(CompactEsdfVoxelTest, MapMatches) {
+  EsdfMap::Config map_config;
+  map_config.esdf_voxel_size = kVoxelSize;
+  map_config.esdf_voxels_per_side = kVoxelsPerSide;
+  EsdfMap esdf_map(map_config);
+  CompactEsdfMap compact_esdf_map(map_config);
+  EsdfIntegrator(esdf_config_, tsdf_layer_.get(), esdf_map.getEsdfLayerPtr())
+      .updateFromTsdfLayerBatch();
+  CompactEsdfIntegrator(esdf_config_, tsdf_layer_.get(),
+                        compact_esdf_map.getEsdfLayerPtr())
+      .updateFromTsdfLayerBatch();
+
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> dis(-2.5, 2.5);
+  size_t num_observed = 0u;
+  for (size_t i = 0u; i < 1000u; ++i) {
+    const Eigen::Vector3d position(dis(gen), dis(gen), dis(gen) / 2.0 + 1.0);
+    double distance, compact_distance;
+    Eigen::Vector3d gradient, compact_gradient;
+    const bool observed = esdf_map.getDistanceAndGradientAtPosition(
+        position, &distance, &gradient);
+    ASSERT_EQ(compact_esdf_map.getDistanceAndGradientAtPosition(
+                  position, &compact_distance, &compact_gradient),
+              observed);
+    ASSERT_EQ(compact_esdf_map.isObserved(position),
+              esdf_map.isObserved(position));
+    if (observed) {
+      EXPECT_EQ(distance, compact_distance);
+      EXPECT_EQ(gradient, compact_gradient);
+      ++num_observed;
+    }
+  }
+  EXPECT_GT(num_observed, 0u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
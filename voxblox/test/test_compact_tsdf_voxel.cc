@@ -0,0 +1,233 @@
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/mesh/mesh_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/layer_utils.h"
+#include "voxblox/utils/voxel_utils.h"
+
+using namespace voxblox;  // NOLINT
+
+class CompactTsdfVoxelTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-3.0, -3.0, -1.0), Point(3.0, 3.0, 3.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addGroundLevel(0.0);
+
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    world_.generateSdfFromWorld(kTruncationDistance, tsdf_layer_.get());
+
+    compact_layer_.reset(
+        new Layer<CompactTsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    utils::compressTsdfLayer(*tsdf_layer_, kTruncationDistance,
+                             compact_layer_.get());
+    tsdf_layer_->getAllAllocatedBlocks(&blocks_);
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+  static constexpr FloatingPoint kTruncationDistance = 4 * kVoxelSize;
+  /// Resolution of the fixed point distance.
+  static constexpr FloatingPoint kDistanceTolerance =
+      kTruncationDistance / CompactTsdfVoxel::kMaxDistance;
+
+  SimulationWorld world_;
+  BlockIndexList blocks_;
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+  std::unique_ptr<Layer<CompactTsdfVoxel>> compact_layer_;
+};
+
+TEST_F(CompactTsdfVoxelTest, HalfConversion) {
+  EXPECT_EQ(sizeof(CompactTsdfVoxel), 8u);
+
+  const float kExactValues[] = {0.0f, 1.0f, 0.5f, 2.0f, 10000.0f, 65504.0f};
+  for (const float value : kExactValues) {
+    EXPECT_EQ(halfToFloat(floatToHalf(value)), value);
+  }
+  EXPECT_TRUE(std::isinf(halfToFloat(floatToHalf(1e6f))));
+  // Smallest subnormal half.
+  EXPECT_EQ(halfToFloat(floatToHalf(std::ldexp(1.0f, -24))),
+            std::ldexp(1.0f, -24));
+
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> dis(-10.0f, 15.0f);
+  for (size_t i = 0u; i < 10000u; ++i) {
+    const float value = std::exp2(dis(gen));
+    const float round_trip = halfToFloat(floatToHalf(value));
+    ASSERT_NEAR(round_trip, value, value * std::ldexp(1.0f, -11));
+  }
+}
+
+TEST_F(CompactTsdfVoxelTest, LayerRoundTrip) {
+  EXPECT_EQ(getVoxelType<CompactTsdfVoxel>(), voxel_types::kCompactTsdf);
+  EXPECT_LT(compact_layer_->getMemorySize(), tsdf_layer_->getMemorySize());
+
+  Layer<TsdfVoxel> round_trip_layer(kVoxelSize, kVoxelsPerSide);
+  utils::decompressTsdfLayer(*compact_layer_, kTruncationDistance,
+                             &round_trip_layer);
+  ASSERT_EQ(round_trip_layer.getNumberOfAllocatedBlocks(), blocks_.size());
+  for (const BlockIndex& block_index : blocks_) {
+    const Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(block_index);
+    const Block<TsdfVoxel>& round_trip_block =
+        round_trip_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const TsdfVoxel& round_trip_voxel =
+          round_trip_block.getVoxelByLinearIndex(i);
+      ASSERT_NEAR(voxel.distance, round_trip_voxel.distance,
+                  kDistanceTolerance);
+      ASSERT_EQ(voxel.weight, round_trip_voxel.weight);
+      ASSERT_EQ(voxel.color.r, round_trip_voxel.color.r);
+    }
+  }
+}
+
+TEST_F(CompactTsdfVoxelTest, Serialization) {
+  for (const BlockIndex& block_index : blocks_) {
+    const Block<CompactTsdfVoxel>& block =
+        compact_layer_->getBlockByIndex(block_index);
+    std::vector<uint32_t> data;
+    block.serializeToIntegers(&data);
+    EXPECT_EQ(data.size(), 2u * block.num_voxels());
+
+    Block<CompactTsdfVoxel> deserialized_block(kVoxelsPerSide, kVoxelSize,
+                                               block.origin());
+    deserialized_block.deserializeFromIntegers(data);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const CompactTsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const CompactTsdfVoxel& deserialized_voxel =
+          deserialized_block.getVoxelByLinearIndex(i);
+      ASSERT_EQ(voxel.distance, deserialized_voxel.distance);
+      ASSERT_EQ(voxel.weight, deserialized_voxel.weight);
+      ASSERT_EQ(voxel.color.a, deserialized_voxel.color.a);
+    }
+  }
+}
+
+TEST_F(CompactTsdfVoxelTest, IntegrationMatches) {
+  const Transformation T_G_C(
+      Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+      Point(2.5, 0.0, 1.5));
+  Pointcloud points_G, points_C;
+  Colors colors;
+  world_.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(64, 48), 2.0, 6.0,
+                                    &points_G, &colors);
+  transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+
+  TsdfIntegratorBase::Config config;
+  config.default_truncation_distance = kTruncationDistance;
+  config.integrator_threads = 1u;
+  // Sums of whole weights up to 2048 are exact in half precision, smaller
+  // weights would be rounded on every update.
+  config.use_const_weight = true;
+  config.use_weight_dropoff = false;
+
+  Layer<TsdfVoxel> integrated_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator(config, &integrated_layer)
+      .integratePointCloud(T_G_C, points_C, colors);
+  Layer<CompactTsdfVoxel> compressed_layer(kVoxelSize, kVoxelsPerSide);
+  utils::compressTsdfLayer(integrated_layer, kTruncationDistance,
+                           &compressed_layer);
+
+  Layer<CompactTsdfVoxel> compact_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator(config, &compact_layer)
+      .integratePointCloud(T_G_C, points_C, colors);
+
+  BlockIndexList blocks;
+  compressed_layer.getAllAllocatedBlocks(&blocks);
+  ASSERT_FALSE(blocks.empty());
+  ASSERT_EQ(compact_layer.getNumberOfAllocatedBlocks(), blocks.size());
+  for (const BlockIndex& block_index : blocks) {
+    ASSERT_TRUE(compact_layer.hasBlock(block_index));
+    const Block<CompactTsdfVoxel>& compressed_block =
+        compressed_layer.getBlockByIndex(block_index);
+    const Block<CompactTsdfVoxel>& block =
+        compact_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const CompactTsdfVoxel& compressed_voxel =
+          compressed_block.getVoxelByLinearIndex(i);
+      const CompactTsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      ASSERT_EQ(hasVoxelData(voxel), hasVoxelData(compressed_voxel));
+      // Every update is quantized, so the rounding errors add up.
+      ASSERT_NEAR(getCompactTsdfDistance(voxel, kTruncationDistance),
+                  getCompactTsdfDistance(compressed_voxel, kTruncationDistance),
+                  1e-3);
+      ASSERT_EQ(voxel.weight, compressed_voxel.weight);
+    }
+  }
+}
+
+TEST_F(CompactTsdfVoxelTest, MeshMatches) {
+  MeshIntegratorConfig config;
+  MeshLayer mesh_layer(tsdf_layer_->block_size());
+  MeshLayer compact_mesh_layer(compact_layer_->block_size());
+  MeshIntegrator<TsdfVoxel> mesh_integrator(config, *tsdf_layer_, &mesh_layer);
+  MeshIntegrator<CompactTsdfVoxel> compact_mesh_integrator(
+      config, *compact_layer_, &compact_mesh_layer);
+  constexpr bool kOnlyMeshUpdatedBlocks = false;
+  constexpr bool kClearUpdatedFlag = false;
+  mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+  compact_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks,
+                                       kClearUpdatedFlag);
+
+  size_t num_vertices = 0u;
+  for (const BlockIndex& block_index : blocks_) {
+    const Mesh& mesh = mesh_layer.getMeshByIndex(block_index);
+    const Mesh& compact_mesh = compact_mesh_layer.getMeshByIndex(block_index);
+    ASSERT_EQ(mesh.vertices.size(), compact_mesh.vertices.size());
+    for (size_t i = 0u; i < mesh.vertices.size(); ++i) {
+      EXPECT_LT((mesh.vertices[i] - compact_mesh.vertices[i]).norm(), 1e-3);
+    }
+    num_vertices += mesh.vertices.size();
+  }
+  EXPECT_GT(num_vertices, 0u);
+}
+
+TEST_F(CompactTsdfVoxelTest, EsdfMatches) {
+  EsdfIntegrator::Config config;
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  Layer<EsdfVoxel> compact_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(config, tsdf_layer_.get(), &esdf_layer);
+  EsdfIntegrator compact_esdf_integrator(config, &compact_esdf_layer);
+  esdf_integrator.updateFromTsdfBlocks(blocks_);
+  compact_esdf_integrator.updateFromTsdfBlocks(
+      *compact_layer_, kTruncationDistance, blocks_);
+
+  size_t num_observed = 0u;
+  for (const BlockIndex& block_index : blocks_) {
+    const Block<EsdfVoxel>& block = esdf_layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& compact_block =
+        compact_esdf_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const EsdfVoxel& compact_voxel = compact_block.getVoxelByLinearIndex(i);
+      ASSERT_EQ(voxel.observed, compact_voxel.observed);
+      // Quantization may flip voxels at the edge of the fixed band, which
+      // then differ by about a voxel.
+      ASSERT_NEAR(voxel.distance, compact_voxel.distance, kVoxelSize);
+      num_observed += voxel.observed ? 1u : 0u;
+    }
+  }
+  EXPECT_GT(num_observed, 0u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/block_pool.h"
+#include "voxblox/core/common.h"
+#include "voxblox/core/concurrent_block_map.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class ConcurrentBlockMapTest : public ::testing::Test {
+ protected:
+  typedef ConcurrentBlockMap<Block<TsdfVoxel>> BlockMap;
+
+  virtual void SetUp() {
+    // Every thread requests all blocks of a cube, in its own random order.
+    for (int x = 0; x < kBlocksPerSide; ++x) {
+      for (int y = 0; y < kBlocksPerSide; ++y) {
+        for (int z = 0; z < kBlocksPerSide; ++z) {
+          block_indices_.emplace_back(x, y, z);
+        }
+      }
+    }
+  }
+
+  /**
+   * Lets num_threads threads request every block once and returns the number
+   * of blocks that were allocated.
+   */
+  size_t allocateFromThreads(size_t num_threads, BlockMap* block_map,
+                             std::vector<BlockIndexList>* thread_indices,
+                             std::vector<std::vector<Block<TsdfVoxel>::Ptr>>*
+                                 thread_blocks) {
+    BlockPool<TsdfVoxel> block_pool;
+    std::atomic<size_t> num_allocations(0u);
+    auto allocate_block = [&](const BlockIndex& index) {
+      ++num_allocations;
+      return block_pool.allocateBlock(
+          kVoxelsPerSide, kVoxelSize,
+          getOriginPointFromGridIndex(index, kVoxelSize * kVoxelsPerSide));
+    };
+
+    thread_indices->assign(num_threads, block_indices_);
+    thread_blocks->assign(num_threads, {});
+    std::vector<std::thread> threads;
+    for (size_t thread_idx = 0u; thread_idx < num_threads; ++thread_idx) {
+      std::shuffle((*thread_indices)[thread_idx].begin(),
+                   (*thread_indices)[thread_idx].end(),
+                   std::mt19937(thread_idx));
+      threads.emplace_back([&, thread_idx]() {
+        for (const BlockIndex& index : (*thread_indices)[thread_idx]) {
+          (*thread_blocks)[thread_idx].push_back(
+              block_map->findOrAllocate(index, allocate_block));
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    return num_allocations;
+  }
+
+  static constexpr int kBlocksPerSide = 12;
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 8u;
+
+  BlockIndexList block_indices_;
+};
+
+TEST_F(ConcurrentBlockMapTest, StressAllocate) {
+  constexpr size_t kNumThreads = 16u;
+  for (const size_t num_shards : {1u, 64u}) {
+    BlockMap block_map(num_shards);
+    std::vector<BlockIndexList> thread_indices;
+    std::vector<std::vector<Block<TsdfVoxel>::Ptr>> thread_blocks;
+    const size_t num_allocations = allocateFromThreads(
+        kNumThreads, &block_map, &thread_indices, &thread_blocks);
+
+    // Every block is allocated exactly once and all threads got the same one.
+    EXPECT_EQ(num_allocations, block_indices_.size());
+    EXPECT_EQ(block_map.size(), block_indices_.size());
+    for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+      for (size_t i = 0u; i < block_indices_.size(); ++i) {
+        const BlockIndex& index = thread_indices[thread_idx][i];
+        const Block<TsdfVoxel>::Ptr block = block_map.find(index);
+        ASSERT_TRUE(block);
+        ASSERT_EQ(thread_blocks[thread_idx][i], block);
+        ASSERT_EQ(block->origin(), getOriginPointFromGridIndex(
+                                       index, kVoxelSize * kVoxelsPerSide));
+      }
+    }
+
+    size_t num_visited = 0u;
+    block_map.forEachBlock(
+        [&num_visited](const BlockIndex& /*index*/,
+                       const Block<TsdfVoxel>::Ptr& /*block*/) {
+          ++num_visited;
+        });
+    EXPECT_EQ(num_visited, block_indices_.size());
+    block_map.clear();
+    EXPECT_TRUE(block_map.empty());
+    EXPECT_FALSE(block_map.find(block_indices_.front()));
+  }
+}
+
+TEST_F(ConcurrentBlockMapTest, MultiThreadedIntegration) {
+  SimulationWorld world;
+  world.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+  world.addObject(std::unique_ptr<Object>(
+      new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+  world.addGroundLevel(0.0);
+
+  const Transformation T_G_C(
+      Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+      Point(4.0, 0.0, 1.5));
+  Pointcloud points_G, points_C;
+  Colors colors;
+  world.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(160, 120), 2.0, 8.0,
+                                   &points_G, &colors);
+  transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+
+  TsdfIntegratorBase::Config config;
+  config.integrator_threads = 1u;
+  Layer<TsdfVoxel> single_thread_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator(config, &single_thread_layer)
+      .integratePointCloud(T_G_C, points_C, colors);
+
+  config.integrator_threads = 8u;
+  Layer<TsdfVoxel> multi_thread_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator(config, &multi_thread_layer)
+      .integratePointCloud(T_G_C, points_C, colors);
+
+  BlockIndexList blocks;
+  single_thread_layer.getAllAllocatedBlocks(&blocks);
+  EXPECT_GT(blocks.size(), 0u);
+  ASSERT_EQ(multi_thread_layer.getNumberOfAllocatedBlocks(), blocks.size());
+  size_t num_observed = 0u;
+  size_t num_different = 0u;
+  for (const BlockIndex& block_index : blocks) {
+    ASSERT_TRUE(multi_thread_layer.hasBlock(block_index));
+    const Block<TsdfVoxel>& block =
+        single_thread_layer.getBlockByIndex(block_index);
+    const Block<TsdfVoxel>& multi_thread_block =
+        multi_thread_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      // The threads fuse the measurements in a different order, which only
+      // changes the rounding of the accumulated weights. The fused distance
+      // however gets clamped to the truncation distance after every
+      // measurement, there the order changes it within the truncation band.
+      const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const TsdfVoxel& multi_thread_voxel =
+          multi_thread_block.getVoxelByLinearIndex(i);
+      ASSERT_NEAR(voxel.distance, multi_thread_voxel.distance,
+                  2.0 * config.default_truncation_distance);
+      ASSERT_NEAR(voxel.weight, multi_thread_voxel.weight,
+                  1e-5 * voxel.weight + 1e-6);
+      if (voxel.weight > 0.0f) {
+        ++num_observed;
+      }
+      if (std::abs(voxel.distance - multi_thread_voxel.distance) > 1e-4) {
+        ++num_different;
+      }
+    }
+  }
+  std::cout << num_different << " of " << num_observed
+            << " voxel distances differ." << std::endl;
+  EXPECT_LT(num_different, num_observed / 100u);
+}
+
+TEST_F(ConcurrentBlockMapTest, Benchmark) {
+  // A single shard corresponds to the previous map behind one mutex.
+  constexpr int kNumRepetitions = 5;
+  timing::Timing::Reset();
+  for (const size_t num_threads : {1u, 4u, 16u}) {
+    for (const size_t num_shards : {1u, 64u}) {
+      const std::string timer_name =
+          "allocate/" + std::to_string(num_threads) + "_threads/" +
+          std::to_string(num_shards) + "_shards";
+      for (int i = 0; i < kNumRepetitions; ++i) {
+        BlockMap block_map(num_shards);
+        std::vector<BlockIndexList> thread_indices;
+        std::vector<std::vector<Block<TsdfVoxel>::Ptr>> thread_blocks;
+        timing::Timer timer(timer_name);
+        allocateFromThreads(num_threads, &block_map, &thread_indices,
+                            &thread_blocks);
+        timer.Stop();
+      }
+    }
+  }
+
+  SimulationWorld world;
+  world.setBounds(Point(-10.0, -10.0, -1.0), Point(10.0, 10.0, 4.0));
+  world.addGroundLevel(0.0);
+  const Transformation T_G_C(
+      Quaternion(Eigen::AngleAxis<FloatingPoint>(0.3, Point::UnitY())),
+      Point(0.0, 0.0, 2.0));
+  Pointcloud points_C;
+  Colors colors;
+  world.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(320, 240), 2.0,
+                                   10.0, &points_C, &colors);
+
+  TsdfIntegratorBase::Config config;
+  config.max_ray_length_m = 10.0;
+  for (const size_t num_threads : {1u, 4u, 16u}) {
+    for (const size_t num_shards : {1u, 64u}) {
+      config.integrator_threads = num_threads;
+      config.num_block_map_shards = num_shards;
+      const std::string timer_name =
+          "fresh_terrain/" + std::to_string(num_threads) + "_threads/" +
+          std::to_string(num_shards) + "_shards";
+      for (int i = 0; i < kNumRepetitions; ++i) {
+        Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+        FastTsdfIntegrator integrator(config, &layer);
+        timing::Timer timer(timer_name);
+        integrator.integratePointCloud(T_G_C, points_C, colors);
+        timer.Stop();
+      }
+    }
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
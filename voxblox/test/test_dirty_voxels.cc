@@ -0,0 +1,304 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/mesh/mesh_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class DirtyVoxelsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addObject(std::unique_ptr<Object>(
+        new Cube(Point(-2.0, 2.0, 0.5), Point(1.0, 1.0, 1.0), Color::Green())));
+    world_.addGroundLevel(0.0);
+
+    // A sensor slowly moving around the scene, each scan mostly observes
+    // voxels that were observed before.
+    constexpr int kNumPoses = 12;
+    for (int i = 0; i < kNumPoses; ++i) {
+      const FloatingPoint angle = 0.5 * M_PI * i / kNumPoses;
+      const Point position(4.0 * std::sin(angle), 4.0 * std::cos(angle), 1.5);
+      const FloatingPoint yaw = std::atan2(-position.y(), -position.x());
+      const Transformation T_G_C(
+          Quaternion(Eigen::AngleAxis<FloatingPoint>(yaw, Point::UnitZ())),
+          position);
+      Pointcloud points_G, points_C;
+      Colors colors;
+      world_.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(160, 120), 2.0,
+                                        8.0, &points_G, &colors);
+      transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+      poses_.push_back(T_G_C);
+      clouds_C_.push_back(points_C);
+      colors_.push_back(colors);
+    }
+
+    config_.integrator_threads = 1u;
+    config_.max_ray_length_m = 8.0;
+  }
+
+  void integrateScan(size_t scan_idx, TsdfIntegratorBase* integrator) const {
+    integrator->integratePointCloud(poses_[scan_idx], clouds_C_[scan_idx],
+                                    colors_[scan_idx]);
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  SimulationWorld world_;
+  TsdfIntegratorBase::Config config_;
+  AlignedVector<Transformation> poses_;
+  AlignedVector<Pointcloud> clouds_C_;
+  AlignedVector<Colors> colors_;
+};
+
+TEST_F(DirtyVoxelsTest, MarkAndIterate) {
+  Block<TsdfVoxel> block(kVoxelsPerSide, kVoxelSize, Point::Zero());
+  // A new block is dirty as a whole.
+  EXPECT_TRUE(block.isVoxelDirty(Update::kMesh, 0u));
+  EXPECT_TRUE(block.isVoxelDirty(Update::kEsdf, block.num_voxels() - 1u));
+
+  block.clearDirtyVoxels(Update::kMesh);
+  EXPECT_FALSE(block.hasDirtyVoxels(Update::kMesh));
+  EXPECT_TRUE(block.hasDirtyVoxels(Update::kEsdf));
+
+  // Without marked voxels all voxels are visited.
+  size_t num_visited_voxels = 0u;
+  block.forEachDirtyVoxel(
+      Update::kMesh, [&](size_t /*linear_index*/) { ++num_visited_voxels; });
+  EXPECT_EQ(num_visited_voxels, block.num_voxels());
+
+  const std::vector<size_t> dirty_voxels = {3u, 64u, 65u, 1000u,
+                                            block.num_voxels() - 1u};
+  for (auto it = dirty_voxels.rbegin(); it != dirty_voxels.rend(); ++it) {
+    block.markVoxelDirty(*it);
+  }
+  block.markVoxelDirty(64u);
+  std::vector<size_t> visited_voxels;
+  block.forEachDirtyVoxel(Update::kMesh, [&](size_t linear_index) {
+    visited_voxels.push_back(linear_index);
+  });
+  EXPECT_EQ(visited_voxels, dirty_voxels);
+  EXPECT_TRUE(block.isVoxelDirty(Update::kMesh, 65u));
+  EXPECT_FALSE(block.isVoxelDirty(Update::kMesh, 66u));
+
+  block.clearDirtyVoxels(Update::kMesh);
+  block.markAllVoxelsDirty(Update::kMesh);
+  for (size_t i = 0u; i < block.num_voxels(); ++i) {
+    ASSERT_TRUE(block.isVoxelDirty(Update::kMesh, i));
+  }
+
+  block.reinitialize(Point::Ones());
+  EXPECT_TRUE(block.isVoxelDirty(Update::kMap, 7u));
+}
+
+TEST_F(DirtyVoxelsTest, IntegratorsRecordUpdatedVoxels) {
+  for (const std::string& integrator_name :
+       {std::string("simple"), std::string("merged"), std::string("fast"),
+        std::string("partitioned")}) {
+    TsdfIntegratorBase::Config config = config_;
+    config.track_dirty_voxels = true;
+    Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+    TsdfIntegratorBase::Ptr integrator =
+        TsdfIntegratorFactory::create(integrator_name, config, &layer);
+    integrateScan(0u, integrator.get());
+
+    BlockIndexList blocks;
+    layer.getAllAllocatedBlocks(&blocks);
+    for (const BlockIndex& block_index : blocks) {
+      layer.getBlockByIndex(block_index).clearDirtyVoxels(Update::kMesh);
+    }
+    Layer<TsdfVoxel> previous_layer(layer);
+
+    integrateScan(1u, integrator.get());
+    size_t num_dirty_voxels = 0u;
+    for (const BlockIndex& block_index : blocks) {
+      const Block<TsdfVoxel>& block = layer.getBlockByIndex(block_index);
+      const Block<TsdfVoxel>& previous_block =
+          previous_layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        const TsdfVoxel& previous_voxel =
+            previous_block.getVoxelByLinearIndex(i);
+        if (voxel.weight != previous_voxel.weight ||
+            voxel.distance != previous_voxel.distance) {
+          ASSERT_TRUE(block.isVoxelDirty(Update::kMesh, i)) << integrator_name;
+        }
+        if (block.isVoxelDirty(Update::kMesh, i)) {
+          ++num_dirty_voxels;
+        }
+      }
+    }
+    EXPECT_GT(num_dirty_voxels, 0u) << integrator_name;
+  }
+}
+
+TEST_F(DirtyVoxelsTest, IncrementalMeshMatchesFullMesh) {
+  TsdfIntegratorBase::Config config = config_;
+  config.track_dirty_voxels = true;
+  Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator integrator(config, &layer);
+
+  MeshIntegratorConfig mesh_config;
+  mesh_config.integrator_threads = 2u;
+  MeshLayer mesh_layer(layer.block_size());
+  MeshIntegrator<TsdfVoxel> mesh_integrator(mesh_config, &layer, &mesh_layer);
+  constexpr bool kOnlyMeshUpdatedBlocks = true;
+  constexpr bool kClearUpdatedFlag = true;
+
+  for (size_t scan_idx = 0u; scan_idx < poses_.size(); ++scan_idx) {
+    integrateScan(scan_idx, &integrator);
+
+    // Without cached meshes all updated blocks are fully meshed.
+    BlockIndexList updated_blocks;
+    layer.getAllUpdatedBlocks(Update::kMesh, &updated_blocks);
+    MeshLayer full_mesh_layer(layer.block_size());
+    MeshIntegrator<TsdfVoxel> full_mesh_integrator(mesh_config, layer,
+                                                   &full_mesh_layer);
+    full_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, false);
+
+    mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+
+    for (const BlockIndex& block_index : updated_blocks) {
+      const Mesh& mesh = mesh_layer.getMeshByIndex(block_index);
+      const Mesh& full_mesh = full_mesh_layer.getMeshByIndex(block_index);
+      ASSERT_EQ(mesh.vertices.size(), full_mesh.vertices.size()) << scan_idx;
+      ASSERT_EQ(mesh.indices, full_mesh.indices);
+      for (size_t i = 0u; i < mesh.vertices.size(); ++i) {
+        ASSERT_EQ(mesh.vertices[i], full_mesh.vertices[i]) << scan_idx;
+        ASSERT_EQ(mesh.normals[i], full_mesh.normals[i]) << scan_idx;
+        ASSERT_EQ(mesh.colors[i].r, full_mesh.colors[i].r) << scan_idx;
+        ASSERT_EQ(mesh.colors[i].g, full_mesh.colors[i].g) << scan_idx;
+        ASSERT_EQ(mesh.colors[i].b, full_mesh.colors[i].b) << scan_idx;
+      }
+    }
+  }
+}
+
+TEST_F(DirtyVoxelsTest, IncrementalEsdfMatchesFullEsdf) {
+  TsdfIntegratorBase::Config config = config_;
+  config.track_dirty_voxels = true;
+  Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator integrator(config, &layer);
+  Layer<TsdfVoxel> full_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator full_integrator(config_, &full_layer);
+
+  EsdfIntegrator::Config esdf_config;
+  esdf_config.max_distance_m = 2.0;
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  Layer<EsdfVoxel> full_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(esdf_config, &layer, &esdf_layer);
+  EsdfIntegrator full_esdf_integrator(esdf_config, &full_layer,
+                                      &full_esdf_layer);
+  constexpr bool kClearUpdatedFlag = true;
+
+  for (size_t scan_idx = 0u; scan_idx < poses_.size(); ++scan_idx) {
+    integrateScan(scan_idx, &integrator);
+    integrateScan(scan_idx, &full_integrator);
+    esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+    full_esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+  }
+
+  BlockIndexList blocks;
+  full_esdf_layer.getAllAllocatedBlocks(&blocks);
+  ASSERT_GT(blocks.size(), 0u);
+  ASSERT_EQ(esdf_layer.getNumberOfAllocatedBlocks(), blocks.size());
+  for (const BlockIndex& block_index : blocks) {
+    const Block<EsdfVoxel>& block = esdf_layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& full_block =
+        full_esdf_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      ASSERT_EQ(block.getVoxelByLinearIndex(i).observed,
+                full_block.getVoxelByLinearIndex(i).observed);
+      ASSERT_EQ(block.getVoxelByLinearIndex(i).distance,
+                full_block.getVoxelByLinearIndex(i).distance);
+    }
+  }
+}
+
+TEST_F(DirtyVoxelsTest, Benchmark) {
+  MeshIntegratorConfig mesh_config;
+  mesh_config.integrator_threads = 1u;
+  EsdfIntegrator::Config esdf_config;
+  esdf_config.max_distance_m = 2.0;
+  constexpr bool kOnlyMeshUpdatedBlocks = true;
+  constexpr bool kClearUpdatedFlag = true;
+
+  // After the first scan only the part of the scans around the sphere is
+  // integrated, as when a single object is observed again, which touches
+  // small parts of many blocks.
+  AlignedVector<Pointcloud> local_clouds_C(clouds_C_.size());
+  AlignedVector<Colors> local_colors(clouds_C_.size());
+  for (size_t scan_idx = 0u; scan_idx < clouds_C_.size(); ++scan_idx) {
+    for (size_t i = 0u; i < clouds_C_[scan_idx].size(); ++i) {
+      const Point point_G = poses_[scan_idx] * clouds_C_[scan_idx][i];
+      if ((point_G - Point(0.0, 0.0, 1.0)).norm() < 1.1) {
+        local_clouds_C[scan_idx].push_back(clouds_C_[scan_idx][i]);
+        local_colors[scan_idx].push_back(colors_[scan_idx][i]);
+      }
+    }
+  }
+
+  timing::Timing::Reset();
+  for (const size_t voxels_per_side : {16u, 32u}) {
+    for (const bool track_dirty_voxels : {false, true}) {
+      const std::string name =
+          std::string(track_dirty_voxels ? "dirty_voxels" : "updated_blocks") +
+          "/vps_" + std::to_string(voxels_per_side);
+      TsdfIntegratorBase::Config config = config_;
+      config.track_dirty_voxels = track_dirty_voxels;
+      Layer<TsdfVoxel> layer(kVoxelSize, voxels_per_side);
+      SimpleTsdfIntegrator integrator(config, &layer);
+      MeshLayer mesh_layer(layer.block_size());
+      MeshIntegrator<TsdfVoxel> mesh_integrator(mesh_config, &layer,
+                                                &mesh_layer);
+      Layer<EsdfVoxel> esdf_layer(kVoxelSize, voxels_per_side);
+      EsdfIntegrator esdf_integrator(esdf_config, &layer, &esdf_layer);
+
+      integrateScan(0u, &integrator);
+      mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+      esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+
+      for (size_t scan_idx = 1u; scan_idx < poses_.size(); ++scan_idx) {
+        timing::Timer integrate_timer(name + "/integrate");
+        integrator.integratePointCloud(poses_[scan_idx],
+                                       local_clouds_C[scan_idx],
+                                       local_colors[scan_idx]);
+        integrate_timer.Stop();
+
+        timing::Timer mesh_timer(name + "/mesh");
+        mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks,
+                                     kClearUpdatedFlag);
+        mesh_timer.Stop();
+
+        timing::Timer esdf_timer(name + "/esdf");
+        esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+        esdf_timer.Stop();
+      }
+    }
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/distance_transform.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+TEST(DistanceTransformTest, MatchesBruteForce1D) {
+  constexpr int kNumSamples = 200;
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> value(0.0f, 100.0f);
+  std::uniform_real_distribution<float> probability(0.0f, 1.0f);
+
+  std::vector<float> values(kNumSamples), distances(kNumSamples),
+      boundaries(kNumSamples + 1);
+  std::vector<int> closest(kNumSamples), vertices(kNumSamples);
+  for (const float site_probability : {0.0f, 0.01f, 0.2f, 1.0f}) {
+    for (int i = 0; i < kNumSamples; ++i) {
+      values[i] = probability(gen) < site_probability ? value(gen) : kInfinity;
+    }
+    computeDistanceTransform1D(values.data(), kNumSamples, distances.data(),
+                               closest.data(), vertices.data(),
+                               boundaries.data());
+
+    for (int q = 0; q < kNumSamples; ++q) {
+      float min_distance = kInfinity;
+      for (int p = 0; p < kNumSamples; ++p) {
+        min_distance =
+            std::min(min_distance, static_cast<float>((q - p) * (q - p)) +
+                                       values[p]);
+      }
+      if (std::isinf(min_distance)) {
+        EXPECT_TRUE(std::isinf(distances[q]));
+        EXPECT_EQ(closest[q], -1);
+        continue;
+      }
+      EXPECT_NEAR(distances[q], min_distance, 1e-3) << q;
+      ASSERT_GE(closest[q], 0);
+      EXPECT_NEAR(static_cast<float>((q - closest[q]) * (q - closest[q])) +
+                      values[closest[q]],
+                  min_distance, 1e-3);
+    }
+  }
+}
+
+TEST(DistanceTransformTest, MatchesBruteForce3D) {
+  constexpr size_t kVoxelsPerSide = 8u;
+  constexpr int kMargin = 1;
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> block_coordinate(-3, 3);
+  std::uniform_int_distribution<int> voxel_coordinate(0, kVoxelsPerSide - 1);
+
+  BlockIndexList blocks;
+  for (int i = 0; i < 12; ++i) {
+    blocks.emplace_back(block_coordinate(gen), block_coordinate(gen),
+                        block_coordinate(gen));
+  }
+  GlobalIndexVector sites;
+  for (int i = 0; i < 40; ++i) {
+    const BlockIndex& block_index = blocks[i % blocks.size()];
+    sites.push_back(getGlobalVoxelIndexFromBlockAndVoxelIndex(
+        block_index,
+        VoxelIndex(voxel_coordinate(gen), voxel_coordinate(gen),
+                   voxel_coordinate(gen)),
+        kVoxelsPerSide));
+  }
+
+  BlockDistanceTransform distance_transform(kVoxelsPerSide);
+  for (const BlockIndex& block_index : blocks) {
+    distance_transform.addBlock(block_index, kMargin);
+  }
+  for (size_t i = 0u; i < sites.size(); ++i) {
+    distance_transform.addSite(sites[i], static_cast<int>(i));
+  }
+  distance_transform.compute();
+
+  // Exact within the margin around the blocks.
+  const float max_squared_distance = kMargin * kMargin * kVoxelsPerSide *
+                                     kVoxelsPerSide;
+  size_t num_checked_voxels = 0u;
+  Block<EsdfVoxel> block(kVoxelsPerSide, 1.0, Point::Zero());
+  for (const BlockIndex& block_index : blocks) {
+    for (size_t lin_index = 0u; lin_index < block.num_voxels(); ++lin_index) {
+      const GlobalIndex global_index =
+          getGlobalVoxelIndexFromBlockAndVoxelIndex(
+              block_index, block.computeVoxelIndexFromLinearIndex(lin_index),
+              kVoxelsPerSide);
+      float min_squared_distance = std::numeric_limits<float>::infinity();
+      for (const GlobalIndex& site : sites) {
+        min_squared_distance = std::min(
+            min_squared_distance,
+            static_cast<float>((site - global_index).squaredNorm()));
+      }
+      float squared_distance;
+      const int site = distance_transform.getClosestSite(
+          block_index, lin_index, &squared_distance);
+      if (min_squared_distance > max_squared_distance) {
+        EXPECT_GE(squared_distance, min_squared_distance);
+        continue;
+      }
+      ASSERT_NE(site, BlockDistanceTransform::kNoSite);
+      EXPECT_EQ(squared_distance, min_squared_distance);
+      EXPECT_EQ((sites[site] - global_index).squaredNorm(),
+                min_squared_distance);
+      ++num_checked_voxels;
+    }
+  }
+  EXPECT_GT(num_checked_voxels, 0u);
+}
+
+class ExactEsdfTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-4.0, -4.0, -1.0), Point(4.0, 4.0, 3.0));
+    // Only objects with exact distances, which cylinders do not have above
+    // their caps.
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addObject(std::unique_ptr<Object>(
+        new Cube(Point(-2.0, 2.0, 0.5), Point(1.0, 1.0, 1.0), Color::Green())));
+    world_.addGroundLevel(0.0);
+
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    world_.generateSdfFromWorld(kTruncationDistance, tsdf_layer_.get());
+
+    esdf_config_.max_distance_m = kMaxDistance;
+    esdf_config_.default_distance_m = kMaxDistance;
+    esdf_config_.min_distance_m = kTruncationDistance / 2.0;
+  }
+
+  struct DistanceError {
+    FloatingPoint max = 0.0;
+    FloatingPoint mean = 0.0;
+  };
+
+  /// Error of the distances of the observed voxels within kMaxDistance.
+  DistanceError getDistanceError(const Layer<EsdfVoxel>& esdf_layer) const {
+    BlockIndexList blocks;
+    esdf_layer.getAllAllocatedBlocks(&blocks);
+    DistanceError error;
+    size_t num_voxels = 0u;
+    for (const BlockIndex& block_index : blocks) {
+      const Block<EsdfVoxel>& block = esdf_layer.getBlockByIndex(block_index);
+      for (size_t lin_index = 0u; lin_index < block.num_voxels(); ++lin_index) {
+        const EsdfVoxel& voxel = block.getVoxelByLinearIndex(lin_index);
+        const Point position =
+            block.computeCoordinatesFromLinearIndex(lin_index);
+        const FloatingPoint distance =
+            world_.getDistanceToPoint(position, kMaxDistance);
+        if (!voxel.observed || std::abs(distance) >= kMaxDistance - 0.5) {
+          continue;
+        }
+        const FloatingPoint voxel_error = std::abs(voxel.distance - distance);
+        error.max = std::max(error.max, voxel_error);
+        error.mean += voxel_error;
+        ++num_voxels;
+      }
+    }
+    EXPECT_GT(num_voxels, 0u);
+    error.mean /= std::max<size_t>(num_voxels, 1u);
+    return error;
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+  static constexpr FloatingPoint kTruncationDistance = 0.3;
+  static constexpr FloatingPoint kMaxDistance = 2.0;
+
+  SimulationWorld world_;
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+  EsdfIntegrator::Config esdf_config_;
+};
+
+TEST_F(ExactEsdfTest, MoreAccurateThanPropagation) {
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator(esdf_config_, tsdf_layer_.get(), &esdf_layer)
+      .updateFromTsdfLayerBatch();
+  const DistanceError error = getDistanceError(esdf_layer);
+
+  for (const bool full_euclidean_distance : {false, true}) {
+    for (const size_t num_threads : {1u, 4u}) {
+      EsdfIntegrator::Config exact_config = esdf_config_;
+      exact_config.full_euclidean_distance = full_euclidean_distance;
+      exact_config.exact_batch_distance = true;
+      exact_config.propagation_threads = num_threads;
+      Layer<EsdfVoxel> exact_esdf_layer(kVoxelSize, kVoxelsPerSide);
+      EsdfIntegrator(exact_config, tsdf_layer_.get(), &exact_esdf_layer)
+          .updateFromTsdfLayerBatch();
+      const DistanceError exact_error = getDistanceError(exact_esdf_layer);
+      std::cout << "Propagated error max: " << error.max
+                << " mean: " << error.mean
+                << ", exact error max: " << exact_error.max
+                << " mean: " << exact_error.mean << std::endl;
+      EXPECT_LT(exact_error.mean, error.mean);
+      EXPECT_LT(exact_error.max, error.max);
+    }
+  }
+}
+
+TEST_F(ExactEsdfTest, Benchmark) {
+  constexpr int kNumRepetitions = 3;
+  timing::Timing::Reset();
+
+  for (const bool exact_batch_distance : {false, true}) {
+    for (const FloatingPoint max_distance : {2.0, 5.0}) {
+      EsdfIntegrator::Config config = esdf_config_;
+      config.exact_batch_distance = exact_batch_distance;
+      config.max_distance_m = max_distance;
+      config.default_distance_m = max_distance;
+      Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+      EsdfIntegrator esdf_integrator(config, tsdf_layer_.get(), &esdf_layer);
+      const std::string name =
+          std::string(exact_batch_distance ? "exact" : "propagate") + "/" +
+          std::to_string(static_cast<int>(max_distance)) + "m";
+      for (int i = 0; i < kNumRepetitions; ++i) {
+        timing::Timer timer("batch/" + name);
+        esdf_integrator.updateFromTsdfLayerBatch();
+        timer.Stop();
+      }
+    }
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
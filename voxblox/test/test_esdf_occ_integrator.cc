@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_occ_integrator.h"
+#include "voxblox/integrator/occupancy_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class EsdfOccIntegratorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    setUpWorld(true, &world_);
+    setUpWorld(false, &world_without_cube_);
+
+    esdf_config_.max_distance_m = kMaxDistance;
+    esdf_config_.default_distance_m = kMaxDistance;
+  }
+
+  static void setUpWorld(bool with_cube, SimulationWorld* world) {
+    world->setBounds(Point(-4.0, -4.0, -1.0), Point(4.0, 4.0, 3.0));
+    world->addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    if (with_cube) {
+      world->addObject(std::unique_ptr<Object>(new Cube(
+          Point(-2.0, 2.0, 0.5), Point(1.0, 1.0, 1.0), Color::Green())));
+    }
+    world->addGroundLevel(0.0);
+  }
+
+  /**
+   * Sets the occupancy of all voxels within the bounds of the world, flagging
+   * the blocks for the ESDF and marking the voxels that changed dirty.
+   */
+  void setOccupancyFromWorld(const SimulationWorld& world,
+                             Layer<OccupancyVoxel>* occ_layer) const {
+    Layer<TsdfVoxel> tsdf_layer(kVoxelSize, kVoxelsPerSide);
+    world.generateSdfFromWorld(kMaxDistance, &tsdf_layer);
+    BlockIndexList blocks;
+    tsdf_layer.getAllAllocatedBlocks(&blocks);
+    for (const BlockIndex& block_index : blocks) {
+      const Block<TsdfVoxel>& tsdf_block =
+          tsdf_layer.getBlockByIndex(block_index);
+      Block<OccupancyVoxel>& occ_block =
+          *occ_layer->allocateBlockPtrByIndex(block_index);
+      occ_block.updated().set(Update::kEsdf);
+      for (size_t i = 0u; i < tsdf_block.num_voxels(); ++i) {
+        const TsdfVoxel& tsdf_voxel = tsdf_block.getVoxelByLinearIndex(i);
+        if (tsdf_voxel.weight <= 0.0f) {
+          continue;
+        }
+        OccupancyVoxel& occ_voxel = occ_block.getVoxelByLinearIndex(i);
+        const float probability_log =
+            tsdf_voxel.distance < kVoxelSize / 2.0 ? 2.0f : -2.0f;
+        if (!occ_voxel.observed ||
+            occ_voxel.probability_log != probability_log) {
+          occ_voxel.observed = true;
+          occ_voxel.probability_log = probability_log;
+          occ_block.markVoxelDirty(i);
+        }
+      }
+    }
+  }
+
+  /// Expects the same distances, returns the number of observed voxels.
+  static size_t compareLayers(const Layer<EsdfVoxel>& layer,
+                              const Layer<EsdfVoxel>& other_layer,
+                              size_t* num_different) {
+    BlockIndexList blocks;
+    layer.getAllAllocatedBlocks(&blocks);
+    EXPECT_EQ(other_layer.getNumberOfAllocatedBlocks(), blocks.size());
+    size_t num_observed = 0u;
+    *num_different = 0u;
+    for (const BlockIndex& block_index : blocks) {
+      const Block<EsdfVoxel>& block = layer.getBlockByIndex(block_index);
+      const Block<EsdfVoxel>& other_block =
+          other_layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        const EsdfVoxel& other_voxel = other_block.getVoxelByLinearIndex(i);
+        EXPECT_EQ(voxel.observed, other_voxel.observed);
+        if (!voxel.observed) {
+          continue;
+        }
+        ++num_observed;
+        EXPECT_EQ(voxel.fixed, other_voxel.fixed);
+        const FloatingPoint distance = std::min(voxel.distance, kMaxDistance);
+        const FloatingPoint other_distance =
+            std::min(other_voxel.distance, kMaxDistance);
+        // The order of the propagation changes the distances by a fraction of
+        // a voxel.
+        EXPECT_NEAR(distance, other_distance, kVoxelSize);
+        if (std::abs(distance - other_distance) > kEpsilon) {
+          ++(*num_different);
+        }
+      }
+    }
+    return num_observed;
+  }
+
+  /// Pose of the sensor circling the scene at the given step.
+  static Transformation getPose(int step) {
+    const FloatingPoint angle = 2.0 * M_PI * step / kNumSteps;
+    const Point position(3.5 * std::cos(angle), 3.5 * std::sin(angle), 1.0);
+    // Looking at the center of the scene.
+    const Quaternion rotation(
+        Eigen::AngleAxis<FloatingPoint>(angle + M_PI, Point::UnitZ()));
+    return Transformation(rotation, position);
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+  static constexpr FloatingPoint kMaxDistance = 2.0;
+  static constexpr int kNumSteps = 20;
+
+  SimulationWorld world_;
+  SimulationWorld world_without_cube_;
+  EsdfOccIntegrator::Config esdf_config_;
+};
+
+TEST_F(EsdfOccIntegratorTest, RaiseMatchesBatch) {
+  Layer<OccupancyVoxel> occ_layer(kVoxelSize, kVoxelsPerSide);
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator esdf_integrator(esdf_config_, &occ_layer, &esdf_layer);
+  constexpr bool kClearUpdatedFlag = true;
+
+  // The cube disappears and shows up again.
+  for (const SimulationWorld* world :
+       {&world_, &world_without_cube_, &world_}) {
+    setOccupancyFromWorld(*world, &occ_layer);
+    esdf_integrator.updateFromOccLayer(kClearUpdatedFlag);
+
+    Layer<EsdfVoxel> batch_esdf_layer(kVoxelSize, kVoxelsPerSide);
+    EsdfOccIntegrator(esdf_config_, &occ_layer, &batch_esdf_layer)
+        .updateFromOccLayerBatch();
+    size_t num_different;
+    const size_t num_observed =
+        compareLayers(esdf_layer, batch_esdf_layer, &num_different);
+    std::cout << num_different << " of " << num_observed
+              << " voxel distances differ." << std::endl;
+    EXPECT_GT(num_observed, 0u);
+    EXPECT_LT(num_different, num_observed / 100u);
+  }
+
+  // Where the cube was, the distance has to come from the ground, which is
+  // occupied up to the voxels centered just below it.
+  const Point cube_center(-2.0, 2.0, 0.5);
+  setOccupancyFromWorld(world_without_cube_, &occ_layer);
+  esdf_integrator.updateFromOccLayer(kClearUpdatedFlag);
+  const EsdfVoxel* voxel = esdf_layer.getVoxelPtrByCoordinates(cube_center);
+  ASSERT_TRUE(voxel != nullptr);
+  EXPECT_FALSE(voxel->fixed);
+  EXPECT_NEAR(voxel->distance, 0.5, 1.5 * kVoxelSize);
+}
+
+TEST_F(EsdfOccIntegratorTest, MovingSensorMatchesBatch) {
+  OccupancyIntegrator::Config occ_config;
+  occ_config.max_ray_length_m = 6.0;
+  Layer<OccupancyVoxel> occ_layer(kVoxelSize, kVoxelsPerSide);
+  OccupancyIntegrator occ_integrator(occ_config, &occ_layer);
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator esdf_integrator(esdf_config_, &occ_layer, &esdf_layer);
+
+  const Eigen::Vector2i camera_resolution(64, 48);
+  for (int step = 0; step < kNumSteps; ++step) {
+    Pointcloud points_G;
+    Colors colors;
+    const Transformation T_G_C = getPose(step);
+    world_.getPointcloudFromTransform(T_G_C, camera_resolution, M_PI / 2.0,
+                                      occ_config.max_ray_length_m, &points_G,
+                                      &colors);
+    Pointcloud points_C;
+    transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+    occ_integrator.integratePointCloud(T_G_C, points_C);
+
+    constexpr bool kClearUpdatedFlag = true;
+    esdf_integrator.updateFromOccLayer(kClearUpdatedFlag);
+  }
+
+  Layer<EsdfVoxel> batch_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator(esdf_config_, &occ_layer, &batch_esdf_layer)
+      .updateFromOccLayerBatch();
+  size_t num_different;
+  const size_t num_observed =
+      compareLayers(esdf_layer, batch_esdf_layer, &num_different);
+  std::cout << num_different << " of " << num_observed
+            << " voxel distances differ." << std::endl;
+  EXPECT_GT(num_observed, 0u);
+  EXPECT_LT(num_different, num_observed / 100u);
+}
+
+TEST_F(EsdfOccIntegratorTest, Benchmark) {
+  timing::Timing::Reset();
+
+  OccupancyIntegrator::Config occ_config;
+  occ_config.max_ray_length_m = 6.0;
+  Layer<OccupancyVoxel> occ_layer(kVoxelSize, kVoxelsPerSide);
+  OccupancyIntegrator occ_integrator(occ_config, &occ_layer);
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator esdf_integrator(esdf_config_, &occ_layer, &esdf_layer);
+  Layer<EsdfVoxel> batch_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator batch_esdf_integrator(esdf_config_, &occ_layer,
+                                          &batch_esdf_layer);
+
+  const Eigen::Vector2i camera_resolution(64, 48);
+  for (int step = 0; step < kNumSteps; ++step) {
+    Pointcloud points_G;
+    Colors colors;
+    const Transformation T_G_C = getPose(step);
+    world_.getPointcloudFromTransform(T_G_C, camera_resolution, M_PI / 2.0,
+                                      occ_config.max_ray_length_m, &points_G,
+                                      &colors);
+    Pointcloud points_C;
+    transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+    occ_integrator.integratePointCloud(T_G_C, points_C);
+
+    timing::Timer incremental_timer("frame/incremental");
+    constexpr bool kClearUpdatedFlag = true;
+    esdf_integrator.updateFromOccLayer(kClearUpdatedFlag);
+    incremental_timer.Stop();
+
+    timing::Timer batch_timer("frame/batch");
+    batch_esdf_integrator.updateFromOccLayerBatch();
+    batch_timer.Stop();
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,235 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class EsdfPropagationTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addObject(std::unique_ptr<Object>(
+        new Cube(Point(-2.0, 2.0, 0.5), Point(1.0, 1.0, 1.0), Color::Green())));
+    world_.addObject(std::unique_ptr<Object>(new Cylinder(
+        Point(2.0, -2.0, 1.0), 0.5, 2.0, Color::Blue())));
+    world_.addGroundLevel(0.0);
+
+    // A sensor moving around the scene.
+    constexpr int kNumPoses = 8;
+    for (int i = 0; i < kNumPoses; ++i) {
+      const FloatingPoint angle = 2.0 * M_PI * i / kNumPoses;
+      const Point position(4.0 * std::sin(angle), 4.0 * std::cos(angle), 1.5);
+      const FloatingPoint yaw = std::atan2(-position.y(), -position.x());
+      const Transformation T_G_C(
+          Quaternion(Eigen::AngleAxis<FloatingPoint>(yaw, Point::UnitZ())),
+          position);
+      Pointcloud points_G, points_C;
+      Colors colors;
+      world_.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(160, 120), 2.0,
+                                        8.0, &points_G, &colors);
+      transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+      poses_.push_back(T_G_C);
+      clouds_C_.push_back(points_C);
+      colors_.push_back(colors);
+    }
+
+    config_.integrator_threads = 1u;
+    config_.max_ray_length_m = 8.0;
+    config_.default_truncation_distance = 3.0 * kVoxelSize;
+  }
+
+  EsdfIntegrator::Config getEsdfConfig() const {
+    EsdfIntegrator::Config esdf_config;
+    // As the ESDF server sets it, larger values would fix all voxels.
+    esdf_config.min_distance_m = config_.default_truncation_distance / 2.0;
+    esdf_config.min_diff_m = kMinDiff;
+    return esdf_config;
+  }
+
+  void integrateScan(size_t scan_idx, TsdfIntegratorBase* integrator) const {
+    integrator->integratePointCloud(poses_[scan_idx], clouds_C_[scan_idx],
+                                    colors_[scan_idx]);
+  }
+
+  struct DistanceDifference {
+    FloatingPoint max = 0.0;
+    FloatingPoint mean = 0.0;
+  };
+
+  /**
+   * Distance differences of the observed voxels of two ESDF layers with the
+   * same voxels that are hallucinated or not.
+   */
+  static DistanceDifference getDistanceDifference(
+      const Layer<EsdfVoxel>& layer, const Layer<EsdfVoxel>& other_layer,
+      bool hallucinated = false) {
+    BlockIndexList blocks;
+    layer.getAllAllocatedBlocks(&blocks);
+    EXPECT_GT(blocks.size(), 0u);
+    EXPECT_EQ(other_layer.getNumberOfAllocatedBlocks(), blocks.size());
+    DistanceDifference difference;
+    size_t num_voxels = 0u;
+    for (const BlockIndex& block_index : blocks) {
+      const Block<EsdfVoxel>& block = layer.getBlockByIndex(block_index);
+      const Block<EsdfVoxel>& other_block =
+          other_layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        const EsdfVoxel& other_voxel = other_block.getVoxelByLinearIndex(i);
+        EXPECT_EQ(voxel.observed, other_voxel.observed);
+        EXPECT_EQ(voxel.hallucinated, other_voxel.hallucinated);
+        EXPECT_EQ(voxel.fixed, other_voxel.fixed);
+        EXPECT_FALSE(other_voxel.in_queue);
+        if (voxel.observed && voxel.hallucinated == hallucinated) {
+          const FloatingPoint voxel_difference =
+              std::abs(voxel.distance - other_voxel.distance);
+          difference.max = std::max(difference.max, voxel_difference);
+          difference.mean += voxel_difference;
+          ++num_voxels;
+        }
+      }
+    }
+    EXPECT_GT(num_voxels, 0u);
+    difference.mean /= std::max<size_t>(num_voxels, 1u);
+    return difference;
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+  /// Per voxel tolerance of the updates, see EsdfIntegrator::Config.
+  static constexpr FloatingPoint kMinDiff = 0.001;
+
+  SimulationWorld world_;
+  TsdfIntegratorBase::Config config_;
+  std::vector<Transformation> poses_;
+  std::vector<Pointcloud> clouds_C_;
+  std::vector<Colors> colors_;
+};
+
+TEST_F(EsdfPropagationTest, ParallelBatchMatchesSerial) {
+  Layer<TsdfVoxel> tsdf_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator integrator(config_, &tsdf_layer);
+  for (size_t scan_idx = 0u; scan_idx < poses_.size(); ++scan_idx) {
+    integrateScan(scan_idx, &integrator);
+  }
+
+  // The threads update the voxels in a different order, which like a
+  // different number of buckets changes the distances of a few voxels by up
+  // to a voxel. The full euclidean distances depend on the order a lot more.
+  const FloatingPoint voxel_size = kVoxelSize;
+  const FloatingPoint min_diff = kMinDiff;
+  for (const bool full_euclidean_distance : {false, true}) {
+    EsdfIntegrator::Config esdf_config = getEsdfConfig();
+    esdf_config.max_distance_m = 2.0;
+    esdf_config.full_euclidean_distance = full_euclidean_distance;
+    Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+    EsdfIntegrator(esdf_config, &tsdf_layer, &esdf_layer)
+        .updateFromTsdfLayerBatch();
+
+    for (const size_t num_threads : {2u, 3u, 8u}) {
+      esdf_config.propagation_threads = num_threads;
+      Layer<EsdfVoxel> parallel_esdf_layer(kVoxelSize, kVoxelsPerSide);
+      EsdfIntegrator(esdf_config, &tsdf_layer, &parallel_esdf_layer)
+          .updateFromTsdfLayerBatch();
+      const DistanceDifference difference =
+          getDistanceDifference(esdf_layer, parallel_esdf_layer);
+      if (full_euclidean_distance) {
+        EXPECT_LT(difference.mean, voxel_size) << num_threads;
+      } else {
+        EXPECT_LT(difference.max, voxel_size) << num_threads;
+        EXPECT_LT(difference.mean, min_diff) << num_threads;
+      }
+    }
+  }
+}
+
+TEST_F(EsdfPropagationTest, ParallelIncrementalMatchesSerial) {
+  Layer<TsdfVoxel> tsdf_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator integrator(config_, &tsdf_layer);
+  Layer<TsdfVoxel> parallel_tsdf_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator parallel_integrator(config_, &parallel_tsdf_layer);
+
+  EsdfIntegrator::Config esdf_config = getEsdfConfig();
+  esdf_config.max_distance_m = 2.0;
+  esdf_config.clear_sphere_radius = 1.0;
+  esdf_config.occupied_sphere_radius = 2.0;
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(esdf_config, &tsdf_layer, &esdf_layer);
+  esdf_config.propagation_threads = 4u;
+  Layer<EsdfVoxel> parallel_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator parallel_esdf_integrator(esdf_config, &parallel_tsdf_layer,
+                                          &parallel_esdf_layer);
+  constexpr bool kClearUpdatedFlag = true;
+
+  // Clear space around the sensor as well, which raises voxels.
+  for (size_t scan_idx = 0u; scan_idx < poses_.size(); ++scan_idx) {
+    integrateScan(scan_idx, &integrator);
+    integrateScan(scan_idx, &parallel_integrator);
+    esdf_integrator.addNewRobotPosition(poses_[scan_idx].getPosition());
+    parallel_esdf_integrator.addNewRobotPosition(
+        poses_[scan_idx].getPosition());
+    esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+    parallel_esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+  }
+
+  const FloatingPoint voxel_size = kVoxelSize;
+  const FloatingPoint min_diff = kMinDiff;
+  const DistanceDifference difference =
+      getDistanceDifference(esdf_layer, parallel_esdf_layer);
+  EXPECT_LT(difference.max, voxel_size);
+  EXPECT_LT(difference.mean, min_diff);
+  constexpr bool kHallucinated = true;
+  EXPECT_LT(getDistanceDifference(esdf_layer, parallel_esdf_layer,
+                                  kHallucinated)
+                .max,
+            voxel_size);
+}
+
+TEST_F(EsdfPropagationTest, Benchmark) {
+  constexpr int kNumRepetitions = 3;
+  timing::Timing::Reset();
+
+  Layer<TsdfVoxel> tsdf_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator integrator(config_, &tsdf_layer);
+  for (size_t scan_idx = 0u; scan_idx < poses_.size(); ++scan_idx) {
+    integrateScan(scan_idx, &integrator);
+  }
+
+  EsdfIntegrator::Config esdf_config = getEsdfConfig();
+  esdf_config.max_distance_m = 5.0;
+  esdf_config.default_distance_m = 5.0;
+  for (const size_t num_threads : {1u, 2u, 4u}) {
+    esdf_config.propagation_threads = num_threads;
+    Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+    EsdfIntegrator esdf_integrator(esdf_config, &tsdf_layer, &esdf_layer);
+    for (int i = 0; i < kNumRepetitions; ++i) {
+      timing::Timer timer("batch/" + std::to_string(num_threads) + "_threads");
+      esdf_integrator.updateFromTsdfLayerBatch();
+      timer.Stop();
+    }
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
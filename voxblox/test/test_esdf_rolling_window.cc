@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class EsdfRollingWindowTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // A corridor the robot drives along.
+    world_.setBounds(Point(-2.0, -3.0, -1.0), Point(14.0, 3.0, 3.0));
+    for (int i = 0; i < 6; ++i) {
+      world_.addObject(std::unique_ptr<Object>(
+          new Sphere(Point(2.0 * i, 1.5, 1.0), 0.7, Color::Red())));
+      world_.addObject(std::unique_ptr<Object>(
+          new Cube(Point(2.0 * i + 1.0, -1.5, 0.5), Point(0.8, 0.8, 1.0),
+                   Color::Green())));
+    }
+    world_.addGroundLevel(0.0);
+
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    world_.generateSdfFromWorld(kTruncationDistance, tsdf_layer_.get());
+
+    esdf_config_.max_distance_m = kMaxDistance;
+    esdf_config_.default_distance_m = kMaxDistance;
+    esdf_config_.min_distance_m = kTruncationDistance / 2.0;
+  }
+
+  /// Robot positions along the corridor.
+  static Point getPosition(int step) {
+    return Point(0.4 * step, 0.0, 1.0);
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 8u;
+  static constexpr FloatingPoint kTruncationDistance = 3 * kVoxelSize;
+  static constexpr FloatingPoint kMaxDistance = 1.0;
+  static constexpr int kWindowBlocks = 7;
+  static constexpr int kNumSteps = 30;
+
+  SimulationWorld world_;
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+  EsdfIntegrator::Config esdf_config_;
+};
+
+TEST_F(EsdfRollingWindowTest, MemoryIsBounded) {
+  const int window_blocks = kWindowBlocks;
+  EsdfIntegrator::Config config = esdf_config_;
+  config.rolling_window_blocks = window_blocks;
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(config, tsdf_layer_.get(), &esdf_layer);
+
+  for (int step = 0; step < kNumSteps; ++step) {
+    esdf_integrator.setRollingWindowCenter(getPosition(step));
+    constexpr bool kClearUpdatedFlag = true;
+    esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+
+    BlockIndexList blocks;
+    esdf_layer.getAllAllocatedBlocks(&blocks);
+    EXPECT_GT(blocks.size(), 0u);
+    EXPECT_LE(blocks.size(),
+              static_cast<size_t>(window_blocks * window_blocks *
+                                  window_blocks));
+    for (const BlockIndex& block_index : blocks) {
+      EXPECT_TRUE(esdf_integrator.isInRollingWindow(block_index));
+    }
+  }
+  EXPECT_LT(esdf_layer.getNumberOfAllocatedBlocks(),
+            tsdf_layer_->getNumberOfAllocatedBlocks());
+}
+
+TEST_F(EsdfRollingWindowTest, TimeLimitedUpdates) {
+  EsdfIntegrator::Config config = esdf_config_;
+  config.rolling_window_blocks = kWindowBlocks;
+  config.max_update_time_s = 1e-4;
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(config, tsdf_layer_.get(), &esdf_layer);
+
+  // The window moves while voxels of the blocks it drops are still queued.
+  size_t num_moves_with_queued_voxels = 0u;
+  for (int step = 0; step < kNumSteps; ++step) {
+    if (esdf_integrator.getUpdateBacklog().num_queued_voxels > 0u) {
+      ++num_moves_with_queued_voxels;
+    }
+    esdf_integrator.setRollingWindowCenter(getPosition(step));
+    constexpr bool kClearUpdatedFlag = true;
+    esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+
+    BlockIndexList blocks;
+    esdf_layer.getAllAllocatedBlocks(&blocks);
+    for (const BlockIndex& block_index : blocks) {
+      EXPECT_TRUE(esdf_integrator.isInRollingWindow(block_index));
+    }
+  }
+  EXPECT_GT(num_moves_with_queued_voxels, 0u);
+}
+
+TEST_F(EsdfRollingWindowTest, MatchesGlobalEsdf) {
+  Layer<EsdfVoxel> global_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator(esdf_config_, tsdf_layer_.get(), &global_esdf_layer)
+      .updateFromTsdfLayerBatch();
+
+  EsdfIntegrator::Config config = esdf_config_;
+  config.rolling_window_blocks = kWindowBlocks;
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(config, tsdf_layer_.get(), &esdf_layer);
+
+  // Away from the faces of the window, all obstacles within kMaxDistance are
+  // in the window.
+  const int margin_blocks = static_cast<int>(
+      std::ceil(kMaxDistance / esdf_layer.block_size()));
+  const FloatingPoint max_distance = kMaxDistance;
+  size_t num_compared_voxels = 0u;
+  for (int step = 0; step < kNumSteps; ++step) {
+    const Point position = getPosition(step);
+    esdf_integrator.setRollingWindowCenter(position);
+    constexpr bool kClearUpdatedFlag = true;
+    esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+
+    const BlockIndex window_min =
+        esdf_layer.computeBlockIndexFromCoordinates(position) -
+        BlockIndex::Constant(kWindowBlocks / 2);
+    BlockIndexList blocks;
+    esdf_layer.getAllAllocatedBlocks(&blocks);
+    for (const BlockIndex& block_index : blocks) {
+      const BlockIndex offset = block_index - window_min;
+      if ((offset.array() < margin_blocks).any() ||
+          (offset.array() >= kWindowBlocks - margin_blocks).any()) {
+        continue;
+      }
+      const Block<EsdfVoxel>& block = esdf_layer.getBlockByIndex(block_index);
+      const Block<EsdfVoxel>& global_block =
+          global_esdf_layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        const EsdfVoxel& global_voxel = global_block.getVoxelByLinearIndex(i);
+        ASSERT_EQ(voxel.observed, global_voxel.observed);
+        if (voxel.observed) {
+          // Distances beyond the maximum are not propagated.
+          EXPECT_NEAR(std::min(voxel.distance, max_distance),
+                      std::min(global_voxel.distance, max_distance),
+                      kVoxelSize);
+          ++num_compared_voxels;
+        }
+      }
+    }
+  }
+  EXPECT_GT(num_compared_voxels, 0u);
+}
+
+TEST_F(EsdfRollingWindowTest, Benchmark) {
+  constexpr FloatingPoint kSensorRange = 2.5;
+  timing::Timing::Reset();
+
+  for (const int window_blocks : {0, kWindowBlocks}) {
+    EsdfIntegrator::Config config = esdf_config_;
+    config.rolling_window_blocks = window_blocks;
+    Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+    EsdfIntegrator esdf_integrator(config, tsdf_layer_.get(), &esdf_layer);
+    const std::string name = window_blocks > 0 ? "rolling" : "global";
+
+    // Every step the robot updates the TSDF within the sensor range.
+    for (int step = 0; step < kNumSteps; ++step) {
+      const Point position = getPosition(step);
+      BlockIndexList tsdf_blocks;
+      tsdf_layer_->getAllAllocatedBlocks(&tsdf_blocks);
+      for (const BlockIndex& block_index : tsdf_blocks) {
+        Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(block_index);
+        if ((block.origin() - position).norm() < kSensorRange) {
+          block.updated().set();
+        }
+      }
+      timing::Timer update_timer("update/" + name);
+      if (window_blocks > 0) {
+        esdf_integrator.setRollingWindowCenter(position);
+      }
+      constexpr bool kClearUpdatedFlag = true;
+      esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+      update_timer.Stop();
+    }
+    std::cout << name << " ESDF blocks: "
+              << esdf_layer.getNumberOfAllocatedBlocks()
+              << ", memory: " << esdf_layer.getMemorySize() << std::endl;
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
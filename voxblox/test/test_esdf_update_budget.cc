@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class EsdfUpdateBudgetTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // A corridor whose far end is of no interest to the robot at its start.
+    world_.setBounds(Point(-2.0, -3.0, -1.0), Point(14.0, 3.0, 3.0));
+    for (int i = 0; i < 6; ++i) {
+      world_.addObject(std::unique_ptr<Object>(
+          new Sphere(Point(2.0 * i, 1.5, 1.0), 0.7, Color::Red())));
+      world_.addObject(std::unique_ptr<Object>(
+          new Cube(Point(2.0 * i + 1.0, -1.5, 0.5), Point(0.8, 0.8, 1.0),
+                   Color::Green())));
+    }
+    world_.addGroundLevel(0.0);
+
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    world_.generateSdfFromWorld(kTruncationDistance, tsdf_layer_.get());
+    markAllBlocksUpdated();
+
+    esdf_config_.max_distance_m = kMaxDistance;
+    esdf_config_.default_distance_m = kMaxDistance;
+    esdf_config_.min_distance_m = kTruncationDistance / 2.0;
+  }
+
+  /// As if the whole TSDF was integrated since the last ESDF update.
+  void markAllBlocksUpdated() {
+    BlockIndexList blocks;
+    tsdf_layer_->getAllAllocatedBlocks(&blocks);
+    for (const BlockIndex& block_index : blocks) {
+      tsdf_layer_->getBlockByIndex(block_index).updated().set(Update::kEsdf);
+    }
+  }
+
+  /// Updates until there is no backlog left, returns the number of updates.
+  static int updateUntilDone(EsdfIntegrator* esdf_integrator) {
+    int num_updates = 0;
+    EsdfIntegrator::UpdateBacklog backlog;
+    do {
+      constexpr bool kClearUpdatedFlag = true;
+      esdf_integrator->updateFromTsdfLayer(kClearUpdatedFlag);
+      backlog = esdf_integrator->getUpdateBacklog();
+      ++num_updates;
+    } while ((backlog.num_blocks > 0u || backlog.num_queued_voxels > 0u) &&
+             num_updates < 10000);
+    return num_updates;
+  }
+
+  FloatingPoint getDistanceToCenter(const BlockIndex& block_index) const {
+    return (getCenterPointFromGridIndex(block_index,
+                                        tsdf_layer_->block_size()) -
+            kCenter)
+        .norm();
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 8u;
+  static constexpr FloatingPoint kTruncationDistance = 3 * kVoxelSize;
+  static constexpr FloatingPoint kMaxDistance = 1.0;
+  const Point kCenter = Point(0.0, 0.0, 1.0);
+
+  SimulationWorld world_;
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+  EsdfIntegrator::Config esdf_config_;
+};
+
+TEST_F(EsdfUpdateBudgetTest, ClosestBlocksFirst) {
+  EsdfIntegrator::Config config = esdf_config_;
+  config.max_update_time_s = 1e-4;
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(config, tsdf_layer_.get(), &esdf_layer);
+  esdf_integrator.setUpdatePriorityCenter(kCenter);
+
+  constexpr bool kClearUpdatedFlag = true;
+  esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+  const EsdfIntegrator::UpdateBacklog backlog =
+      esdf_integrator.getUpdateBacklog();
+  EXPECT_GT(backlog.num_blocks, 0u);
+  EXPECT_GT(esdf_layer.getNumberOfAllocatedBlocks(), 0u);
+  EXPECT_EQ(esdf_layer.getNumberOfAllocatedBlocks() + backlog.num_blocks,
+            tsdf_layer_->getNumberOfAllocatedBlocks());
+
+  // All propagated blocks are closer than the ones left.
+  BlockIndexList tsdf_blocks;
+  tsdf_layer_->getAllAllocatedBlocks(&tsdf_blocks);
+  FloatingPoint max_propagated_distance = 0.0;
+  FloatingPoint min_backlog_distance =
+      std::numeric_limits<FloatingPoint>::max();
+  size_t num_backlog_blocks = 0u;
+  for (const BlockIndex& block_index : tsdf_blocks) {
+    const FloatingPoint distance = getDistanceToCenter(block_index);
+    if (tsdf_layer_->getBlockByIndex(block_index).updated().test(
+            Update::kEsdf)) {
+      EXPECT_FALSE(esdf_layer.hasBlock(block_index));
+      min_backlog_distance = std::min(min_backlog_distance, distance);
+      ++num_backlog_blocks;
+    } else {
+      EXPECT_TRUE(esdf_layer.hasBlock(block_index));
+      max_propagated_distance = std::max(max_propagated_distance, distance);
+    }
+  }
+  EXPECT_EQ(num_backlog_blocks, backlog.num_blocks);
+  EXPECT_LE(max_propagated_distance, min_backlog_distance);
+
+  // The backlog shrinks with every update.
+  size_t last_num_blocks = backlog.num_blocks;
+  for (int i = 0; i < 3 && last_num_blocks > 0u; ++i) {
+    esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+    const size_t num_blocks = esdf_integrator.getUpdateBacklog().num_blocks;
+    EXPECT_LT(num_blocks, last_num_blocks);
+    last_num_blocks = num_blocks;
+  }
+}
+
+TEST_F(EsdfUpdateBudgetTest, MatchesUnlimitedUpdate) {
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                 &esdf_layer);
+  EXPECT_EQ(updateUntilDone(&esdf_integrator), 1);
+
+  markAllBlocksUpdated();
+  EsdfIntegrator::Config config = esdf_config_;
+  config.max_update_time_s = 1e-3;
+  Layer<EsdfVoxel> limited_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator limited_esdf_integrator(config, tsdf_layer_.get(),
+                                         &limited_esdf_layer);
+  limited_esdf_integrator.setUpdatePriorityCenter(kCenter);
+  const int num_updates = updateUntilDone(&limited_esdf_integrator);
+  std::cout << "Time limited updates: " << num_updates << std::endl;
+  EXPECT_GT(num_updates, 1);
+  EXPECT_LT(num_updates, 10000);
+
+  // The order of the propagation changes the distances by up to a voxel.
+  BlockIndexList blocks;
+  esdf_layer.getAllAllocatedBlocks(&blocks);
+  ASSERT_EQ(limited_esdf_layer.getNumberOfAllocatedBlocks(), blocks.size());
+  size_t num_observed = 0u;
+  size_t num_different = 0u;
+  for (const BlockIndex& block_index : blocks) {
+    const Block<EsdfVoxel>& block = esdf_layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& limited_block =
+        limited_esdf_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const EsdfVoxel& limited_voxel = limited_block.getVoxelByLinearIndex(i);
+      ASSERT_EQ(voxel.observed, limited_voxel.observed);
+      if (!voxel.observed) {
+        continue;
+      }
+      ++num_observed;
+      const FloatingPoint distance = std::min(voxel.distance, kMaxDistance);
+      const FloatingPoint limited_distance =
+          std::min(limited_voxel.distance, kMaxDistance);
+      EXPECT_NEAR(limited_distance, distance, kVoxelSize + kEpsilon);
+      if (std::abs(limited_distance - distance) > kEpsilon) {
+        ++num_different;
+      }
+    }
+  }
+  std::cout << num_different << " of " << num_observed
+            << " voxel distances differ." << std::endl;
+  EXPECT_LT(num_different, num_observed / 100u);
+}
+
+TEST_F(EsdfUpdateBudgetTest, Benchmark) {
+  timing::Timing::Reset();
+
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                 &esdf_layer);
+  timing::Timer unlimited_timer("update/unlimited");
+  updateUntilDone(&esdf_integrator);
+  unlimited_timer.Stop();
+
+  markAllBlocksUpdated();
+  EsdfIntegrator::Config config = esdf_config_;
+  config.max_update_time_s = 0.005;
+  Layer<EsdfVoxel> limited_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator limited_esdf_integrator(config, tsdf_layer_.get(),
+                                         &limited_esdf_layer);
+  limited_esdf_integrator.setUpdatePriorityCenter(kCenter);
+  int num_updates = 0;
+  EsdfIntegrator::UpdateBacklog backlog;
+  do {
+    timing::Timer limited_timer("update/limited_5ms");
+    constexpr bool kClearUpdatedFlag = true;
+    limited_esdf_integrator.updateFromTsdfLayer(kClearUpdatedFlag);
+    limited_timer.Stop();
+    backlog = limited_esdf_integrator.getUpdateBacklog();
+    ++num_updates;
+  } while (backlog.num_blocks > 0u || backlog.num_queued_voxels > 0u);
+  std::cout << "Drained the backlog in " << num_updates << " updates."
+            << std::endl;
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,115 @@
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/integrator_utils.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+
+using namespace voxblox;  // NOLINT
+
+class IntegrationTimeBudgetTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addGroundLevel(0.0);
+
+    T_G_C_ = Transformation(
+        Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+        Point(4.0, 0.0, 1.5));
+    Pointcloud points_G;
+    world_.getPointcloudFromTransform(T_G_C_, Eigen::Vector2i(160, 120), 2.0,
+                                      8.0, &points_G, &colors_);
+    transformPointcloud(T_G_C_.inverse(), points_G, &points_C_);
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  SimulationWorld world_;
+  Transformation T_G_C_;
+  Pointcloud points_C_;
+  Colors colors_;
+};
+
+TEST_F(IntegrationTimeBudgetTest, ThreadSafeIndex) {
+  for (const std::string& mode :
+       {std::string("mixed"), std::string("sorted")}) {
+    std::unique_ptr<ThreadSafeIndex> index_getter(
+        ThreadSafeIndexFactory::get(mode, points_C_));
+    size_t point_idx;
+    for (size_t i = 0u; i < 10u; ++i) {
+      ASSERT_TRUE(index_getter->getNextIndex(&point_idx));
+    }
+    EXPECT_EQ(index_getter->getNumReadIndices(), 10u);
+    while (index_getter->getNextIndex(&point_idx)) {
+    }
+    EXPECT_FALSE(index_getter->getNextIndex(&point_idx));
+    EXPECT_EQ(index_getter->getNumReadIndices(), points_C_.size());
+  }
+}
+
+TEST_F(IntegrationTimeBudgetTest, IntegratedAndDroppedPoints) {
+  for (const std::string& integrator_name :
+       {std::string("simple"), std::string("merged"), std::string("fast"),
+        std::string("partitioned")}) {
+    for (const std::string& mode :
+         {std::string("mixed"), std::string("sorted")}) {
+      TsdfIntegratorBase::Config config;
+      config.integrator_threads = 4u;
+      config.integration_order_mode = mode;
+
+      // Without a time limit all points are integrated.
+      Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+      TsdfIntegratorBase::Ptr integrator =
+          TsdfIntegratorFactory::create(integrator_name, config, &layer);
+      integrator->integratePointCloud(T_G_C_, points_C_, colors_);
+      EXPECT_EQ(integrator->getLastIntegrationStats().num_integrated_points,
+                points_C_.size())
+          << integrator_name << " " << mode;
+      EXPECT_EQ(integrator->getLastIntegrationStats().num_dropped_points, 0u)
+          << integrator_name << " " << mode;
+      EXPECT_GT(layer.getNumberOfAllocatedBlocks(), 0u);
+
+      // Without any time all points are dropped.
+      config.max_integration_time_s = 0.0f;
+      Layer<TsdfVoxel> empty_layer(kVoxelSize, kVoxelsPerSide);
+      integrator =
+          TsdfIntegratorFactory::create(integrator_name, config, &empty_layer);
+      integrator->integratePointCloud(T_G_C_, points_C_, colors_);
+      EXPECT_EQ(integrator->getLastIntegrationStats().num_integrated_points,
+                0u)
+          << integrator_name << " " << mode;
+      EXPECT_EQ(integrator->getLastIntegrationStats().num_dropped_points,
+                points_C_.size())
+          << integrator_name << " " << mode;
+      EXPECT_EQ(empty_layer.getNumberOfAllocatedBlocks(), 0u);
+
+      // In between, every point is either integrated or dropped.
+      config.max_integration_time_s = 1e-3f;
+      Layer<TsdfVoxel> partial_layer(kVoxelSize, kVoxelsPerSide);
+      integrator = TsdfIntegratorFactory::create(integrator_name, config,
+                                                 &partial_layer);
+      integrator->integratePointCloud(T_G_C_, points_C_, colors_);
+      EXPECT_EQ(integrator->getLastIntegrationStats().num_integrated_points +
+                    integrator->getLastIntegrationStats().num_dropped_points,
+                points_C_.size())
+          << integrator_name << " " << mode;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
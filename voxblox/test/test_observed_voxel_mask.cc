@@ -0,0 +1,246 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/mesh/mesh_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class ObservedVoxelMaskTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addGroundLevel(0.0);
+
+    // Without carving only the voxels close to the surface are updated, which
+    // leaves most of the allocated blocks unobserved.
+    TsdfIntegratorBase::Config config;
+    config.default_truncation_distance = 4 * kVoxelSize;
+    config.voxel_carving_enabled = false;
+    config.integrator_threads = 1;
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    SimpleTsdfIntegrator integrator(config, tsdf_layer_.get());
+
+    constexpr int kNumPoses = 8;
+    for (int i = 0; i < kNumPoses; ++i) {
+      const FloatingPoint angle = 2.0 * M_PI * i / kNumPoses;
+      const Point position(4.0 * std::sin(angle), 4.0 * std::cos(angle), 1.5);
+      const FloatingPoint yaw = std::atan2(-position.y(), -position.x());
+      const Transformation T_G_C(
+          Quaternion(Eigen::AngleAxis<FloatingPoint>(yaw, Point::UnitZ())),
+          position);
+
+      Pointcloud points_C;
+      Colors colors;
+      world_.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(160, 120),
+                                        2.0, 8.0, &points_C, &colors);
+      integrator.integratePointCloud(T_G_C, points_C, colors);
+    }
+    tsdf_layer_->getAllAllocatedBlocks(&blocks_);
+  }
+
+  /// Marks every voxel of the layer, as if the mask did not exist.
+  void markAllVoxels(Layer<TsdfVoxel>* layer) {
+    for (const BlockIndex& block_index : blocks_) {
+      Block<TsdfVoxel>& block = layer->getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        block.markVoxelObserved(i);
+      }
+    }
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  SimulationWorld world_;
+  BlockIndexList blocks_;
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+};
+
+TEST_F(ObservedVoxelMaskTest, MarkAndIterate) {
+  Block<TsdfVoxel> block(kVoxelsPerSide, kVoxelSize, Point::Zero());
+  EXPECT_EQ(block.num_observed_voxels(), 0u);
+
+  // Const access does not mark.
+  const Block<TsdfVoxel>& const_block = block;
+  EXPECT_EQ(const_block.getVoxelByLinearIndex(5u).weight, 0.0f);
+  EXPECT_FALSE(block.isVoxelObserved(5u));
+
+  const std::vector<size_t> kIndices = {0u, 63u, 64u, 1000u, 4095u};
+  for (const size_t index : kIndices) {
+    block.getVoxelByLinearIndex(index).weight = 1.0f;
+  }
+  // Marking twice does not count twice.
+  block.getVoxelByLinearIndex(64u).weight = 2.0f;
+  EXPECT_EQ(block.num_observed_voxels(), kIndices.size());
+
+  std::vector<size_t> visited;
+  block.forEachObservedVoxel(
+      [&visited](size_t index) { visited.push_back(index); });
+  EXPECT_EQ(visited, kIndices);
+
+  // Only the voxels that actually hold data survive a rebuild.
+  block.getVoxelByLinearIndex(7u);
+  EXPECT_TRUE(block.isVoxelObserved(7u));
+  block.recomputeObservedMask();
+  EXPECT_FALSE(block.isVoxelObserved(7u));
+  EXPECT_EQ(block.num_observed_voxels(), kIndices.size());
+
+  std::vector<uint32_t> data;
+  block.serializeToIntegers(&data);
+  Block<TsdfVoxel> deserialized_block(kVoxelsPerSide, kVoxelSize,
+                                      Point::Zero());
+  deserialized_block.deserializeFromIntegers(data);
+  EXPECT_EQ(deserialized_block.num_observed_voxels(), kIndices.size());
+
+  block.reinitialize(Point::Zero());
+  EXPECT_EQ(block.num_observed_voxels(), 0u);
+  EXPECT_FALSE(block.isVoxelObserved(0u));
+}
+
+TEST_F(ObservedVoxelMaskTest, LayerCopyAndMerge) {
+  size_t num_observed = 0u;
+  for (const BlockIndex& block_index : blocks_) {
+    num_observed +=
+        tsdf_layer_->getBlockByIndex(block_index).num_observed_voxels();
+  }
+  EXPECT_GT(num_observed, 0u);
+  EXPECT_LT(num_observed, blocks_.size() * kVoxelsPerSide * kVoxelsPerSide *
+                              kVoxelsPerSide / 2u);
+
+  const Layer<TsdfVoxel> layer_copy(*tsdf_layer_);
+  Layer<TsdfVoxel> merged_layer(kVoxelSize, kVoxelsPerSide);
+  for (const BlockIndex& block_index : blocks_) {
+    // The integrators do not flag blocks as holding data, merging skips them
+    // otherwise.
+    tsdf_layer_->getBlockByIndex(block_index).has_data() = true;
+    const Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(block_index);
+    const Block<TsdfVoxel>& block_copy =
+        layer_copy.getBlockByIndex(block_index);
+    Block<TsdfVoxel>& merged_block =
+        *merged_layer.allocateBlockPtrByIndex(block_index);
+    merged_block.mergeBlock(block);
+    EXPECT_EQ(block.num_observed_voxels(), block_copy.num_observed_voxels());
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      ASSERT_EQ(block.getVoxelByLinearIndex(i).distance,
+                block_copy.getVoxelByLinearIndex(i).distance);
+      ASSERT_EQ(block.getVoxelByLinearIndex(i).weight,
+                merged_block.getVoxelByLinearIndex(i).weight);
+    }
+  }
+}
+
+TEST_F(ObservedVoxelMaskTest, MeshAndEsdfMatchFullIteration) {
+  Layer<TsdfVoxel> full_layer(*tsdf_layer_);
+  markAllVoxels(&full_layer);
+
+  MeshIntegratorConfig mesh_config;
+  MeshLayer mesh_layer(tsdf_layer_->block_size());
+  MeshLayer full_mesh_layer(full_layer.block_size());
+  MeshIntegrator<TsdfVoxel> mesh_integrator(mesh_config, *tsdf_layer_,
+                                            &mesh_layer);
+  MeshIntegrator<TsdfVoxel> full_mesh_integrator(mesh_config, full_layer,
+                                                 &full_mesh_layer);
+  constexpr bool kOnlyMeshUpdatedBlocks = false;
+  constexpr bool kClearUpdatedFlag = false;
+  mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+  full_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+
+  size_t num_vertices = 0u;
+  for (const BlockIndex& block_index : blocks_) {
+    const Mesh& mesh = mesh_layer.getMeshByIndex(block_index);
+    const Mesh& full_mesh = full_mesh_layer.getMeshByIndex(block_index);
+    ASSERT_EQ(mesh.vertices.size(), full_mesh.vertices.size());
+    for (size_t i = 0u; i < mesh.vertices.size(); ++i) {
+      EXPECT_EQ(mesh.vertices[i], full_mesh.vertices[i]);
+    }
+    num_vertices += mesh.vertices.size();
+  }
+  EXPECT_GT(num_vertices, 0u);
+
+  EsdfIntegrator::Config esdf_config;
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  Layer<EsdfVoxel> full_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator esdf_integrator(esdf_config, tsdf_layer_.get(), &esdf_layer);
+  EsdfIntegrator full_esdf_integrator(esdf_config, &full_layer,
+                                      &full_esdf_layer);
+  esdf_integrator.updateFromTsdfBlocks(blocks_);
+  full_esdf_integrator.updateFromTsdfBlocks(blocks_);
+  for (const BlockIndex& block_index : blocks_) {
+    const Block<EsdfVoxel>& block = esdf_layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& full_block =
+        full_esdf_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      ASSERT_EQ(block.getVoxelByLinearIndex(i).observed,
+                full_block.getVoxelByLinearIndex(i).observed);
+      ASSERT_EQ(block.getVoxelByLinearIndex(i).distance,
+                full_block.getVoxelByLinearIndex(i).distance);
+    }
+  }
+}
+
+TEST_F(ObservedVoxelMaskTest, Benchmark) {
+  Layer<TsdfVoxel> full_layer(*tsdf_layer_);
+  markAllVoxels(&full_layer);
+
+  constexpr int kNumRepetitions = 5;
+  MeshIntegratorConfig mesh_config;
+  mesh_config.integrator_threads = 1;
+  EsdfIntegrator::Config esdf_config;
+  constexpr bool kOnlyMeshUpdatedBlocks = false;
+  constexpr bool kClearUpdatedFlag = false;
+
+  timing::Timing::Reset();
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    MeshLayer mesh_layer(tsdf_layer_->block_size());
+    MeshIntegrator<TsdfVoxel> mesh_integrator(mesh_config, *tsdf_layer_,
+                                              &mesh_layer);
+    timing::Timer mesh_timer("observed_mask/mesh");
+    mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+    mesh_timer.Stop();
+
+    MeshLayer full_mesh_layer(full_layer.block_size());
+    MeshIntegrator<TsdfVoxel> full_mesh_integrator(mesh_config, full_layer,
+                                                   &full_mesh_layer);
+    timing::Timer full_mesh_timer("all_voxels/mesh");
+    full_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks,
+                                      kClearUpdatedFlag);
+    full_mesh_timer.Stop();
+
+    Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+    EsdfIntegrator esdf_integrator(esdf_config, tsdf_layer_.get(),
+                                   &esdf_layer);
+    timing::Timer esdf_timer("observed_mask/esdf");
+    esdf_integrator.updateFromTsdfBlocks(blocks_);
+    esdf_timer.Stop();
+
+    Layer<EsdfVoxel> full_esdf_layer(kVoxelSize, kVoxelsPerSide);
+    EsdfIntegrator full_esdf_integrator(esdf_config, &full_layer,
+                                        &full_esdf_layer);
+    timing::Timer full_esdf_timer("all_voxels/esdf");
+    full_esdf_integrator.updateFromTsdfBlocks(blocks_);
+    full_esdf_timer.Stop();
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class PartitionedTsdfIntegratorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-12.0, -12.0, -1.0), Point(12.0, 12.0, 5.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(3.0, 1.0, 1.0), 1.0, Color::Red())));
+    world_.addObject(std::unique_ptr<Object>(new Cylinder(
+        Point(-4.0, -2.0, 2.0), 1.5, 4.0, Color::Green())));
+    world_.addGroundLevel(0.0);
+    world_.addPlaneBoundaries(-10.0, 10.0, -10.0, 10.0);
+
+    // Emulates a spinning LiDAR by stitching four 90 degree views.
+    T_G_S_ = Transformation(Quaternion::Identity(), Point(0.0, 0.0, 1.5));
+    constexpr int kNumViews = 4;
+    for (int i = 0; i < kNumViews; ++i) {
+      const Transformation T_S_V(
+          Quaternion(Eigen::AngleAxis<FloatingPoint>(i * M_PI_2,
+                                                     Point::UnitZ())),
+          Point::Zero());
+      Pointcloud points_G;
+      Colors colors;
+      world_.getPointcloudFromTransform(T_G_S_ * T_S_V,
+                                        Eigen::Vector2i(256, 32), M_PI_2,
+                                        kMaxDistance, &points_G, &colors);
+      Pointcloud points_S;
+      transformPointcloud(T_G_S_.inverse(), points_G, &points_S);
+      points_S_.insert(points_S_.end(), points_S.begin(), points_S.end());
+      colors_.insert(colors_.end(), colors.begin(), colors.end());
+    }
+  }
+
+  TsdfIntegratorBase::Config getConfig(size_t num_threads) const {
+    TsdfIntegratorBase::Config config;
+    config.default_truncation_distance = 4 * kVoxelSize;
+    config.max_ray_length_m = kMaxDistance;
+    config.integrator_threads = num_threads;
+    return config;
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+  static constexpr FloatingPoint kMaxDistance = 15.0;
+
+  SimulationWorld world_;
+  Transformation T_G_S_;
+  Pointcloud points_S_;
+  Colors colors_;
+};
+
+TEST_F(PartitionedTsdfIntegratorTest, IndependentOfThreadCount) {
+  Layer<TsdfVoxel> reference_layer(kVoxelSize, kVoxelsPerSide);
+  PartitionedTsdfIntegrator(getConfig(1u), &reference_layer)
+      .integratePointCloud(T_G_S_, points_S_, colors_);
+  BlockIndexList blocks;
+  reference_layer.getAllAllocatedBlocks(&blocks);
+  EXPECT_GT(blocks.size(), 0u);
+
+  for (const size_t num_threads : {3u, 16u}) {
+    Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+    PartitionedTsdfIntegrator(getConfig(num_threads), &layer)
+        .integratePointCloud(T_G_S_, points_S_, colors_);
+    ASSERT_EQ(layer.getNumberOfAllocatedBlocks(), blocks.size());
+    for (const BlockIndex& block_index : blocks) {
+      const Block<TsdfVoxel>& reference_block =
+          reference_layer.getBlockByIndex(block_index);
+      const Block<TsdfVoxel>& block = layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const TsdfVoxel& reference_voxel =
+            reference_block.getVoxelByLinearIndex(i);
+        const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        ASSERT_EQ(reference_voxel.distance, voxel.distance);
+        ASSERT_EQ(reference_voxel.weight, voxel.weight);
+        ASSERT_EQ(reference_voxel.color.g, voxel.color.g);
+      }
+    }
+  }
+}
+
+TEST_F(PartitionedTsdfIntegratorTest, MatchesSimpleIntegrator) {
+  Layer<TsdfVoxel> simple_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator(getConfig(1u), &simple_layer)
+      .integratePointCloud(T_G_S_, points_S_, colors_);
+  Layer<TsdfVoxel> partitioned_layer(kVoxelSize, kVoxelsPerSide);
+  TsdfIntegratorFactory::create("partitioned", getConfig(4u),
+                                &partitioned_layer)
+      ->integratePointCloud(T_G_S_, points_S_, colors_);
+
+  // Both cast the same rays, only the order of fusing differs.
+  BlockIndexList blocks;
+  simple_layer.getAllAllocatedBlocks(&blocks);
+  ASSERT_EQ(partitioned_layer.getNumberOfAllocatedBlocks(), blocks.size());
+  for (const BlockIndex& block_index : blocks) {
+    const Block<TsdfVoxel>& simple_block =
+        simple_layer.getBlockByIndex(block_index);
+    const Block<TsdfVoxel>& block =
+        partitioned_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const float weight = simple_block.getVoxelByLinearIndex(i).weight;
+      ASSERT_NEAR(weight, block.getVoxelByLinearIndex(i).weight,
+                  1e-4 * weight + 1e-6);
+    }
+  }
+}
+
+TEST_F(PartitionedTsdfIntegratorTest, Benchmark) {
+  constexpr int kNumRepetitions = 3;
+  std::cout << "Dense scan with " << points_S_.size() << " points."
+            << std::endl;
+  timing::Timing::Reset();
+  for (const std::string& integrator_type : std::vector<std::string>(
+           {"simple", "merged", "fast", "partitioned"})) {
+    for (const size_t num_threads : {1u, 4u, 16u}) {
+      const std::string timer_name = "benchmark/" + integrator_type + "/" +
+                                     std::to_string(num_threads) +
+                                     "_threads";
+      for (int i = 0; i < kNumRepetitions; ++i) {
+        Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+        TsdfIntegratorBase::Ptr integrator = TsdfIntegratorFactory::create(
+            integrator_type, getConfig(num_threads), &layer);
+        timing::Timer timer(timer_name);
+        integrator->integratePointCloud(T_G_S_, points_S_, colors_);
+        timer.Stop();
+      }
+    }
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
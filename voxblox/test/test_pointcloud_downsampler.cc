@@ -0,0 +1,245 @@
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/block_hash.h"
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/pointcloud_downsampler.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+namespace {
+
+/// Sums of the points of a cell, as a plain voxel grid filter keeps them.
+struct CellSum {
+  Point point_sum = Point::Zero();
+  uint32_t r = 0u, g = 0u, b = 0u, a = 0u;
+  size_t num_points = 0u;
+};
+
+}  // namespace
+
+class PointcloudDownsamplerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // Clusters of points, so most cells hold several of them.
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<FloatingPoint> center(-20.0, 20.0);
+    std::normal_distribution<FloatingPoint> spread(0.0, 0.3);
+    std::uniform_int_distribution<int> channel(0, 255);
+    for (size_t i = 0u; i < 500u; ++i) {
+      const Point cluster_center(center(gen), center(gen), center(gen));
+      for (size_t j = 0u; j < 100u; ++j) {
+        points_.push_back(cluster_center +
+                          Point(spread(gen), spread(gen), spread(gen)));
+        colors_.emplace_back(channel(gen), channel(gen), channel(gen),
+                             channel(gen));
+      }
+    }
+    for (size_t i = 0u; i < points_.size(); i += 97u) {
+      points_[i].y() = std::numeric_limits<FloatingPoint>::quiet_NaN();
+    }
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.25;
+
+  Pointcloud points_;
+  Colors colors_;
+};
+
+TEST_F(PointcloudDownsamplerTest, MatchesVoxelGrid) {
+  const FloatingPoint voxel_size_inv = 1.0 / kVoxelSize;
+  LongIndexHashMapType<CellSum>::type cells;
+  for (size_t i = 0u; i < points_.size(); ++i) {
+    if (!points_[i].allFinite()) {
+      continue;
+    }
+    CellSum& cell = cells[getGridIndexFromPoint<GlobalIndex>(points_[i],
+                                                             voxel_size_inv)];
+    cell.point_sum += points_[i];
+    cell.r += colors_[i].r;
+    cell.g += colors_[i].g;
+    cell.b += colors_[i].b;
+    cell.a += colors_[i].a;
+    ++cell.num_points;
+  }
+
+  Pointcloud single_thread_points;
+  for (const size_t num_threads : {1u, 4u}) {
+    PointcloudDownsampler::Config config;
+    config.voxel_size = kVoxelSize;
+    config.num_threads = num_threads;
+    PointcloudDownsampler downsampler(config);
+
+    Pointcloud downsampled_points;
+    Colors downsampled_colors;
+    std::vector<float> weights;
+    // The second call reuses the buffers of the first.
+    for (int i = 0; i < 2; ++i) {
+      downsampler.downsample(points_, colors_, &downsampled_points,
+                             &downsampled_colors, &weights);
+    }
+    ASSERT_EQ(downsampled_points.size(), cells.size());
+    ASSERT_EQ(downsampled_colors.size(), cells.size());
+    ASSERT_EQ(weights.size(), cells.size());
+
+    LongIndexSet seen_cells;
+    for (size_t i = 0u; i < downsampled_points.size(); ++i) {
+      const GlobalIndex cell_index = getGridIndexFromPoint<GlobalIndex>(
+          downsampled_points[i], voxel_size_inv);
+      ASSERT_TRUE(seen_cells.insert(cell_index).second);
+      const LongIndexHashMapType<CellSum>::type::const_iterator it =
+          cells.find(cell_index);
+      ASSERT_TRUE(it != cells.end());
+      const CellSum& cell = it->second;
+      EXPECT_EQ(weights[i], static_cast<float>(cell.num_points));
+      const Point mean =
+          cell.point_sum / static_cast<FloatingPoint>(cell.num_points);
+      EXPECT_NEAR((downsampled_points[i] - mean).norm(), 0.0, 1e-4);
+      EXPECT_NEAR(downsampled_colors[i].r,
+                  static_cast<float>(cell.r) / cell.num_points, 0.5);
+      EXPECT_NEAR(downsampled_colors[i].g,
+                  static_cast<float>(cell.g) / cell.num_points, 0.5);
+      EXPECT_NEAR(downsampled_colors[i].b,
+                  static_cast<float>(cell.b) / cell.num_points, 0.5);
+      EXPECT_NEAR(downsampled_colors[i].a,
+                  static_cast<float>(cell.a) / cell.num_points, 0.5);
+    }
+
+    // The points of a cell are summed in their original order, whatever the
+    // number of threads.
+    if (num_threads == 1u) {
+      single_thread_points = downsampled_points;
+    } else {
+      ASSERT_EQ(single_thread_points.size(), downsampled_points.size());
+      for (size_t i = 0u; i < downsampled_points.size(); ++i) {
+        EXPECT_EQ(single_thread_points[i], downsampled_points[i]);
+      }
+    }
+  }
+}
+
+TEST_F(PointcloudDownsamplerTest, EmptyAndNonFiniteClouds) {
+  PointcloudDownsampler::Config config;
+  config.voxel_size = kVoxelSize;
+  PointcloudDownsampler downsampler(config);
+
+  Pointcloud downsampled_points(1u);
+  Colors downsampled_colors(1u);
+  std::vector<float> weights(1u);
+  downsampler.downsample(Pointcloud(), Colors(), &downsampled_points,
+                         &downsampled_colors, &weights);
+  EXPECT_TRUE(downsampled_points.empty());
+  EXPECT_TRUE(downsampled_colors.empty());
+  EXPECT_TRUE(weights.empty());
+
+  Pointcloud non_finite_points(
+      10u, Point::Constant(std::numeric_limits<FloatingPoint>::infinity()));
+  downsampler.downsample(non_finite_points, Colors(10u), &downsampled_points,
+                         &downsampled_colors, &weights);
+  EXPECT_TRUE(downsampled_points.empty());
+}
+
+TEST_F(PointcloudDownsamplerTest, WeightedIntegration) {
+  // Scaling the weights of all points scales the voxel weights, the distances
+  // stay the same.
+  SimulationWorld world;
+  world.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+  world.addObject(std::unique_ptr<Object>(
+      new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+  const Transformation T_G_C(
+      Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+      Point(3.0, 0.0, 1.0));
+  Pointcloud points_G, points_C;
+  Colors colors;
+  world.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(80, 60), 2.0, 8.0,
+                                   &points_G, &colors);
+  transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+
+  TsdfIntegratorBase::Config config;
+  config.integrator_threads = 1u;
+  config.use_const_weight = true;
+  config.max_weight = std::numeric_limits<float>::max();
+  Layer<TsdfVoxel> layer(0.1, 16u);
+  SimpleTsdfIntegrator integrator(config, &layer);
+  integrator.integratePointCloud(T_G_C, points_C, colors);
+
+  Layer<TsdfVoxel> weighted_layer(0.1, 16u);
+  SimpleTsdfIntegrator weighted_integrator(config, &weighted_layer);
+  weighted_integrator.integrateWeightedPointCloud(
+      T_G_C, points_C, colors, std::vector<float>(points_C.size(), 2.0f));
+
+  BlockIndexList blocks;
+  layer.getAllAllocatedBlocks(&blocks);
+  ASSERT_EQ(weighted_layer.getNumberOfAllocatedBlocks(), blocks.size());
+  for (const BlockIndex& block_index : blocks) {
+    const Block<TsdfVoxel>& block = layer.getBlockByIndex(block_index);
+    const Block<TsdfVoxel>& weighted_block =
+        weighted_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const TsdfVoxel& weighted_voxel = weighted_block.getVoxelByLinearIndex(i);
+      ASSERT_NEAR(weighted_voxel.weight, 2.0f * voxel.weight,
+                  1e-4 * voxel.weight + 1e-6);
+      ASSERT_NEAR(weighted_voxel.distance, voxel.distance, 1e-5);
+    }
+  }
+}
+
+TEST_F(PointcloudDownsamplerTest, Benchmark) {
+  constexpr int kNumRepetitions = 20;
+  timing::Timing::Reset();
+
+  const FloatingPoint voxel_size_inv = 1.0 / kVoxelSize;
+  size_t num_hashed_cells = 0u;
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    // The bundling of the merged integrator.
+    timing::Timer timer("downsample/hash_map");
+    LongIndexHashMapType<AlignedVector<size_t>>::type cells;
+    for (size_t j = 0u; j < points_.size(); ++j) {
+      if (points_[j].allFinite()) {
+        cells[getGridIndexFromPoint<GlobalIndex>(points_[j], voxel_size_inv)]
+            .push_back(j);
+      }
+    }
+    num_hashed_cells = cells.size();
+    timer.Stop();
+  }
+
+  Pointcloud downsampled_points;
+  Colors downsampled_colors;
+  std::vector<float> weights;
+  for (const size_t num_threads : {1u, 4u}) {
+    PointcloudDownsampler::Config config;
+    config.voxel_size = kVoxelSize;
+    config.num_threads = num_threads;
+    PointcloudDownsampler downsampler(config);
+    for (int i = 0; i < kNumRepetitions; ++i) {
+      timing::Timer timer(num_threads == 1u ? "downsample/sorted_1_thread"
+                                            : "downsample/sorted_4_threads");
+      downsampler.downsample(points_, colors_, &downsampled_points,
+                             &downsampled_colors, &weights);
+      timer.Stop();
+    }
+    EXPECT_EQ(downsampled_points.size(), num_hashed_cells);
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,190 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/prepared_pointcloud.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class PreparedPointcloudTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<FloatingPoint> coordinate(-4.0, 4.0);
+    for (size_t i = 0u; i < 100000u; ++i) {
+      points_C_.emplace_back(coordinate(gen), coordinate(gen), coordinate(gen));
+    }
+    for (size_t i = 0u; i < points_C_.size(); i += 101u) {
+      points_C_[i].x() = std::numeric_limits<FloatingPoint>::quiet_NaN();
+    }
+    for (size_t i = 50u; i < points_C_.size(); i += 103u) {
+      points_C_[i].z() = std::numeric_limits<FloatingPoint>::infinity();
+    }
+    for (size_t i = 25u; i < points_C_.size(); i += 107u) {
+      points_C_[i] *= 0.01;
+    }
+
+    T_G_C_ = Transformation(
+        Quaternion(Eigen::AngleAxis<FloatingPoint>(0.3, Point(1.0, 2.0, 3.0)
+                                                            .normalized())),
+        Point(1.0, -2.0, 0.5));
+  }
+
+  Pointcloud points_C_;
+  Transformation T_G_C_;
+};
+
+TEST_F(PreparedPointcloudTest, MatchesPointwiseChecks) {
+  for (const bool allow_clear : {true, false}) {
+    for (const bool freespace_points : {false, true}) {
+      PreparedPointcloud::Config config;
+      config.min_ray_length_m = 0.1;
+      config.max_ray_length_m = 5.0;
+      config.allow_clear = allow_clear;
+      PreparedPointcloud prepared_points;
+      prepared_points.prepare(config, T_G_C_, points_C_, freespace_points);
+      EXPECT_EQ(prepared_points.getNumInputPoints(), points_C_.size());
+      EXPECT_EQ(prepared_points.areFreespacePoints(), freespace_points);
+
+      size_t i = 0u;
+      for (size_t point_idx = 0u; point_idx < points_C_.size(); ++point_idx) {
+        const Point& point_C = points_C_[point_idx];
+        const FloatingPoint range = point_C.norm();
+        if (!point_C.allFinite() || range < config.min_ray_length_m) {
+          continue;
+        }
+        const bool is_far = range > config.max_ray_length_m;
+        if (is_far && !allow_clear && !freespace_points) {
+          continue;
+        }
+        ASSERT_LT(i, prepared_points.size());
+        ASSERT_EQ(prepared_points.getPointIndex(i), point_idx);
+        EXPECT_EQ(prepared_points.isClearing(i), is_far || freespace_points);
+        EXPECT_NEAR(prepared_points.getRange(i), range, 1e-5);
+        EXPECT_EQ(prepared_points.getPointC(i), point_C);
+        EXPECT_NEAR((prepared_points.getPointG(i) - T_G_C_ * point_C).norm(),
+                    0.0, 1e-5);
+        ++i;
+      }
+      EXPECT_EQ(prepared_points.size(), i);
+    }
+  }
+}
+
+TEST_F(PreparedPointcloudTest, SetTransform) {
+  PreparedPointcloud::Config config;
+  PreparedPointcloud prepared_points;
+  prepared_points.prepare(config, Transformation(), points_C_, false);
+  prepared_points.setTransform(T_G_C_);
+
+  PreparedPointcloud expected_points;
+  expected_points.prepare(config, T_G_C_, points_C_, false);
+  ASSERT_EQ(prepared_points.size(), expected_points.size());
+  for (size_t i = 0u; i < prepared_points.size(); ++i) {
+    EXPECT_EQ(prepared_points.getPointG(i), expected_points.getPointG(i));
+  }
+}
+
+TEST_F(PreparedPointcloudTest, Integration) {
+  SimulationWorld world;
+  world.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+  world.addObject(std::unique_ptr<Object>(
+      new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+  world.addGroundLevel(0.0);
+  const Transformation T_G_C(
+      Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+      Point(4.0, 0.0, 1.5));
+  Pointcloud points_G, points_C;
+  Colors colors;
+  world.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(80, 60), 2.0, 8.0,
+                                   &points_G, &colors);
+  transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+
+  // Integrating a cloud prepared up front gives the same map.
+  for (const std::string& integrator_name :
+       {std::string("simple"), std::string("merged"), std::string("fast"),
+        std::string("partitioned")}) {
+    TsdfIntegratorBase::Config config;
+    config.integrator_threads = 1u;
+
+    Layer<TsdfVoxel> layer(0.1, 16u);
+    TsdfIntegratorFactory::create(integrator_name, config, &layer)
+        ->integratePointCloud(T_G_C, points_C, colors);
+
+    Layer<TsdfVoxel> prepared_layer(0.1, 16u);
+    TsdfIntegratorBase::Ptr integrator =
+        TsdfIntegratorFactory::create(integrator_name, config, &prepared_layer);
+    PreparedPointcloud prepared_points;
+    integrator->preparePointcloud(T_G_C, points_C, false, &prepared_points);
+    integrator->integratePreparedPointCloud(prepared_points, colors);
+
+    BlockIndexList blocks;
+    layer.getAllAllocatedBlocks(&blocks);
+    ASSERT_GT(blocks.size(), 0u) << integrator_name;
+    ASSERT_EQ(prepared_layer.getNumberOfAllocatedBlocks(), blocks.size())
+        << integrator_name;
+    for (const BlockIndex& block_index : blocks) {
+      const Block<TsdfVoxel>& block = layer.getBlockByIndex(block_index);
+      const Block<TsdfVoxel>& prepared_block =
+          prepared_layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        const TsdfVoxel& prepared_voxel =
+            prepared_block.getVoxelByLinearIndex(i);
+        ASSERT_EQ(prepared_voxel.weight, voxel.weight) << integrator_name;
+        ASSERT_EQ(prepared_voxel.distance, voxel.distance) << integrator_name;
+      }
+    }
+  }
+}
+
+TEST_F(PreparedPointcloudTest, Benchmark) {
+  constexpr int kNumRepetitions = 20;
+  timing::Timing::Reset();
+
+  PreparedPointcloud::Config config;
+  size_t num_pointwise_points = 0u;
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    // What every integration thread did for its points.
+    timing::Timer timer("prepare/pointwise");
+    Pointcloud points_G;
+    points_G.reserve(points_C_.size());
+    for (const Point& point_C : points_C_) {
+      const FloatingPoint range = point_C.norm();
+      if (range >= config.min_ray_length_m && std::isfinite(range)) {
+        points_G.push_back(T_G_C_ * point_C);
+      }
+    }
+    num_pointwise_points = points_G.size();
+    timer.Stop();
+  }
+
+  PreparedPointcloud prepared_points;
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    timing::Timer timer("prepare/batched");
+    prepared_points.prepare(config, T_G_C_, points_C_, false);
+    timer.Stop();
+  }
+  EXPECT_EQ(prepared_points.size(), num_pointwise_points);
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,217 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/evaluation_utils.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class ProjectiveTsdfIntegratorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+    world_.addObject(std::unique_ptr<Object>(new Cylinder(
+        Point(0.0, 0.0, 1.0), 1.0, 2.0, Color::Red())));
+    world_.addGroundLevel(0.0);
+
+    gt_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    world_.generateSdfFromWorld(kTruncationDistance, gt_layer_.get());
+
+    // The simulated sensor looks along x with pixels along y and z, rotate it
+    // into an optical frame looking along z.
+    Eigen::Matrix<FloatingPoint, 3, 3> R_S_O;
+    R_S_O << 0.0, 0.0, 1.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0;
+    const Transformation T_S_O(Quaternion(R_S_O), Point::Zero());
+
+    // The simulation only supports yawing sensors.
+    constexpr int kNumPoses = 8;
+    for (int i = 0; i < kNumPoses; ++i) {
+      const FloatingPoint angle = 2.0 * M_PI * i / kNumPoses;
+      const Point position(4.0 * std::sin(angle), 4.0 * std::cos(angle), 1.5);
+      const FloatingPoint yaw = std::atan2(-position.y(), -position.x());
+      const Transformation T_G_S(
+          Quaternion(Eigen::AngleAxis<FloatingPoint>(yaw, Point::UnitZ())),
+          position);
+      poses_.push_back(T_G_S * T_S_O);
+
+      Pointcloud points_G;
+      Colors colors;
+      world_.getPointcloudFromTransform(T_G_S, kSimulationResolution, kFov,
+                                        kMaxDistance, &points_G, &colors);
+      Pointcloud points_O;
+      transformPointcloud(poses_.back().inverse(), points_G, &points_O);
+      points_.push_back(points_O);
+      colors_.push_back(colors);
+    }
+
+    // Half the simulated resolution with the same field of view.
+    intrinsics_.width = kSimulationResolution.x() / 2;
+    intrinsics_.height = kSimulationResolution.y() / 2;
+    intrinsics_.fx = intrinsics_.width / (2.0 * std::tan(kFov / 2.0));
+    intrinsics_.fy = intrinsics_.fx;
+    intrinsics_.cx = intrinsics_.width / 2;
+    intrinsics_.cy = intrinsics_.height / 2;
+
+    config_.default_truncation_distance = kTruncationDistance;
+    config_.max_ray_length_m = kMaxDistance;
+    config_.projective_camera_intrinsics = intrinsics_;
+  }
+
+  void integrate(TsdfIntegratorBase* integrator) {
+    for (size_t i = 0u; i < poses_.size(); ++i) {
+      integrator->integratePointCloud(poses_[i], points_[i], colors_[i]);
+    }
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+  static constexpr FloatingPoint kTruncationDistance = 4 * kVoxelSize;
+  static constexpr FloatingPoint kFov = M_PI_2;
+  static constexpr FloatingPoint kMaxDistance = 8.0;
+  const Eigen::Vector2i kSimulationResolution = Eigen::Vector2i(320, 240);
+
+  SimulationWorld world_;
+  std::unique_ptr<Layer<TsdfVoxel>> gt_layer_;
+  AlignedVector<Transformation> poses_;
+  AlignedVector<Pointcloud> points_;
+  AlignedVector<Colors> colors_;
+  CameraIntrinsics intrinsics_;
+  TsdfIntegratorBase::Config config_;
+};
+
+TEST_F(ProjectiveTsdfIntegratorTest, GroundTruthRmse) {
+  config_.integrator_threads = 4u;
+  Layer<TsdfVoxel> simple_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator simple_integrator(config_, &simple_layer);
+  integrate(&simple_integrator);
+
+  Layer<TsdfVoxel> projective_layer(kVoxelSize, kVoxelsPerSide);
+  TsdfIntegratorBase::Ptr projective_integrator = TsdfIntegratorFactory::create(
+      "projective", config_, &projective_layer);
+  integrate(projective_integrator.get());
+
+  utils::VoxelEvaluationDetails simple_result, projective_result;
+  utils::evaluateLayersRmse(*gt_layer_, simple_layer,
+                            utils::VoxelEvaluationMode::kEvaluateAllVoxels,
+                            &simple_result);
+  utils::evaluateLayersRmse(*gt_layer_, projective_layer,
+                            utils::VoxelEvaluationMode::kEvaluateAllVoxels,
+                            &projective_result);
+  std::cout << "Simple Integrator: " << simple_result.toString();
+  std::cout << "Projective Integrator: " << projective_result.toString();
+
+  // Both observe about the same voxels with about the same accuracy. Rays
+  // also update the voxels they graze at the silhouettes, which projecting
+  // voxels does not.
+  EXPECT_GT(projective_result.num_overlapping_voxels, 0u);
+  EXPECT_NEAR(projective_result.num_overlapping_voxels,
+              simple_result.num_overlapping_voxels,
+              0.2 * simple_result.num_overlapping_voxels);
+  EXPECT_LT(projective_result.max_error, 2 * kTruncationDistance);
+  EXPECT_LT(projective_result.rmse, 2 * kVoxelSize);
+}
+
+TEST_F(ProjectiveTsdfIntegratorTest, IndependentOfThreadCount) {
+  // Every block is updated by a single thread, so the result is exact.
+  config_.integrator_threads = 1u;
+  Layer<TsdfVoxel> single_thread_layer(kVoxelSize, kVoxelsPerSide);
+  ProjectiveTsdfIntegrator single_thread_integrator(config_,
+                                                    &single_thread_layer);
+  integrate(&single_thread_integrator);
+
+  config_.integrator_threads = 8u;
+  Layer<TsdfVoxel> multi_thread_layer(kVoxelSize, kVoxelsPerSide);
+  ProjectiveTsdfIntegrator multi_thread_integrator(config_,
+                                                   &multi_thread_layer);
+  integrate(&multi_thread_integrator);
+
+  BlockIndexList blocks;
+  single_thread_layer.getAllAllocatedBlocks(&blocks);
+  EXPECT_GT(blocks.size(), 0u);
+  ASSERT_EQ(multi_thread_layer.getNumberOfAllocatedBlocks(), blocks.size());
+  for (const BlockIndex& block_index : blocks) {
+    ASSERT_TRUE(multi_thread_layer.hasBlock(block_index));
+    const Block<TsdfVoxel>& block =
+        single_thread_layer.getBlockByIndex(block_index);
+    const Block<TsdfVoxel>& multi_thread_block =
+        multi_thread_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const TsdfVoxel& multi_thread_voxel =
+          multi_thread_block.getVoxelByLinearIndex(i);
+      ASSERT_EQ(voxel.distance, multi_thread_voxel.distance);
+      ASSERT_EQ(voxel.weight, multi_thread_voxel.weight);
+      ASSERT_EQ(voxel.color.r, multi_thread_voxel.color.r);
+    }
+  }
+}
+
+TEST_F(ProjectiveTsdfIntegratorTest, OnlyUpdatedBlocksAreAllocated) {
+  // Without carving most blocks of the frustum see no update.
+  config_.voxel_carving_enabled = false;
+  Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+  ProjectiveTsdfIntegrator integrator(config_, &layer);
+  integrator.integratePointCloud(poses_.front(), points_.front(),
+                                 colors_.front());
+
+  BlockIndexList blocks;
+  layer.getAllAllocatedBlocks(&blocks);
+  EXPECT_GT(blocks.size(), 0u);
+  for (const BlockIndex& block_index : blocks) {
+    const Block<TsdfVoxel>& block = layer.getBlockByIndex(block_index);
+    EXPECT_GT(block.num_observed_voxels(), 0u);
+    EXPECT_TRUE(block.updated().all());
+    block.forEachObservedVoxel([this, &block](size_t linear_index) {
+      EXPECT_LE(std::abs(block.getVoxelByLinearIndex(linear_index).distance),
+                config_.default_truncation_distance);
+    });
+  }
+
+  // Depth images can be integrated directly, a depth image without valid
+  // pixels does not change the layer.
+  DepthImage empty_image =
+      DepthImage::Zero(intrinsics_.height, intrinsics_.width);
+  integrator.integrateDepthImage(poses_.back(), empty_image, Colors());
+  EXPECT_EQ(layer.getNumberOfAllocatedBlocks(), blocks.size());
+}
+
+TEST_F(ProjectiveTsdfIntegratorTest, Benchmark) {
+  constexpr int kNumRepetitions = 3;
+  timing::Timing::Reset();
+  for (const size_t num_threads : {1u, 4u}) {
+    config_.integrator_threads = num_threads;
+    for (const std::string& integrator_name :
+         {std::string("simple"), std::string("fast"),
+          std::string("projective")}) {
+      const std::string timer_name =
+          integrator_name + "/" + std::to_string(num_threads) + "_threads";
+      for (int i = 0; i < kNumRepetitions; ++i) {
+        Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+        TsdfIntegratorBase::Ptr integrator =
+            TsdfIntegratorFactory::create(integrator_name, config_, &layer);
+        timing::Timer timer(timer_name);
+        integrate(integrator.get());
+        timer.Stop();
+      }
+    }
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,228 @@
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/integrator_utils.h"
+#include "voxblox/integrator/occupancy_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+
+using namespace voxblox;  // NOLINT
+
+namespace {
+
+/**
+ * Counts the heap allocations of this process while enabled. Allocations are
+ * counted in malloc, as operator new and Eigen's aligned allocator both end up
+ * there. Relies on the glibc entry points.
+ */
+std::atomic<bool> counting_allocations(false);
+std::atomic<size_t> num_counted_allocations(0u);
+
+class AllocationCounter {
+ public:
+  AllocationCounter() {
+    num_counted_allocations = 0u;
+    counting_allocations = true;
+  }
+  ~AllocationCounter() { counting_allocations = false; }
+
+  size_t num_allocations() const { return num_counted_allocations; }
+};
+
+}  // namespace
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num_elements, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+
+void* malloc(size_t size) {
+  if (counting_allocations) {
+    ++num_counted_allocations;
+  }
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t num_elements, size_t size) {
+  if (counting_allocations) {
+    ++num_counted_allocations;
+  }
+  return __libc_calloc(num_elements, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+  if (counting_allocations) {
+    ++num_counted_allocations;
+  }
+  return __libc_realloc(pointer, size);
+}
+}
+
+class RayCastingAllocationsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addGroundLevel(0.0);
+
+    T_G_C_ = Transformation(
+        Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+        Point(3.0, 0.5, 1.5));
+    Pointcloud points_G;
+    Colors colors;
+    world_.getPointcloudFromTransform(T_G_C_, Eigen::Vector2i(160, 120), 2.0,
+                                      8.0, &points_G, &colors);
+    transformPointcloud(T_G_C_.inverse(), points_G, &points_C_);
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  SimulationWorld world_;
+  Transformation T_G_C_;
+  Pointcloud points_C_;
+};
+
+TEST_F(RayCastingAllocationsTest, HierarchicalIndexAlongRay) {
+  const size_t voxels_per_side = kVoxelsPerSide;
+  const FloatingPoint voxel_size = kVoxelSize;
+  constexpr FloatingPoint kTruncationDistance = 0.3;
+
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<FloatingPoint> coordinate(-5.0, 5.0);
+  AlignedVector<Point> starts, ends;
+  for (size_t i = 0u; i < 1000u; ++i) {
+    starts.emplace_back(coordinate(gen), coordinate(gen), coordinate(gen));
+    ends.emplace_back(coordinate(gen), coordinate(gen), coordinate(gen));
+  }
+
+  // Same voxels as in the map.
+  HierarchicalIndexBuffer hierarchical_idx;
+  for (size_t i = 0u; i < starts.size(); ++i) {
+    const bool voxel_carving_enabled = (i % 2u == 0u);
+    HierarchicalIndexMap hierarchical_idx_map;
+    getHierarchicalIndexAlongRay(starts[i], ends[i], voxels_per_side,
+                                 voxel_size, kTruncationDistance,
+                                 voxel_carving_enabled, &hierarchical_idx_map);
+    getHierarchicalIndexAlongRay(starts[i], ends[i], voxels_per_side,
+                                 voxel_size, kTruncationDistance,
+                                 voxel_carving_enabled, &hierarchical_idx);
+    ASSERT_EQ(hierarchical_idx.num_blocks(), hierarchical_idx_map.size());
+    for (size_t j = 0u; j < hierarchical_idx.num_blocks(); ++j) {
+      const HierarchicalIndexMap::const_iterator it =
+          hierarchical_idx_map.find(hierarchical_idx.getBlockIndex(j));
+      ASSERT_TRUE(it != hierarchical_idx_map.end());
+      ASSERT_EQ(hierarchical_idx.getVoxelIndices(j), it->second);
+    }
+  }
+
+  // The buffer fits all rays by now.
+  AllocationCounter allocation_counter;
+  size_t num_voxels = 0u;
+  for (size_t i = 0u; i < starts.size(); ++i) {
+    getHierarchicalIndexAlongRay(starts[i], ends[i], voxels_per_side,
+                                 voxel_size, kTruncationDistance,
+                                 (i % 2u == 0u), &hierarchical_idx);
+    for (size_t j = 0u; j < hierarchical_idx.num_blocks(); ++j) {
+      num_voxels += hierarchical_idx.getVoxelIndices(j).size();
+    }
+  }
+  EXPECT_EQ(allocation_counter.num_allocations(), 0u);
+  EXPECT_GT(num_voxels, 0u);
+
+  // Unlike filling a map.
+  HierarchicalIndexMap hierarchical_idx_map;
+  getHierarchicalIndexAlongRay(starts.front(), ends.front(), voxels_per_side,
+                               voxel_size, kTruncationDistance, true,
+                               &hierarchical_idx_map);
+  EXPECT_GT(allocation_counter.num_allocations(), 0u);
+}
+
+TEST_F(RayCastingAllocationsTest, OccupancyIntegrator) {
+  OccupancyIntegrator::Config config;
+  Layer<OccupancyVoxel> layer(kVoxelSize, kVoxelsPerSide);
+  OccupancyIntegrator integrator(config, &layer);
+  integrator.integratePointCloud(T_G_C_, points_C_);
+
+  // Cast the rays one by one with sets of cells, as before the buffers.
+  const FloatingPoint voxel_size_inv = 1.0 / kVoxelSize;
+  const Point& origin = T_G_C_.getPosition();
+  const Point start_scaled = origin * voxel_size_inv;
+  LongIndexSet free_cells, occupied_cells;
+  for (const Point& point_C : points_C_) {
+    const Point point_G = T_G_C_ * point_C;
+    const FloatingPoint ray_distance = (point_G - origin).norm();
+    AlignedVector<GlobalIndex> indices;
+    if (ray_distance < config.min_ray_length_m) {
+      continue;
+    } else if (ray_distance > config.max_ray_length_m) {
+      const Point end_scaled =
+          (origin + config.max_ray_length_m * (point_G - origin).normalized()) *
+          voxel_size_inv;
+      if (free_cells.count(getGridIndexFromPoint<GlobalIndex>(end_scaled)) ==
+          0u) {
+        castRay(start_scaled, end_scaled, &indices);
+        free_cells.insert(indices.begin(), indices.end());
+      }
+    } else {
+      const Point end_scaled = point_G * voxel_size_inv;
+      if (occupied_cells.count(
+              getGridIndexFromPoint<GlobalIndex>(end_scaled)) == 0u) {
+        castRay(start_scaled, end_scaled, &indices);
+        if (indices.size() > 2u) {
+          free_cells.insert(indices.begin(), indices.end() - 1);
+          occupied_cells.insert(indices.back());
+        }
+      }
+    }
+  }
+  EXPECT_GT(occupied_cells.size(), 0u);
+
+  BlockIndexList blocks;
+  layer.getAllAllocatedBlocks(&blocks);
+  size_t num_observed_voxels = 0u;
+  for (const BlockIndex& block_index : blocks) {
+    const Block<OccupancyVoxel>& block = layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const OccupancyVoxel& voxel = block.getVoxelByLinearIndex(i);
+      if (!voxel.observed) {
+        continue;
+      }
+      ++num_observed_voxels;
+      const GlobalIndex global_index =
+          getGlobalVoxelIndexFromBlockAndVoxelIndex(
+              block_index, block.computeVoxelIndexFromLinearIndex(i),
+              block.voxels_per_side());
+      const bool occupied = occupied_cells.count(global_index) > 0u;
+      ASSERT_TRUE(occupied || free_cells.count(global_index) > 0u);
+      ASSERT_EQ(voxel.probability_log > 0.0f, occupied);
+    }
+  }
+  for (const GlobalIndex& occupied_cell : occupied_cells) {
+    free_cells.insert(occupied_cell);
+  }
+  EXPECT_EQ(num_observed_voxels, free_cells.size());
+
+  // All blocks and buffers exist after the first scan.
+  AllocationCounter allocation_counter;
+  for (int i = 0; i < 5; ++i) {
+    integrator.integratePointCloud(T_G_C_, points_C_);
+  }
+  EXPECT_EQ(allocation_counter.num_allocations(), 0u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
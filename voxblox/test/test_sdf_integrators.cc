@@ -124,6 +124,10 @@ TEST_P(SdfIntegratorsTest, TsdfIntegrators) {
   Layer<TsdfVoxel> fast_layer(voxel_size_, voxels_per_side_);
   FastTsdfIntegrator fast_integrator(config, &fast_layer);
 
+  // Partitioned integrator
+  Layer<TsdfVoxel> partitioned_layer(voxel_size_, voxels_per_side_);
+  PartitionedTsdfIntegrator partitioned_integrator(config, &partitioned_layer);
+
   for (size_t i = 0; i < poses_.size(); i++) {
     Pointcloud ptcloud, ptcloud_C;
     Colors colors;
@@ -134,9 +138,11 @@ TEST_P(SdfIntegratorsTest, TsdfIntegrators) {
     simple_integrator.integratePointCloud(poses_[i], ptcloud_C, colors);
     merged_integrator.integratePointCloud(poses_[i], ptcloud_C, colors);
     fast_integrator.integratePointCloud(poses_[i], ptcloud_C, colors);
+    partitioned_integrator.integratePointCloud(poses_[i], ptcloud_C, colors);
   }
 
-  utils::VoxelEvaluationDetails simple_result, merged_result, fast_result;
+  utils::VoxelEvaluationDetails simple_result, merged_result, fast_result,
+      partitioned_result;
   utils::evaluateLayersRmse(*tsdf_gt_, simple_layer,
                             utils::VoxelEvaluationMode::kEvaluateAllVoxels,
                             &simple_result);
@@ -146,9 +152,13 @@ TEST_P(SdfIntegratorsTest, TsdfIntegrators) {
   utils::evaluateLayersRmse(*tsdf_gt_, fast_layer,
                             utils::VoxelEvaluationMode::kEvaluateAllVoxels,
                             &fast_result);
+  utils::evaluateLayersRmse(*tsdf_gt_, partitioned_layer,
+                            utils::VoxelEvaluationMode::kEvaluateAllVoxels,
+                            &partitioned_result);
   std::cout << "Simple Integrator: " << simple_result.toString();
   std::cout << "Merged Integrator: " << merged_result.toString();
   std::cout << "Fast Integrator: " << fast_result.toString();
+  std::cout << "Partitioned Integrator: " << partitioned_result.toString();
   std::cout << "Truncation distance: " << truncation_distance_ << std::endl;
 
   // Figure out some metrics to compare against, based on voxel size.
@@ -163,19 +173,25 @@ TEST_P(SdfIntegratorsTest, TsdfIntegrators) {
               merged_result.num_overlapping_voxels, one_percent_of_voxels);
   EXPECT_NEAR(simple_result.num_overlapping_voxels,
               fast_result.num_overlapping_voxels, one_percent_of_voxels);
+  EXPECT_NEAR(simple_result.num_overlapping_voxels,
+              partitioned_result.num_overlapping_voxels,
+              one_percent_of_voxels);
 
   // Make sure they're all reasonable.
   EXPECT_NEAR(simple_result.min_error, 0.0, kFloatingPointToleranceHigh);
   EXPECT_NEAR(merged_result.min_error, 0.0, kFloatingPointToleranceHigh);
   EXPECT_NEAR(fast_result.min_error, 0.0, kFloatingPointToleranceHigh);
+  EXPECT_NEAR(partitioned_result.min_error, 0.0, kFloatingPointToleranceHigh);
 
   EXPECT_LT(simple_result.max_error, truncation_distance_ * 2);
   EXPECT_LT(merged_result.max_error, truncation_distance_ * 2);
   EXPECT_LT(fast_result.max_error, truncation_distance_ * 2);
+  EXPECT_LT(partitioned_result.max_error, truncation_distance_ * 2);
 
   EXPECT_LT(simple_result.rmse, voxel_size_ * 2);
   EXPECT_LT(merged_result.rmse, voxel_size_ * 2);
   EXPECT_LT(fast_result.rmse, voxel_size_ * 2);
+  EXPECT_LT(partitioned_result.rmse, voxel_size_ * 2);
 
   io::SaveLayer(merged_layer, "tsdf_fast_test.voxblox", true);
 }
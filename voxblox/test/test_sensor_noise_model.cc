@@ -0,0 +1,200 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/sensor_noise_model.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+class SensorNoiseModelTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<FloatingPoint> range(0.1, kMaxRange);
+    for (size_t i = 0u; i < 100000u; ++i) {
+      ranges_.push_back(range(gen));
+    }
+  }
+
+  static SensorNoiseModel::Config getConfig(const std::string& type_name) {
+    SensorNoiseModel::Config config;
+    config.type = SensorNoiseModel::getTypeFromName(type_name);
+    config.max_range_m = kMaxRange;
+    return config;
+  }
+
+  static constexpr FloatingPoint kMaxRange = 10.0;
+
+  const std::vector<std::string> type_names_ = {"inverse_square_depth",
+                                                "lidar", "rgbd"};
+  std::vector<FloatingPoint> ranges_;
+};
+
+TEST_F(SensorNoiseModelTest, TableMatchesModel) {
+  for (const std::string& type_name : type_names_) {
+    const SensorNoiseModel model(getConfig(type_name));
+    for (const FloatingPoint range : ranges_) {
+      const float weight = model.computeWeightAtRange(range);
+      ASSERT_NEAR(model.getWeightAtRange(range), weight, 1e-3 * weight)
+          << type_name << " " << range;
+    }
+    // Normalized at 1 m.
+    EXPECT_NEAR(model.getWeightAtRange(1.0), 1.0f, 1e-4) << type_name;
+  }
+}
+
+TEST_F(SensorNoiseModelTest, InverseSquareDepth) {
+  // The weights voxblox always used.
+  const SensorNoiseModel model(getConfig("inverse_square_depth"));
+  for (const FloatingPoint range : ranges_) {
+    const float weight = 1.0f / (range * range);
+    ASSERT_NEAR(model.getWeight(Point(1.0, -2.0, range)), weight,
+                1e-3 * weight);
+    ASSERT_NEAR(model.getWeight(Point(0.0, 0.0, -range)), weight,
+                1e-3 * weight);
+  }
+}
+
+TEST_F(SensorNoiseModelTest, RangeAndDepth) {
+  const Point point_C(3.0, 0.0, 4.0);
+  const SensorNoiseModel lidar_model(getConfig("lidar"));
+  EXPECT_EQ(lidar_model.getWeight(point_C), lidar_model.getWeightAtRange(5.0));
+  const SensorNoiseModel rgbd_model(getConfig("rgbd"));
+  EXPECT_EQ(rgbd_model.getWeight(point_C), rgbd_model.getWeightAtRange(4.0));
+}
+
+TEST_F(SensorNoiseModelTest, RangesOutsideTable) {
+  for (const std::string& type_name : type_names_) {
+    const SensorNoiseModel model(getConfig(type_name));
+    const float max_range_weight = model.getWeightAtRange(kMaxRange);
+    const FloatingPoint max_range = kMaxRange;
+    for (const FloatingPoint range : {max_range, 2.0f * max_range}) {
+      EXPECT_EQ(model.getWeightAtRange(range),
+                model.computeWeightAtRange(range))
+          << type_name;
+    }
+    EXPECT_EQ(model.getWeightAtRange(
+                  std::numeric_limits<FloatingPoint>::infinity()),
+              0.0f)
+        << type_name;
+    EXPECT_EQ(model.getWeightAtRange(
+                  std::numeric_limits<FloatingPoint>::quiet_NaN()),
+              max_range_weight);
+
+    // Points at zero depth are ignored, as they always were.
+    EXPECT_EQ(model.getWeightAtRange(0.0), 0.0f) << type_name;
+    const Point zero_depth_point_C(1.0, 2.0, 0.0);
+    EXPECT_EQ(model.getWeight(zero_depth_point_C),
+              type_name == "lidar"
+                  ? model.getWeightAtRange(zero_depth_point_C.norm())
+                  : 0.0f)
+        << type_name;
+
+    // Ranges below the first entry of the table are clamped to it.
+    const float small_range_weight = model.getWeightAtRange(1e-3);
+    EXPECT_TRUE(std::isfinite(small_range_weight)) << type_name;
+    EXPECT_GT(small_range_weight, 0.0f) << type_name;
+  }
+}
+
+TEST_F(SensorNoiseModelTest, InverseSquareDepthBeyondTable) {
+  // Clearing rays and far points keep the weights voxblox always used.
+  const SensorNoiseModel model(getConfig("inverse_square_depth"));
+  for (const FloatingPoint range : {10.0f, 10.5f, 12.0f, 20.0f, 100.0f}) {
+    const float weight = 1.0f / (range * range);
+    EXPECT_NEAR(model.getWeight(Point(0.0, 0.0, range)), weight,
+                1e-3 * weight);
+  }
+}
+
+TEST_F(SensorNoiseModelTest, Integration) {
+  SimulationWorld world;
+  world.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+  world.addObject(std::unique_ptr<Object>(
+      new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+  world.addGroundLevel(0.0);
+  const Transformation T_G_C(
+      Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+      Point(4.0, 0.0, 1.5));
+  Pointcloud points_G, points_C;
+  Colors colors;
+  world.getPointcloudFromTransform(T_G_C, Eigen::Vector2i(80, 60), 2.0, 8.0,
+                                   &points_G, &colors);
+  transformPointcloud(T_G_C.inverse(), points_G, &points_C);
+
+  for (const std::string& type_name : type_names_) {
+    TsdfIntegratorBase::Config config;
+    config.integrator_threads = 1u;
+    config.sensor_noise_model = type_name;
+    config.max_ray_length_m = kMaxRange;
+    Layer<TsdfVoxel> layer(0.1, 16u);
+    SimpleTsdfIntegrator integrator(config, &layer);
+    EXPECT_EQ(integrator.getSensorNoiseModel().getConfig().type,
+              SensorNoiseModel::getTypeFromName(type_name));
+    integrator.integratePointCloud(T_G_C, points_C, colors);
+
+    BlockIndexList blocks;
+    layer.getAllAllocatedBlocks(&blocks);
+    ASSERT_GT(blocks.size(), 0u);
+    size_t num_observed_voxels = 0u;
+    for (const BlockIndex& block_index : blocks) {
+      const Block<TsdfVoxel>& block = layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        ASSERT_TRUE(std::isfinite(voxel.weight)) << type_name;
+        ASSERT_TRUE(std::isfinite(voxel.distance)) << type_name;
+        if (voxel.weight > 0.0f) {
+          ++num_observed_voxels;
+        }
+      }
+    }
+    EXPECT_GT(num_observed_voxels, 0u) << type_name;
+  }
+}
+
+TEST_F(SensorNoiseModelTest, Benchmark) {
+  constexpr int kNumRepetitions = 20;
+  timing::Timing::Reset();
+
+  for (const std::string& type_name : type_names_) {
+    const SensorNoiseModel model(getConfig(type_name));
+    float computed_sum = 0.0f;
+    float tabulated_sum = 0.0f;
+    for (int i = 0; i < kNumRepetitions; ++i) {
+      timing::Timer computed_timer("weights/" + type_name + "/computed");
+      for (const FloatingPoint range : ranges_) {
+        computed_sum += model.computeWeightAtRange(range);
+      }
+      computed_timer.Stop();
+
+      timing::Timer tabulated_timer("weights/" + type_name + "/tabulated");
+      for (const FloatingPoint range : ranges_) {
+        tabulated_sum += model.getWeightAtRange(range);
+      }
+      tabulated_timer.Stop();
+    }
+    EXPECT_NEAR(tabulated_sum, computed_sum, 1e-3 * computed_sum);
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,216 @@
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/mesh/mesh_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/thread_pool.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+TEST(ThreadPoolTest, RunsEveryTaskOnce) {
+  constexpr size_t kNumTasks = 1000u;
+  for (const size_t num_threads : {0u, 1u, 4u}) {
+    ThreadPool thread_pool(num_threads);
+    EXPECT_EQ(thread_pool.num_threads(), num_threads);
+    EXPECT_EQ(thread_pool.getWorkerIndex(), ThreadPool::kNoAffinity);
+
+    std::vector<std::atomic<int>> num_runs(kNumTasks);
+    for (std::atomic<int>& num_run : num_runs) {
+      num_run = 0;
+    }
+    std::atomic<bool> valid_worker_indices(true);
+    thread_pool.runTasks(kNumTasks, [&](size_t task_idx) {
+      ++num_runs[task_idx];
+      const int worker_idx = thread_pool.getWorkerIndex();
+      if (worker_idx != ThreadPool::kNoAffinity &&
+          (worker_idx < 0 || worker_idx >= static_cast<int>(num_threads))) {
+        valid_worker_indices = false;
+      }
+    });
+    for (const std::atomic<int>& num_run : num_runs) {
+      ASSERT_EQ(num_run, 1);
+    }
+    EXPECT_TRUE(valid_worker_indices);
+
+    // Single tasks with and without affinity.
+    ThreadPool::TaskGroup group;
+    std::atomic<size_t> num_submitted_runs(0u);
+    for (size_t i = 0u; i < kNumTasks; ++i) {
+      thread_pool.submit([&num_submitted_runs]() { ++num_submitted_runs; },
+                         &group,
+                         (i % 2u == 0u) ? static_cast<int>(i)
+                                        : ThreadPool::kNoAffinity);
+    }
+    thread_pool.wait(&group);
+    EXPECT_TRUE(group.done());
+    EXPECT_EQ(num_submitted_runs, kNumTasks);
+  }
+}
+
+TEST(ThreadPoolTest, NestedAndConcurrentCallers) {
+  // Waiting threads run queued tasks themselves, so tasks can wait for tasks
+  // even if there are fewer workers than waiting tasks.
+  ThreadPool thread_pool(2u);
+  constexpr size_t kNumTasks = 8u;
+  std::atomic<size_t> num_runs(0u);
+  std::vector<std::thread> callers;
+  for (size_t caller_idx = 0u; caller_idx < 4u; ++caller_idx) {
+    callers.emplace_back([&]() {
+      thread_pool.runTasks(kNumTasks, [&](size_t /*task_idx*/) {
+        thread_pool.runTasks(kNumTasks,
+                             [&](size_t /*task_idx*/) { ++num_runs; });
+      });
+    });
+  }
+  for (std::thread& caller : callers) {
+    caller.join();
+  }
+  EXPECT_EQ(num_runs, 4u * kNumTasks * kNumTasks);
+}
+
+class SharedThreadPoolTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addGroundLevel(0.0);
+
+    T_G_C_ = Transformation(
+        Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+        Point(4.0, 0.0, 1.5));
+    Pointcloud points_G;
+    world_.getPointcloudFromTransform(T_G_C_, Eigen::Vector2i(160, 120), 2.0,
+                                      8.0, &points_G, &colors_);
+    transformPointcloud(T_G_C_.inverse(), points_G, &points_C_);
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  SimulationWorld world_;
+  Transformation T_G_C_;
+  Pointcloud points_C_;
+  Colors colors_;
+};
+
+TEST_F(SharedThreadPoolTest, IntegratorsAndMesher) {
+  TsdfIntegratorBase::Config config;
+  config.integrator_threads = 1u;
+  Layer<TsdfVoxel> reference_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator(config, &reference_layer)
+      .integratePointCloud(T_G_C_, points_C_, colors_);
+
+  // More tasks than workers.
+  ThreadPool::Ptr thread_pool = std::make_shared<ThreadPool>(3u);
+  config.integrator_threads = 8u;
+  for (const std::string& integrator_name :
+       {std::string("simple"), std::string("merged"), std::string("fast"),
+        std::string("partitioned")}) {
+    Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+    TsdfIntegratorBase::Ptr integrator =
+        TsdfIntegratorFactory::create(integrator_name, config, &layer);
+    integrator->setThreadPool(thread_pool);
+    integrator->integratePointCloud(T_G_C_, points_C_, colors_);
+    EXPECT_GT(layer.getNumberOfAllocatedBlocks(), 0u) << integrator_name;
+
+    // The simple integrator matches its single threaded result, up to the
+    // order of fusion.
+    if (integrator_name == "simple") {
+      BlockIndexList blocks;
+      reference_layer.getAllAllocatedBlocks(&blocks);
+      ASSERT_EQ(layer.getNumberOfAllocatedBlocks(), blocks.size());
+      for (const BlockIndex& block_index : blocks) {
+        const Block<TsdfVoxel>& reference_block =
+            reference_layer.getBlockByIndex(block_index);
+        const Block<TsdfVoxel>& block = layer.getBlockByIndex(block_index);
+        for (size_t i = 0u; i < block.num_voxels(); ++i) {
+          const float weight = reference_block.getVoxelByLinearIndex(i).weight;
+          ASSERT_NEAR(block.getVoxelByLinearIndex(i).weight, weight,
+                      1e-4 * weight + 1e-6);
+        }
+      }
+    }
+  }
+
+  MeshIntegratorConfig mesh_config;
+  mesh_config.integrator_threads = 8u;
+  MeshLayer mesh_layer(reference_layer.block_size());
+  MeshLayer pooled_mesh_layer(reference_layer.block_size());
+  MeshIntegrator<TsdfVoxel> mesh_integrator(mesh_config, reference_layer,
+                                            &mesh_layer);
+  MeshIntegrator<TsdfVoxel> pooled_mesh_integrator(mesh_config, reference_layer,
+                                                   &pooled_mesh_layer);
+  pooled_mesh_integrator.setThreadPool(thread_pool);
+  constexpr bool kOnlyMeshUpdatedBlocks = false;
+  constexpr bool kClearUpdatedFlag = false;
+  mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+  pooled_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks,
+                                      kClearUpdatedFlag);
+  EXPECT_GT(mesh_layer.getNumberOfAllocatedMeshes(), 0u);
+  EXPECT_EQ(pooled_mesh_layer.getNumberOfAllocatedMeshes(),
+            mesh_layer.getNumberOfAllocatedMeshes());
+}
+
+TEST_F(SharedThreadPoolTest, Benchmark) {
+  constexpr int kNumRepetitions = 200;
+  constexpr size_t kNumThreads = 4u;
+  timing::Timing::Reset();
+
+  // Pure dispatch overhead.
+  std::atomic<size_t> num_runs(0u);
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    timing::Timer timer("dispatch/spawn_threads");
+    std::vector<std::thread> threads;
+    for (size_t j = 0u; j < kNumThreads; ++j) {
+      threads.emplace_back([&num_runs]() { ++num_runs; });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    timer.Stop();
+  }
+  ThreadPool thread_pool(kNumThreads - 1u);
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    timing::Timer timer("dispatch/thread_pool");
+    thread_pool.runTasks(kNumThreads,
+                         [&num_runs](size_t /*task_idx*/) { ++num_runs; });
+    timer.Stop();
+  }
+  EXPECT_EQ(num_runs, 2u * kNumRepetitions * kNumThreads);
+
+  // A stream of small scans as from a 30 Hz sensor.
+  TsdfIntegratorBase::Config config;
+  config.integrator_threads = kNumThreads;
+  Pointcloud small_points_C(points_C_.begin(),
+                            points_C_.begin() + points_C_.size() / 8u);
+  Colors small_colors(colors_.begin(), colors_.begin() + colors_.size() / 8u);
+  Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+  FastTsdfIntegrator integrator(config, &layer);
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    timing::Timer timer("fast_small_scan/thread_pool");
+    integrator.integratePointCloud(T_G_C_, small_points_C, small_colors);
+    timer.Stop();
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,215 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+/// Exposes the voxel update of the integrator base to the test.
+class VoxelUpdateIntegrator : public TsdfIntegratorBase {
+ public:
+  VoxelUpdateIntegrator(const Config& config, Layer<TsdfVoxel>* layer)
+      : TsdfIntegratorBase(config, layer) {}
+
+  void integratePreparedPointCloud(
+      const PreparedPointcloud& /*prepared_points*/,
+      const Colors& /*colors*/) {}
+
+  using TsdfIntegratorBase::updateTsdfVoxel;
+};
+
+class VoxelSpinLockTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-5.0, -5.0, -1.0), Point(5.0, 5.0, 4.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addGroundLevel(0.0);
+
+    T_G_C_ = Transformation(
+        Quaternion(Eigen::AngleAxis<FloatingPoint>(M_PI, Point::UnitZ())),
+        Point(4.0, 0.0, 1.5));
+    Pointcloud points_G;
+    world_.getPointcloudFromTransform(T_G_C_, Eigen::Vector2i(320, 240), 2.0,
+                                      8.0, &points_G, &colors_);
+    transformPointcloud(T_G_C_.inverse(), points_G, &points_C_);
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.05;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  SimulationWorld world_;
+  Transformation T_G_C_;
+  Pointcloud points_C_;
+  Colors colors_;
+};
+
+TEST_F(VoxelSpinLockTest, NoLostUpdates) {
+  TsdfIntegratorBase::Config config;
+  config.use_voxel_spin_locks = true;
+  config.use_weight_dropoff = false;
+  config.max_weight = 1e9;
+  Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+  VoxelUpdateIntegrator integrator(config, &layer);
+
+  // All threads hammer the same voxel, every update has to be counted.
+  constexpr size_t kNumThreads = 16u;
+  constexpr size_t kNumUpdatesPerThread = 2000u;
+  const Point origin(0.0, 0.0, 0.0);
+  const Point point_G(1.0, 0.0, 0.0);
+  const GlobalIndex global_voxel_index(19, 0, 0);
+  TsdfVoxel voxel;
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&]() {
+      for (size_t i = 0u; i < kNumUpdatesPerThread; ++i) {
+        integrator.updateTsdfVoxel(origin, point_G, global_voxel_index,
+                                   Color::Red(), 1.0f, &voxel);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(voxel.weight, static_cast<float>(kNumThreads *
+                                             kNumUpdatesPerThread));
+
+  // A single update gives the same distance as the mutex guarded update.
+  TsdfVoxel single_voxel;
+  integrator.updateTsdfVoxel(origin, point_G, global_voxel_index,
+                             Color::Red(), 1.0f, &single_voxel);
+  EXPECT_NEAR(voxel.distance, single_voxel.distance, 1e-5);
+  EXPECT_EQ(voxel.color.r, Color::Red().r);
+}
+
+TEST_F(VoxelSpinLockTest, MatchesMutexUpdates) {
+  // With a single thread the updates happen in the same order, so both modes
+  // have to produce identical layers.
+  for (const std::string& integrator_type :
+       std::vector<std::string>({"simple", "merged", "fast"})) {
+    TsdfIntegratorBase::Config config;
+    config.integrator_threads = 1u;
+    Layer<TsdfVoxel> mutex_layer(kVoxelSize, kVoxelsPerSide);
+    TsdfIntegratorFactory::create(integrator_type, config, &mutex_layer)
+        ->integratePointCloud(T_G_C_, points_C_, colors_);
+
+    config.use_voxel_spin_locks = true;
+    Layer<TsdfVoxel> spin_lock_layer(kVoxelSize, kVoxelsPerSide);
+    TsdfIntegratorFactory::create(integrator_type, config, &spin_lock_layer)
+        ->integratePointCloud(T_G_C_, points_C_, colors_);
+
+    BlockIndexList blocks;
+    mutex_layer.getAllAllocatedBlocks(&blocks);
+    EXPECT_GT(blocks.size(), 0u);
+    ASSERT_EQ(spin_lock_layer.getNumberOfAllocatedBlocks(), blocks.size());
+    for (const BlockIndex& block_index : blocks) {
+      const Block<TsdfVoxel>& block = mutex_layer.getBlockByIndex(block_index);
+      const Block<TsdfVoxel>& spin_lock_block =
+          spin_lock_layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        ASSERT_EQ(block.getVoxelByLinearIndex(i).distance,
+                  spin_lock_block.getVoxelByLinearIndex(i).distance);
+        ASSERT_EQ(block.getVoxelByLinearIndex(i).weight,
+                  spin_lock_block.getVoxelByLinearIndex(i).weight);
+      }
+    }
+  }
+}
+
+TEST_F(VoxelSpinLockTest, MultiThreadedMatchesSingleThreaded) {
+  // The simple integrator fuses the same measurements regardless of the number
+  // of threads, unlike the merged and fast ones.
+  TsdfIntegratorBase::Config config;
+  config.integrator_threads = 1u;
+  Layer<TsdfVoxel> single_thread_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator(config, &single_thread_layer)
+      .integratePointCloud(T_G_C_, points_C_, colors_);
+
+  config.integrator_threads = 8u;
+  config.use_voxel_spin_locks = true;
+  Layer<TsdfVoxel> spin_lock_layer(kVoxelSize, kVoxelsPerSide);
+  SimpleTsdfIntegrator(config, &spin_lock_layer)
+      .integratePointCloud(T_G_C_, points_C_, colors_);
+
+  BlockIndexList blocks;
+  single_thread_layer.getAllAllocatedBlocks(&blocks);
+  EXPECT_GT(blocks.size(), 0u);
+  ASSERT_EQ(spin_lock_layer.getNumberOfAllocatedBlocks(), blocks.size());
+  size_t num_observed = 0u;
+  size_t num_different = 0u;
+  for (const BlockIndex& block_index : blocks) {
+    ASSERT_TRUE(spin_lock_layer.hasBlock(block_index));
+    const Block<TsdfVoxel>& block =
+        single_thread_layer.getBlockByIndex(block_index);
+    const Block<TsdfVoxel>& spin_lock_block =
+        spin_lock_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      // As with the mutexes, the fusion order only changes the rounding of the
+      // weights and, through clamping, the distances within the truncation
+      // band.
+      const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const TsdfVoxel& spin_lock_voxel =
+          spin_lock_block.getVoxelByLinearIndex(i);
+      ASSERT_NEAR(voxel.distance, spin_lock_voxel.distance,
+                  2.0 * config.default_truncation_distance);
+      ASSERT_NEAR(voxel.weight, spin_lock_voxel.weight,
+                  1e-5 * voxel.weight + 1e-6);
+      if (voxel.weight > 0.0f) {
+        ++num_observed;
+      }
+      if (std::abs(voxel.distance - spin_lock_voxel.distance) > 1e-4) {
+        ++num_different;
+      }
+    }
+  }
+  std::cout << num_different << " of " << num_observed
+            << " voxel distances differ." << std::endl;
+  EXPECT_LT(num_different, num_observed / 100u);
+}
+
+TEST_F(VoxelSpinLockTest, Benchmark) {
+  constexpr int kNumRepetitions = 3;
+  timing::Timing::Reset();
+  for (const std::string& integrator_type :
+       std::vector<std::string>({"simple", "fast"})) {
+    for (const size_t num_threads : {1u, 4u, 16u}) {
+      for (const bool use_voxel_spin_locks : {false, true}) {
+        TsdfIntegratorBase::Config config;
+        config.integrator_threads = num_threads;
+        config.use_voxel_spin_locks = use_voxel_spin_locks;
+        const std::string timer_name =
+            integrator_type + "/" + std::to_string(num_threads) +
+            "_threads/" + (use_voxel_spin_locks ? "spin_lock" : "mutex");
+        for (int i = 0; i < kNumRepetitions; ++i) {
+          Layer<TsdfVoxel> layer(kVoxelSize, kVoxelsPerSide);
+          TsdfIntegratorBase::Ptr integrator =
+              TsdfIntegratorFactory::create(integrator_type, config, &layer);
+          timing::Timer timer(timer_name);
+          integrator->integratePointCloud(T_G_C_, points_C_, colors_);
+          timer.Stop();
+        }
+      }
+    }
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
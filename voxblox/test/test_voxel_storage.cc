@@ -0,0 +1,256 @@
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/interpolator/interpolator.h"
+#include "voxblox/mesh/mesh_integrator.h"
+#include "voxblox/simulation/simulation_world.h"
+#include "voxblox/utils/timing.h"
+
+using namespace voxblox;  // NOLINT
+
+typedef Layer<TsdfVoxel, FlatAnyIndexHashMapType, SoaVoxelStorage>
+    SoaTsdfLayer;
+
+class VoxelStorageTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    world_.setBounds(Point(-3.0, -3.0, -1.0), Point(3.0, 3.0, 3.0));
+    world_.addObject(std::unique_ptr<Object>(
+        new Sphere(Point(0.0, 0.0, 1.0), 1.0, Color::Red())));
+    world_.addGroundLevel(0.0);
+
+    aos_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    world_.generateSdfFromWorld(4 * kVoxelSize, aos_layer_.get());
+
+    // Copy the layer voxel by voxel into the structure of arrays layout.
+    soa_layer_.reset(new SoaTsdfLayer(kVoxelSize, kVoxelsPerSide));
+    aos_layer_->getAllAllocatedBlocks(&blocks_);
+    for (const BlockIndex& block_index : blocks_) {
+      const Block<TsdfVoxel>& aos_block =
+          aos_layer_->getBlockByIndex(block_index);
+      SoaTsdfLayer::BlockType::Ptr soa_block =
+          soa_layer_->allocateBlockPtrByIndex(block_index);
+      for (size_t i = 0u; i < aos_block.num_voxels(); ++i) {
+        soa_block->getVoxelByLinearIndex(i) =
+            aos_block.getVoxelByLinearIndex(i);
+      }
+      soa_block->set_has_data(aos_block.has_data());
+    }
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.1;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  SimulationWorld world_;
+  BlockIndexList blocks_;
+  std::unique_ptr<Layer<TsdfVoxel>> aos_layer_;
+  std::unique_ptr<SoaTsdfLayer> soa_layer_;
+};
+
+TEST_F(VoxelStorageTest, ProxiesWriteThroughToPlanes) {
+  SoaTsdfLayer::BlockType block(kVoxelsPerSide, kVoxelSize, Point::Zero());
+  TsdfVoxel voxel;
+  voxel.distance = 0.5f;
+  voxel.weight = 2.0f;
+  voxel.color = Color::Green();
+  block.getVoxelByLinearIndex(3u) = voxel;
+  block.getVoxelByLinearIndex(4u).weight += 1.0f;
+
+  EXPECT_EQ(block.voxels().distances()[3], 0.5f);
+  EXPECT_EQ(block.voxels().weights()[3], 2.0f);
+  EXPECT_EQ(block.voxels().colors()[3].g, Color::Green().g);
+  EXPECT_EQ(block.voxels().weights()[4], 1.0f);
+
+  const TsdfVoxel copy = block.getVoxelByLinearIndex(3u);
+  EXPECT_EQ(copy.distance, voxel.distance);
+  EXPECT_EQ(copy.weight, voxel.weight);
+
+  block.reinitialize(Point::Zero());
+  EXPECT_EQ(block.voxels().weights()[3], 0.0f);
+}
+
+TEST_F(VoxelStorageTest, SerializationMatches) {
+  for (const BlockIndex& block_index : blocks_) {
+    std::vector<uint32_t> aos_data;
+    std::vector<uint32_t> soa_data;
+    aos_layer_->getBlockByIndex(block_index).serializeToIntegers(&aos_data);
+    soa_layer_->getBlockByIndex(block_index).serializeToIntegers(&soa_data);
+    ASSERT_EQ(aos_data, soa_data);
+
+    SoaTsdfLayer::BlockType block(kVoxelsPerSide, kVoxelSize, Point::Zero());
+    block.deserializeFromIntegers(soa_data);
+    std::vector<uint32_t> round_trip_data;
+    block.serializeToIntegers(&round_trip_data);
+    ASSERT_EQ(soa_data, round_trip_data);
+  }
+}
+
+TEST_F(VoxelStorageTest, MeshMatches) {
+  MeshIntegratorConfig config;
+  MeshLayer aos_mesh_layer(aos_layer_->block_size());
+  MeshLayer soa_mesh_layer(soa_layer_->block_size());
+  MeshIntegrator<TsdfVoxel> aos_mesh_integrator(config, *aos_layer_,
+                                                &aos_mesh_layer);
+  MeshIntegrator<TsdfVoxel, SoaVoxelStorage> soa_mesh_integrator(
+      config, *soa_layer_, &soa_mesh_layer);
+  constexpr bool kOnlyMeshUpdatedBlocks = false;
+  constexpr bool kClearUpdatedFlag = false;
+  aos_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+  soa_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks, kClearUpdatedFlag);
+
+  ASSERT_EQ(aos_mesh_layer.getNumberOfAllocatedMeshes(),
+            soa_mesh_layer.getNumberOfAllocatedMeshes());
+  size_t num_vertices = 0u;
+  for (const BlockIndex& block_index : blocks_) {
+    const Mesh& aos_mesh = aos_mesh_layer.getMeshByIndex(block_index);
+    const Mesh& soa_mesh = soa_mesh_layer.getMeshByIndex(block_index);
+    ASSERT_EQ(aos_mesh.vertices.size(), soa_mesh.vertices.size());
+    for (size_t i = 0u; i < aos_mesh.vertices.size(); ++i) {
+      EXPECT_EQ(aos_mesh.vertices[i], soa_mesh.vertices[i]);
+      EXPECT_EQ(aos_mesh.colors[i].r, soa_mesh.colors[i].r);
+    }
+    num_vertices += aos_mesh.vertices.size();
+  }
+  EXPECT_GT(num_vertices, 0u);
+}
+
+TEST_F(VoxelStorageTest, EsdfMatches) {
+  EsdfIntegrator::Config config;
+  Layer<EsdfVoxel> aos_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  Layer<EsdfVoxel> soa_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator aos_esdf_integrator(config, aos_layer_.get(),
+                                     &aos_esdf_layer);
+  EsdfIntegrator soa_esdf_integrator(config, &soa_esdf_layer);
+  aos_esdf_integrator.updateFromTsdfBlocks(blocks_);
+  soa_esdf_integrator.updateFromTsdfBlocks(*soa_layer_, blocks_);
+
+  ASSERT_EQ(aos_esdf_layer.getNumberOfAllocatedBlocks(),
+            soa_esdf_layer.getNumberOfAllocatedBlocks());
+  for (const BlockIndex& block_index : blocks_) {
+    const Block<EsdfVoxel>& aos_block =
+        aos_esdf_layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& soa_block =
+        soa_esdf_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < aos_block.num_voxels(); ++i) {
+      ASSERT_EQ(aos_block.getVoxelByLinearIndex(i).distance,
+                soa_block.getVoxelByLinearIndex(i).distance);
+      ASSERT_EQ(aos_block.getVoxelByLinearIndex(i).observed,
+                soa_block.getVoxelByLinearIndex(i).observed);
+    }
+  }
+}
+
+TEST_F(VoxelStorageTest, InterpolatorMatches) {
+  Interpolator<TsdfVoxel> aos_interpolator(aos_layer_.get());
+  Interpolator<TsdfVoxel, SoaVoxelStorage> soa_interpolator(soa_layer_.get());
+
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<FloatingPoint> dis(-2.5, 2.5);
+  constexpr bool kInterpolate = true;
+  size_t num_valid = 0u;
+  for (size_t i = 0u; i < 1000u; ++i) {
+    const Point point(dis(gen), dis(gen), dis(gen) + 0.5);
+    FloatingPoint aos_distance = 0.0f;
+    FloatingPoint soa_distance = 0.0f;
+    const bool aos_valid =
+        aos_interpolator.getDistance(point, &aos_distance, kInterpolate);
+    const bool soa_valid =
+        soa_interpolator.getDistance(point, &soa_distance, kInterpolate);
+    ASSERT_EQ(aos_valid, soa_valid);
+    if (aos_valid) {
+      EXPECT_EQ(aos_distance, soa_distance);
+      ++num_valid;
+    }
+
+    TsdfVoxel aos_voxel;
+    TsdfVoxel soa_voxel;
+    ASSERT_EQ(aos_interpolator.getVoxel(point, &aos_voxel, kInterpolate),
+              soa_interpolator.getVoxel(point, &soa_voxel, kInterpolate));
+    EXPECT_EQ(aos_voxel.color.r, soa_voxel.color.r);
+  }
+  EXPECT_GT(num_valid, 0u);
+}
+
+TEST_F(VoxelStorageTest, Benchmark) {
+  constexpr int kNumRepetitions = 5;
+  MeshIntegratorConfig mesh_config;
+  mesh_config.integrator_threads = 1;
+  EsdfIntegrator::Config esdf_config;
+  constexpr bool kOnlyMeshUpdatedBlocks = false;
+  constexpr bool kClearUpdatedFlag = false;
+
+  timing::Timing::Reset();
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    MeshLayer aos_mesh_layer(aos_layer_->block_size());
+    MeshIntegrator<TsdfVoxel> aos_mesh_integrator(mesh_config, *aos_layer_,
+                                                  &aos_mesh_layer);
+    timing::Timer aos_mesh_timer("aos/mesh");
+    aos_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks,
+                                     kClearUpdatedFlag);
+    aos_mesh_timer.Stop();
+
+    MeshLayer soa_mesh_layer(soa_layer_->block_size());
+    MeshIntegrator<TsdfVoxel, SoaVoxelStorage> soa_mesh_integrator(
+        mesh_config, *soa_layer_, &soa_mesh_layer);
+    timing::Timer soa_mesh_timer("soa/mesh");
+    soa_mesh_integrator.generateMesh(kOnlyMeshUpdatedBlocks,
+                                     kClearUpdatedFlag);
+    soa_mesh_timer.Stop();
+
+    Layer<EsdfVoxel> aos_esdf_layer(kVoxelSize, kVoxelsPerSide);
+    EsdfIntegrator aos_esdf_integrator(esdf_config, aos_layer_.get(),
+                                       &aos_esdf_layer);
+    timing::Timer aos_esdf_timer("aos/esdf");
+    aos_esdf_integrator.updateFromTsdfBlocks(blocks_);
+    aos_esdf_timer.Stop();
+
+    Layer<EsdfVoxel> soa_esdf_layer(kVoxelSize, kVoxelsPerSide);
+    EsdfIntegrator soa_esdf_integrator(esdf_config, &soa_esdf_layer);
+    timing::Timer soa_esdf_timer("soa/esdf");
+    soa_esdf_integrator.updateFromTsdfBlocks(*soa_layer_, blocks_);
+    soa_esdf_timer.Stop();
+
+    // Counting observed voxels only touches the weights, over the planes this
+    // is a plain loop the compiler can vectorize.
+    size_t aos_num_observed = 0u;
+    timing::Timer aos_count_timer("aos/count_observed");
+    for (const BlockIndex& block_index : blocks_) {
+      const Block<TsdfVoxel>& block = aos_layer_->getBlockByIndex(block_index);
+      for (size_t j = 0u; j < block.num_voxels(); ++j) {
+        aos_num_observed += block.getVoxelByLinearIndex(j).weight > 0.0f;
+      }
+    }
+    aos_count_timer.Stop();
+
+    size_t soa_num_observed = 0u;
+    timing::Timer soa_count_timer("soa/count_observed");
+    for (const BlockIndex& block_index : blocks_) {
+      const SoaTsdfLayer::BlockType& block =
+          soa_layer_->getBlockByIndex(block_index);
+      const float* weights = block.voxels().weights();
+      for (size_t j = 0u; j < block.num_voxels(); ++j) {
+        soa_num_observed += weights[j] > 0.0f;
+      }
+    }
+    soa_count_timer.Stop();
+    EXPECT_EQ(aos_num_observed, soa_num_observed);
+  }
+  std::cout << timing::Timing::Print();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
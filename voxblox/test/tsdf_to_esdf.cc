@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <thread>
 
 #include <glog/logging.h>
 
@@ -16,11 +18,12 @@ using namespace voxblox;  // NOLINT
 int main(int argc, char** argv) {
   google::InitGoogleLogging(argv[0]);
 
-  if (argc != 7) {
+  if (argc != 7 && argc != 8) {
     throw std::runtime_error(
         std::string("Args: filename to load, filename to save to") +
         ", min weight, min fixed distance" +
-        ", max esdf distance, default esdf distance");
+        ", max esdf distance, default esdf distance" +
+        ", optionally the batch method: exact (default) or propagate");
   }
 
   const std::string file = argv[1];
@@ -28,6 +31,10 @@ int main(int argc, char** argv) {
   const FloatingPoint min_distance_m = std::stof(argv[4]);
   const FloatingPoint max_distance_m = std::stof(argv[5]);
   const FloatingPoint default_distance_m = std::stof(argv[6]);
+  const std::string batch_method = argc > 7 ? argv[7] : "exact";
+  if (batch_method != "exact" && batch_method != "propagate") {
+    throw std::runtime_error("Unknown batch method: " + batch_method);
+  }
 
   Layer<TsdfVoxel>::Ptr layer_from_file;
   io::LoadLayer<TsdfVoxel>(file, &layer_from_file);
@@ -48,6 +55,10 @@ int main(int argc, char** argv) {
   esdf_integrator_config.min_distance_m = min_distance_m;
   esdf_integrator_config.max_distance_m = max_distance_m;
   esdf_integrator_config.default_distance_m = default_distance_m;
+  // The map is generated offline, so the distances might as well be exact.
+  esdf_integrator_config.exact_batch_distance = batch_method == "exact";
+  esdf_integrator_config.propagation_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
 
   EsdfMap esdf_map(esdf_config);
   EsdfIntegrator esdf_integrator(esdf_integrator_config, layer_from_file.get(),
@@ -46,6 +46,8 @@ class EsdfServer : public TsdfServer {
   void updateEsdf();
   /// Update the ESDF all at once; clear the existing map.
   void updateEsdfBatch(bool full_euclidean = false);
+  /// Rebuilds the coarse level of the ESDF map if it has one.
+  void updateEsdfCoarseLevel();
 
   // Overwrites the layer with what's coming from the topic!
   void esdfMapCallback(const voxblox_msgs::Layer& layer_msg);
@@ -50,7 +50,11 @@ template <typename VoxelType>
 using ShouldVisualizeVoxelFunctionType =
     std::function<bool(const VoxelType& voxel, const Point& coord)>;  // NOLINT;
 
-/// Template function to visualize a colored pointcloud.
+/**
+ * Template function to visualize a colored pointcloud. Only the voxels in the
+ * observed mask of each block are passed to vis_function, default constructed
+ * voxels are never visualized.
+ */
 template <typename VoxelType>
 void createColorPointcloudFromLayer(
     const Layer<VoxelType>& layer,
@@ -61,10 +65,6 @@ void createColorPointcloudFromLayer(
   BlockIndexList blocks;
   layer.getAllAllocatedBlocks(&blocks);
 
-  // Cache layer settings.
-  size_t vps = layer.voxels_per_side();
-  size_t num_voxels_per_block = vps * vps * vps;
-
   // Temp variables.
   Color color;
   // Iterate over all blocks.
@@ -72,8 +72,7 @@ void createColorPointcloudFromLayer(
     // Iterate over all voxels in said blocks.
     const Block<VoxelType>& block = layer.getBlockByIndex(index);
 
-    for (size_t linear_index = 0; linear_index < num_voxels_per_block;
-         ++linear_index) {
+    block.forEachObservedVoxel([&](size_t linear_index) {
       Point coord = block.computeCoordinatesFromLinearIndex(linear_index);
       if (vis_function(block.getVoxelByLinearIndex(linear_index), coord,
                        &color)) {
@@ -86,11 +85,11 @@ void createColorPointcloudFromLayer(
         point.b = color.b;
         pointcloud->push_back(point);
       }
-    }
+    });
   }
 }
 
-/// Template function to visualize an intensity pointcloud.
+/// Same as above for an intensity pointcloud.
 template <typename VoxelType>
 void createColorPointcloudFromLayer(
     const Layer<VoxelType>& layer,
@@ -101,10 +100,6 @@ void createColorPointcloudFromLayer(
   BlockIndexList blocks;
   layer.getAllAllocatedBlocks(&blocks);
 
-  // Cache layer settings.
-  size_t vps = layer.voxels_per_side();
-  size_t num_voxels_per_block = vps * vps * vps;
-
   // Temp variables.
   double intensity = 0.0;
   // Iterate over all blocks.
@@ -112,8 +107,7 @@ void createColorPointcloudFromLayer(
     // Iterate over all voxels in said blocks.
     const Block<VoxelType>& block = layer.getBlockByIndex(index);
 
-    for (size_t linear_index = 0; linear_index < num_voxels_per_block;
-         ++linear_index) {
+    block.forEachObservedVoxel([&](size_t linear_index) {
       Point coord = block.computeCoordinatesFromLinearIndex(linear_index);
       if (vis_function(block.getVoxelByLinearIndex(linear_index), coord,
                        &intensity)) {
@@ -124,7 +118,7 @@ void createColorPointcloudFromLayer(
         point.intensity = intensity;
         pointcloud->push_back(point);
       }
-    }
+    });
   }
 }
 
@@ -7,6 +7,7 @@
 #include <voxblox/core/esdf_map.h>
 #include <voxblox/core/tsdf_map.h>
 #include <voxblox/integrator/esdf_integrator.h>
+#include <voxblox/integrator/pointcloud_downsampler.h>
 #include <voxblox/integrator/tsdf_integrator.h>
 #include <voxblox/mesh/mesh_integrator.h>
 
@@ -80,6 +81,8 @@ inline TsdfIntegratorBase::Config getTsdfIntegratorConfigFromRosParam(
   nh_private.param("max_weight", max_weight, max_weight);
   nh_private.param("use_const_weight", integrator_config.use_const_weight,
                    integrator_config.use_const_weight);
+  nh_private.param("sensor_noise_model", integrator_config.sensor_noise_model,
+                   integrator_config.sensor_noise_model);
   nh_private.param("use_weight_dropoff", integrator_config.use_weight_dropoff,
                    integrator_config.use_weight_dropoff);
   nh_private.param("allow_clear", integrator_config.allow_clear,
@@ -96,6 +99,8 @@ inline TsdfIntegratorBase::Config getTsdfIntegratorConfigFromRosParam(
   nh_private.param("max_integration_time_s",
                    integrator_config.max_integration_time_s,
                    integrator_config.max_integration_time_s);
+  nh_private.param("track_dirty_voxels", integrator_config.track_dirty_voxels,
+                   integrator_config.track_dirty_voxels);
   nh_private.param("anti_grazing", integrator_config.enable_anti_grazing,
                    integrator_config.enable_anti_grazing);
   nh_private.param("use_sparsity_compensation_factor",
@@ -107,6 +112,9 @@ inline TsdfIntegratorBase::Config getTsdfIntegratorConfigFromRosParam(
   nh_private.param("integration_order_mode",
                    integrator_config.integration_order_mode,
                    integrator_config.integration_order_mode);
+  nh_private.param("use_voxel_spin_locks",
+                   integrator_config.use_voxel_spin_locks,
+                   integrator_config.use_voxel_spin_locks);
 
   integrator_config.default_truncation_distance =
       static_cast<float>(truncation_distance);
@@ -115,6 +123,17 @@ inline TsdfIntegratorBase::Config getTsdfIntegratorConfigFromRosParam(
   return integrator_config;
 }
 
+inline PointcloudDownsampler::Config
+getPointcloudDownsamplerConfigFromRosParam(const ros::NodeHandle& nh_private) {
+  PointcloudDownsampler::Config downsampler_config;
+
+  nh_private.param("pointcloud_downsampling_voxel_size",
+                   downsampler_config.voxel_size,
+                   downsampler_config.voxel_size);
+
+  return downsampler_config;
+}
+
 inline EsdfMap::Config getEsdfMapConfigFromRosParam(
     const ros::NodeHandle& nh_private) {
   EsdfMap::Config esdf_config;
@@ -123,6 +142,12 @@ inline EsdfMap::Config getEsdfMapConfigFromRosParam(
   esdf_config.esdf_voxel_size = tsdf_config.tsdf_voxel_size;
   esdf_config.esdf_voxels_per_side = tsdf_config.tsdf_voxels_per_side;
 
+  double coarse_max_distance_m = esdf_config.coarse_max_distance_m;
+  nh_private.param("esdf_coarse_max_distance_m", coarse_max_distance_m,
+                   coarse_max_distance_m);
+  esdf_config.coarse_max_distance_m =
+      static_cast<FloatingPoint>(coarse_max_distance_m);
+
   return esdf_config;
 }
 
@@ -157,6 +182,25 @@ inline EsdfIntegrator::Config getEsdfIntegratorConfigFromRosParam(
   nh_private.param("esdf_add_occupied_crust",
                    esdf_integrator_config.add_occupied_crust,
                    esdf_integrator_config.add_occupied_crust);
+  nh_private.param("esdf_exact_batch_distance",
+                   esdf_integrator_config.exact_batch_distance,
+                   esdf_integrator_config.exact_batch_distance);
+  nh_private.param("esdf_rolling_window_blocks",
+                   esdf_integrator_config.rolling_window_blocks,
+                   esdf_integrator_config.rolling_window_blocks);
+  nh_private.param("esdf_max_update_time_s",
+                   esdf_integrator_config.max_update_time_s,
+                   esdf_integrator_config.max_update_time_s);
+  int propagation_threads =
+      static_cast<int>(esdf_integrator_config.propagation_threads);
+  nh_private.param("esdf_propagation_threads", propagation_threads,
+                   propagation_threads);
+  if (propagation_threads < 1) {
+    ROS_ERROR("esdf_propagation_threads must be positive, setting it to 1");
+    propagation_threads = 1;
+  }
+  esdf_integrator_config.propagation_threads =
+      static_cast<size_t>(propagation_threads);
   if (esdf_integrator_config.default_distance_m <
       esdf_integrator_config.max_distance_m) {
     esdf_integrator_config.default_distance_m =
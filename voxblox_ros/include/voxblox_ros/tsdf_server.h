@@ -1,6 +1,7 @@
 #ifndef VOXBLOX_ROS_TSDF_SERVER_H_
 #define VOXBLOX_ROS_TSDF_SERVER_H_
 
+#include <algorithm>
 #include <memory>
 #include <queue>
 #include <string>
@@ -18,11 +19,13 @@
 
 #include <voxblox/alignment/icp.h>
 #include <voxblox/core/tsdf_map.h>
+#include <voxblox/integrator/pointcloud_downsampler.h>
 #include <voxblox/integrator/tsdf_integrator.h>
 #include <voxblox/io/layer_io.h>
 #include <voxblox/io/mesh_ply.h>
 #include <voxblox/mesh/mesh_integrator.h>
 #include <voxblox/utils/color_maps.h>
+#include <voxblox/utils/thread_pool.h>
 #include <voxblox_msgs/FilePath.h>
 #include <voxblox_msgs/Mesh.h>
 
@@ -235,6 +238,16 @@ class TsdfServer {
   /// ICP matcher
   std::shared_ptr<ICP> icp_;
 
+  /// Merges the points of each cell before integration, if enabled.
+  bool downsample_pointclouds_;
+  std::unique_ptr<PointcloudDownsampler> pointcloud_downsampler_;
+  Pointcloud downsampled_points_C_;
+  Colors downsampled_colors_;
+  std::vector<float> downsampled_weights_;
+
+  /// Workers shared by the integrator, the mesh integrator and ICP.
+  ThreadPool::Ptr thread_pool_;
+
   // Mesh accessories.
   std::shared_ptr<MeshLayer> mesh_layer_;
   std::unique_ptr<MeshIntegrator<TsdfVoxel>> mesh_integrator_;
@@ -193,6 +193,16 @@ void EsdfServer::updateEsdf() {
   if (tsdf_map_->getTsdfLayer().getNumberOfAllocatedBlocks() > 0) {
     const bool clear_updated_flag_esdf = true;
     esdf_integrator_->updateFromTsdfLayer(clear_updated_flag_esdf);
+    updateEsdfCoarseLevel();
+    const EsdfIntegrator::UpdateBacklog backlog =
+        esdf_integrator_->getUpdateBacklog();
+    if (verbose_ &&
+        (backlog.num_blocks > 0u || backlog.num_queued_voxels > 0u)) {
+      ROS_INFO(
+          "Left %lu blocks and %lu queued voxels of the ESDF update to meet "
+          "esdf_max_update_time_s.",
+          backlog.num_blocks, backlog.num_queued_voxels);
+    }
   }
 }
 
@@ -200,6 +210,13 @@ void EsdfServer::updateEsdfBatch(bool full_euclidean) {
   if (tsdf_map_->getTsdfLayer().getNumberOfAllocatedBlocks() > 0) {
     esdf_integrator_->setFullEuclidean(full_euclidean);
     esdf_integrator_->updateFromTsdfLayerBatch();
+    updateEsdfCoarseLevel();
+  }
+}
+
+void EsdfServer::updateEsdfCoarseLevel() {
+  if (esdf_map_->usesCoarseLevel()) {
+    esdf_map_->updateCoarseLevel(esdf_integrator_->getEsdfMaxDistance());
   }
 }
 
@@ -223,6 +240,10 @@ void EsdfServer::newPoseCallback(const Transformation& T_G_C) {
   if (clear_sphere_for_planning_) {
     esdf_integrator_->addNewRobotPosition(T_G_C.getPosition());
   }
+  esdf_integrator_->setUpdatePriorityCenter(T_G_C.getPosition());
+  if (esdf_integrator_->hasRollingWindow()) {
+    esdf_integrator_->setRollingWindowCenter(T_G_C.getPosition());
+  }
 
   timing::Timer block_remove_timer("remove_distant_blocks");
   esdf_map_->getEsdfLayerPtr()->removeDistantBlocks(
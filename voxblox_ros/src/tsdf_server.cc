@@ -38,6 +38,7 @@ TsdfServer::TsdfServer(const ros::NodeHandle& nh,
       accumulate_icp_corrections_(true),
       pointcloud_queue_size_(1),
       num_subscribers_tsdf_map_(0),
+      downsample_pointclouds_(false),
       transformer_(nh, nh_private) {
   getServerConfigFromRosParam(nh_private);
 
@@ -112,6 +113,23 @@ TsdfServer::TsdfServer(const ros::NodeHandle& nh,
 
   icp_.reset(new ICP(getICPConfigFromRosParam(nh_private)));
 
+  // The integrator, the mesher and ICP share the workers, the calling thread
+  // takes part in the work as well.
+  thread_pool_ = std::make_shared<ThreadPool>(
+      std::max<size_t>(integrator_config.integrator_threads, 1u) - 1u);
+  tsdf_integrator_->setThreadPool(thread_pool_);
+  mesh_integrator_->setThreadPool(thread_pool_);
+  icp_->setThreadPool(thread_pool_);
+
+  if (downsample_pointclouds_) {
+    PointcloudDownsampler::Config downsampler_config =
+        getPointcloudDownsamplerConfigFromRosParam(nh_private);
+    downsampler_config.num_threads = integrator_config.integrator_threads;
+    pointcloud_downsampler_.reset(
+        new PointcloudDownsampler(downsampler_config));
+    pointcloud_downsampler_->setThreadPool(thread_pool_);
+  }
+
   // Advertise services.
   generate_mesh_srv_ = nh_private_.advertiseService(
       "generate_mesh", &TsdfServer::generateMeshCallback, this);
@@ -176,6 +194,8 @@ void TsdfServer::getServerConfigFromRosParam(
   nh_private.param("enable_icp", enable_icp_, enable_icp_);
   nh_private.param("accumulate_icp_corrections", accumulate_icp_corrections_,
                    accumulate_icp_corrections_);
+  nh_private.param("downsample_pointclouds", downsample_pointclouds_,
+                   downsample_pointclouds_);
 
   nh_private.param("verbose", verbose_, verbose_);
 
@@ -309,6 +329,14 @@ void TsdfServer::processPointCloudMessageAndInsert(
     ROS_INFO("Finished integrating in %f seconds, have %lu blocks.",
              (end - start).toSec(),
              tsdf_map_->getTsdfLayer().getNumberOfAllocatedBlocks());
+    const TsdfIntegratorBase::IntegrationStats& integration_stats =
+        tsdf_integrator_->getLastIntegrationStats();
+    if (integration_stats.num_dropped_points > 0u) {
+      ROS_INFO("Dropped %lu of %lu points to meet max_integration_time_s.",
+               integration_stats.num_dropped_points,
+               integration_stats.num_dropped_points +
+                   integration_stats.num_integrated_points);
+    }
   }
 
   timing::Timer block_remove_timer("remove_distant_blocks");
@@ -409,6 +437,16 @@ void TsdfServer::integratePointcloud(const Transformation& T_G_C,
                                      const Colors& colors,
                                      const bool is_freespace_pointcloud) {
   CHECK_EQ(ptcloud_C.size(), colors.size());
+  if (pointcloud_downsampler_) {
+    pointcloud_downsampler_->downsample(ptcloud_C, colors,
+                                        &downsampled_points_C_,
+                                        &downsampled_colors_,
+                                        &downsampled_weights_);
+    tsdf_integrator_->integrateWeightedPointCloud(
+        T_G_C, downsampled_points_C_, downsampled_colors_,
+        downsampled_weights_, is_freespace_pointcloud);
+    return;
+  }
   tsdf_integrator_->integratePointCloud(T_G_C, ptcloud_C, colors,
                                         is_freespace_pointcloud);
 }